@@ -5,6 +5,7 @@ import android.app.AlertDialog
 import android.content.Intent
 import android.os.Build
 import android.os.Bundle
+import android.os.SystemClock
 import android.util.Log
 import android.view.View
 import android.widget.TextView
@@ -15,7 +16,6 @@ import com.github.mikephil.charting.charts.LineChart
 import com.github.mikephil.charting.data.Entry
 import com.github.mikephil.charting.data.LineData
 import com.github.mikephil.charting.data.LineDataSet
-import java.time.Instant
 import kotlinx.serialization.*
 import kotlinx.serialization.json.Json
 
@@ -28,7 +28,58 @@ class MainActivity : AppCompatActivity() {
     private lateinit var tempChart: LineChart
     private var vocDataset = mutableListOf<LineDataSet>(LineDataSet(mutableListOf<Entry>(), "VOC Fridge Top"), LineDataSet(mutableListOf<Entry>(), "VOC Fridge Bottom"))
     private var tempDataset = mutableListOf<LineDataSet>(LineDataSet(mutableListOf<Entry>(), "Temp Fridge Top"), LineDataSet(mutableListOf<Entry>(), "Temp Fridge Bottom"))
-    private var counts = mutableListOf<Float>(5f, 5f)
+    // The x axis is seconds since the app started
+    private val startMs = SystemClock.elapsedRealtime()
+    private val sequenceTracker = SequenceTracker()
+
+    // Plots one puck's reading, the top sensor also drives the VOC alert and the text readouts
+    // Readings from a sensor that failed its self-check are plotted but never raise the alert
+    // Stamped readings are plotted at the time they were taken, anything else at the time it arrived
+    @SuppressLint("SetTextI18n")
+    private fun onReading(client: Int, voc: Float, temp: Float, status: Int = MetricsRecord.STATUS_OK, age: Int = 0) {
+        val targetClient = 0xDC
+        val series = if (client == targetClient) 0 else 1
+        val time = (SystemClock.elapsedRealtime() - startMs) / 1000f - age
+
+        try {
+            // Batched readings can arrive after newer ones from the same puck
+            vocDataset[series].addEntryOrdered(Entry(time, voc))
+            tempDataset[series].addEntryOrdered(Entry(time, temp))
+
+            if (series == 0 && status == MetricsRecord.STATUS_OK) {
+                lineOfBestFit.check(client, voc)
+            }
+
+            val lineData = LineData()
+            val lineData2 = LineData()
+            for (vocData in vocDataset) {
+                lineData.addDataSet(vocData)
+
+            }
+            for (tempData in tempDataset){
+                lineData2.addDataSet(tempData)
+            }
+
+            vocConcentrationChart.data = lineData
+            tempChart.data = lineData2
+
+            vocConcentrationChart.notifyDataSetChanged()
+            tempChart.notifyDataSetChanged()
+
+            vocConcentrationChart.invalidate()
+            tempChart.invalidate()
+
+            if (series == 0) {
+                val vocText = findViewById<View>(R.id.VOCConcentration) as TextView
+                vocText.text = voc.toString() + "mg/m^3" + if (status == MetricsRecord.STATUS_DAMAGED) " (sensor fault)" else ""
+
+                val tempText = findViewById<View>(R.id.temperature) as TextView
+                tempText.text = temp.toString() + "C"
+            }
+        } catch (e: Exception){
+            Log.e("Error with text", e.toString())
+        }
+    }
 
     private val socketListener = object : WebSocketClient.SocketListener {
         @RequiresApi(Build.VERSION_CODES.O)
@@ -43,73 +94,26 @@ class MainActivity : AppCompatActivity() {
                 var battLvl = parts[2].toInt()
                 var client = parts[3].toInt()
 
-                val targetClient = 0xDC
-
-                if (client == targetClient) {
-                    try {
-                        val currentTime = Instant.now().epochSecond
-                        Log.e("current time", currentTime.toString())
-                        vocDataset[0].addEntry(Entry(counts[0], voc))
-                        tempDataset[0].addEntry(Entry(counts[0], temp))
-
-                        counts[0] += 5f
-
-                        lineOfBestFit.check(client, voc)
-
-                        val lineData = LineData()
-                        val lineData2 = LineData()
-                        for (vocData in vocDataset) {
-                            lineData.addDataSet(vocData)
-
-                        }
-                        for (tempData in tempDataset){
-                            lineData2.addDataSet(tempData)
-                        }
-
-                        vocConcentrationChart.data = lineData
-                        tempChart.data = lineData2
-
-                        vocConcentrationChart.notifyDataSetChanged()
-                        tempChart.notifyDataSetChanged()
-
-                        vocConcentrationChart.invalidate()
-                        tempChart.invalidate()
-
-                        val vocText = findViewById<View>(R.id.VOCConcentration) as TextView
-                        vocText.text = voc.toString() + "mg/m^3"
-
-                        val tempText = findViewById<View>(R.id.temperature) as TextView
-                        tempText.text = temp.toString() + "C"
-                    } catch (e: Exception){
-                        Log.e("Error with text", e.toString())
-                    }
-                } else {
-                    try {
-                        vocDataset[1].addEntry(Entry(counts[1], voc))
-                        tempDataset[1].addEntry(Entry(counts[1], temp))
-
-                        counts[1] += 5f
-
-                        val lineData = LineData()
-                        val lineData2 = LineData()
-                        for (vocData in vocDataset) {
-                            lineData.addDataSet(vocData)
-
-                        }
-                        for (tempData in tempDataset){
-                            lineData2.addDataSet(tempData)
-                        }
-
-                        vocConcentrationChart.data = lineData
-                        tempChart.data = lineData2
-
-                        vocConcentrationChart.notifyDataSetChanged()
-                        tempChart.notifyDataSetChanged()
-
-                        vocConcentrationChart.invalidate()
-                        tempChart.invalidate()
-                    } catch (e: Exception){
-                        Log.e("Error with text", e.toString())
+                onReading(client, voc, temp)
+            } else if (message.startsWith("Metrics")) {
+                val final_message = message.substring(7)
+                val parts = final_message.split(";")
+                var client = parts[0].toInt()
+                val record = MetricsRecord.fromHex(parts[1])
+                val missingBefore = sequenceTracker.missing
+
+                if (record == null) {
+                    Log.e("Bad metrics record", message)
+                } else if (record.seq != null && !sequenceTracker.accept(client, record.seq)) {
+                    Log.e("Duplicate reading", "$client #${record.seq}, ${sequenceTracker.duplicates} so far")
+                } else if (record.status == MetricsRecord.STATUS_WARMUP) {
+                    // Pucks normally hold these back, they aren't meaningful enough to plot
+                    Log.e("Warm-up reading", record.toString())
+                } else if (record.tvoc != null && record.temperature != null) {
+                    Log.e("metrics", record.toString())
+                    onReading(client, record.tvoc, record.temperature, record.status ?: MetricsRecord.STATUS_OK, record.age ?: 0)
+                    if (sequenceTracker.missing > missingBefore) {
+                        Log.e("Missing readings", "${sequenceTracker.missing} so far")
                     }
                 }
             } else if (message.startsWith("System")) {
@@ -191,8 +195,9 @@ class MainActivity : AppCompatActivity() {
         vocConcentrationChart = findViewById<View>(R.id.voc_concentration_chart) as LineChart
         tempChart = findViewById<View>(R.id.temperature_chart) as LineChart
 
-        vocConcentrationChart.setVisibleXRangeMaximum(25F)
-        tempChart.setVisibleXRangeMaximum(25F)
+        // Half an hour, pucks can go quiet for up to 15 minutes while nothing is changing
+        vocConcentrationChart.setVisibleXRangeMaximum(1800F)
+        tempChart.setVisibleXRangeMaximum(1800F)
 
         val numbers = listOf(listOf(0,0));
         val numbersSecond = listOf(listOf(0,0));
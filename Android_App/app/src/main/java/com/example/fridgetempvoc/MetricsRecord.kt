@@ -0,0 +1,91 @@
+package com.example.fridgetempvoc
+
+// Multi-metric reading written by a puck and passed through the base station untouched:
+// | 0xA0 | Mask | TVOC (4) | eCO2 (2) | EtOH (2) | IAQ (1) | Temp (2) | Battery (1) | Status (1) | Seq (2) | Age (2) |
+// Only the fields set in the mask are present, in bit order, big endian. Fields the puck left out are null.
+data class MetricsRecord(
+    val tvoc: Float?,           // mg/m^3
+    val eco2: Int?,             // ppm
+    val etoh: Float?,           // ppm
+    val iaq: Float?,
+    val temperature: Float?,    // C
+    val battery: Int?,          // %
+    val status: Int?,
+    val seq: Int?,              // Per puck, wraps at 16 bits
+    val age: Int?,              // Seconds between the reading being taken and the puck sending it
+) {
+    companion object {
+        const val TAG = 0xA0
+
+        const val FIELD_TVOC = 1 shl 0
+        const val FIELD_ECO2 = 1 shl 1
+        const val FIELD_ETOH = 1 shl 2
+        const val FIELD_IAQ = 1 shl 3
+        const val FIELD_TEMP = 1 shl 4
+        const val FIELD_BATTERY = 1 shl 5
+        const val FIELD_STATUS = 1 shl 6
+        const val FIELD_STAMP = 1 shl 7
+
+        const val STATUS_OK = 0
+        const val STATUS_WARMUP = 1
+        const val STATUS_DAMAGED = 2
+
+        fun fromHex(hex: String): MetricsRecord? {
+            if (hex.length % 2 != 0) {
+                return null
+            }
+            val bytes = try {
+                hex.chunked(2).map { it.toInt(16) }
+            } catch (e: NumberFormatException) {
+                return null
+            }
+            return decode(bytes)
+        }
+
+        fun decode(bytes: List<Int>): MetricsRecord? {
+            if (bytes.size < 2 || bytes[0] != TAG) {
+                return null
+            }
+            val fields = bytes[1]
+
+            var idx = 2
+            fun take(size: Int, field: Int): Int? {
+                if (fields and field == 0) {
+                    return null
+                }
+                if (idx + size > bytes.size) {
+                    throw IndexOutOfBoundsException()
+                }
+                var value = 0
+                repeat(size) { value = (value shl 8) or bytes[idx++] }
+                return value
+            }
+
+            return try {
+                val tvoc = take(4, FIELD_TVOC)
+                val eco2 = take(2, FIELD_ECO2)
+                val etoh = take(2, FIELD_ETOH)
+                val iaq = take(1, FIELD_IAQ)
+                val temp = take(2, FIELD_TEMP)
+                val battery = take(1, FIELD_BATTERY)
+                val status = take(1, FIELD_STATUS)
+                val seq = take(2, FIELD_STAMP)
+                val age = take(2, FIELD_STAMP)
+                MetricsRecord(
+                    tvoc = tvoc?.let { it / 10000f },
+                    eco2 = eco2,
+                    etoh = etoh?.let { it / 100f },
+                    iaq = iaq?.let { it / 10f },
+                    // Sign extend, fridge and freezer temperatures go below zero
+                    temperature = temp?.let { it.toShort() / 10f },
+                    battery = battery,
+                    status = status,
+                    seq = seq,
+                    age = age,
+                )
+            } catch (e: IndexOutOfBoundsException) {
+                null
+            }
+        }
+    }
+}
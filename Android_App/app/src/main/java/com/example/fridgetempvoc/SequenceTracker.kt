@@ -0,0 +1,52 @@
+package com.example.fridgetempvoc
+
+// Spots repeated and missing readings from each puck by their 16 bit sequence numbers.
+// A repeat is a reading the base station passed on twice (a retried upload whose first attempt
+// actually made it), a gap is readings lost somewhere between the puck and here.
+class SequenceTracker {
+    private class PuckState(var lastSeq: Int) {
+        // Recently seen numbers, so a late reading can be told apart from a repeat
+        val recent = ArrayDeque<Int>()
+    }
+
+    private val pucks = mutableMapOf<Int, PuckState>()
+    var duplicates = 0
+        private set
+    var missing = 0
+        private set
+
+    // Returns false if the reading has been seen before and should be dropped
+    fun accept(client: Int, seq: Int): Boolean {
+        val state = pucks[client]
+        if (state == null) {
+            pucks[client] = PuckState(seq).also { remember(it, seq) }
+            return true
+        }
+        if (seq in state.recent) {
+            duplicates++
+            return false
+        }
+
+        val ahead = (seq - state.lastSeq) and 0xFFFF
+        if (ahead < 0x8000) {
+            missing += ahead - 1
+            state.lastSeq = seq
+        } else if (missing > 0) {
+            // Late, it fills in a gap counted earlier
+            missing--
+        }
+        remember(state, seq)
+        return true
+    }
+
+    private fun remember(state: PuckState, seq: Int) {
+        state.recent.addLast(seq)
+        if (state.recent.size > RECENT_WINDOW) {
+            state.recent.removeFirst()
+        }
+    }
+
+    companion object {
+        private const val RECENT_WINDOW = 64
+    }
+}
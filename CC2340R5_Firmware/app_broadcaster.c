@@ -105,12 +105,24 @@ const BLEAppUtil_AdvInit_t broadcasterInitAdvSet1 =
     .advParam        = &advParams1
 };
 
+// Nothing connects to the puck, it only advertises for a while after boot so it can be
+// spotted with a scanner. 0 advertises forever.
+#ifndef BROADCASTER_ADV_DURATION_MS
+#define BROADCASTER_ADV_DURATION_MS 30000
+#endif
+
 const BLEAppUtil_AdvStart_t broadcasterStartAdvSet1 =
 {
+#if BROADCASTER_ADV_DURATION_MS
+  /* Duration is in 10 ms units */
+  .enableOptions         = GAP_ADV_ENABLE_OPTIONS_USE_DURATION,
+  .durationOrMaxEvents   = BROADCASTER_ADV_DURATION_MS / 10
+#else
   /* Use the maximum possible value. This is the spec-defined maximum for */
   /* directed advertising and infinite advertising for all other types */
   .enableOptions         = GAP_ADV_ENABLE_OPTIONS_USE_MAX,
   .durationOrMaxEvents   = 0
+#endif
 };
 
 //*****************************************************************************
@@ -70,6 +70,9 @@ Target Device: cc23xx
 #include <ti/bleapp/ble_app_util/inc/bleapputil_api.h>
 #include <ti/bleapp/menu_module/menu_module.h>
 #include <app_main.h>
+#include "FreeRTOS.h"
+#include <task.h>
+#include "send_link.h"
 
 //*****************************************************************************
 //! Prototypes
@@ -77,6 +80,7 @@ Target Device: cc23xx
 
 void Central_ScanEventHandler(uint32 event, BLEAppUtil_msgHdr_t *pMsgData);
 void Central_addScanRes(GapScan_Evt_AdvRpt_t *pScanRpt);
+void Central_addBaseStation(GapScan_Evt_AdvRpt_t *pScanRpt);
 
 //*****************************************************************************
 //! Globals
@@ -89,7 +93,8 @@ BLEAppUtil_EventHandler_t centralScanHandler =
     .handlerType    = BLEAPPUTIL_GAP_SCAN_TYPE,
     .pEventHandler  = Central_ScanEventHandler,
     .eventMask      = BLEAPPUTIL_SCAN_ENABLED |
-                      BLEAPPUTIL_SCAN_DISABLED
+                      BLEAPPUTIL_SCAN_DISABLED |
+                      BLEAPPUTIL_ADV_REPORT
 };
 
 BLEAppUtil_ConnectParams_t centralConnParams =
@@ -153,6 +158,18 @@ const BLEAppUtil_ConnParams_t centralConnInitParams =
 static App_scanResults centralScanRes[APP_MAX_NUM_OF_ADV_REPORTS];
 static uint8 centralScanIndex = 0;
 
+// Base stations are told apart from other advertisers by the service they advertise
+#define CENTRAL_MAX_BASE_STATIONS           4
+// Consecutive failed uploads before failing over to the next base station
+#define CENTRAL_BASE_STATION_MAX_FAILURES   3
+
+static const uint8_t centralBaseStationUuid[] = APP_FRIDGE_SERVICE_UUID;
+static App_baseStation centralBaseStations[CENTRAL_MAX_BASE_STATIONS];
+static uint8 centralNumBaseStations = 0;
+// The base station list is filled in on the stack thread and read by the send task, only touched in critical sections
+// Set while a scan the send path started is running, only touched on the stack thread
+static bool centralSendScan = false;
+
 //*****************************************************************************
 //! Functions
 //*****************************************************************************
@@ -207,6 +224,19 @@ void Central_ScanEventHandler(uint32 event, BLEAppUtil_msgHdr_t *pMsgData)
                               "Num results: " MENU_MODULE_COLOR_YELLOW "%d " MENU_MODULE_COLOR_RESET,
                               scanMsg->pBuf->pScanDis.reason,
                               scanMsg->pBuf->pScanDis.numReport);
+
+            // Scans started from the menu aren't the send task's to complete
+            if (centralSendScan)
+            {
+                centralSendScan = false;
+                SendLink_onScanDone();
+            }
+            break;
+        }
+
+        case BLEAPPUTIL_ADV_REPORT:
+        {
+            Central_addBaseStation(&scanMsg->pBuf->pAdvReport);
             break;
         }
 
@@ -238,6 +268,212 @@ void Central_addScanRes(GapScan_Evt_AdvRpt_t *pScanRpt)
     }
 }
 
+/*********************************************************************
+ * @fn      Central_isBaseStation
+ *
+ * @brief   Check whether an advertiser lists the Fridge Monitor service
+ *          in its 128-bit service UUIDs
+ *
+ * @param   pScanRpt - the adv report to check
+ *
+ * @return  true if the advertiser is a base station
+ */
+static bool Central_isBaseStation(GapScan_Evt_AdvRpt_t *pScanRpt)
+{
+    uint16_t idx = 0;
+
+    // Walk the AD structures: | Length | Type | Data (Length - 1) |
+    while (pScanRpt->pData != NULL && idx + 1 < pScanRpt->dataLen)
+    {
+        uint8_t fieldLen = pScanRpt->pData[idx];
+        uint8_t fieldType = pScanRpt->pData[idx + 1];
+        if (fieldLen == 0 || idx + 1 + fieldLen > pScanRpt->dataLen)
+        {
+            break;
+        }
+
+        if (fieldType == GAP_ADTYPE_128BIT_MORE || fieldType == GAP_ADTYPE_128BIT_COMPLETE)
+        {
+            uint16_t uuidIdx;
+            for (uuidIdx = idx + 2; uuidIdx + ATT_UUID_SIZE <= idx + 1 + fieldLen; uuidIdx += ATT_UUID_SIZE)
+            {
+                if (memcmp(&pScanRpt->pData[uuidIdx], centralBaseStationUuid, ATT_UUID_SIZE) == 0)
+                {
+                    return true;
+                }
+            }
+        }
+
+        idx += fieldLen + 1;
+    }
+
+    return false;
+}
+
+/*********************************************************************
+ * @fn      Central_addBaseStation
+ *
+ * @brief   Add an advertiser to the base station list if it hosts the
+ *          Fridge Monitor service, keeping the strongest ones
+ *
+ * @param   pScanRpt - the adv report to take the data from
+ *
+ * @return  none
+ */
+void Central_addBaseStation(GapScan_Evt_AdvRpt_t *pScanRpt)
+{
+    uint8 i;
+    uint8 weakest = 0;
+
+    if (!Central_isBaseStation(pScanRpt))
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    for (i = 0; i < centralNumBaseStations; i++)
+    {
+        if (memcmp(centralBaseStations[i].address, pScanRpt->addr, B_ADDR_LEN) == 0)
+        {
+            if (pScanRpt->rssi > centralBaseStations[i].rssi)
+            {
+                centralBaseStations[i].rssi = pScanRpt->rssi;
+            }
+            taskEXIT_CRITICAL();
+            return;
+        }
+        if (centralBaseStations[i].rssi < centralBaseStations[weakest].rssi)
+        {
+            weakest = i;
+        }
+    }
+
+    // Take a free slot, otherwise only displace a weaker base station
+    if (centralNumBaseStations < CENTRAL_MAX_BASE_STATIONS)
+    {
+        i = centralNumBaseStations++;
+    }
+    else if (pScanRpt->rssi > centralBaseStations[weakest].rssi)
+    {
+        i = weakest;
+    }
+    else
+    {
+        taskEXIT_CRITICAL();
+        return;
+    }
+
+    centralBaseStations[i].addressType = pScanRpt->addrType;
+    memcpy(centralBaseStations[i].address, pScanRpt->addr, B_ADDR_LEN);
+    centralBaseStations[i].rssi = pScanRpt->rssi;
+    centralBaseStations[i].failures = 0;
+    taskEXIT_CRITICAL();
+}
+
+/*********************************************************************
+ * @fn      Central_startSendScan
+ *
+ * @brief   Forget the known base stations and their failure counts,
+ *          ahead of a scan the send path starts to find new ones.
+ *          The end of that scan is reported to the send link, scans
+ *          started from the menu leave the list alone and only add to it.
+ *
+ * @return  none
+ */
+void Central_startSendScan(void)
+{
+    taskENTER_CRITICAL();
+    centralNumBaseStations = 0;
+    taskEXIT_CRITICAL();
+    centralSendScan = true;
+}
+
+/*********************************************************************
+ * @fn      Central_cancelSendScan
+ *
+ * @brief   The scan from @ref Central_startSendScan didn't start
+ *
+ * @return  none
+ */
+void Central_cancelSendScan(void)
+{
+    centralSendScan = false;
+}
+
+/*********************************************************************
+ * @fn      Central_getBaseStation
+ *
+ * @brief   Get the base station to upload to, which is the one with
+ *          the strongest signal that hasn't failed too many times
+ *
+ * @param   baseStation - filled in with the selected base station
+ *
+ * @return  true if a usable base station is known, false if a new
+ *          scan is needed
+ */
+bool Central_getBaseStation(App_baseStation *baseStation)
+{
+    uint8 i;
+    App_baseStation *best = NULL;
+    bool found = false;
+
+    taskENTER_CRITICAL();
+    for (i = 0; i < centralNumBaseStations; i++)
+    {
+        if (centralBaseStations[i].failures >= CENTRAL_BASE_STATION_MAX_FAILURES)
+        {
+            continue;
+        }
+        if (best == NULL || centralBaseStations[i].rssi > best->rssi)
+        {
+            best = &centralBaseStations[i];
+        }
+    }
+
+    if (best != NULL)
+    {
+        *baseStation = *best;
+        found = true;
+    }
+    taskEXIT_CRITICAL();
+
+    return found;
+}
+
+/*********************************************************************
+ * @fn      Central_reportBaseStation
+ *
+ * @brief   Record the outcome of an upload to a base station, so
+ *          repeated failures fail over to the next best candidate
+ *
+ * @param   address - address of the base station used
+ * @param   success - whether the upload went through
+ *
+ * @return  none
+ */
+void Central_reportBaseStation(const uint8_t *address, bool success)
+{
+    uint8 i;
+
+    taskENTER_CRITICAL();
+    for (i = 0; i < centralNumBaseStations; i++)
+    {
+        if (memcmp(centralBaseStations[i].address, address, B_ADDR_LEN) == 0)
+        {
+            if (success)
+            {
+                centralBaseStations[i].failures = 0;
+            }
+            else if (centralBaseStations[i].failures < CENTRAL_BASE_STATION_MAX_FAILURES)
+            {
+                centralBaseStations[i].failures++;
+            }
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+
 /*********************************************************************
  * @fn      Scan_getScanResList
  *
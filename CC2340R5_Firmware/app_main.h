@@ -49,11 +49,15 @@ Target Device: cc23xx
 //! Includes
 //*****************************************************************************
 #include <ti/bleapp/ble_app_util/inc/bleapputil_api.h>
+#include "report_policy.h"
 
 //*****************************************************************************
 //! Defines
 //*****************************************************************************
 
+// Fridge Monitor service hosted by the base station: 1974e0a6-a490-4869-84b7-5f03cf47ac9d
+#define APP_FRIDGE_SERVICE_UUID {0x9D, 0xAC, 0x47, 0xCF, 0x03, 0x5F, 0xB7, 0x84, 0x69, 0x48, 0x90, 0xA4, 0xA6, 0xE0, 0x74, 0x19}
+
 //*****************************************************************************
 //! Typedefs
 //*****************************************************************************
@@ -84,6 +88,30 @@ PACKED_ALIGNED_TYPEDEF_STRUCT
   int rssi;
 }App_scanResults;
 
+// Base station found by scanning for the Fridge Monitor service
+PACKED_ALIGNED_TYPEDEF_STRUCT
+{
+  /// Address type of the base station
+  uint8_t  addressType;
+  /// Base station address
+  BLEAppUtil_BDaddr  address;
+  // Strongest RSSI seen during the last scan
+  int rssi;
+  // Consecutive failed uploads to this base station
+  uint8_t failures;
+}App_baseStation;
+
+// Results of one measurement cycle, as handed to the send task
+typedef struct
+{
+  float tvoc;             // mg/m^3
+  float eco2;             // ppm
+  float etoh;             // ppm
+  float iaq;
+  float temperatureDegC;  // The temperature the algorithm was given
+  uint8_t status;         // READING_STATUS_* from reading_codec.h
+}App_measurement;
+
 // Connected device information
 PACKED_ALIGNED_TYPEDEF_STRUCT
 {
@@ -290,6 +318,51 @@ bStatus_t Menu_start(void);
  */
 uint8 Scan_getScanResList(App_scanResults **scanRes);
 
+/*********************************************************************
+ * @fn      Central_startSendScan
+ *
+ * @brief   Forget the known base stations and their failure counts,
+ *          ahead of a scan the send path starts to find new ones
+ *
+ * @return  none
+ */
+void Central_startSendScan(void);
+
+/*********************************************************************
+ * @fn      Central_cancelSendScan
+ *
+ * @brief   The scan from @ref Central_startSendScan didn't start
+ *
+ * @return  none
+ */
+void Central_cancelSendScan(void);
+
+/*********************************************************************
+ * @fn      Central_getBaseStation
+ *
+ * @brief   Get the base station to upload to, which is the one with
+ *          the strongest signal that hasn't failed too many times
+ *
+ * @param   baseStation - filled in with the selected base station
+ *
+ * @return  true if a usable base station is known, false if a new
+ *          scan is needed
+ */
+bool Central_getBaseStation(App_baseStation *baseStation);
+
+/*********************************************************************
+ * @fn      Central_reportBaseStation
+ *
+ * @brief   Record the outcome of an upload to a base station, so
+ *          repeated failures fail over to the next best candidate
+ *
+ * @param   address - address of the base station used
+ * @param   success - whether the upload went through
+ *
+ * @return  none
+ */
+void Central_reportBaseStation(const uint8_t *address, bool success);
+
 /*********************************************************************
  * @fn      Connection_getConnList
  *
@@ -320,7 +393,10 @@ uint16_t Connection_getConnhandle(uint8_t index);
 uint16_t Connection_getConnIndex(uint16_t connHandle);
 
 void SendUpdateInit();
-void SendUpdateValue(float vocReading);
+void SendUpdateValue(const App_measurement *measurement);
+bool SendDataRequestCaptureDownload(void);
+void SendDataSetReportParams(const report_policy_params_t *params);
+void SendDataGetReportParams(report_policy_params_t *params, uint32_t *considered, uint32_t *reported);
 
 void app_zmod4xxx_init(void);
 
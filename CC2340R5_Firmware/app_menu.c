@@ -47,10 +47,14 @@ Target Device: cc23xx
 //! Includes
 //*****************************************************************************
 #include <string.h>
+#include <inttypes.h>
 #include <ti/bleapp/ble_app_util/inc/bleapputil_api.h>
 #include <ti/bleapp/menu_module/menu_module.h>
 #include <app_main.h>
 #include "ti_ble_config.h"
+#include "puck_display.h"
+#include "capture_log.h"
+#include "power_mgr.h"
 
 #if !defined(Display_DISABLE_ALL)
 //*****************************************************************************
@@ -70,6 +74,23 @@ void Menu_connPhyCB(uint8 index);
 void Menu_connPhyChangeCB(uint8 index);
 void Menu_paramUpdateCB(uint8 index);
 void Menu_disconnectCB(uint8 index);
+#if PUCK_DISPLAY_ENABLE
+// Puck status display callback
+void Menu_statusDisplayCB(uint8 index);
+#endif // #if PUCK_DISPLAY_ENABLE
+// Capture log callbacks
+void Menu_captureCB(uint8 index);
+void Menu_captureToggleCB(uint8 index);
+void Menu_captureDownloadCB(uint8 index);
+void Menu_captureEraseCB(uint8 index);
+
+// Reporting policy callbacks
+void Menu_reportingCB(uint8 index);
+void Menu_reportingAdaptiveCB(uint8 index);
+void Menu_reportingDeadbandCB(uint8 index);
+void Menu_reportingSilenceCB(uint8 index);
+
+void Menu_powerStatsCB(uint8 index);
 
 //*****************************************************************************
 //! Globals
@@ -126,6 +147,26 @@ MENU_MODULE_MENU_OBJECT("Set Conn PHY Preference", connPhyMenu);
 
 #endif // #if ( HOST_CONFIG & ( CENTRAL_CFG | PERIPHERAL_CFG ) )
 
+// Capture log menu
+const MenuModule_Menu_t captureMenu[] =
+{
+ {"Start/Stop", &Menu_captureToggleCB, "Toggle logging every measurement to flash"},
+ {"Download", &Menu_captureDownloadCB, "Send the log to the base station"},
+ {"Erase", &Menu_captureEraseCB, "Erase the whole log"},
+};
+
+MENU_MODULE_MENU_OBJECT("Capture Log Menu", captureMenu);
+
+// Reporting policy menu
+const MenuModule_Menu_t reportingMenu[] =
+{
+ {"Adaptive", &Menu_reportingAdaptiveCB, "Toggle between adaptive reporting and sending every reading"},
+ {"Deadband", &Menu_reportingDeadbandCB, "Cycle the TVOC change that triggers a report"},
+ {"Max silence", &Menu_reportingSilenceCB, "Cycle the longest time between reports"},
+};
+
+MENU_MODULE_MENU_OBJECT("Reporting Menu", reportingMenu);
+
 // Main menu
 #if ( HOST_CONFIG & ( CENTRAL_CFG | OBSERVER_CFG | PERIPHERAL_CFG ) )
 const MenuModule_Menu_t mainMenu[] =
@@ -136,6 +177,12 @@ const MenuModule_Menu_t mainMenu[] =
 #if ( HOST_CONFIG & ( CENTRAL_CFG | PERIPHERAL_CFG ) )
  {"Connection", &Menu_connectionCB, "Connection menu"},
 #endif // #if ( HOST_CONFIG & ( CENTRAL_CFG | PERIPHERAL_CFG ) )
+#if PUCK_DISPLAY_ENABLE
+ {"Status display", &Menu_statusDisplayCB, "Toggle the live puck status"},
+#endif // #if PUCK_DISPLAY_ENABLE
+ {"Capture log", &Menu_captureCB, "Raw sensor capture for algorithm tuning"},
+ {"Reporting", &Menu_reportingCB, "When readings are sent to the base station"},
+ {"Power", &Menu_powerStatsCB, "Time spent in each power state"},
 };
 
 MENU_MODULE_MENU_OBJECT("Basic BLE Menu", mainMenu);
@@ -521,6 +568,273 @@ void Menu_disconnectCB(uint8 index)
 
 #endif // #if ( HOST_CONFIG & ( CENTRAL_CFG | PERIPHERAL_CFG ) )
 
+#if PUCK_DISPLAY_ENABLE
+/*********************************************************************
+ * @fn      Menu_statusDisplayCB
+ *
+ * @brief   A callback that will be called once the status display
+ *          item in the main menu is selected.
+ *          Toggles rendering of the live puck status lines.
+ *
+ * @param   index - the index in the menu
+ *
+ * @return  none
+ */
+void Menu_statusDisplayCB(uint8 index)
+{
+    bool enabled = !PuckDisplay_isEnabled();
+    PuckDisplay_setEnabled(enabled);
+
+    MenuModule_printf(APP_MENU_GENERAL_STATUS_LINE, 0, "Call Status: Status display = "
+                      MENU_MODULE_COLOR_BOLD "%s" MENU_MODULE_COLOR_RESET,
+                      enabled ? "On" : "Off");
+}
+#endif // #if PUCK_DISPLAY_ENABLE
+
+/*********************************************************************
+ * @fn      Menu_captureStatus
+ *
+ * @brief   Prints whether capture is on, how much of the log is used
+ *          and how the last download went.
+ *
+ * @return  none
+ */
+static void Menu_captureStatus(void)
+{
+    capture_log_stats_t stats;
+    CaptureLog_getStats(&stats);
+
+    MenuModule_printf(APP_MENU_GENERAL_STATUS_LINE, 0, "Call Status: Capture = "
+                      MENU_MODULE_COLOR_BOLD "%s" MENU_MODULE_COLOR_RESET
+                      " %" PRIu32 "/%" PRIu32 " records, %" PRIu32 " write failures, last download %" PRIu32
+                      " records (%" PRIu32 " lost) result 0x%08" PRIx32,
+                      CaptureLog_isEnabled() ? "On" : "Off",
+                      stats.numRecords, stats.numSlots, stats.writeFailures,
+                      stats.lastDownloadRecords, stats.lastDownloadLost, stats.lastDownloadResult);
+}
+
+/*********************************************************************
+ * @fn      Menu_captureCB
+ *
+ * @brief   A callback that will be called once the Capture log item
+ *          in the main menu is selected.
+ *          Shows the capture status and the capture log menu.
+ *
+ * @param   index - the index in the menu
+ *
+ * @return  none
+ */
+void Menu_captureCB(uint8 index)
+{
+    Menu_captureStatus();
+    MenuModule_startSubMenu(&captureMenuObject);
+}
+
+/*********************************************************************
+ * @fn      Menu_captureToggleCB
+ *
+ * @brief   A callback that will be called once the Start/Stop item
+ *          in the captureMenu is selected.
+ *          Toggles logging of every measurement cycle to flash.
+ *
+ * @param   index - the index in the menu
+ *
+ * @return  none
+ */
+void Menu_captureToggleCB(uint8 index)
+{
+    CaptureLog_setEnabled(!CaptureLog_isEnabled());
+    Menu_captureStatus();
+}
+
+/*********************************************************************
+ * @fn      Menu_captureDownloadCB
+ *
+ * @brief   A callback that will be called once the Download item
+ *          in the captureMenu is selected.
+ *          Asks the send task to stream the log to the base station,
+ *          the result shows up in the capture status once it's done.
+ *
+ * @param   index - the index in the menu
+ *
+ * @return  none
+ */
+void Menu_captureDownloadCB(uint8 index)
+{
+    bool queued = SendDataRequestCaptureDownload();
+
+    MenuModule_printf(APP_MENU_GENERAL_STATUS_LINE, 0, "Call Status: Capture download = "
+                      MENU_MODULE_COLOR_BOLD "%s" MENU_MODULE_COLOR_RESET,
+                      queued ? "Queued" : "Send queue full");
+}
+
+/*********************************************************************
+ * @fn      Menu_captureEraseCB
+ *
+ * @brief   A callback that will be called once the Erase item
+ *          in the captureMenu is selected.
+ *          Erases the whole capture log.
+ *
+ * @param   index - the index in the menu
+ *
+ * @return  none
+ */
+void Menu_captureEraseCB(uint8 index)
+{
+    bool erased = CaptureLog_erase();
+
+    MenuModule_printf(APP_MENU_GENERAL_STATUS_LINE, 0, "Call Status: Capture erase = "
+                      MENU_MODULE_COLOR_BOLD "%s" MENU_MODULE_COLOR_RESET,
+                      erased ? "Done" : "Failed");
+}
+
+// Choices the Deadband and Max silence items step through
+static const int32_t reportingDeadbands[] = {200, 500, 1000, 2000};
+static const uint32_t reportingSilencesMs[] = {5 * 60 * 1000, 15 * 60 * 1000, 30 * 60 * 1000, 60 * 60 * 1000};
+
+/*********************************************************************
+ * @fn      Menu_reportingStatus
+ *
+ * @brief   Prints the reporting policy and how many readings it
+ *          has let through.
+ *
+ * @return  none
+ */
+static void Menu_reportingStatus(void)
+{
+    report_policy_params_t params;
+    uint32_t considered, reported;
+    SendDataGetReportParams(&params, &considered, &reported);
+
+    MenuModule_printf(APP_MENU_GENERAL_STATUS_LINE, 0, "Call Status: Reporting = "
+                      MENU_MODULE_COLOR_BOLD "%s" MENU_MODULE_COLOR_RESET
+                      " deadband %" PRId32 ".%04" PRId32 " mg/m^3, max silence %" PRIu32 " min, %" PRIu32 " of %" PRIu32
+                      " readings reported",
+                      params.adaptive ? "Adaptive" : "Every reading",
+                      params.tvocDeadband / 10000, params.tvocDeadband % 10000,
+                      params.maxSilenceMs / 60000, reported, considered);
+}
+
+/*********************************************************************
+ * @fn      Menu_reportingCB
+ *
+ * @brief   A callback that will be called once the Reporting item
+ *          in the main menu is selected.
+ *          Shows the reporting policy and the reporting menu.
+ *
+ * @param   index - the index in the menu
+ *
+ * @return  none
+ */
+void Menu_reportingCB(uint8 index)
+{
+    Menu_reportingStatus();
+    MenuModule_startSubMenu(&reportingMenuObject);
+}
+
+/*********************************************************************
+ * @fn      Menu_reportingAdaptiveCB
+ *
+ * @brief   A callback that will be called once the Adaptive item
+ *          in the reportingMenu is selected.
+ *          Toggles between adaptive reporting and sending every reading.
+ *
+ * @param   index - the index in the menu
+ *
+ * @return  none
+ */
+void Menu_reportingAdaptiveCB(uint8 index)
+{
+    report_policy_params_t params;
+    uint32_t considered, reported;
+    SendDataGetReportParams(&params, &considered, &reported);
+    params.adaptive = !params.adaptive;
+    SendDataSetReportParams(&params);
+    Menu_reportingStatus();
+}
+
+/*********************************************************************
+ * @fn      Menu_reportingDeadbandCB
+ *
+ * @brief   A callback that will be called once the Deadband item
+ *          in the reportingMenu is selected.
+ *          Steps the TVOC deadband to the next choice.
+ *
+ * @param   index - the index in the menu
+ *
+ * @return  none
+ */
+void Menu_reportingDeadbandCB(uint8 index)
+{
+    report_policy_params_t params;
+    uint32_t considered, reported;
+    SendDataGetReportParams(&params, &considered, &reported);
+
+    size_t next = 0;
+    for (size_t i = 0; i < sizeof(reportingDeadbands) / sizeof(reportingDeadbands[0]); i++) {
+        if (reportingDeadbands[i] > params.tvocDeadband) {
+            next = i;
+            break;
+        }
+    }
+    params.tvocDeadband = reportingDeadbands[next];
+    SendDataSetReportParams(&params);
+    Menu_reportingStatus();
+}
+
+/*********************************************************************
+ * @fn      Menu_reportingSilenceCB
+ *
+ * @brief   A callback that will be called once the Max silence item
+ *          in the reportingMenu is selected.
+ *          Steps the longest time between reports to the next choice.
+ *
+ * @param   index - the index in the menu
+ *
+ * @return  none
+ */
+void Menu_reportingSilenceCB(uint8 index)
+{
+    report_policy_params_t params;
+    uint32_t considered, reported;
+    SendDataGetReportParams(&params, &considered, &reported);
+
+    size_t next = 0;
+    for (size_t i = 0; i < sizeof(reportingSilencesMs) / sizeof(reportingSilencesMs[0]); i++) {
+        if (reportingSilencesMs[i] > params.maxSilenceMs) {
+            next = i;
+            break;
+        }
+    }
+    params.maxSilenceMs = reportingSilencesMs[next];
+    SendDataSetReportParams(&params);
+    Menu_reportingStatus();
+}
+
+/*********************************************************************
+ * @fn      Menu_powerStatsCB
+ *
+ * @brief   A callback that will be called once the Power item
+ *          in the main menu is selected.
+ *          Prints how long the puck has spent in each power state.
+ *
+ * @param   index - the index in the menu
+ *
+ * @return  none
+ */
+void Menu_powerStatsCB(uint8 index)
+{
+    power_mgr_stats_t stats;
+    PowerMgr_getStats(&stats);
+
+    MenuModule_printf(APP_MENU_GENERAL_STATUS_LINE, 0, "Call Status: Power = "
+                      "standby " MENU_MODULE_COLOR_BOLD "%" PRIu32 MENU_MODULE_COLOR_RESET " ms (%" PRIu32 " entries),"
+                      " idle %" PRIu32 " ms, sensor %" PRIu32 " ms, radio %" PRIu32 " ms, %" PRIu32 " constraint holds",
+                      stats.residencyMs[POWER_STATE_STANDBY], stats.standbyEntries,
+                      stats.residencyMs[POWER_STATE_IDLE], stats.residencyMs[POWER_STATE_SENSOR],
+                      stats.residencyMs[POWER_STATE_RADIO], stats.constraintHolds);
+}
+
 #endif // #if !defined(Display_DISABLE_ALL)
 
 /*********************************************************************
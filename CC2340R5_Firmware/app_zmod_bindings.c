@@ -8,8 +8,10 @@
 #include <pthread.h>
 #include <assert.h>
 #include <string.h>
+#include <math.h>
 #include "FreeRTOS.h"
 #include <task.h>
+#include <semphr.h>
 #include "ti_drivers_config.h"
 #include "zmod4xxx_types.h"
 #include "zmod4410_config_iaq2.h"
@@ -17,27 +19,148 @@
 #include "zmod4xxx_cleaning.h"
 #include "iaq_2nd_gen.h"
 #include <ti/drivers/GPIO.h>
-#include <ti/bleapp/menu_module/menu_module.h>
+#include <ti/drivers/Temperature.h>
 #include <app_main.h>
+#include "puck_display.h"
+#include "env_fusion.h"
+#include "periodic_sched.h"
+#include "i2c_bus.h"
+#include "capture_log.h"
+#include "reading_codec.h"
+#include "power_mgr.h"
+
+// How the end of a measurement is detected
+#define ZMOD_COMPLETION_SLEEP       0   // Sleep until the next deadline, as the Renesas examples do
+#define ZMOD_COMPLETION_INTERRUPT   1   // Wake on the sensor's INT line (needs CONFIG_GPIO_ZMOD_INT in the syscfg)
+#define ZMOD_COMPLETION_POLL        2   // Sleep through most of the period, then poll the status register
+
+#ifndef ZMOD_COMPLETION_MODE
+#define ZMOD_COMPLETION_MODE        ZMOD_COMPLETION_SLEEP
+#endif
+
+// Polling starts this long before the deadline, and checks the status this often
+#define ZMOD_POLL_LEAD_MS           300
+#define ZMOD_POLL_INTERVAL_MS       20
+
+#if (ZMOD_COMPLETION_MODE == ZMOD_COMPLETION_INTERRUPT) && !defined(CONFIG_GPIO_ZMOD_INT)
+#error "Interrupt completion needs the ZMOD INT pin set up as CONFIG_GPIO_ZMOD_INT"
+#endif
+
+// Wakes and time spent awake by the zmod thread, both in total and for the last measurement cycle
+typedef struct zmod_wake_stats_t {
+    uint32_t wakes;
+    TickType_t awakeTicks;
+    uint32_t lastCycleWakes;
+    TickType_t lastCycleAwakeTicks;
+} zmod_wake_stats_t;
 
 static pthread_t zmodThread;
-static I2C_Handle zmodHandle;
-static uint8_t dataBufTmp[257];
+static periodic_sched_t measSched;
+static zmod_wake_stats_t wakeStats;
+static uint32_t cycleStartWakes;
+static TickType_t cycleStartAwakeTicks;
+static TickType_t lastWakeTick;
+#if ZMOD_COMPLETION_MODE == ZMOD_COMPLETION_INTERRUPT
+static SemaphoreHandle_t zmodDoneSem;
+#endif
+
+static bool app_zmod4xxx_die_temp_read(void *ctx, env_sample_t *sample) {
+    // The die sits in the same air as the sensor, it's the best we've got without an external sensor
+    sample->temperatureDegC = Temperature_getTemperature();
+    sample->hasHumidity = false;
+    return true;
+}
+
+static const env_source_t dieTempSource = {
+    .name = "die",
+    .read = &app_zmod4xxx_die_temp_read,
+    .ctx = NULL,
+};
+
+// Every block of the zmod thread goes through these, so wakes and awake time are accounted for
+static void app_zmod4xxx_sleep_begin(void) {
+    wakeStats.awakeTicks += xTaskGetTickCount() - lastWakeTick;
+    PowerMgr_end(POWER_ACTIVITY_SENSOR);
+}
+
+static void app_zmod4xxx_sleep_end(void) {
+    PowerMgr_begin(POWER_ACTIVITY_SENSOR);
+    lastWakeTick = xTaskGetTickCount();
+    wakeStats.wakes++;
+}
+
+static void app_zmod4xxx_sleep(TickType_t ticks) {
+    if (ticks == 0) {
+        return;
+    }
+    app_zmod4xxx_sleep_begin();
+    vTaskDelay(ticks);
+    app_zmod4xxx_sleep_end();
+}
+
+static void app_zmod4xxx_cycle_started(void) {
+    PeriodicSched_cycleStarted(&measSched, xTaskGetTickCount());
+
+    // Close off the stats for the cycle that just ended
+    TickType_t awakeTicks = wakeStats.awakeTicks + (xTaskGetTickCount() - lastWakeTick);
+    wakeStats.lastCycleWakes = wakeStats.wakes - cycleStartWakes;
+    wakeStats.lastCycleAwakeTicks = awakeTicks - cycleStartAwakeTicks;
+    cycleStartWakes = wakeStats.wakes;
+    cycleStartAwakeTicks = awakeTicks;
+}
 
 void app_zmod4xxx_hal_delay_ms(uint32_t ms) {
-    vTaskDelay(ms / portTICK_PERIOD_MS);
+    app_zmod4xxx_sleep(ms / portTICK_PERIOD_MS);
+}
+
+#if ZMOD_COMPLETION_MODE == ZMOD_COMPLETION_INTERRUPT
+static void app_zmod4xxx_int_callback(uint_least8_t index) {
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    xSemaphoreGiveFromISR(zmodDoneSem, &higherPriorityTaskWoken);
+    portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+#endif
+
+static void app_zmod4xxx_wait_completion(zmod4xxx_dev_t *dev) {
+    // Never past the next deadline, if it isn't done by then the status check reports it
+#if ZMOD_COMPLETION_MODE == ZMOD_COMPLETION_INTERRUPT
+    TickType_t timeout = PeriodicSched_ticksUntilDue(&measSched, xTaskGetTickCount());
+    app_zmod4xxx_sleep_begin();
+    xSemaphoreTake(zmodDoneSem, timeout);
+    app_zmod4xxx_sleep_end();
+#elif ZMOD_COMPLETION_MODE == ZMOD_COMPLETION_POLL
+    TickType_t lead = pdMS_TO_TICKS(ZMOD_POLL_LEAD_MS);
+    TickType_t remaining = PeriodicSched_ticksUntilDue(&measSched, xTaskGetTickCount());
+    if (remaining > lead) {
+        app_zmod4xxx_sleep(remaining - lead);
+    }
+
+    // Polls are too close together for standby to pay for itself
+    uint8_t status;
+    PowerMgr_begin(POWER_ACTIVITY_SENSOR_POLL);
+    while (PeriodicSched_ticksUntilDue(&measSched, xTaskGetTickCount()) > 0) {
+        if (zmod4xxx_read_status(dev, &status) == ZMOD4XXX_OK && !(status & STATUS_SEQUENCER_RUNNING_MASK)) {
+            break;
+        }
+        app_zmod4xxx_sleep(pdMS_TO_TICKS(ZMOD_POLL_INTERVAL_MS));
+    }
+    PowerMgr_end(POWER_ACTIVITY_SENSOR_POLL);
+#else
+    app_zmod4xxx_sleep(PeriodicSched_ticksUntilDue(&measSched, xTaskGetTickCount()));
+#endif
+}
+
+static int8_t app_zmod4xxx_start(zmod4xxx_dev_t *dev) {
+    app_zmod4xxx_cycle_started();
+#if ZMOD_COMPLETION_MODE == ZMOD_COMPLETION_INTERRUPT
+    // Clear out an edge left over from a measurement we gave up on
+    xSemaphoreTake(zmodDoneSem, 0);
+#endif
+    return zmod4xxx_start_measurement(dev);
 }
 
 int8_t app_zmod4xxx_i2c_read(uint8_t addr, uint8_t reg_addr, uint8_t *data_buf, uint8_t len) {
-    I2C_Transaction transaction = {0};
-    transaction.targetAddress = addr;
-
-    // Read from I2C target device
-    transaction.writeBuf = &reg_addr;
-    transaction.writeCount = 1;
-    transaction.readBuf = data_buf;
-    transaction.readCount = len;
-    if (!I2C_transfer(zmodHandle, &transaction)) {
+    if (!I2CBus_readReg(addr, reg_addr, data_buf, len)) {
         return ERROR_I2C;
     }
 
@@ -45,18 +168,8 @@ int8_t app_zmod4xxx_i2c_read(uint8_t addr, uint8_t reg_addr, uint8_t *data_buf,
 }
 
 int8_t app_zmod4xxx_i2c_write(uint8_t addr, uint8_t reg_addr, uint8_t *data_buf, uint8_t len) {
-    I2C_Transaction transaction = {0};
-    transaction.targetAddress = addr;
-
-    dataBufTmp[0] = reg_addr;
-    memcpy(&dataBufTmp[1], data_buf, len);
-
-    // Read from I2C target device
-    transaction.writeBuf = &dataBufTmp;
-    transaction.writeCount = len + 1;
-    transaction.readBuf = data_buf;
-    transaction.readCount = len;
-    if (!I2C_transfer(zmodHandle, &transaction)) {
+    // Write only, the bus layer frames the register address on its own stack
+    if (!I2CBus_writeReg(addr, reg_addr, data_buf, len)) {
         return ERROR_I2C;
     }
 
@@ -64,16 +177,8 @@ int8_t app_zmod4xxx_i2c_write(uint8_t addr, uint8_t reg_addr, uint8_t *data_buf,
 }
 
 int8_t app_zmod4xxx_hal_init(zmod4xxx_dev_t *dev) {
-    I2C_init();
-
-    // initialize optional I2C bus parameters
-    I2C_Params params;
-    I2C_Params_init(&params);
-    params.bitRate = CONFIG_I2C_0_MAXBITRATE;
-
-    // Open I2C bus for usage
-    zmodHandle = I2C_open(CONFIG_I2C_0, &params);
-    if (zmodHandle == NULL) {
+    // The bus is shared with any other sensor thread, whoever gets here first opens it
+    if (!I2CBus_open()) {
         return 1;
     }
 
@@ -98,7 +203,8 @@ void *app_zmod4xxx_run(void* arg) {
     iaq_2nd_gen_results_t algo_results;
     iaq_2nd_gen_inputs_t algo_input;
 
-    MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Initializing ZMOD4410");
+    PowerMgr_begin(POWER_ACTIVITY_SENSOR);
+    PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Initializing ZMOD4410");
 
     /**** TARGET SPECIFIC FUNCTION ****/
     /*
@@ -110,8 +216,8 @@ void *app_zmod4xxx_run(void* arg) {
      */
     ret = app_zmod4xxx_hal_init(&dev);
     if (ret) {
-        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Error %d during initialize zmod hardware",
-                          ret);
+        PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Error %d during initialize zmod hardware",
+                            ret);
         goto exit;
     }
     /**** TARGET SPECIFIC FUNCTION ****/
@@ -126,8 +232,8 @@ void *app_zmod4xxx_run(void* arg) {
     /* Read product ID and configuration parameters. */
     ret = zmod4xxx_read_sensor_info(&dev);
     if (ret) {
-        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Error %d during reading sensor information",
-                          ret);
+        PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Error %d during reading sensor information",
+                            ret);
         goto exit;
     }
     /*
@@ -136,68 +242,108 @@ void *app_zmod4xxx_run(void* arg) {
      */
     ret = zmod4xxx_read_tracking_number(&dev, track_number);
     if (ret) {
-        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Error %d during reading tracking number",
-                          ret);
+        PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Error %d during reading tracking number",
+                            ret);
         goto exit;
     }
     static_assert(sizeof(track_number) == 6, "Tracking number not expected size");
-    MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE1, 0, "Sensor tracking number: x0000%02x%02x%02x%02x%02x%02x",
-                      track_number[0], track_number[1], track_number[2],
-                      track_number[3], track_number[4], track_number[5]);
+    PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE1, "Sensor tracking number: x0000%02x%02x%02x%02x%02x%02x",
+                        track_number[0], track_number[1], track_number[2],
+                        track_number[3], track_number[4], track_number[5]);
     static_assert(sizeof(prod_data) == 7, "Prod data not expected size");
-    MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE2, 0, "Sensor trimming data: %i %i %i %i %i %i %i",
-                          prod_data[0], prod_data[1], prod_data[2], prod_data[3],
-                          prod_data[4], prod_data[5], prod_data[6]);
+    PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE2, "Sensor trimming data: %i %i %i %i %i %i %i",
+                            prod_data[0], prod_data[1], prod_data[2], prod_data[3],
+                            prod_data[4], prod_data[5], prod_data[6]);
 
     /*
      * Start the cleaning procedure. Check the Programming Manual on indications
      * of usage. IMPORTANT NOTE: The cleaning procedure can be run only once
      * during the modules lifetime and takes 1 minute (blocking).
      */
-//    MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Starting cleaning procedure. This might take up to 1 min ...");
+//    PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Starting cleaning procedure. This might take up to 1 min ...");
 //    ret = zmod4xxx_cleaning_run(&dev);
 //    if (ERROR_CLEANING == ret) {
-//        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Skipping cleaning procedure. It has already been performed!");
+//        PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Skipping cleaning procedure. It has already been performed!");
 //    } else if (ret) {
-//        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Error %d during cleaning procedure", ret);
+//        PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Error %d during cleaning procedure", ret);
 //        goto exit;
 //    }
 
     /* Determine calibration parameters and configure measurement. */
     ret = zmod4xxx_prepare_sensor(&dev);
     if (ret) {
-        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Error %d during preparation of the sensor", ret);
+        PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Error %d during preparation of the sensor", ret);
         goto exit;
     }
 
+    // Everything the replay tool needs to rebuild dev for the algorithm, logged ahead of each capture
+    static_assert(sizeof(adc_result) == CAPTURE_ADC_LEN, "ADC result doesn't fit the capture record");
+    static_assert(sizeof(prod_data) == CAPTURE_PROD_DATA_LEN, "Prod data doesn't fit the capture record");
+    static_assert(sizeof(track_number) == CAPTURE_TRACKING_LEN, "Tracking number doesn't fit the capture record");
+    static_assert(sizeof(dev.config) == sizeof(((capture_session_t *) 0)->config), "Sensor config doesn't fit the capture record");
+    {
+        capture_session_t session = {
+            .pid = dev.pid,
+            .moxLr = dev.mox_lr,
+            .moxEr = dev.mox_er,
+            .samplePeriodMs = ZMOD4410_IAQ2_SAMPLE_TIME,
+        };
+        memcpy(session.config, dev.config, sizeof(session.config));
+        memcpy(session.prodData, prod_data, sizeof(session.prodData));
+        memcpy(session.trackingNumber, track_number, sizeof(session.trackingNumber));
+        CaptureLog_setSession(&session);
+    }
+
     /*
      * One-time initialization of the algorithm. Handle passed to calculation
      * function.
      */
     ret = init_iaq_2nd_gen(&algo_handle);
     if (ret) {
-        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Error %d during initializing algorithm", ret);
+        PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Error %d during initializing algorithm", ret);
         goto exit;
     }
 
+    /*
+     * Measurements are started on a fixed grid of absolute deadlines, so time spent reading,
+     * calculating and reporting never stretches the sample period the algorithm relies on.
+     * The thread wakes when the measurement completes (how depends on ZMOD_COMPLETION_MODE),
+     * reads it out, and sleeps until the next deadline once the results are processed.
+     */
+#if ZMOD_COMPLETION_MODE == ZMOD_COMPLETION_INTERRUPT
+    zmodDoneSem = xSemaphoreCreateBinary();
+    GPIO_setConfig(CONFIG_GPIO_ZMOD_INT, GPIO_CFG_IN_PU | GPIO_CFG_IN_INT_FALLING);
+    GPIO_setCallback(CONFIG_GPIO_ZMOD_INT, app_zmod4xxx_int_callback);
+    GPIO_enableInt(CONFIG_GPIO_ZMOD_INT);
+#endif
+    lastWakeTick = xTaskGetTickCount();
+    PeriodicSched_init(&measSched, xTaskGetTickCount(), pdMS_TO_TICKS(ZMOD4410_IAQ2_SAMPLE_TIME));
+    bool measuring = false;
+
     while ( 1 ) {
-        /* Start a measurement. */
-        ret = zmod4xxx_start_measurement(&dev);
-        if (ret) {
-            MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Error %d during starting measurement", ret);
-            goto reading_fail;
+        if (!measuring) {
+            app_zmod4xxx_sleep(PeriodicSched_ticksUntilDue(&measSched, xTaskGetTickCount()));
+
+            /* Start a measurement. */
+            ret = app_zmod4xxx_start(&dev);
+            if (ret) {
+                PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Error %d during starting measurement", ret);
+                goto reading_fail;
+            }
         }
+        measuring = false;
+
         /*
-         * Perform delay. Required to keep proper measurement timing and keep algorithm accuracy.
-         * For more information, read the Programming Manual, section
+         * Wait for the measurement to finish. Required to keep proper measurement timing and keep
+         * algorithm accuracy. For more information, read the Programming Manual, section
          * "Interrupt Usage and Measurement Timing".
          */
-        dev.delay_ms(ZMOD4410_IAQ2_SAMPLE_TIME);
+        app_zmod4xxx_wait_completion(&dev);
 
         /* Verify completion of measurement sequence. */
         ret = zmod4xxx_read_status(&dev, &zmod4xxx_status);
         if (ret) {
-            MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Error %d during reading sensor status", ret);
+            PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Error %d during reading sensor status", ret);
             goto reading_fail;
         }
         /* Check if measurement is running. */
@@ -209,23 +355,23 @@ void *app_zmod4xxx_run(void* arg) {
             ret = zmod4xxx_check_error_event(&dev);
             switch (ret) {
             case ERROR_POR_EVENT:
-                MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Measurement completion fault. Unexpected sensor reset.");
+                PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Measurement completion fault. Unexpected sensor reset.");
                 break;
             case ZMOD4XXX_OK:
-                MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Measurement completion fault. Wrong sensor setup.");
+                PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Measurement completion fault. Wrong sensor setup.");
                 break;
             default:
-                MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Error during reading status register (%d)", ret);
+                PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Error during reading status register (%d)", ret);
                 break;
             }
-            dev.delay_ms(5000);
+            /* Drop this cycle and start over on the next deadline. */
             continue;
         }
         /* Read sensor ADC output. */
         ret = zmod4xxx_read_adc_result(&dev, adc_result);
         if (ret) {
-            MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Error %d during reading of ADC results, exiting program!",
-                              ret);
+            PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Error %d during reading of ADC results, exiting program!",
+                                ret);
             goto reading_fail;
         }
 
@@ -235,61 +381,111 @@ void *app_zmod4xxx_run(void* arg) {
          */
         ret = zmod4xxx_check_error_event(&dev);
         if (ret) {
-            MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Error during reading status register (%d)", ret);
+            PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Error during reading status register (%d)", ret);
             goto reading_fail;
         }
 
+        /*
+         * When completion is only known at the deadline, the next measurement is due already.
+         * Start it before the slow part of the cycle rather than after.
+         */
+        if (PeriodicSched_ticksUntilDue(&measSched, xTaskGetTickCount()) == 0) {
+            ret = app_zmod4xxx_start(&dev);
+            if (ret) {
+                PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Error %d during starting measurement", ret);
+                goto reading_fail;
+            }
+            measuring = true;
+        }
+
         /*
          * Assign algorithm inputs: raw sensor data and ambient conditions.
-         * Production code should use measured temperature and humidity values.
+         * The conditions are sampled right after the ADC read so they line up with it.
          */
+        env_fusion_result_t env;
+        EnvFusion_sample(&env);
         algo_input.adc_result = adc_result;
-        algo_input.humidity_pct = 50.0;
-        algo_input.temperature_degc = 20.0;
+        algo_input.humidity_pct = env.humidityPct;
+        algo_input.temperature_degc = env.temperatureDegC;
 
         /* Calculate algorithm results. */
         ret = calc_iaq_2nd_gen(&algo_handle, &dev, &algo_input, &algo_results);
 
-//        printf("*********** Measurements ***********\n");
-        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE1, 0, " EtOH = %6.3f ppm", algo_results.etoh);
-        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE2, 0, " TVOC = %6.3f mg/m^3", algo_results.tvoc);
-        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE3, 0, " eCO2 = %4.0f ppm", algo_results.eco2);
-        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE4, 0, " IAQ  = %4.1f", algo_results.iaq);
-        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE4 + 1, 0, " Rcda = %.3f kOhm", pow(10, algo_results.log_rcda) / 1e3);
-        for (int i = 0; i < 13; i++) {
-            MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE4 + 2 + i, 0, " Rmox[%d] = %.3f kOhm", i, algo_results.rmox[i] / 1e3);
+        // Warm-up and damaged cycles too, they're as much a part of the stream the algorithm sees
+        if (CaptureLog_isEnabled()) {
+            capture_sample_t sample = {
+                .temperatureCentiDegC = (int16_t) (env.temperatureDegC * 100),
+                .humidityCentiPct = (uint16_t) (env.humidityPct * 100),
+                .tvoc = algo_results.tvoc,
+                .etoh = algo_results.etoh,
+                .eco2 = algo_results.eco2,
+                .iaq = algo_results.iaq,
+                .logRcda = algo_results.log_rcda,
+            };
+            memcpy(sample.adc, adc_result, sizeof(sample.adc));
+            CaptureLog_appendSample(&sample, (uint8_t) ret);
         }
 
         /* Check validity of the algorithm results. */
+        const char *sensorStatus;
+        uint8_t readingStatus;
         switch (ret) {
         case IAQ_2ND_GEN_STABILIZATION:
             /* The sensor should run for at least 100 cycles to stabilize.
              * Algorithm results obtained during this period SHOULD NOT be
              * considered as valid outputs! */
-            MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Readings from Warm-Up!");
+            sensorStatus = "Readings from Warm-Up!";
+            readingStatus = READING_STATUS_WARMUP;
             break;
         case IAQ_2ND_GEN_OK:
-            MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Readings Valid!");
+            sensorStatus = "Readings Valid!";
+            readingStatus = READING_STATUS_OK;
             break;
         /*
         * Notification from Sensor self-check. For more information, read the
         * Programming Manual, section "Troubleshoot Sensor Damage (Sensor Self-Check)".
         */
         case IAQ_2ND_GEN_DAMAGE:
-            MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Error: Sensor probably damaged. Algorithm results may be incorrect.");
+            sensorStatus = "Error: Sensor probably damaged. Algorithm results may be incorrect.";
+            readingStatus = READING_STATUS_DAMAGED;
             break;
         /* Exit program due to unexpected error. */
         default:
-            MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "Unexpected Error during algorithm calculation (%d)", ret);
+            PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Unexpected Error during algorithm calculation (%d)", ret);
             goto reading_fail;
         }
 
-        SendUpdateValue(algo_results.tvoc);
+        // Only formatted and written out when the display is on, and then at a capped rate
+        puck_display_measurement_t measurement = {
+            .etoh = algo_results.etoh,
+            .tvoc = algo_results.tvoc,
+            .eco2 = algo_results.eco2,
+            .iaq = algo_results.iaq,
+            .rcdaKohm = pow(10, algo_results.log_rcda) / 1e3,
+            .jitterMeanMs = PeriodicSched_meanJitterTicks(&measSched) * portTICK_PERIOD_MS,
+            .jitterMaxMs = measSched.maxJitterTicks * portTICK_PERIOD_MS,
+            .missedDeadlines = measSched.missedDeadlines,
+            .wakesPerCycle = wakeStats.lastCycleWakes,
+            .awakeMsPerCycle = wakeStats.lastCycleAwakeTicks * portTICK_PERIOD_MS,
+        };
+        PuckDisplay_updateMeasurement(&measurement, sensorStatus);
+
+        // Never blocks, a slow upload costs readings rather than measurement timing
+        App_measurement result = {
+            .tvoc = algo_results.tvoc,
+            .eco2 = algo_results.eco2,
+            .etoh = algo_results.etoh,
+            .iaq = algo_results.iaq,
+            .temperatureDegC = env.temperatureDegC,
+            .status = readingStatus,
+        };
+        SendUpdateValue(&result);
         // SendUpdateValue(algo_results.rmox[12] / 3000000.0);
 //        SendUpdateValue((1E6 / algo_results.rmox[12]) + 0.2);
         continue;
 
 reading_fail:
+        measuring = false;
         for (int i = 0; i < 10; i++) {
             GPIO_write(CONFIG_GPIO_LED_RED, CONFIG_GPIO_LED_ON);
             dev.delay_ms(250);
@@ -300,10 +496,17 @@ reading_fail:
 
 exit:
     GPIO_write(CONFIG_GPIO_LED_RED, CONFIG_GPIO_LED_ON);
+    PowerMgr_end(POWER_ACTIVITY_SENSOR);
 
     return NULL;
 }
 
 void app_zmod4xxx_init(void) {
+    // Die temperature by default, an external sensor can replace it with EnvFusion_setSource
+    Temperature_init();
+    EnvFusion_setSource(&dieTempSource);
+    CaptureLog_init();
+    I2CBus_init();
+
     pthread_create(&zmodThread, NULL, app_zmod4xxx_run, NULL);
 }
@@ -0,0 +1,111 @@
+/*
+ * battery_model.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "battery_model.h"
+
+// Weight of the newest sample in the filtered voltage is 1 / (1 << BATTERY_FILTER_SHIFT)
+#define BATTERY_FILTER_SHIFT    4
+// A jump up this big can only be a fresh cell
+#define BATTERY_REPLACED_PCT    20
+
+typedef struct battery_curve_point_t {
+    uint16_t mv;
+    uint8_t percent;
+} battery_curve_point_t;
+
+// CR2032 loaded voltage against remaining capacity, for BLE connection sized pulses
+static const battery_curve_point_t batteryCurve[] = {
+    {2950, 100},
+    {2900, 90},
+    {2850, 75},
+    {2800, 55},
+    {2750, 40},
+    {2700, 30},
+    {2600, 18},
+    {2500, 10},
+    {2300, 4},
+    {2000, 0},
+};
+
+#define BATTERY_CURVE_POINTS (sizeof(batteryCurve) / sizeof(batteryCurve[0]))
+
+static uint8_t BatteryModel_curvePercent(uint16_t mv) {
+    if (mv >= batteryCurve[0].mv) {
+        return batteryCurve[0].percent;
+    }
+    for (size_t i = 1; i < BATTERY_CURVE_POINTS; i++) {
+        const battery_curve_point_t *hi = &batteryCurve[i - 1];
+        const battery_curve_point_t *lo = &batteryCurve[i];
+        if (mv >= lo->mv) {
+            return lo->percent + (uint32_t) (mv - lo->mv) * (hi->percent - lo->percent) / (hi->mv - lo->mv);
+        }
+    }
+    return 0;
+}
+
+void BatteryModel_init(battery_model_t *model) {
+    memset(model, 0, sizeof(*model));
+    model->sagMv = BATTERY_DEFAULT_SAG_MV;
+}
+
+void BatteryModel_restSample(battery_model_t *model, uint16_t mv) {
+    model->haveRest = true;
+    model->lastRestMv = mv;
+
+    uint32_t loadedQ4 = (mv > model->sagMv) ? (uint32_t) (mv - model->sagMv) << 4 : 0;
+    if (!model->haveFiltered) {
+        model->filteredMvQ4 = loadedQ4;
+        model->haveFiltered = true;
+        model->percent = BatteryModel_curvePercent(loadedQ4 >> 4);
+        return;
+    }
+    model->filteredMvQ4 = model->filteredMvQ4 - (model->filteredMvQ4 >> BATTERY_FILTER_SHIFT) + (loadedQ4 >> BATTERY_FILTER_SHIFT);
+
+    // Voltage recovers as the cell warms up or rests, that isn't charge coming back
+    uint8_t percent = BatteryModel_curvePercent(model->filteredMvQ4 >> 4);
+    if (percent < model->percent || percent >= model->percent + BATTERY_REPLACED_PCT) {
+        model->percent = percent;
+    }
+}
+
+void BatteryModel_loadSample(battery_model_t *model, uint16_t mv) {
+    if (!model->haveRest || mv >= model->lastRestMv) {
+        return;
+    }
+    // Sag grows as the cell's internal resistance does, so it is tracked rather than fixed
+    uint16_t sag = model->lastRestMv - mv;
+    model->sagMv = model->sagMv - (model->sagMv >> 2) + (sag >> 2);
+}
+
+uint16_t BatteryModel_loadedMv(const battery_model_t *model) {
+    return model->filteredMvQ4 >> 4;
+}
+
+uint8_t BatteryModel_percent(const battery_model_t *model) {
+    return model->percent;
+}
+
+uint32_t BatteryModel_remainingUploads(const battery_model_t *model) {
+    return (uint32_t) model->percent * (BATTERY_CAPACITY_UAH / 100) / BATTERY_UPLOAD_CHARGE_UAH;
+}
+
+uint8_t BatteryModel_level(const battery_model_t *model) {
+    if (model->percent >= 50) {
+        return 3;
+    }
+    if (model->percent >= 20) {
+        return 2;
+    }
+    if (model->percent >= 5) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * battery_model.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef BATTERY_MODEL_H_
+#define BATTERY_MODEL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// State of charge of the CR2032 from the supply voltage. A coin cell's voltage at rest says little
+// until it is nearly flat, what it drops to under the radio's load is what matters, so the model is
+// a discharge curve of loaded voltage. Rest samples are converted with the sag measured right after
+// each upload, and the result is filtered so a single noisy sample can't move the estimate.
+// All integer maths, and no driver calls, the caller does the sampling.
+
+// Nominal capacity and what one upload (scan, connect, writes, disconnect) takes out of it
+#ifndef BATTERY_CAPACITY_UAH
+#define BATTERY_CAPACITY_UAH        225000
+#endif
+#ifndef BATTERY_UPLOAD_CHARGE_UAH
+#define BATTERY_UPLOAD_CHARGE_UAH   2
+#endif
+
+// Assumed until the first upload has measured it
+#define BATTERY_DEFAULT_SAG_MV      100
+
+typedef struct battery_model_t {
+    bool haveRest;
+    uint16_t lastRestMv;
+    uint16_t sagMv;
+    bool haveFiltered;
+    uint32_t filteredMvQ4;      // Loaded voltage estimate, mV * 16
+    uint8_t percent;            // Only ever goes down, unless the cell is replaced
+} battery_model_t;
+
+void BatteryModel_init(battery_model_t *model);
+// Supply voltage with the radio idle, taken every measurement cycle
+void BatteryModel_restSample(battery_model_t *model, uint16_t mv);
+// Supply voltage straight after a radio burst
+void BatteryModel_loadSample(battery_model_t *model, uint16_t mv);
+
+uint16_t BatteryModel_loadedMv(const battery_model_t *model);
+uint8_t BatteryModel_percent(const battery_model_t *model);
+// Uploads the remaining charge would pay for, not counting what the sensor draws in between
+uint32_t BatteryModel_remainingUploads(const battery_model_t *model);
+// 0 (empty) to 3 (good), for the formats that only have room for a coarse level
+uint8_t BatteryModel_level(const battery_model_t *model);
+
+#endif /* BATTERY_MODEL_H_ */
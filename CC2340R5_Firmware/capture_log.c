@@ -0,0 +1,290 @@
+/*
+ * capture_log.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "capture_log.h"
+#include "reading_codec.h"
+
+uint16_t CaptureLog_crc(const capture_record_t *record) {
+    capture_record_t tmp = *record;
+    tmp.crc = 0;
+
+    // CRC-16/CCITT, bitwise since it only runs once per record
+    const uint8_t *bytes = (const uint8_t *) &tmp;
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < sizeof(tmp); i++) {
+        crc ^= (uint16_t) bytes[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+#ifndef CAPTURE_LOG_HOST
+
+#include "FreeRTOS.h"
+#include <task.h>
+#include <semphr.h>
+#include "ti_drivers_config.h"
+#include <ti/drivers/NVS.h>
+
+static NVS_Handle nvsHandle = NULL;
+static SemaphoreHandle_t logMutex = NULL;
+static uint32_t numSlots = 0;
+static uint32_t slotsPerSector = 0;
+static size_t sectorSize = 0;
+
+// Records are stored at slot seq % numSlots, so finding one never needs a scan
+static uint32_t nextSeq = 0;
+// Nothing older than this is in flash, whatever the ring size says
+static uint32_t oldestSeq = 0;
+
+static volatile bool captureEnabled = false;
+static bool sessionPending = false;
+static capture_session_t session;
+static capture_log_stats_t logStats;
+
+bool CaptureLog_init(void) {
+    logMutex = xSemaphoreCreateMutex();
+    if (logMutex == NULL) {
+        return false;
+    }
+
+    NVS_init();
+    NVS_Params params;
+    NVS_Params_init(&params);
+    nvsHandle = NVS_open(CONFIG_NVS_CAPTURE, &params);
+    if (nvsHandle == NULL) {
+        return false;
+    }
+
+    NVS_Attrs attrs;
+    NVS_getAttrs(nvsHandle, &attrs);
+    sectorSize = attrs.sectorSize;
+    slotsPerSector = attrs.sectorSize / CAPTURE_RECORD_SIZE;
+    numSlots = attrs.regionSize / CAPTURE_RECORD_SIZE;
+
+    // Pick up where the ring left off before the last reset
+    bool found = false;
+    uint32_t minSeq = 0;
+    uint32_t maxSeq = 0;
+    for (uint32_t slot = 0; slot < numSlots; slot++) {
+        uint32_t seq;
+        if (NVS_read(nvsHandle, slot * CAPTURE_RECORD_SIZE, &seq, sizeof(seq)) != NVS_STATUS_SUCCESS || seq == CAPTURE_SEQ_ERASED) {
+            continue;
+        }
+        if (!found || seq < minSeq) {
+            minSeq = seq;
+        }
+        if (!found || seq > maxSeq) {
+            maxSeq = seq;
+        }
+        found = true;
+    }
+    nextSeq = found ? maxSeq + 1 : 0;
+    oldestSeq = found ? minSeq : 0;
+
+    return true;
+}
+
+// Oldest sequence number that can still be in flash, the rest of the sector being written has been erased
+static uint32_t CaptureLog_firstSeq(void) {
+    uint32_t head = nextSeq % numSlots;
+    uint32_t erasedAhead = (head % slotsPerSector) ? slotsPerSector - (head % slotsPerSector) : 0;
+    uint32_t held = numSlots - erasedAhead;
+    return (nextSeq - oldestSeq > held) ? nextSeq - held : oldestSeq;
+}
+
+static void CaptureLog_write(capture_record_t *record) {
+    uint32_t offset = (nextSeq % numSlots) * CAPTURE_RECORD_SIZE;
+
+    record->seq = nextSeq;
+    record->crc = CaptureLog_crc(record);
+
+    // The sequence number moves on even if the write fails, the slot can't be written twice without an erase
+    nextSeq++;
+
+    if (offset % sectorSize == 0 && NVS_erase(nvsHandle, offset, sectorSize) != NVS_STATUS_SUCCESS) {
+        logStats.writeFailures++;
+        return;
+    }
+    if (NVS_write(nvsHandle, offset, record, sizeof(*record), NVS_WRITE_POST_VERIFY) != NVS_STATUS_SUCCESS) {
+        logStats.writeFailures++;
+        return;
+    }
+    logStats.appended++;
+}
+
+void CaptureLog_setEnabled(bool enabled) {
+    if (enabled && !captureEnabled) {
+        sessionPending = true;
+    }
+    captureEnabled = enabled;
+}
+
+bool CaptureLog_isEnabled(void) {
+    return captureEnabled;
+}
+
+void CaptureLog_setSession(const capture_session_t *newSession) {
+    session = *newSession;
+    sessionPending = true;
+}
+
+void CaptureLog_appendSample(const capture_sample_t *sample, uint8_t algoStatus) {
+    if (!captureEnabled || nvsHandle == NULL) {
+        return;
+    }
+
+    capture_record_t record;
+    xSemaphoreTake(logMutex, portMAX_DELAY);
+    bool sectorStart = ((nextSeq % numSlots) % slotsPerSector) == 0;
+    if (sessionPending || sectorStart) {
+        memset(&record, 0, sizeof(record));
+        record.kind = CAPTURE_KIND_SESSION;
+        record.body.session = session;
+        record.body.session.restart = sessionPending;
+        CaptureLog_write(&record);
+        sessionPending = false;
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.kind = CAPTURE_KIND_SAMPLE;
+    record.algoStatus = algoStatus;
+    record.body.sample = *sample;
+    CaptureLog_write(&record);
+    xSemaphoreGive(logMutex);
+}
+
+bool CaptureLog_erase(void) {
+    if (nvsHandle == NULL) {
+        return false;
+    }
+
+    xSemaphoreTake(logMutex, portMAX_DELAY);
+    NVS_Attrs attrs;
+    NVS_getAttrs(nvsHandle, &attrs);
+    bool ok = NVS_erase(nvsHandle, 0, attrs.regionSize) == NVS_STATUS_SUCCESS;
+    // Sequence numbers carry on, so a download can't confuse old records with new ones
+    oldestSeq = nextSeq;
+    sessionPending = true;
+    xSemaphoreGive(logMutex);
+
+    return ok;
+}
+
+void CaptureLog_getStats(capture_log_stats_t *stats) {
+    if (nvsHandle == NULL) {
+        *stats = logStats;
+        return;
+    }
+
+    xSemaphoreTake(logMutex, portMAX_DELAY);
+    *stats = logStats;
+    stats->numSlots = numSlots;
+    stats->numRecords = nextSeq - CaptureLog_firstSeq();
+    xSemaphoreGive(logMutex);
+}
+
+void CaptureLog_downloadBegin(capture_download_t *download) {
+    memset(download, 0, sizeof(*download));
+    download->recordOffset = CAPTURE_RECORD_SIZE;
+    if (nvsHandle == NULL) {
+        return;
+    }
+
+    // Only what is in flash right now, anything captured during the download waits for the next one
+    xSemaphoreTake(logMutex, portMAX_DELAY);
+    download->nextSeq = CaptureLog_firstSeq();
+    download->endSeq = nextSeq;
+    xSemaphoreGive(logMutex);
+}
+
+static bool CaptureLog_downloadFetch(capture_download_t *download) {
+    while (download->nextSeq != download->endSeq) {
+        uint32_t seq = download->nextSeq++;
+        capture_record_t record;
+
+        xSemaphoreTake(logMutex, portMAX_DELAY);
+        int_fast16_t status = NVS_read(nvsHandle, (seq % numSlots) * CAPTURE_RECORD_SIZE, &record, sizeof(record));
+        xSemaphoreGive(logMutex);
+
+        // Overwritten since the download started, or never made it to flash intact
+        if (status != NVS_STATUS_SUCCESS || record.seq != seq || record.crc != CaptureLog_crc(&record)) {
+            download->lost++;
+            continue;
+        }
+
+        memcpy(download->record, &record, CAPTURE_RECORD_SIZE);
+        download->recordOffset = 0;
+        download->records++;
+        return true;
+    }
+    return false;
+}
+
+size_t CaptureLog_downloadNext(capture_download_t *download, uint8_t *buf, size_t len) {
+    if (download->ended || len < CAPTURE_END_RECORD_SIZE) {
+        return 0;
+    }
+
+    size_t used = CAPTURE_CHUNK_HEADER_SIZE;
+    while (used < len) {
+        if (download->recordOffset == CAPTURE_RECORD_SIZE && !CaptureLog_downloadFetch(download)) {
+            break;
+        }
+        size_t take = CAPTURE_RECORD_SIZE - download->recordOffset;
+        if (take > len - used) {
+            take = len - used;
+        }
+        memcpy(&buf[used], &download->record[download->recordOffset], take);
+        download->recordOffset += take;
+        used += take;
+    }
+    // A 7 byte write is a reading to the base station, leave the last byte for the next chunk
+    if (used == READING_LEGACY_SIZE) {
+        download->recordOffset--;
+        used--;
+    }
+
+    if (used > CAPTURE_CHUNK_HEADER_SIZE) {
+        buf[0] = RECORD_TAG_CAPTURE_CHUNK;
+        buf[1] = download->chunk >> 8;
+        buf[2] = download->chunk;
+        download->chunk++;
+        return used;
+    }
+
+    // Out of records, finish off with the end marker so the base station knows nothing is missing
+    buf[0] = RECORD_TAG_CAPTURE_END;
+    buf[1] = download->chunk >> 8;
+    buf[2] = download->chunk;
+    buf[3] = download->records >> 24;
+    buf[4] = download->records >> 16;
+    buf[5] = download->records >> 8;
+    buf[6] = download->records;
+    buf[7] = download->lost >> 24;
+    buf[8] = download->lost >> 16;
+    buf[9] = download->lost >> 8;
+    buf[10] = download->lost;
+    download->ended = true;
+    return CAPTURE_END_RECORD_SIZE;
+}
+
+void CaptureLog_downloadDone(const capture_download_t *download, uint32_t result) {
+    taskENTER_CRITICAL();
+    logStats.lastDownloadRecords = download->records;
+    logStats.lastDownloadLost = download->lost;
+    logStats.lastDownloadResult = result;
+    taskEXIT_CRITICAL();
+}
+
+#endif /* CAPTURE_LOG_HOST */
@@ -0,0 +1,123 @@
+/*
+ * capture_log.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef CAPTURE_LOG_H_
+#define CAPTURE_LOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Raw sensor capture for tuning the algorithm offline. Every cycle's ADC result, the conditions
+// the algorithm was given and what it made of them go into a ring of fixed size records in flash
+// (the CONFIG_NVS_CAPTURE region), oldest overwritten first. Nothing here depends on the drivers,
+// so the replay tool can include it for the record layout.
+
+#define CAPTURE_RECORD_SIZE         64
+#define CAPTURE_ADC_LEN             32
+#define CAPTURE_PROD_DATA_LEN       7
+#define CAPTURE_TRACKING_LEN        6
+
+// Erased flash, never a valid sequence number
+#define CAPTURE_SEQ_ERASED          0xFFFFFFFF
+
+#define CAPTURE_KIND_SESSION        0x01    // Sensor identity and calibration, written whenever capture starts
+                                            // and again at the start of every sector, so the ring never loses it
+#define CAPTURE_KIND_SAMPLE         0x02    // One measurement cycle
+
+typedef struct capture_session_t {
+    uint16_t pid;
+    uint16_t moxLr;
+    uint16_t moxEr;
+    uint8_t config[6];
+    uint8_t prodData[CAPTURE_PROD_DATA_LEN];
+    uint8_t trackingNumber[CAPTURE_TRACKING_LEN];
+    uint8_t restart;        // 0 when the record is only a repeat at the start of a flash sector
+    uint32_t samplePeriodMs;
+} capture_session_t;
+
+typedef struct capture_sample_t {
+    uint8_t adc[CAPTURE_ADC_LEN];
+    int16_t temperatureCentiDegC;   // Algorithm inputs
+    uint16_t humidityCentiPct;
+    float tvoc;                     // Algorithm outputs
+    float etoh;
+    float eco2;
+    float iaq;
+    float logRcda;
+} capture_sample_t;
+
+// Little endian, as laid out in flash and sent in a download
+typedef struct capture_record_t {
+    uint32_t seq;           // One higher for every record, across sessions and erases
+    uint8_t kind;
+    uint8_t algoStatus;     // calc_iaq_2nd_gen() return code for samples
+    uint16_t crc;           // CRC-16/CCITT over the record with this field zeroed
+    union {
+        capture_session_t session;
+        capture_sample_t sample;
+        uint8_t raw[CAPTURE_RECORD_SIZE - 8];
+    } body;
+} capture_record_t;
+
+_Static_assert(sizeof(capture_record_t) == CAPTURE_RECORD_SIZE, "Capture record layout changed size");
+
+// First byte of a download chunk written to the base station (readings are untagged 7 byte writes)
+// | Tag | Chunk (2) | Up to 17 bytes of the record stream |
+// The records are sent back to back, oldest first, and split across as many chunks as it takes.
+// No chunk is ever 7 bytes long, so none can be taken for a reading.
+// An end marker follows the last chunk: | Tag | Chunks sent (2) | Records sent (4) | Records lost (4) |
+#define RECORD_TAG_CAPTURE_CHUNK    0xC0
+#define RECORD_TAG_CAPTURE_END      0xC1
+#define CAPTURE_CHUNK_HEADER_SIZE   3
+#define CAPTURE_END_RECORD_SIZE     11
+
+typedef struct capture_log_stats_t {
+    uint32_t numRecords;        // Currently held in flash
+    uint32_t numSlots;
+    uint32_t appended;          // Since boot
+    uint32_t writeFailures;
+    uint32_t lastDownloadRecords;
+    uint32_t lastDownloadLost;  // Overwritten by the capture running alongside the download
+    uint32_t lastDownloadResult;
+} capture_log_stats_t;
+
+uint16_t CaptureLog_crc(const capture_record_t *record);
+
+#ifndef CAPTURE_LOG_HOST
+
+// Opens the flash region and finds where the ring left off
+bool CaptureLog_init(void);
+void CaptureLog_setEnabled(bool enabled);
+bool CaptureLog_isEnabled(void);
+// Identity for the session record written ahead of the first sample of every capture
+void CaptureLog_setSession(const capture_session_t *session);
+// Only stores anything while capture is enabled
+void CaptureLog_appendSample(const capture_sample_t *sample, uint8_t algoStatus);
+bool CaptureLog_erase(void);
+void CaptureLog_getStats(capture_log_stats_t *stats);
+
+// Download cursor, used by the send task to stream the log out in chunks
+typedef struct capture_download_t {
+    uint32_t nextSeq;
+    uint32_t endSeq;
+    uint8_t record[CAPTURE_RECORD_SIZE];
+    size_t recordOffset;        // Bytes of record already sent, CAPTURE_RECORD_SIZE once it's used up
+    uint16_t chunk;
+    uint32_t records;
+    uint32_t lost;
+    bool ended;
+} capture_download_t;
+
+void CaptureLog_downloadBegin(capture_download_t *download);
+// Fills buf with the next write of the download, 0 once the end marker has been produced
+size_t CaptureLog_downloadNext(capture_download_t *download, uint8_t *buf, size_t len);
+void CaptureLog_downloadDone(const capture_download_t *download, uint32_t result);
+
+#endif /* CAPTURE_LOG_HOST */
+
+#endif /* CAPTURE_LOG_H_ */
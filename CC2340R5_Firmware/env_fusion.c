@@ -0,0 +1,80 @@
+/*
+ * env_fusion.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "env_fusion.h"
+
+// No driver dependencies in here, the sources live with the bindings
+// Only used from the zmod thread, so no locking is needed
+static const env_source_t *envSource = NULL;
+static float filteredTemperature = ENV_FUSION_DEFAULT_TEMPERATURE_DEGC;
+static float filteredHumidity = ENV_FUSION_DEFAULT_HUMIDITY_PCT;
+static bool hasTemperature = false;
+static bool hasHumidity = false;
+static uint32_t staleSamples = 0;
+
+static float EnvFusion_clamp(float val, float min, float max) {
+    if (val < min) {
+        return min;
+    }
+    if (val > max) {
+        return max;
+    }
+    return val;
+}
+
+static float EnvFusion_filter(float prev, float sample, bool primed) {
+    // The first sample goes straight through, no point easing in from a default
+    if (!primed) {
+        return sample;
+    }
+    return prev + ENV_FUSION_FILTER_ALPHA * (sample - prev);
+}
+
+void EnvFusion_setSource(const env_source_t *source) {
+    envSource = source;
+    EnvFusion_reset();
+}
+
+void EnvFusion_sample(env_fusion_result_t *result) {
+    env_sample_t sample;
+
+    if (envSource != NULL && envSource->read(envSource->ctx, &sample)) {
+        float temperature = EnvFusion_clamp(sample.temperatureDegC, ENV_FUSION_MIN_TEMPERATURE_DEGC, ENV_FUSION_MAX_TEMPERATURE_DEGC);
+        filteredTemperature = EnvFusion_filter(filteredTemperature, temperature, hasTemperature);
+        hasTemperature = true;
+
+        if (sample.hasHumidity) {
+            float humidity = EnvFusion_clamp(sample.humidityPct, 0.0f, 100.0f);
+            filteredHumidity = EnvFusion_filter(filteredHumidity, humidity, hasHumidity);
+            hasHumidity = true;
+        }
+        staleSamples = 0;
+    }
+    else if (staleSamples < ENV_FUSION_MAX_STALE_SAMPLES) {
+        staleSamples++;
+    }
+    else {
+        // The source has been gone too long to keep trusting the last values
+        EnvFusion_reset();
+    }
+
+    result->temperatureDegC = hasTemperature ? filteredTemperature : ENV_FUSION_DEFAULT_TEMPERATURE_DEGC;
+    result->humidityPct = hasHumidity ? filteredHumidity : ENV_FUSION_DEFAULT_HUMIDITY_PCT;
+    result->measured = hasTemperature;
+}
+
+void EnvFusion_reset(void) {
+    filteredTemperature = ENV_FUSION_DEFAULT_TEMPERATURE_DEGC;
+    filteredHumidity = ENV_FUSION_DEFAULT_HUMIDITY_PCT;
+    hasTemperature = false;
+    hasHumidity = false;
+    staleSamples = 0;
+}
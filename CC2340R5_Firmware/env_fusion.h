@@ -0,0 +1,55 @@
+/*
+ * env_fusion.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef ENV_FUSION_H_
+#define ENV_FUSION_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Used until the source has given a good sample, and for humidity when the source has no humidity sensor
+// The IAQ algorithm's own defaults, which is what the puck fed it before there was a source
+#define ENV_FUSION_DEFAULT_TEMPERATURE_DEGC 20.0f
+#define ENV_FUSION_DEFAULT_HUMIDITY_PCT     50.0f
+
+// Range the IAQ algorithm is specified over, anything outside is clamped
+#define ENV_FUSION_MIN_TEMPERATURE_DEGC     -40.0f
+#define ENV_FUSION_MAX_TEMPERATURE_DEGC     85.0f
+
+// Weight of a new sample in the exponential filter (1 disables filtering)
+// The die sensor only has 1 C resolution, so it needs some smoothing to not step the algorithm
+#define ENV_FUSION_FILTER_ALPHA             0.25f
+
+// Consecutive failed reads before the last good values are no longer trusted
+#define ENV_FUSION_MAX_STALE_SAMPLES        10
+
+typedef struct env_sample_t {
+    float temperatureDegC;
+    float humidityPct;
+    bool hasHumidity;
+} env_sample_t;
+
+// Where the ambient conditions come from (die sensor, an external sensor, a recorded trace...)
+typedef struct env_source_t {
+    const char *name;
+    // Returns false if no sample could be taken
+    bool (*read)(void *ctx, env_sample_t *sample);
+    void *ctx;
+} env_source_t;
+
+typedef struct env_fusion_result_t {
+    float temperatureDegC;
+    float humidityPct;
+    bool measured;          // False if these are defaults or too stale to count as measured
+} env_fusion_result_t;
+
+void EnvFusion_setSource(const env_source_t *source);
+// Takes a sample from the source, call right after the sensor ADC read so the two line up in time
+void EnvFusion_sample(env_fusion_result_t *result);
+void EnvFusion_reset(void);
+
+#endif /* ENV_FUSION_H_ */
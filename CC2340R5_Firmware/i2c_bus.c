@@ -0,0 +1,123 @@
+/*
+ * i2c_bus.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include <task.h>
+#include <semphr.h>
+#include "ti_drivers_config.h"
+#include <ti/drivers/I2C.h>
+
+#include "i2c_bus.h"
+
+static I2C_Handle busHandle = NULL;
+static SemaphoreHandle_t busMutex = NULL;
+static i2c_bus_stats_t busStats;
+
+bool I2CBus_init(void) {
+    // Before any thread that uses the bus is started, so there is nobody to race with
+    if (busMutex == NULL) {
+        busMutex = xSemaphoreCreateMutex();
+    }
+    return busMutex != NULL;
+}
+
+bool I2CBus_open(void) {
+    if (busMutex == NULL) {
+        return false;
+    }
+
+    xSemaphoreTake(busMutex, portMAX_DELAY);
+    if (busHandle == NULL) {
+        I2C_init();
+
+        // initialize optional I2C bus parameters
+        I2C_Params params;
+        I2C_Params_init(&params);
+        params.bitRate = CONFIG_I2C_0_MAXBITRATE;
+
+        // Open I2C bus for usage
+        busHandle = I2C_open(CONFIG_I2C_0, &params);
+    }
+    bool ok = (busHandle != NULL);
+    xSemaphoreGive(busMutex);
+
+    return ok;
+}
+
+static TickType_t I2CBus_lock(void) {
+    TickType_t waitStart = xTaskGetTickCount();
+    xSemaphoreTake(busMutex, portMAX_DELAY);
+    TickType_t now = xTaskGetTickCount();
+    busStats.contendedTicks += now - waitStart;
+    return now;
+}
+
+static void I2CBus_unlock(TickType_t lockTick, bool ok) {
+    busStats.transfers++;
+    if (!ok) {
+        busStats.failures++;
+    }
+    busStats.busTicks += xTaskGetTickCount() - lockTick;
+    xSemaphoreGive(busMutex);
+}
+
+bool I2CBus_readReg(uint8_t addr, uint8_t reg, uint8_t *data, size_t len) {
+    I2C_Transaction transaction = {0};
+    transaction.targetAddress = addr;
+
+    // Write the register address, then repeated start and read it back
+    transaction.writeBuf = &reg;
+    transaction.writeCount = 1;
+    transaction.readBuf = data;
+    transaction.readCount = len;
+
+    TickType_t lockTick = I2CBus_lock();
+    bool ok = I2C_transfer(busHandle, &transaction);
+    I2CBus_unlock(lockTick, ok);
+    return ok;
+}
+
+bool I2CBus_writeReg(uint8_t addr, uint8_t reg, const uint8_t *data, size_t len) {
+    bool ok = true;
+
+    // The chunks go out back to back without letting another thread in between
+    TickType_t lockTick = I2CBus_lock();
+    size_t offset = 0;
+    do {
+        size_t chunkLen = len - offset;
+        if (chunkLen > I2C_BUS_WRITE_CHUNK) {
+            chunkLen = I2C_BUS_WRITE_CHUNK;
+        }
+
+        // Register address followed by the data, in one write-only transfer
+        uint8_t frame[1 + I2C_BUS_WRITE_CHUNK];
+        frame[0] = reg + offset;
+        memcpy(&frame[1], &data[offset], chunkLen);
+
+        I2C_Transaction transaction = {0};
+        transaction.targetAddress = addr;
+        transaction.writeBuf = frame;
+        transaction.writeCount = 1 + chunkLen;
+        transaction.readBuf = NULL;
+        transaction.readCount = 0;
+        ok = I2C_transfer(busHandle, &transaction);
+
+        offset += chunkLen;
+    } while (ok && offset < len);
+    I2CBus_unlock(lockTick, ok);
+
+    return ok;
+}
+
+void I2CBus_getStats(i2c_bus_stats_t *stats) {
+    taskENTER_CRITICAL();
+    *stats = busStats;
+    taskEXIT_CRITICAL();
+}
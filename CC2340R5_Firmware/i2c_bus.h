@@ -0,0 +1,37 @@
+/*
+ * i2c_bus.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef I2C_BUS_H_
+#define I2C_BUS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Register writes are framed on the stack in chunks of this size, relying on the target auto
+// incrementing its register address (the ZMOD does), so nothing is shared between callers
+#define I2C_BUS_WRITE_CHUNK     32
+
+typedef struct i2c_bus_stats_t {
+    uint32_t transfers;
+    uint32_t failures;
+    uint32_t busTicks;          // Time the bus was held, waiting for the lock not included
+    uint32_t contendedTicks;    // Time spent waiting for another thread to finish with the bus
+} i2c_bus_stats_t;
+
+// Creates the bus lock, call once at startup before any thread that uses the bus is started
+bool I2CBus_init(void);
+// Safe to call from every thread that uses the bus, it is only opened once
+bool I2CBus_open(void);
+
+// Register access, each call is a complete transaction holding the bus lock throughout
+bool I2CBus_readReg(uint8_t addr, uint8_t reg, uint8_t *data, size_t len);
+bool I2CBus_writeReg(uint8_t addr, uint8_t reg, const uint8_t *data, size_t len);
+
+void I2CBus_getStats(i2c_bus_stats_t *stats);
+
+#endif /* I2C_BUS_H_ */
@@ -0,0 +1,531 @@
+/*
+ * ota_client.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "ota_client.h"
+
+// First sector of the store: | Magic (4) | Version (4) | Size (4) | Image CRC (4) | Block shift (4) | No delta (4) |
+// Verified (4) | Install tried (4) | Done (4 per block) |. Erased flash reads as ones, so the flags and the done words are
+// each written to zero exactly once, and progress never needs a sector erase.
+#define OTA_HEADER_MAGIC        0x4F544150
+#define OTA_HEADER_SIZE         32
+#define OTA_HEADER_NO_DELTA     20
+#define OTA_HEADER_VERIFIED     24
+#define OTA_HEADER_INSTALLED    28
+#define OTA_WORD_ERASED         0xFFFFFFFF
+#define OTA_STREAM_NONE         0xFFFFFFFF
+
+// Everything a session needs, and why it stopped
+typedef struct ota_session_t {
+    ota_client_t *client;
+    const ota_link_t *link;
+    uint32_t budget;
+    size_t maxRead;
+    ota_result_t result;
+} ota_session_t;
+
+static void OtaClient_putU32(uint8_t *buf, uint32_t val) {
+    buf[0] = val >> 24;
+    buf[1] = val >> 16;
+    buf[2] = val >> 8;
+    buf[3] = val;
+}
+
+static uint32_t OtaClient_getU32(const uint8_t *buf) {
+    return ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) | ((uint32_t) buf[2] << 8) | buf[3];
+}
+
+// CRC-32 (IEEE), the same one the base station uses. Bitwise, it only runs over a block at a time.
+uint32_t OtaClient_crc32(uint32_t crc, const void *buf, size_t len) {
+    const uint8_t *bytes = buf;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *bytes++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t OtaClient_maxBlocks(const ota_store_t *store) {
+    return (store->sectorSize - OTA_HEADER_SIZE) / sizeof(uint32_t);
+}
+
+static size_t OtaClient_blockLen(const ota_client_t *client, uint32_t block) {
+    uint32_t offset = block << client->blockShift;
+    uint32_t blockSize = 1 << client->blockShift;
+    return (client->size - offset < blockSize) ? client->size - offset : blockSize;
+}
+
+static bool OtaClient_readWord(const ota_store_t *store, uint32_t offset, uint32_t *word) {
+    return store->read(store->ctx, offset, word, sizeof(*word));
+}
+
+static bool OtaClient_clearWord(const ota_store_t *store, uint32_t offset) {
+    uint32_t zero = 0;
+    return store->write(store->ctx, offset, &zero, sizeof(zero));
+}
+
+void OtaClient_init(ota_client_t *client, const ota_store_t *store, uint32_t runningVersion) {
+    memset(client, 0, sizeof(*client));
+    client->store = store;
+    client->runningVersion = runningVersion;
+    client->streamPos = OTA_STREAM_NONE;
+
+    uint32_t header[OTA_HEADER_SIZE / sizeof(uint32_t)];
+    if (!store->read(store->ctx, 0, header, sizeof(header)) || header[0] != OTA_HEADER_MAGIC) {
+        return;
+    }
+    // An image no newer than the one running has been installed already (or never will be), it's done with
+    if (header[1] <= runningVersion) {
+        return;
+    }
+    client->version = header[1];
+    client->size = header[2];
+    client->crc = header[3];
+    client->blockShift = header[4];
+    client->noDelta = header[OTA_HEADER_NO_DELTA / sizeof(uint32_t)] != OTA_WORD_ERASED;
+    client->ready = header[OTA_HEADER_VERIFIED / sizeof(uint32_t)] != OTA_WORD_ERASED;
+    if (client->blockShift == 0 || (1u << client->blockShift) > OTA_CLIENT_MAX_BLOCK) {
+        return;
+    }
+    client->numBlocks = (client->size + (1 << client->blockShift) - 1) >> client->blockShift;
+    if (client->numBlocks > OtaClient_maxBlocks(store)) {
+        return;
+    }
+
+    // Blocks are done in order, so the first one not marked is where to carry on
+    uint32_t done;
+    while (client->nextBlock < client->numBlocks &&
+           OtaClient_readWord(store, OTA_HEADER_SIZE + client->nextBlock * sizeof(uint32_t), &done) &&
+           done != OTA_WORD_ERASED) {
+        client->nextBlock++;
+    }
+    client->active = true;
+}
+
+// Throws away whatever is staged and starts on the image on offer
+static bool OtaClient_begin(ota_client_t *client, uint32_t version, uint32_t size, uint32_t crc, uint8_t blockShift,
+                            bool noDelta) {
+    const ota_store_t *store = client->store;
+    client->active = false;
+    client->ready = false;
+
+    size_t eraseLen = store->sectorSize + size;
+    eraseLen = (eraseLen + store->sectorSize - 1) / store->sectorSize * store->sectorSize;
+    if (!store->erase(store->ctx, 0, eraseLen)) {
+        return false;
+    }
+
+    uint32_t header[OTA_HEADER_SIZE / sizeof(uint32_t)];
+    memset(header, 0xFF, sizeof(header));
+    header[0] = OTA_HEADER_MAGIC;
+    header[1] = version;
+    header[2] = size;
+    header[3] = crc;
+    header[4] = blockShift;
+    if (noDelta) {
+        header[OTA_HEADER_NO_DELTA / sizeof(uint32_t)] = 0;
+    }
+    if (!store->write(store->ctx, 0, header, sizeof(header))) {
+        return false;
+    }
+
+    client->version = version;
+    client->size = size;
+    client->crc = crc;
+    client->blockShift = blockShift;
+    client->noDelta = noDelta;
+    client->numBlocks = (size + (1 << blockShift) - 1) >> blockShift;
+    client->nextBlock = 0;
+    client->mapCount = 0;
+    client->active = true;
+    client->stats.restarts++;
+    return true;
+}
+
+static bool OtaClient_write(ota_session_t *session, const uint8_t *req, size_t len) {
+    if (session->budget == 0) {
+        session->result = OTA_RESULT_IN_PROGRESS;
+        return false;
+    }
+    session->budget--;
+    session->client->stats.exchanges++;
+    if (!session->link->write(session->link->ctx, req, len)) {
+        session->result = OTA_RESULT_LINK_FAILED;
+        return false;
+    }
+    return true;
+}
+
+// Returns the length of the response, 0 if there wasn't one with the expected tag
+static size_t OtaClient_read(ota_session_t *session, uint8_t *rsp, uint8_t tag, size_t minLen) {
+    if (session->budget == 0) {
+        session->result = OTA_RESULT_IN_PROGRESS;
+        return 0;
+    }
+    session->budget--;
+    session->client->stats.exchanges++;
+    size_t len = session->link->read(session->link->ctx, rsp, session->maxRead);
+    session->client->stats.bytesRead += len;
+    if (len == 0) {
+        session->result = OTA_RESULT_LINK_FAILED;
+        return 0;
+    }
+    if (rsp[0] == RECORD_TAG_OTA_ERROR && len >= 2 && (rsp[1] == OTA_STATUS_STALE || rsp[1] == OTA_STATUS_NO_IMAGE)) {
+        session->result = OTA_RESULT_STALE;
+        return 0;
+    }
+    if (rsp[0] != tag || len < minLen) {
+        session->result = OTA_RESULT_LINK_FAILED;
+        return 0;
+    }
+    return len;
+}
+
+static bool OtaClient_fetchMap(ota_session_t *session, uint32_t first) {
+    ota_client_t *client = session->client;
+    uint8_t req[8] = {RECORD_TAG_OTA_REQUEST, OTA_OP_MAP};
+    OtaClient_putU32(&req[2], client->crc);
+    req[6] = first >> 8;
+    req[7] = first;
+
+    // The base station's cursor moves over to the map
+    client->streamPos = OTA_STREAM_NONE;
+    client->carryLen = 0;
+    client->mapCount = 0;
+    if (!OtaClient_write(session, req, sizeof(req))) {
+        return false;
+    }
+
+    uint32_t count = client->numBlocks - first;
+    if (count > OTA_CLIENT_MAP_WINDOW) {
+        count = OTA_CLIENT_MAP_WINDOW;
+    }
+    uint32_t got = 0;
+    while (got < count) {
+        uint8_t rsp[OTA_CLIENT_MAX_READ];
+        size_t len = OtaClient_read(session, rsp, RECORD_TAG_OTA_MAP, OTA_MAP_HEADER_LEN + sizeof(uint32_t));
+        if (len == 0) {
+            return false;
+        }
+        if ((uint32_t) ((rsp[1] << 8) | rsp[2]) != first + got) {
+            session->result = OTA_RESULT_LINK_FAILED;
+            return false;
+        }
+        for (size_t idx = OTA_MAP_HEADER_LEN; idx + sizeof(uint32_t) <= len && got < count; idx += sizeof(uint32_t)) {
+            client->map[got++] = OtaClient_getU32(&rsp[idx]);
+        }
+    }
+    client->mapFirst = first;
+    client->mapCount = count;
+    return true;
+}
+
+// Reads a block into client->block, continuing the base station's cursor when it's already in the right place
+static bool OtaClient_fetchBlock(ota_session_t *session, uint32_t offset, size_t len) {
+    ota_client_t *client = session->client;
+    size_t filled = 0;
+    if (client->carryLen > 0 && client->carryOffset == offset) {
+        filled = (client->carryLen < len) ? client->carryLen : len;
+        memcpy(client->block, client->carry, filled);
+    }
+    client->carryLen = 0;
+
+    while (filled < len) {
+        uint32_t pos = offset + filled;
+        if (client->streamPos != pos) {
+            uint8_t req[10] = {RECORD_TAG_OTA_REQUEST, OTA_OP_READ};
+            OtaClient_putU32(&req[2], client->crc);
+            OtaClient_putU32(&req[6], pos);
+            client->streamPos = OTA_STREAM_NONE;
+            if (!OtaClient_write(session, req, sizeof(req))) {
+                return false;
+            }
+            client->streamPos = pos;
+        }
+
+        uint8_t rsp[OTA_CLIENT_MAX_READ];
+        size_t rspLen = OtaClient_read(session, rsp, RECORD_TAG_OTA_DATA, OTA_DATA_HEADER_LEN + 1);
+        if (rspLen == 0) {
+            client->streamPos = OTA_STREAM_NONE;
+            return false;
+        }
+        if (OtaClient_getU32(&rsp[1]) != pos) {
+            client->streamPos = OTA_STREAM_NONE;
+            session->result = OTA_RESULT_LINK_FAILED;
+            return false;
+        }
+
+        size_t dataLen = rspLen - OTA_DATA_HEADER_LEN;
+        size_t take = (dataLen < len - filled) ? dataLen : len - filled;
+        memcpy(&client->block[filled], &rsp[OTA_DATA_HEADER_LEN], take);
+        filled += take;
+        client->streamPos += dataLen;
+
+        // The start of the next block, kept in case that one has to be fetched too
+        if (dataLen > take) {
+            client->carryLen = dataLen - take;
+            client->carryOffset = offset + len;
+            memcpy(client->carry, &rsp[OTA_DATA_HEADER_LEN + take], client->carryLen);
+        }
+    }
+    return true;
+}
+
+static bool OtaClient_verify(ota_client_t *client) {
+    const ota_store_t *store = client->store;
+    uint32_t crc = 0;
+    for (uint32_t block = 0; block < client->numBlocks; block++) {
+        size_t len = OtaClient_blockLen(client, block);
+        if (!store->read(store->ctx, store->sectorSize + (block << client->blockShift), client->block, len)) {
+            return false;
+        }
+        crc = OtaClient_crc32(crc, client->block, len);
+    }
+    return crc == client->crc;
+}
+
+static ota_result_t OtaClient_transfer(ota_session_t *session) {
+    ota_client_t *client = session->client;
+    const ota_store_t *store = client->store;
+
+    while (client->nextBlock < client->numBlocks) {
+        uint32_t block = client->nextBlock;
+        uint32_t offset = block << client->blockShift;
+        size_t len = OtaClient_blockLen(client, block);
+        bool copied = false;
+        uint32_t expected = 0;
+
+        if (!client->noDelta) {
+            if (client->mapCount == 0 || block < client->mapFirst || block >= client->mapFirst + client->mapCount) {
+                if (!OtaClient_fetchMap(session, block)) {
+                    return session->result;
+                }
+            }
+            expected = client->map[block - client->mapFirst];
+
+            // Unchanged blocks come straight out of the running image
+            copied = offset + len <= store->runningSize &&
+                     store->readRunning(store->ctx, offset, client->block, len) &&
+                     OtaClient_crc32(0, client->block, len) == expected;
+        }
+
+        if (copied) {
+            client->stats.blocksCopied++;
+        }
+        else {
+            if (!OtaClient_fetchBlock(session, offset, len)) {
+                return session->result;
+            }
+            if (!client->noDelta && OtaClient_crc32(0, client->block, len) != expected) {
+                client->stats.badBlocks++;
+                client->streamPos = OTA_STREAM_NONE;
+                client->carryLen = 0;
+                return OTA_RESULT_BAD_DATA;
+            }
+            client->stats.blocksFetched++;
+        }
+
+        if (!store->write(store->ctx, store->sectorSize + offset, client->block, len) ||
+            !OtaClient_clearWord(store, OTA_HEADER_SIZE + block * sizeof(uint32_t))) {
+            return OTA_RESULT_STORE_FAILED;
+        }
+        client->nextBlock++;
+    }
+
+    if (!OtaClient_verify(client)) {
+        // Two blocks that share a CRC would get past the delta, so the next attempt fetches everything
+        OtaClient_begin(client, client->version, client->size, client->crc, client->blockShift, true);
+        return OTA_RESULT_BAD_DATA;
+    }
+    if (!OtaClient_clearWord(store, OTA_HEADER_VERIFIED)) {
+        return OTA_RESULT_STORE_FAILED;
+    }
+    client->ready = true;
+    return OTA_RESULT_READY;
+}
+
+static ota_result_t OtaClient_session(ota_session_t *session) {
+    ota_client_t *client = session->client;
+    const ota_store_t *store = client->store;
+
+    // Each connection starts with a query, the image on offer may have changed since the last one
+    uint8_t req[6] = {RECORD_TAG_OTA_REQUEST, OTA_OP_QUERY};
+    OtaClient_putU32(&req[2], client->runningVersion);
+    if (!OtaClient_write(session, req, sizeof(req))) {
+        return session->result;
+    }
+    uint8_t rsp[OTA_CLIENT_MAX_READ];
+    if (OtaClient_read(session, rsp, RECORD_TAG_OTA_OFFER, OTA_OFFER_LEN) == 0) {
+        return session->result;
+    }
+    if (rsp[1] != OTA_STATUS_OK) {
+        return OTA_RESULT_UP_TO_DATE;
+    }
+
+    uint32_t version = OtaClient_getU32(&rsp[2]);
+    uint32_t size = OtaClient_getU32(&rsp[6]);
+    uint32_t crc = OtaClient_getU32(&rsp[10]);
+    uint8_t blockShift = rsp[14];
+    if (client->active && client->crc == crc) {
+        if (client->ready) {
+            return OTA_RESULT_READY;
+        }
+        if (client->nextBlock > 0) {
+            client->stats.resumes++;
+        }
+    }
+    else {
+        uint32_t numBlocks = (size + (1 << blockShift) - 1) >> blockShift;
+        if (blockShift == 0 || (1u << blockShift) > OTA_CLIENT_MAX_BLOCK) {
+            return OTA_RESULT_LINK_FAILED;
+        }
+        if (size == 0 || store->sectorSize + size > store->size || numBlocks > OtaClient_maxBlocks(store)) {
+            return OTA_RESULT_TOO_BIG;
+        }
+        if (!OtaClient_begin(client, version, size, crc, blockShift, false)) {
+            return OTA_RESULT_STORE_FAILED;
+        }
+    }
+
+    // Nothing is known about the base station's cursors on a new connection
+    client->streamPos = OTA_STREAM_NONE;
+    client->carryLen = 0;
+    client->mapCount = 0;
+    return OtaClient_transfer(session);
+}
+
+ota_result_t OtaClient_run(ota_client_t *client, const ota_link_t *link, uint32_t maxExchanges) {
+    ota_session_t session = {
+        .client = client,
+        .link = link,
+        .budget = maxExchanges,
+        .maxRead = (link->maxRead < OTA_CLIENT_MAX_READ) ? link->maxRead : OTA_CLIENT_MAX_READ,
+        .result = OTA_RESULT_LINK_FAILED,
+    };
+    client->stats.sessions++;
+
+    ota_result_t result = OtaClient_session(&session);
+    client->stats.results[result]++;
+    return result;
+}
+
+bool OtaClient_inProgress(const ota_client_t *client) {
+    return client->active && !client->ready;
+}
+
+bool OtaClient_ready(const ota_client_t *client) {
+    return client->ready;
+}
+
+#ifndef OTA_CLIENT_HOST
+
+#include "ti_drivers_config.h"
+#include <ti/drivers/NVS.h>
+#include <ti/devices/DeviceFamily.h>
+#include DeviceFamily_constructPath(cmsis/cc23x0r5.h)
+
+// MCUboot's slots, laid out over the CONFIG_NVS_OTA region:
+// | Transfer progress (1 sector) | Secondary slot: image ... | trailer sector |
+// The bootloader's secondary slot has to start one sector into the region and run to its end, and the
+// primary slot has to be the same size. Its trailer magic goes in the last 16 bytes of the region.
+//
+// The image header imgtool puts in front of the application (its --header-size). The application is
+// linked to start right after it, so the primary slot starts that far before the vector table MCUboot
+// pointed VTOR at when it booted us.
+#ifndef OTA_IMAGE_HEADER_SIZE
+#define OTA_IMAGE_HEADER_SIZE   0x100
+#endif
+
+// MCUboot's image trailer magic. In the last 16 bytes of the secondary slot, it makes the bootloader
+// install the image there on the next boot.
+static const uint8_t mcubootMagic[16] = {
+    0x77, 0xC2, 0x95, 0xF3, 0x60, 0xD2, 0xEF, 0x7F, 0x35, 0x52, 0x50, 0x0F, 0x2C, 0xB6, 0x79, 0x80
+};
+
+static NVS_Handle nvsHandle = NULL;
+static size_t regionSize = 0;
+static uintptr_t runningBase = 0;
+static ota_store_t flashStore;
+
+static bool OtaClient_flashRead(void *ctx, uint32_t offset, void *buf, size_t len) {
+    return NVS_read(nvsHandle, offset, buf, len) == NVS_STATUS_SUCCESS;
+}
+
+static bool OtaClient_flashWrite(void *ctx, uint32_t offset, const void *buf, size_t len) {
+    return NVS_write(nvsHandle, offset, (void *) buf, len, NVS_WRITE_POST_VERIFY) == NVS_STATUS_SUCCESS;
+}
+
+static bool OtaClient_flashErase(void *ctx, uint32_t offset, size_t len) {
+    return NVS_erase(nvsHandle, offset, len) == NVS_STATUS_SUCCESS;
+}
+
+static bool OtaClient_flashReadRunning(void *ctx, uint32_t offset, void *buf, size_t len) {
+    // Internal flash is memory mapped
+    memcpy(buf, (const uint8_t *) runningBase + offset, len);
+    return true;
+}
+
+const ota_store_t* OtaClient_flashStore(void) {
+    if (nvsHandle == NULL) {
+        NVS_init();
+        NVS_Params params;
+        NVS_Params_init(&params);
+        nvsHandle = NVS_open(CONFIG_NVS_OTA, &params);
+        if (nvsHandle == NULL) {
+            return NULL;
+        }
+
+        NVS_Attrs attrs;
+        NVS_getAttrs(nvsHandle, &attrs);
+        regionSize = attrs.regionSize;
+        size_t slotSize = attrs.regionSize - attrs.sectorSize;
+        // Without the bootloader there is no image header to find, every block is fetched
+        bool booted = SCB->VTOR >= OTA_IMAGE_HEADER_SIZE;
+        runningBase = SCB->VTOR - OTA_IMAGE_HEADER_SIZE;
+        flashStore = (ota_store_t) {
+            .read = OtaClient_flashRead,
+            .write = OtaClient_flashWrite,
+            .erase = OtaClient_flashErase,
+            // The image is staged at the start of the secondary slot, and stops short of its trailer sector
+            .size = attrs.regionSize - attrs.sectorSize,
+            .sectorSize = attrs.sectorSize,
+            .readRunning = OtaClient_flashReadRunning,
+            .runningSize = booted ? slotSize : 0,
+        };
+    }
+    return &flashStore;
+}
+
+void OtaClient_install(ota_client_t *client) {
+    if (!client->ready || nvsHandle == NULL) {
+        return;
+    }
+
+    // Only ever once, if the bootloader didn't take it the last time it won't this time either
+    uint32_t installed;
+    if (!OtaClient_readWord(&flashStore, OTA_HEADER_INSTALLED, &installed) || installed != OTA_WORD_ERASED ||
+        !OtaClient_clearWord(&flashStore, OTA_HEADER_INSTALLED)) {
+        return;
+    }
+
+    // The end of the region is the end of the secondary slot
+    size_t trailerSector = regionSize - flashStore.sectorSize;
+    if (NVS_erase(nvsHandle, trailerSector, flashStore.sectorSize) != NVS_STATUS_SUCCESS ||
+        NVS_write(nvsHandle, regionSize - sizeof(mcubootMagic), (void *) mcubootMagic, sizeof(mcubootMagic),
+                  NVS_WRITE_POST_VERIFY) != NVS_STATUS_SUCCESS) {
+        return;
+    }
+    NVIC_SystemReset();
+}
+
+#endif /* OTA_CLIENT_HOST */
@@ -0,0 +1,145 @@
+/*
+ * ota_client.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef OTA_CLIENT_H_
+#define OTA_CLIENT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Firmware updates pulled from the base station over the upload characteristic (the protocol is
+// described in ota_dist.h on the Bluetooth server). The new image is staged in the CONFIG_NVS_OTA
+// region a block at a time. Blocks whose CRC matches the same block of the running image are copied
+// across rather than fetched, so only what changed goes over the air. Progress is kept in flash, so
+// a transfer carries on from where the last connection left it. Nothing here depends on the drivers
+// except the flash store at the bottom, so the simulation tool can run the whole transfer on a PC.
+
+#define RECORD_TAG_OTA_REQUEST      0xD0
+#define RECORD_TAG_OTA_OFFER        0xD1
+#define RECORD_TAG_OTA_MAP          0xD2
+#define RECORD_TAG_OTA_DATA         0xD3
+#define RECORD_TAG_OTA_ERROR        0xDF
+
+#define OTA_OP_QUERY                0x01
+#define OTA_OP_MAP                  0x02
+#define OTA_OP_READ                 0x03
+
+#define OTA_STATUS_OK               0
+#define OTA_STATUS_NO_IMAGE         1
+#define OTA_STATUS_UP_TO_DATE       2
+#define OTA_STATUS_STALE            3
+
+#define OTA_OFFER_LEN               15
+#define OTA_MAP_HEADER_LEN          3
+#define OTA_DATA_HEADER_LEN         5
+
+// Version of the firmware being built, the base station only offers newer ones
+#ifndef OTA_FIRMWARE_VERSION
+#define OTA_FIRMWARE_VERSION        1
+#endif
+
+// Largest block the base station can ask for (1 << block shift)
+#define OTA_CLIENT_MAX_BLOCK        512
+// Largest read response used, anything bigger is cut down to it
+#define OTA_CLIENT_MAX_READ         64
+// Block CRCs fetched at a time
+#define OTA_CLIENT_MAP_WINDOW       32
+
+// The characteristic, on a connection that's already up. Each call is one ATT request.
+typedef struct ota_link_t {
+    bool (*write)(void *ctx, const uint8_t *buf, size_t len);
+    // Returns the length of the value read, 0 if the read failed
+    size_t (*read)(void *ctx, uint8_t *buf, size_t len);
+    size_t maxRead;             // ATT MTU less one
+    void *ctx;
+} ota_link_t;
+
+// Where the new image is staged, and where the running one can be read from
+// The first sector of the store holds the transfer's progress, the image starts on the next one.
+// On the puck that next sector is the start of MCUboot's secondary slot (see ota_client.c).
+typedef struct ota_store_t {
+    bool (*read)(void *ctx, uint32_t offset, void *buf, size_t len);
+    bool (*write)(void *ctx, uint32_t offset, const void *buf, size_t len);
+    bool (*erase)(void *ctx, uint32_t offset, size_t len);
+    size_t size;
+    size_t sectorSize;
+    bool (*readRunning)(void *ctx, uint32_t offset, void *buf, size_t len);
+    size_t runningSize;
+    void *ctx;
+} ota_store_t;
+
+typedef enum ota_result_t {
+    OTA_RESULT_UP_TO_DATE = 0,  // Nothing newer on offer
+    OTA_RESULT_IN_PROGRESS,     // Ran out of exchanges, carries on next time
+    OTA_RESULT_READY,           // The whole image is staged and checks out
+    OTA_RESULT_LINK_FAILED,
+    OTA_RESULT_STALE,           // The base station's image changed under us, starts over next time
+    OTA_RESULT_BAD_DATA,        // A block or the image didn't match its CRC
+    OTA_RESULT_TOO_BIG,
+    OTA_RESULT_STORE_FAILED,
+    OTA_RESULT_COUNT
+} ota_result_t;
+
+typedef struct ota_client_stats_t {
+    uint32_t sessions;
+    uint32_t resumes;           // Sessions that picked up a transfer part way through
+    uint32_t restarts;          // Transfers started from scratch
+    uint32_t exchanges;         // Writes and reads of the characteristic
+    uint32_t bytesRead;         // Every byte of every response, headers included
+    uint32_t blocksFetched;
+    uint32_t blocksCopied;      // Blocks the running image already had
+    uint32_t badBlocks;
+    uint32_t results[OTA_RESULT_COUNT];
+} ota_client_stats_t;
+
+typedef struct ota_client_t {
+    const ota_store_t *store;
+    uint32_t runningVersion;
+
+    // The transfer in the store, reloaded from flash by OtaClient_init
+    bool active;
+    bool ready;
+    bool noDelta;               // Fetch every block, the delta already produced a bad image once
+    uint32_t version;
+    uint32_t size;
+    uint32_t crc;
+    uint8_t blockShift;
+    uint32_t numBlocks;
+    uint32_t nextBlock;
+
+    // Position of the base station's data cursor, and what was read past the end of the last block
+    uint32_t streamPos;
+    uint32_t carryOffset;
+    size_t carryLen;
+    uint8_t carry[OTA_CLIENT_MAX_READ];
+    uint8_t block[OTA_CLIENT_MAX_BLOCK];
+    uint32_t mapFirst;
+    uint32_t mapCount;
+    uint32_t map[OTA_CLIENT_MAP_WINDOW];
+
+    ota_client_stats_t stats;
+} ota_client_t;
+
+uint32_t OtaClient_crc32(uint32_t crc, const void *buf, size_t len);
+void OtaClient_init(ota_client_t *client, const ota_store_t *store, uint32_t runningVersion);
+// Runs one session on a connection, using at most maxExchanges writes and reads
+ota_result_t OtaClient_run(ota_client_t *client, const ota_link_t *link, uint32_t maxExchanges);
+// Whether a transfer has been started and not finished
+bool OtaClient_inProgress(const ota_client_t *client);
+bool OtaClient_ready(const ota_client_t *client);
+
+#ifndef OTA_CLIENT_HOST
+
+// The CONFIG_NVS_OTA region, and the running image in internal flash
+const ota_store_t* OtaClient_flashStore(void);
+// Hands the staged image to the bootloader and resets, doesn't return if it worked
+void OtaClient_install(ota_client_t *client);
+
+#endif /* OTA_CLIENT_HOST */
+
+#endif /* OTA_CLIENT_H_ */
@@ -0,0 +1,44 @@
+/*
+ * periodic_sched.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "periodic_sched.h"
+
+void PeriodicSched_init(periodic_sched_t *sched, uint32_t now, uint32_t periodTicks) {
+    memset(sched, 0, sizeof(*sched));
+    sched->periodTicks = periodTicks;
+    sched->deadline = now;
+}
+
+uint32_t PeriodicSched_ticksUntilDue(const periodic_sched_t *sched, uint32_t now) {
+    int32_t remaining = (int32_t) (sched->deadline - now);
+    return (remaining > 0) ? (uint32_t) remaining : 0;
+}
+
+void PeriodicSched_cycleStarted(periodic_sched_t *sched, uint32_t now) {
+    int32_t late = (int32_t) (now - sched->deadline);
+    uint32_t jitter = (late > 0) ? (uint32_t) late : 0;
+
+    sched->cycles++;
+    sched->sumJitterTicks += jitter;
+    if (jitter > sched->maxJitterTicks) {
+        sched->maxJitterTicks = jitter;
+    }
+
+    // Stay on the original grid, skipping any periods that were overrun rather than bunching up to catch up
+    sched->deadline += sched->periodTicks;
+    while ((int32_t) (now - sched->deadline) >= 0) {
+        sched->deadline += sched->periodTicks;
+        sched->missedDeadlines++;
+    }
+}
+
+uint32_t PeriodicSched_meanJitterTicks(const periodic_sched_t *sched) {
+    return sched->cycles ? (uint32_t) (sched->sumJitterTicks / sched->cycles) : 0;
+}
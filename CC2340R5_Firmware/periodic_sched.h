@@ -0,0 +1,33 @@
+/*
+ * periodic_sched.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef PERIODIC_SCHED_H_
+#define PERIODIC_SCHED_H_
+
+#include <stdint.h>
+
+// Absolute deadline scheduling, so time spent inside a cycle never pushes the following cycles back
+// Works in whatever tick the caller passes in (RTOS ticks on target, a simulated clock on a host),
+// and copes with the tick counter wrapping
+typedef struct periodic_sched_t {
+    uint32_t periodTicks;
+    uint32_t deadline;
+
+    uint32_t cycles;
+    uint32_t missedDeadlines;   // Whole periods skipped because a cycle ran past the next deadline
+    uint32_t maxJitterTicks;    // How late a cycle started compared to its deadline
+    uint64_t sumJitterTicks;
+} periodic_sched_t;
+
+void PeriodicSched_init(periodic_sched_t *sched, uint32_t now, uint32_t periodTicks);
+// Ticks to sleep before the current deadline, 0 if it has already passed
+uint32_t PeriodicSched_ticksUntilDue(const periodic_sched_t *sched, uint32_t now);
+// Call as the cycle starts, records its jitter and moves on to the next deadline
+void PeriodicSched_cycleStarted(periodic_sched_t *sched, uint32_t now);
+uint32_t PeriodicSched_meanJitterTicks(const periodic_sched_t *sched);
+
+#endif /* PERIODIC_SCHED_H_ */
@@ -0,0 +1,192 @@
+/*
+ * phy_policy.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "phy_policy.h"
+
+// The failure rate is kept with PHY_FAIL_RATE_SHIFT extra bits so it can decay all the way back to 0
+#define PHY_FAIL_RATE_SHIFT 4
+// Weight of the newest upload in the failure rate is 1 / (1 << PHY_FAIL_SMOOTH_SHIFT)
+#define PHY_FAIL_SMOOTH_SHIFT 3
+
+static const char* const modeNames[PHY_MODE_COUNT] = {
+    [PHY_MODE_2M] = "2M",
+    [PHY_MODE_1M] = "1M",
+    [PHY_MODE_CODED_S2] = "Coded S2",
+    [PHY_MODE_CODED_S8] = "Coded S8",
+};
+
+static const char* const reasonNames[PHY_REASON_COUNT] = {
+    [PHY_REASON_NONE] = "none",
+    [PHY_REASON_STRONG_SIGNAL] = "strong signal",
+    [PHY_REASON_WEAK_SIGNAL] = "weak signal",
+    [PHY_REASON_FAILURES] = "failures",
+    [PHY_REASON_UNSUPPORTED] = "unsupported",
+    [PHY_REASON_NEW_PEER] = "new base station",
+};
+
+void PhyPolicy_init(phy_policy_t *policy, const phy_policy_params_t *params) {
+    memset(policy, 0, sizeof(*policy));
+    policy->params = *params;
+    policy->mode = PHY_MODE_1M;
+    policy->lastFrom = PHY_MODE_1M;
+}
+
+static bool PhyPolicySupported(const phy_policy_t *policy, int mode) {
+    return (policy->unsupported & (1 << mode)) == 0;
+}
+
+// The PHY the RSSI alone calls for
+static phy_mode_t PhyPolicyForRssi(const phy_policy_params_t *params, int rssi) {
+    if (rssi >= params->rssi2M) {
+        return PHY_MODE_2M;
+    }
+    if (rssi >= params->rssiCoded) {
+        return PHY_MODE_1M;
+    }
+    if (rssi >= params->rssiS8) {
+        return PHY_MODE_CODED_S2;
+    }
+    return PHY_MODE_CODED_S8;
+}
+
+// The first supported PHY at least as robust as target, the current one if there's none
+static phy_mode_t PhyPolicyRobust(const phy_policy_t *policy, int target) {
+    for (int mode = target; mode < PHY_MODE_COUNT; mode++) {
+        if (PhyPolicySupported(policy, mode)) {
+            return (phy_mode_t) mode;
+        }
+    }
+    return policy->mode;
+}
+
+// The first supported PHY faster than the current one, the current one if there's none
+static phy_mode_t PhyPolicyFaster(const phy_policy_t *policy) {
+    for (int mode = (int) policy->mode - 1; mode >= 0; mode--) {
+        if (PhyPolicySupported(policy, mode)) {
+            return (phy_mode_t) mode;
+        }
+    }
+    return policy->mode;
+}
+
+static phy_reason_t PhyPolicySwitch(phy_policy_t *policy, phy_mode_t mode, phy_reason_t reason) {
+    if (mode == policy->mode) {
+        return PHY_REASON_NONE;
+    }
+    policy->lastFrom = policy->mode;
+    policy->lastReason = reason;
+    policy->mode = mode;
+    policy->failuresInRow = 0;
+    policy->uploadsInMode = 0;
+    policy->switches[reason]++;
+    return reason;
+}
+
+phy_reason_t PhyPolicy_uploadDone(phy_policy_t *policy, int8_t rssi, bool success) {
+    const phy_policy_params_t *params = &policy->params;
+
+    policy->rssi = rssi;
+    policy->uploads[policy->mode]++;
+    int32_t sample = success ? 0 : (255 << PHY_FAIL_RATE_SHIFT);
+    policy->failRate += (sample - (int32_t) policy->failRate) / (1 << PHY_FAIL_SMOOTH_SHIFT);
+    if (success) {
+        policy->failuresInRow = 0;
+        if (policy->uploadsInMode < UINT8_MAX) {
+            policy->uploadsInMode++;
+        }
+    }
+    else {
+        if (policy->failuresInRow < UINT8_MAX) {
+            policy->failuresInRow++;
+        }
+        policy->uploadsInMode = 0;
+    }
+    uint8_t failRate = PhyPolicy_failRate(policy);
+
+    if (!success && (policy->failuresInRow >= params->failuresToStepDown || failRate > params->maxFailRate)) {
+        return PhyPolicySwitch(policy, PhyPolicyRobust(policy, (int) policy->mode + 1), PHY_REASON_FAILURES);
+    }
+
+    phy_mode_t forRssi = PhyPolicyForRssi(params, rssi);
+    if (forRssi > policy->mode) {
+        return PhyPolicySwitch(policy, PhyPolicyRobust(policy, forRssi), PHY_REASON_WEAK_SIGNAL);
+    }
+
+    // One step at a time, and only with margin on the RSSI, so a faster PHY that fails costs little
+    if (success && policy->uploadsInMode >= params->uploadsToStepUp && failRate <= params->maxFailRate / 4 &&
+        PhyPolicyForRssi(params, (int) rssi - params->hysteresisDb) < policy->mode) {
+        return PhyPolicySwitch(policy, PhyPolicyFaster(policy), PHY_REASON_STRONG_SIGNAL);
+    }
+    return PHY_REASON_NONE;
+}
+
+phy_reason_t PhyPolicy_unsupported(phy_policy_t *policy, phy_mode_t mode) {
+    // Support for Coded is one feature bit, S2 and S8 come together
+    switch (mode) {
+        case PHY_MODE_2M:
+            policy->unsupported |= 1 << PHY_MODE_2M;
+            break;
+        case PHY_MODE_CODED_S2:
+        case PHY_MODE_CODED_S8:
+            policy->unsupported |= (1 << PHY_MODE_CODED_S2) | (1 << PHY_MODE_CODED_S8);
+            break;
+        default:
+            return PHY_REASON_NONE;
+    }
+    if (PhyPolicySupported(policy, policy->mode)) {
+        return PHY_REASON_NONE;
+    }
+    return PhyPolicySwitch(policy, PHY_MODE_1M, PHY_REASON_UNSUPPORTED);
+}
+
+phy_reason_t PhyPolicy_reset(phy_policy_t *policy) {
+    phy_reason_t reason = PhyPolicySwitch(policy, PHY_MODE_1M, PHY_REASON_NEW_PEER);
+    policy->unsupported = 0;
+    policy->failuresInRow = 0;
+    policy->uploadsInMode = 0;
+    policy->failRate = 0;
+    return reason;
+}
+
+uint8_t PhyPolicy_failRate(const phy_policy_t *policy) {
+    return policy->failRate >> PHY_FAIL_RATE_SHIFT;
+}
+
+size_t PhyPolicy_buildRecord(const phy_policy_t *policy, uint8_t *buf, size_t len) {
+    if (len < PHY_POLICY_RECORD_SIZE) {
+        return 0;
+    }
+
+    // Big endian, same as the phase stats
+    size_t idx = 0;
+    buf[idx++] = RECORD_TAG_PHY_STATS;
+    buf[idx++] = policy->mode;
+    buf[idx++] = policy->lastFrom;
+    buf[idx++] = policy->lastReason;
+    buf[idx++] = (uint8_t) policy->rssi;
+    buf[idx++] = PhyPolicy_failRate(policy);
+    buf[idx++] = policy->unsupported;
+    for (int reason = PHY_REASON_NONE + 1; reason < PHY_REASON_COUNT; reason++) {
+        uint16_t switches = (policy->switches[reason] > UINT16_MAX) ? UINT16_MAX : (uint16_t) policy->switches[reason];
+        buf[idx++] = switches >> 8;
+        buf[idx++] = switches & 0xFF;
+    }
+
+    return idx;
+}
+
+const char* PhyPolicy_modeName(phy_mode_t mode) {
+    return (mode < PHY_MODE_COUNT) ? modeNames[mode] : "?";
+}
+
+const char* PhyPolicy_reasonName(phy_reason_t reason) {
+    return (reason < PHY_REASON_COUNT) ? reasonNames[reason] : "?";
+}
@@ -0,0 +1,98 @@
+/*
+ * phy_policy.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef PHY_POLICY_H_
+#define PHY_POLICY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Picks the PHY for the next upload from the base station's RSSI and how the last uploads went.
+// Close pucks use 2M so the radio is on for less time, distant or struggling pucks drop to Coded
+// S2 and then S8 for the range. Moving to a more robust PHY happens as soon as the signal or the
+// failures call for it, moving back to a faster one takes a run of clean uploads and a margin on
+// the RSSI so the choice doesn't flap around a threshold.
+// Knows nothing about the stack, so it can be run on a PC.
+
+// Fastest first, each one more robust than the one before it
+typedef enum phy_mode_t {
+    PHY_MODE_2M = 0,
+    PHY_MODE_1M,
+    PHY_MODE_CODED_S2,
+    PHY_MODE_CODED_S8,
+    PHY_MODE_COUNT
+} phy_mode_t;
+
+typedef enum phy_reason_t {
+    PHY_REASON_NONE = 0,        // Staying on the same PHY
+    PHY_REASON_STRONG_SIGNAL,   // Clean uploads with RSSI to spare, one step faster
+    PHY_REASON_WEAK_SIGNAL,     // RSSI below what the PHY needs
+    PHY_REASON_FAILURES,        // Uploads keep failing on this PHY
+    PHY_REASON_UNSUPPORTED,     // The base station refused the PHY
+    PHY_REASON_NEW_PEER,        // Uploading to a different base station, start over
+    PHY_REASON_COUNT
+} phy_reason_t;
+
+typedef struct phy_policy_params_t {
+    int8_t rssi2M;              // dBm, at or above this 2M is worth using
+    int8_t rssiCoded;           // dBm, below this 1M is left for Coded S2
+    int8_t rssiS8;              // dBm, below this S2 is left for S8
+    uint8_t hysteresisDb;       // Extra RSSI needed before moving to a faster PHY
+    uint8_t failuresToStepDown; // Failures in a row before moving to a more robust PHY
+    uint8_t maxFailRate;        // Failure rate (out of 255) above which any failure moves to a more robust PHY
+    uint8_t uploadsToStepUp;    // Clean uploads on a PHY before trying a faster one
+} phy_policy_params_t;
+
+// 2M loses about 5 dB of sensitivity to 1M, S2 and S8 gain about 4 and 9 dB
+#define PHY_POLICY_DEFAULTS { \
+    .rssi2M = -65, \
+    .rssiCoded = -85, \
+    .rssiS8 = -92, \
+    .hysteresisDb = 6, \
+    .failuresToStepDown = 2, \
+    .maxFailRate = 64, \
+    .uploadsToStepUp = 8, \
+}
+
+typedef struct phy_policy_t {
+    phy_policy_params_t params;
+    phy_mode_t mode;
+    uint8_t unsupported;        // Bit per phy_mode_t the base station refused
+    uint8_t failuresInRow;
+    uint8_t uploadsInMode;      // Clean uploads since the last switch
+    uint16_t failRate;          // Smoothed, read it with PhyPolicy_failRate
+    int8_t rssi;                // Connection RSSI of the last upload
+    phy_mode_t lastFrom;        // The last switch, PHY_REASON_NONE until there's been one
+    phy_reason_t lastReason;
+    uint32_t uploads[PHY_MODE_COUNT];
+    uint32_t switches[PHY_REASON_COUNT];
+} phy_policy_t;
+
+// First byte of the PHY stats record written to the base station, after the phase stats
+#define RECORD_TAG_PHY_STATS        0xF1
+// | Tag | Mode | Last from | Last reason | RSSI | Fail rate | Unsupported | Switches per reason (2 each, from strong signal) |
+#define PHY_POLICY_RECORD_SIZE      (7 + 2 * (PHY_REASON_COUNT - 1))
+
+// Starts on 1M, which every base station supports
+void PhyPolicy_init(phy_policy_t *policy, const phy_policy_params_t *params);
+// Call after every upload with the RSSI of the base station it went to
+// Returns why the PHY for the next upload changed, PHY_REASON_NONE if it didn't
+phy_reason_t PhyPolicy_uploadDone(phy_policy_t *policy, int8_t rssi, bool success);
+// The base station refused the PHY, it isn't asked for again until the policy is reset
+phy_reason_t PhyPolicy_unsupported(phy_policy_t *policy, phy_mode_t mode);
+// Forgets what was learnt about the last base station, keeps the counters
+phy_reason_t PhyPolicy_reset(phy_policy_t *policy);
+// Failure rate out of 255
+uint8_t PhyPolicy_failRate(const phy_policy_t *policy);
+// The switch counters and the last switch, the counters go back to when the policy was initialised
+size_t PhyPolicy_buildRecord(const phy_policy_t *policy, uint8_t *buf, size_t len);
+
+const char* PhyPolicy_modeName(phy_mode_t mode);
+const char* PhyPolicy_reasonName(phy_reason_t reason);
+
+#endif /* PHY_POLICY_H_ */
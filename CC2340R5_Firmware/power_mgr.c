@@ -0,0 +1,114 @@
+/*
+ * power_mgr.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include <task.h>
+#include <ti/drivers/Power.h>
+#include <ti/drivers/power/PowerCC23X0.h>
+#include <ti/devices/DeviceFamily.h>
+#include DeviceFamily_constructPath(inc/hw_types.h)
+#include DeviceFamily_constructPath(inc/hw_memmap.h)
+#include DeviceFamily_constructPath(inc/hw_rtc.h)
+
+#include "power_mgr.h"
+
+// Constraint each activity holds while it runs, 0 for none
+static const int activityConstraints[POWER_ACTIVITY_COUNT] = {
+    [POWER_ACTIVITY_SENSOR] = 0,
+    [POWER_ACTIVITY_SENSOR_POLL] = PowerLPF3_DISALLOW_STANDBY,
+    [POWER_ACTIVITY_RADIO] = 0,     // The BLE stack holds what it needs itself
+};
+
+static Power_NotifyObj standbyNotify;
+static uint8_t activityCount[POWER_ACTIVITY_COUNT];
+static power_state_t currentState = POWER_STATE_IDLE;
+static uint32_t stateStart;
+static uint64_t residency[POWER_STATE_COUNT];
+static uint32_t standbyEntries;
+static uint32_t constraintHolds;
+
+// The RTC keeps counting through standby, unlike the RTOS tick which is only caught up afterwards
+static uint32_t PowerMgr_now(void) {
+    return HWREG(RTC_BASE + RTC_O_TIME8U);
+}
+
+// Interrupts must be disabled
+static void PowerMgr_switchState(power_state_t state) {
+    uint32_t now = PowerMgr_now();
+    residency[currentState] += now - stateStart;
+    stateStart = now;
+    currentState = state;
+}
+
+static power_state_t PowerMgr_activeState(void) {
+    if (activityCount[POWER_ACTIVITY_RADIO]) {
+        return POWER_STATE_RADIO;
+    }
+    if (activityCount[POWER_ACTIVITY_SENSOR] || activityCount[POWER_ACTIVITY_SENSOR_POLL]) {
+        return POWER_STATE_SENSOR;
+    }
+    return POWER_STATE_IDLE;
+}
+
+// Called by the power policy with interrupts disabled
+static int PowerMgr_standbyNotify(unsigned int eventType, uintptr_t eventArg, uintptr_t clientArg) {
+    if (eventType == PowerLPF3_ENTERING_STANDBY) {
+        standbyEntries++;
+        PowerMgr_switchState(POWER_STATE_STANDBY);
+    }
+    else {
+        PowerMgr_switchState(PowerMgr_activeState());
+    }
+    return Power_NOTIFYDONE;
+}
+
+void PowerMgr_init(void) {
+    stateStart = PowerMgr_now();
+    Power_registerNotify(&standbyNotify, PowerLPF3_ENTERING_STANDBY | PowerLPF3_AWAKE_STANDBY,
+                         PowerMgr_standbyNotify, 0);
+}
+
+void PowerMgr_begin(power_activity_t activity) {
+    taskENTER_CRITICAL();
+    bool first = (activityCount[activity]++ == 0);
+    PowerMgr_switchState(PowerMgr_activeState());
+    if (first && activityConstraints[activity]) {
+        constraintHolds++;
+    }
+    taskEXIT_CRITICAL();
+
+    if (first && activityConstraints[activity]) {
+        Power_setConstraint(activityConstraints[activity]);
+    }
+}
+
+void PowerMgr_end(power_activity_t activity) {
+    taskENTER_CRITICAL();
+    bool last = (activityCount[activity] > 0 && --activityCount[activity] == 0);
+    PowerMgr_switchState(PowerMgr_activeState());
+    taskEXIT_CRITICAL();
+
+    if (last && activityConstraints[activity]) {
+        Power_releaseConstraint(activityConstraints[activity]);
+    }
+}
+
+void PowerMgr_getStats(power_mgr_stats_t *stats) {
+    taskENTER_CRITICAL();
+    // Bring the current state up to date so it isn't missing from the totals
+    PowerMgr_switchState(currentState);
+    for (int state = 0; state < POWER_STATE_COUNT; state++) {
+        // 8 us RTC ticks
+        stats->residencyMs[state] = (uint32_t) (residency[state] * 8 / 1000);
+    }
+    stats->standbyEntries = standbyEntries;
+    stats->constraintHolds = constraintHolds;
+    taskEXIT_CRITICAL();
+}
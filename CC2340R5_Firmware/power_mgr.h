@@ -0,0 +1,47 @@
+/*
+ * power_mgr.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef POWER_MGR_H_
+#define POWER_MGR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Coordinates what keeps the puck awake. Threads bracket their work with PowerMgr_begin/end, and the
+// power policy is left free to drop into standby whenever none of it is running. The sensor's heater
+// runs its own sequence, so a measurement in progress never holds the MCU up, only the activities
+// that would pay more for a standby round trip than they save place a constraint.
+
+typedef enum power_activity_t {
+    POWER_ACTIVITY_SENSOR = 0,      // zmod thread running: I2C transfers, the algorithm, reporting
+    POWER_ACTIVITY_SENSOR_POLL,     // Polling the sensor for completion, too often for standby to pay off
+    POWER_ACTIVITY_RADIO,           // An upload or download, from scan to disconnect
+    POWER_ACTIVITY_COUNT
+} power_activity_t;
+
+// Where the time goes, the MCU is in exactly one of these at any time
+typedef enum power_state_t {
+    POWER_STATE_IDLE = 0,           // Awake with nothing bracketed running (stack, menu, idle loop)
+    POWER_STATE_SENSOR,
+    POWER_STATE_RADIO,              // Takes precedence over the sensor when both are running
+    POWER_STATE_STANDBY,
+    POWER_STATE_COUNT
+} power_state_t;
+
+typedef struct power_mgr_stats_t {
+    uint32_t residencyMs[POWER_STATE_COUNT];
+    uint32_t standbyEntries;
+    uint32_t constraintHolds;       // Times an activity set a constraint
+} power_mgr_stats_t;
+
+void PowerMgr_init(void);
+// Calls nest, an activity is running until every begin has had its end
+void PowerMgr_begin(power_activity_t activity);
+void PowerMgr_end(power_activity_t activity);
+void PowerMgr_getStats(power_mgr_stats_t *stats);
+
+#endif /* POWER_MGR_H_ */
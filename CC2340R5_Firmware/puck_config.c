@@ -0,0 +1,277 @@
+/*
+ * puck_config.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "puck_config.h"
+
+// Longest interval in seconds that still fits in milliseconds
+#define PUCK_CONFIG_MAX_SECONDS         (UINT32_MAX / 1000)
+
+static uint32_t PuckConfigGetU32(const uint8_t *buf) {
+    return ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) | ((uint32_t) buf[2] << 8) | buf[3];
+}
+
+static uint16_t PuckConfigGetU16(const uint8_t *buf) {
+    return (buf[0] << 8) | buf[1];
+}
+
+void PuckConfig_defaults(puck_config_t *config) {
+    const report_policy_params_t reportDefaults = REPORT_POLICY_DEFAULTS;
+    memset(config, 0, sizeof(*config));
+    config->report = reportDefaults;
+    config->batchReadings = PUCK_CONFIG_DEFAULT_BATCH_READINGS;
+    config->checkIntervalMin = PUCK_CONFIG_DEFAULT_CHECK_MINUTES;
+}
+
+bool PuckConfig_decode(puck_config_t *config, uint32_t revision, const uint8_t *tlv, size_t len) {
+    if (len > PUCK_CONFIG_MAX_TLV_LEN) {
+        return false;
+    }
+
+    puck_config_t decoded;
+    PuckConfig_defaults(&decoded);
+    size_t pos = 0;
+    while (pos < len) {
+        if (len - pos < 2 || len - pos - 2 < tlv[pos + 1]) {
+            return false;
+        }
+        uint8_t type = tlv[pos];
+        uint8_t valueLen = tlv[pos + 1];
+        const uint8_t *value = &tlv[pos + 2];
+        pos += 2 + valueLen;
+
+        // Known types have to be the right size, so a mistake on the server can't be half applied
+        size_t expectedLen;
+        switch (type) {
+            case CONFIG_TLV_ADAPTIVE:
+            case CONFIG_TLV_BATCH_READINGS:
+                expectedLen = 1;
+                break;
+            case CONFIG_TLV_TEMP_DEADBAND:
+            case CONFIG_TLV_CHECK_INTERVAL:
+                expectedLen = 2;
+                break;
+            case CONFIG_TLV_TVOC_DEADBAND:
+            case CONFIG_TLV_MAX_SILENCE:
+            case CONFIG_TLV_RISING_SLOPE:
+            case CONFIG_TLV_RISING_INTERVAL:
+                expectedLen = 4;
+                break;
+            default:
+                // Newer than this firmware
+                continue;
+        }
+        if (valueLen != expectedLen) {
+            return false;
+        }
+
+        uint32_t u32 = (valueLen == 4) ? PuckConfigGetU32(value) : (valueLen == 2) ? PuckConfigGetU16(value) : value[0];
+        switch (type) {
+            case CONFIG_TLV_ADAPTIVE:
+                decoded.report.adaptive = u32 != 0;
+                break;
+            case CONFIG_TLV_TVOC_DEADBAND:
+                if ((int32_t) u32 < 0) {
+                    return false;
+                }
+                decoded.report.tvocDeadband = (int32_t) u32;
+                break;
+            case CONFIG_TLV_TEMP_DEADBAND:
+                if ((int16_t) u32 < 0) {
+                    return false;
+                }
+                decoded.report.tempDeadband = (int16_t) u32;
+                break;
+            case CONFIG_TLV_MAX_SILENCE:
+                if (u32 == 0 || u32 > PUCK_CONFIG_MAX_SECONDS) {
+                    return false;
+                }
+                decoded.report.maxSilenceMs = u32 * 1000;
+                break;
+            case CONFIG_TLV_RISING_SLOPE:
+                decoded.report.risingSlope = (int32_t) u32;
+                break;
+            case CONFIG_TLV_RISING_INTERVAL:
+                if (u32 == 0 || u32 > PUCK_CONFIG_MAX_SECONDS) {
+                    return false;
+                }
+                decoded.report.risingIntervalMs = u32 * 1000;
+                break;
+            case CONFIG_TLV_BATCH_READINGS:
+                if (u32 == 0 || u32 > PUCK_CONFIG_MAX_BATCH_READINGS) {
+                    return false;
+                }
+                decoded.batchReadings = (uint8_t) u32;
+                break;
+            case CONFIG_TLV_CHECK_INTERVAL:
+                if (u32 == 0) {
+                    return false;
+                }
+                decoded.checkIntervalMin = (uint16_t) u32;
+                break;
+        }
+    }
+
+    decoded.revision = revision;
+    decoded.tlvLen = (uint8_t) len;
+    memcpy(decoded.tlv, tlv, len);
+    *config = decoded;
+    return true;
+}
+
+puck_config_result_t PuckConfig_fetch(puck_config_t *config, const ota_link_t *link) {
+    uint8_t req[CONFIG_REQUEST_LEN] = {
+        RECORD_TAG_CONFIG_REQUEST,
+        config->revision >> 24, config->revision >> 16, config->revision >> 8, config->revision,
+    };
+    if (!link->write(link->ctx, req, sizeof(req))) {
+        return PUCK_CONFIG_RESULT_LINK_FAILED;
+    }
+
+    // Each read carries the next part of the list, until all of it has been read
+    uint8_t tlv[PUCK_CONFIG_MAX_TLV_LEN];
+    uint32_t revision = 0;
+    size_t total = 0;
+    size_t received = 0;
+    size_t maxRead = (link->maxRead < OTA_CLIENT_MAX_READ) ? link->maxRead : OTA_CLIENT_MAX_READ;
+    do {
+        uint8_t rsp[OTA_CLIENT_MAX_READ];
+        size_t len = link->read(link->ctx, rsp, maxRead);
+        if (len == 0) {
+            return PUCK_CONFIG_RESULT_LINK_FAILED;
+        }
+        if (len < 2 || rsp[0] != RECORD_TAG_CONFIG_DATA) {
+            return PUCK_CONFIG_RESULT_BAD_DATA;
+        }
+        if (rsp[1] == CONFIG_STATUS_UP_TO_DATE) {
+            return PUCK_CONFIG_RESULT_UP_TO_DATE;
+        }
+        if (rsp[1] == CONFIG_STATUS_NONE) {
+            return PUCK_CONFIG_RESULT_NONE;
+        }
+        if (rsp[1] != CONFIG_STATUS_OK || len < CONFIG_DATA_HEADER_LEN) {
+            return PUCK_CONFIG_RESULT_BAD_DATA;
+        }
+
+        size_t chunk = len - CONFIG_DATA_HEADER_LEN;
+        uint32_t chunkRevision = PuckConfigGetU32(&rsp[2]);
+        if (received == 0) {
+            revision = chunkRevision;
+            total = rsp[7];
+        }
+        // A response that makes no progress would keep us here for good
+        if (chunkRevision != revision || rsp[6] != received || rsp[7] != total || total > sizeof(tlv) ||
+            chunk > total - received || (chunk == 0 && received < total)) {
+            return PUCK_CONFIG_RESULT_BAD_DATA;
+        }
+        memcpy(&tlv[received], &rsp[CONFIG_DATA_HEADER_LEN], chunk);
+        received += chunk;
+    } while (received < total);
+
+    if (!PuckConfig_decode(config, revision, tlv, total)) {
+        return PUCK_CONFIG_RESULT_BAD_DATA;
+    }
+    return PUCK_CONFIG_RESULT_UPDATED;
+}
+
+#ifndef PUCK_CONFIG_HOST
+
+#include "ti_drivers_config.h"
+#include <ti/drivers/NVS.h>
+
+// Each save goes in the next slot, so the region wears evenly, and a save cut short by a reset
+// leaves the one before it to load
+#define PUCK_CONFIG_RECORD_SIZE     64
+#define PUCK_CONFIG_SEQ_ERASED      0xFFFFFFFF
+
+typedef struct puck_config_record_t {
+    uint32_t seq;
+    uint32_t revision;
+    uint32_t crc;               // CRC-32 of the record with this field zeroed
+    uint8_t tlvLen;
+    uint8_t reserved[3];
+    uint8_t tlv[PUCK_CONFIG_MAX_TLV_LEN];
+} puck_config_record_t;
+
+_Static_assert(sizeof(puck_config_record_t) == PUCK_CONFIG_RECORD_SIZE, "Config record layout changed size");
+
+static NVS_Handle nvsHandle = NULL;
+static size_t sectorSize = 0;
+static uint32_t numSlots = 0;
+static uint32_t nextSeq = 0;
+
+static uint32_t PuckConfigRecordCrc(const puck_config_record_t *record) {
+    puck_config_record_t tmp = *record;
+    tmp.crc = 0;
+    return OtaClient_crc32(0, &tmp, sizeof(tmp));
+}
+
+void PuckConfig_load(puck_config_t *config) {
+    PuckConfig_defaults(config);
+
+    NVS_init();
+    NVS_Params params;
+    NVS_Params_init(&params);
+    nvsHandle = NVS_open(CONFIG_NVS_CONFIG, &params);
+    if (nvsHandle == NULL) {
+        return;
+    }
+
+    NVS_Attrs attrs;
+    NVS_getAttrs(nvsHandle, &attrs);
+    sectorSize = attrs.sectorSize;
+    numSlots = attrs.regionSize / PUCK_CONFIG_RECORD_SIZE;
+
+    bool found = false;
+    puck_config_record_t latest;
+    for (uint32_t slot = 0; slot < numSlots; slot++) {
+        puck_config_record_t record;
+        if (NVS_read(nvsHandle, slot * PUCK_CONFIG_RECORD_SIZE, &record, sizeof(record)) != NVS_STATUS_SUCCESS ||
+            record.seq == PUCK_CONFIG_SEQ_ERASED || record.crc != PuckConfigRecordCrc(&record) ||
+            record.tlvLen > PUCK_CONFIG_MAX_TLV_LEN) {
+            continue;
+        }
+        if (!found || record.seq > latest.seq) {
+            latest = record;
+            found = true;
+        }
+    }
+    if (!found) {
+        return;
+    }
+
+    nextSeq = latest.seq + 1;
+    // Saved by a firmware that understood it differently, the defaults are safer than half of it
+    PuckConfig_decode(config, latest.revision, latest.tlv, latest.tlvLen);
+}
+
+bool PuckConfig_save(const puck_config_t *config) {
+    if (nvsHandle == NULL || numSlots == 0) {
+        return false;
+    }
+
+    puck_config_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.seq = nextSeq;
+    record.revision = config->revision;
+    record.tlvLen = config->tlvLen;
+    memcpy(record.tlv, config->tlv, config->tlvLen);
+    record.crc = PuckConfigRecordCrc(&record);
+
+    // The sequence number moves on even if the write fails, the slot can't be written twice without an erase
+    uint32_t offset = (nextSeq % numSlots) * PUCK_CONFIG_RECORD_SIZE;
+    nextSeq++;
+    if (offset % sectorSize == 0 && NVS_erase(nvsHandle, offset, sectorSize) != NVS_STATUS_SUCCESS) {
+        return false;
+    }
+    return NVS_write(nvsHandle, offset, &record, sizeof(record), NVS_WRITE_POST_VERIFY) == NVS_STATUS_SUCCESS;
+}
+
+#endif /* PUCK_CONFIG_HOST */
@@ -0,0 +1,88 @@
+/*
+ * puck_config.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef PUCK_CONFIG_H_
+#define PUCK_CONFIG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "report_policy.h"
+#include "ota_client.h"
+
+// Settings the base station can change on a running puck (the protocol is described in config_dist.h
+// on the Bluetooth server). Pucks only ever act as GATT clients, so a new configuration is staged on
+// the base station and each puck pulls it through the upload characteristic during one of its own
+// uploads, the same way it picks up firmware. The configuration is a list of TLVs, kept in the
+// CONFIG_NVS_CONFIG region as it was received so it survives a reset. Settings the list leaves out
+// keep their built in defaults, and types a puck doesn't know are skipped.
+// The sample period isn't here, the IAQ algorithm only works at the cadence it was trained for.
+
+#define RECORD_TAG_CONFIG_REQUEST   0xD8
+#define RECORD_TAG_CONFIG_DATA      0xD9
+
+#define CONFIG_STATUS_OK            0
+#define CONFIG_STATUS_UP_TO_DATE    1
+#define CONFIG_STATUS_NONE          2
+
+#define CONFIG_REQUEST_LEN          5
+#define CONFIG_DATA_HEADER_LEN      8
+
+// | Type | Length | Value (big endian) |
+#define CONFIG_TLV_ADAPTIVE         0x01    // 1, 0 sends every reading
+#define CONFIG_TLV_TVOC_DEADBAND    0x02    // 4, TVOC * 10000
+#define CONFIG_TLV_TEMP_DEADBAND    0x03    // 2, degrees C * 10
+#define CONFIG_TLV_MAX_SILENCE      0x04    // 4, seconds
+#define CONFIG_TLV_RISING_SLOPE     0x05    // 4, TVOC * 10000 per minute
+#define CONFIG_TLV_RISING_INTERVAL  0x06    // 4, seconds
+#define CONFIG_TLV_BATCH_READINGS   0x07    // 1, readings to collect before an upload
+#define CONFIG_TLV_CHECK_INTERVAL   0x08    // 2, minutes between checks for a new configuration
+
+// Longest TLV list a puck keeps, every type above takes 38 bytes
+#define PUCK_CONFIG_MAX_TLV_LEN     48
+
+#define PUCK_CONFIG_DEFAULT_BATCH_READINGS  1
+// Keeps an upload from turning into a long wait
+#define PUCK_CONFIG_MAX_BATCH_READINGS      32
+#define PUCK_CONFIG_DEFAULT_CHECK_MINUTES   60
+
+typedef struct puck_config_t {
+    uint32_t revision;          // 0 until the base station has sent one
+    report_policy_params_t report;
+    uint8_t batchReadings;
+    uint16_t checkIntervalMin;
+
+    // What the settings were decoded from, as it is stored
+    uint8_t tlvLen;
+    uint8_t tlv[PUCK_CONFIG_MAX_TLV_LEN];
+} puck_config_t;
+
+typedef enum puck_config_result_t {
+    PUCK_CONFIG_RESULT_UPDATED = 0,
+    PUCK_CONFIG_RESULT_UP_TO_DATE,
+    PUCK_CONFIG_RESULT_NONE,            // Nothing staged for this puck
+    PUCK_CONFIG_RESULT_LINK_FAILED,
+    PUCK_CONFIG_RESULT_BAD_DATA,
+} puck_config_result_t;
+
+void PuckConfig_defaults(puck_config_t *config);
+// Replaces every setting with the defaults overridden by the TLV list
+// Leaves the configuration alone and returns false if the list doesn't parse or a value is out of range
+bool PuckConfig_decode(puck_config_t *config, uint32_t revision, const uint8_t *tlv, size_t len);
+// Asks the base station for a configuration newer than the one held, on a connection that's already up
+puck_config_result_t PuckConfig_fetch(puck_config_t *config, const ota_link_t *link);
+
+#ifndef PUCK_CONFIG_HOST
+
+// The last configuration saved, the defaults if there isn't one
+void PuckConfig_load(puck_config_t *config);
+bool PuckConfig_save(const puck_config_t *config);
+
+#endif /* PUCK_CONFIG_HOST */
+
+#endif /* PUCK_CONFIG_H_ */
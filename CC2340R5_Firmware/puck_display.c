@@ -0,0 +1,130 @@
+/*
+ * puck_display.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#include "puck_display.h"
+
+#if PUCK_DISPLAY_ENABLE
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "FreeRTOS.h"
+#include <task.h>
+#include <ti/bleapp/menu_module/menu_module.h>
+#include <app_main.h>
+
+#define PUCK_DISPLAY_DIRTY_MEASUREMENT  (1 << 0)
+#define PUCK_DISPLAY_DIRTY_QUEUED       (1 << 1)
+#define PUCK_DISPLAY_DIRTY_SENT         (1 << 2)
+
+typedef struct puck_display_frame_t {
+    puck_display_measurement_t measurement;
+    const char *sensorStatus;
+    puck_display_queued_t queued;
+    uint32_t numSent;
+    uint32_t sendResult;
+    uint32_t staleEvents;
+    uint32_t timeouts;
+} puck_display_frame_t;
+
+// Written from both the zmod and send data threads, so the frame is only touched in a critical section
+// The frame is kept up to date while the display is off, so it is current as soon as it is switched on
+static puck_display_frame_t frame = {.sensorStatus = ""};
+static uint8_t dirty = 0;
+static TickType_t lastRenderTick = 0;
+static bool hasRendered = false;
+static volatile bool displayEnabled = PUCK_DISPLAY_DEFAULT_ON;
+
+static void PuckDisplay_renderIfDue(void) {
+    puck_display_frame_t snapshot;
+    uint8_t renderMask;
+
+    taskENTER_CRITICAL();
+    TickType_t now = xTaskGetTickCount();
+    bool due = !hasRendered || (now - lastRenderTick) >= pdMS_TO_TICKS(PUCK_DISPLAY_MIN_INTERVAL_MS);
+    renderMask = (displayEnabled && due) ? dirty : 0;
+    if (renderMask) {
+        snapshot = frame;
+        dirty = 0;
+        lastRenderTick = now;
+        hasRendered = true;
+    }
+    taskEXIT_CRITICAL();
+
+    // Format outside the critical section, the UART writes are slow
+    if (renderMask & PUCK_DISPLAY_DIRTY_MEASUREMENT) {
+        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE, 0, "%s", snapshot.sensorStatus);
+        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE1, 0,
+                          " TVOC = %6.3f mg/m^3  eCO2 = %4.0f ppm  IAQ = %4.1f  EtOH = %6.3f ppm  Rcda = %.3f kOhm",
+                          snapshot.measurement.tvoc, snapshot.measurement.eco2, snapshot.measurement.iaq,
+                          snapshot.measurement.etoh, snapshot.measurement.rcdaKohm);
+        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE4, 0, " Sample jitter: mean %" PRIu32 " ms, max %" PRIu32 " ms, missed %" PRIu32 "; Wakes: %" PRIu32
+                          ", awake %" PRIu32 " ms per cycle",
+                          snapshot.measurement.jitterMeanMs, snapshot.measurement.jitterMaxMs,
+                          snapshot.measurement.missedDeadlines, snapshot.measurement.wakesPerCycle,
+                          snapshot.measurement.awakeMsPerCycle);
+    }
+    if (renderMask & PUCK_DISPLAY_DIRTY_QUEUED) {
+        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE2, 0,
+                          " Queued (TVOC: %6.3f, Temperature: %d C; Voltage: %d mV; Batt: %d%% (%" PRIu32 " uploads left); Pending: %" PRIu32
+                          "; Dropped: %" PRIu32 "; Warm-up: %" PRIu32 "; Unreported: %" PRIu32 ")",
+                          snapshot.queued.tvoc, snapshot.queued.temperature, snapshot.queued.voltageMv,
+                          snapshot.queued.batteryPct, snapshot.queued.remainingUploads, snapshot.queued.numPending, snapshot.queued.numDropped,
+                          snapshot.queued.numWarmup, snapshot.queued.numUnreported);
+    }
+    if (renderMask & PUCK_DISPLAY_DIRTY_SENT) {
+        MenuModule_printf(APP_MENU_PROFILE_STATUS_LINE3, 0, " Sent Data (%" PRIu32 " readings): Result = "
+                          MENU_MODULE_COLOR_BOLD MENU_MODULE_COLOR_RED "0x%08" PRIx32 MENU_MODULE_COLOR_RESET
+                          " (stale events: %" PRIu32 ", timeouts: %" PRIu32 ")",
+                          snapshot.numSent, snapshot.sendResult, snapshot.staleEvents, snapshot.timeouts);
+    }
+}
+
+void PuckDisplay_setEnabled(bool enabled) {
+    taskENTER_CRITICAL();
+    displayEnabled = enabled;
+    // Redraw everything on the next update, the lines may have been overwritten while off
+    if (enabled) {
+        dirty = PUCK_DISPLAY_DIRTY_MEASUREMENT | PUCK_DISPLAY_DIRTY_QUEUED | PUCK_DISPLAY_DIRTY_SENT;
+        hasRendered = false;
+    }
+    taskEXIT_CRITICAL();
+}
+
+bool PuckDisplay_isEnabled(void) {
+    return displayEnabled;
+}
+
+void PuckDisplay_updateMeasurement(const puck_display_measurement_t *measurement, const char *status) {
+    taskENTER_CRITICAL();
+    frame.measurement = *measurement;
+    frame.sensorStatus = status;
+    dirty |= PUCK_DISPLAY_DIRTY_MEASUREMENT;
+    taskEXIT_CRITICAL();
+    PuckDisplay_renderIfDue();
+}
+
+void PuckDisplay_updateQueued(const puck_display_queued_t *queued) {
+    taskENTER_CRITICAL();
+    frame.queued = *queued;
+    dirty |= PUCK_DISPLAY_DIRTY_QUEUED;
+    taskEXIT_CRITICAL();
+    PuckDisplay_renderIfDue();
+}
+
+void PuckDisplay_updateSent(uint32_t numSent, uint32_t result, uint32_t staleEvents, uint32_t timeouts) {
+    taskENTER_CRITICAL();
+    frame.numSent = numSent;
+    frame.sendResult = result;
+    frame.staleEvents = staleEvents;
+    frame.timeouts = timeouts;
+    dirty |= PUCK_DISPLAY_DIRTY_SENT;
+    taskEXIT_CRITICAL();
+    PuckDisplay_renderIfDue();
+}
+
+#endif /* PUCK_DISPLAY_ENABLE */
@@ -0,0 +1,86 @@
+/*
+ * puck_display.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef PUCK_DISPLAY_H_
+#define PUCK_DISPLAY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Live status on the menu UART. Off in production builds, formatting floats and pushing
+// ANSI sequences out the UART every cycle costs more than the sensing itself
+#ifndef PUCK_DISPLAY_ENABLE
+#define PUCK_DISPLAY_ENABLE             0
+#endif
+
+// Whether the display starts out rendering when it is compiled in (toggled from the main menu)
+#ifndef PUCK_DISPLAY_DEFAULT_ON
+#define PUCK_DISPLAY_DEFAULT_ON         1
+#endif
+
+// Minimum time between renders of the status frame, updates in between are coalesced
+#define PUCK_DISPLAY_MIN_INTERVAL_MS    1000
+
+typedef struct puck_display_measurement_t {
+    float etoh;         // ppm
+    float tvoc;         // mg/m^3
+    float eco2;         // ppm
+    float iaq;
+    float rcdaKohm;
+    uint32_t jitterMeanMs;      // How late measurements start compared to their deadline
+    uint32_t jitterMaxMs;
+    uint32_t missedDeadlines;
+    uint32_t wakesPerCycle;     // Times the zmod thread woke up during the last measurement cycle
+    uint32_t awakeMsPerCycle;
+} puck_display_measurement_t;
+
+typedef struct puck_display_queued_t {
+    float tvoc;
+    int16_t temperature;
+    uint16_t voltageMv;
+    uint8_t batteryPct;
+    uint32_t remainingUploads;  // Battery model estimate
+    uint32_t numPending;
+    uint32_t numDropped;        // Readings the send task had no room for
+    uint32_t numWarmup;         // Readings held back while the sensor warms up
+    uint32_t numUnreported;     // Readings the report policy decided weren't worth sending
+} puck_display_queued_t;
+
+#if PUCK_DISPLAY_ENABLE
+
+#include <ti/bleapp/menu_module/menu_module.h>
+
+void PuckDisplay_setEnabled(bool enabled);
+bool PuckDisplay_isEnabled(void);
+
+// Each update marks its part of the frame dirty, and the frame is rendered if the rate limit allows
+// status must be a string literal (or otherwise outlive the render)
+void PuckDisplay_updateMeasurement(const puck_display_measurement_t *measurement, const char *status);
+void PuckDisplay_updateQueued(const puck_display_queued_t *queued);
+void PuckDisplay_updateSent(uint32_t numSent, uint32_t result, uint32_t staleEvents, uint32_t timeouts);
+
+// One-off messages (init, errors) go straight out, they are rare enough not to need rate limiting
+#define PUCK_DISPLAY_PRINTF(line, ...) \
+    do { \
+        if (PuckDisplay_isEnabled()) { \
+            MenuModule_printf((line), 0, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#else
+
+static inline void PuckDisplay_setEnabled(bool enabled) { (void) enabled; }
+static inline bool PuckDisplay_isEnabled(void) { return false; }
+static inline void PuckDisplay_updateMeasurement(const puck_display_measurement_t *measurement, const char *status) { (void) measurement; (void) status; }
+static inline void PuckDisplay_updateQueued(const puck_display_queued_t *queued) { (void) queued; }
+static inline void PuckDisplay_updateSent(uint32_t numSent, uint32_t result, uint32_t staleEvents, uint32_t timeouts) { (void) numSent; (void) result; (void) staleEvents; (void) timeouts; }
+
+#define PUCK_DISPLAY_PRINTF(line, ...) do { } while (0)
+
+#endif /* PUCK_DISPLAY_ENABLE */
+
+#endif /* PUCK_DISPLAY_H_ */
@@ -0,0 +1,163 @@
+/*
+ * reading_codec.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "reading_codec.h"
+
+static size_t ReadingCodec_putVarint(int32_t val, uint8_t *buf) {
+    // Zig-zag first so small negative deltas stay small
+    uint32_t zz = ((uint32_t) val << 1) ^ (uint32_t) (val >> 31);
+    size_t idx = 0;
+    while (zz >= 0x80) {
+        buf[idx++] = (zz & 0x7F) | 0x80;
+        zz >>= 7;
+    }
+    buf[idx++] = zz;
+    return idx;
+}
+
+// Seconds since the reading was taken, saturating
+static uint16_t ReadingCodec_age(const puck_reading_t *reading, uint32_t nowMs) {
+    uint32_t age = (nowMs - reading->timeMs) / 1000;
+    return (age > UINT16_MAX) ? UINT16_MAX : age;
+}
+
+size_t ReadingCodec_encodeLegacy(const puck_reading_t *reading, uint8_t *buf, size_t len) {
+    if (len < READING_LEGACY_SIZE) {
+        return 0;
+    }
+
+    uint32_t voc = (uint32_t) reading->voc;
+    uint16_t temp = (uint16_t) reading->temp;
+    buf[0] = voc >> 24;
+    buf[1] = (voc >> 16) & 0xFF;
+    buf[2] = (voc >> 8) & 0xFF;
+    buf[3] = voc & 0xFF;
+    buf[4] = temp >> 8;
+    buf[5] = temp & 0xFF;
+    buf[6] = reading->batteryLevel;
+    return READING_LEGACY_SIZE;
+}
+
+size_t ReadingCodec_encodeBatch(const puck_reading_t *readings, size_t count, bool stamped, uint32_t nowMs,
+                                uint8_t *buf, size_t len, size_t *numEncoded) {
+    *numEncoded = 0;
+    if (len < READING_BATCH_HEADER_SIZE) {
+        return 0;
+    }
+
+    size_t idx = READING_BATCH_HEADER_SIZE;
+    puck_reading_t prev = {0};
+    uint16_t prevAge = 0;
+    while (*numEncoded < count && *numEncoded < UINT8_MAX) {
+        const puck_reading_t *cur = &readings[*numEncoded];
+
+        // Encode into scratch first, so a sample is never split across records
+        uint8_t sample[READING_BATCH_MAX_SAMPLE_SIZE];
+        size_t sampleLen = 0;
+        sampleLen += ReadingCodec_putVarint((int32_t) ((uint32_t) cur->voc - (uint32_t) prev.voc), &sample[sampleLen]);
+        sampleLen += ReadingCodec_putVarint((int32_t) cur->temp - prev.temp, &sample[sampleLen]);
+        sampleLen += ReadingCodec_putVarint((int32_t) cur->batteryLevel - prev.batteryLevel, &sample[sampleLen]);
+        uint16_t age = ReadingCodec_age(cur, nowMs);
+        if (stamped) {
+            // Sequence numbers wrap, the delta is taken the same way so it stays small across the wrap
+            sampleLen += ReadingCodec_putVarint((int16_t) (uint16_t) (cur->seq - prev.seq), &sample[sampleLen]);
+            sampleLen += ReadingCodec_putVarint((int32_t) age - prevAge, &sample[sampleLen]);
+        }
+        if (idx + sampleLen > len) {
+            break;
+        }
+
+        if (buf != NULL) {
+            memcpy(&buf[idx], sample, sampleLen);
+        }
+        idx += sampleLen;
+        prev = *cur;
+        prevAge = age;
+        (*numEncoded)++;
+    }
+
+    if (*numEncoded == 0) {
+        return 0;
+    }
+
+    // A stamped batch of one can come out at 7 bytes, which would be taken for the untagged format
+    bool pad = idx == READING_LEGACY_SIZE && idx < len;
+    if (buf != NULL) {
+        buf[0] = stamped ? RECORD_TAG_READING_BATCH_STAMPED : RECORD_TAG_READING_BATCH;
+        buf[1] = *numEncoded;
+        if (pad) {
+            buf[idx] = 0;
+        }
+    }
+    return pad ? idx + 1 : idx;
+}
+
+size_t ReadingCodec_batchSize(const puck_reading_t *readings, size_t count, bool stamped, uint32_t nowMs, size_t len) {
+    size_t total = 0;
+    size_t done = 0;
+    while (done < count) {
+        size_t numEncoded;
+        size_t recordLen = ReadingCodec_encodeBatch(&readings[done], count - done, stamped, nowMs, NULL, len, &numEncoded);
+        if (recordLen == 0) {
+            return 0;
+        }
+        total += recordLen;
+        done += numEncoded;
+    }
+    return total;
+}
+
+static size_t ReadingCodec_putBE(uint32_t val, size_t size, uint8_t *buf) {
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = val >> (8 * (size - 1 - i));
+    }
+    return size;
+}
+
+size_t ReadingCodec_encodeMetrics(const puck_reading_t *reading, uint8_t fields, uint32_t nowMs, uint8_t *buf, size_t len) {
+    // Leaves room for the padding byte
+    if (len < READING_METRICS_MAX_SIZE + 1) {
+        return 0;
+    }
+
+    size_t idx = 0;
+    buf[idx++] = RECORD_TAG_READING_METRICS;
+    buf[idx++] = fields;
+    if (fields & READING_FIELD_TVOC) {
+        idx += ReadingCodec_putBE((uint32_t) reading->voc, 4, &buf[idx]);
+    }
+    if (fields & READING_FIELD_ECO2) {
+        idx += ReadingCodec_putBE(reading->eco2, 2, &buf[idx]);
+    }
+    if (fields & READING_FIELD_ETOH) {
+        idx += ReadingCodec_putBE(reading->etoh, 2, &buf[idx]);
+    }
+    if (fields & READING_FIELD_IAQ) {
+        buf[idx++] = reading->iaq;
+    }
+    if (fields & READING_FIELD_TEMP) {
+        idx += ReadingCodec_putBE((uint16_t) reading->temp, 2, &buf[idx]);
+    }
+    if (fields & READING_FIELD_BATTERY) {
+        buf[idx++] = reading->batteryPct;
+    }
+    if (fields & READING_FIELD_STATUS) {
+        buf[idx++] = reading->status;
+    }
+    if (fields & READING_FIELD_STAMP) {
+        idx += ReadingCodec_putBE(reading->seq, 2, &buf[idx]);
+        idx += ReadingCodec_putBE(ReadingCodec_age(reading, nowMs), 2, &buf[idx]);
+    }
+
+    if (idx == READING_LEGACY_SIZE) {
+        buf[idx++] = 0;
+    }
+    return idx;
+}
@@ -0,0 +1,78 @@
+/*
+ * reading_codec.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef READING_CODEC_H_
+#define READING_CODEC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// A single reading, in the same fixed point units as the records it is written in
+// The batch and 7 byte formats only carry voc, temp and batteryLevel, plus the stamp for the stamped batch
+typedef struct puck_reading_t {
+    int32_t voc;            // TVOC * 10000
+    int16_t temp;           // Degrees C * 10
+    uint8_t batteryLevel;   // 0 (empty) to 3 (good)
+    uint16_t eco2;          // ppm
+    uint16_t etoh;          // ppm * 100
+    uint8_t iaq;            // IAQ index * 10
+    uint8_t status;         // READING_STATUS_*
+    uint8_t batteryPct;     // Estimated charge left
+    uint16_t seq;           // Counts up by one for every reading queued for upload, wraps
+    uint32_t timeMs;        // When it was taken, on the puck's own clock. Sent as an age, see READING_FIELD_STAMP
+} puck_reading_t;
+
+// Readings sent in the 7 byte or batch formats are always READING_STATUS_OK
+#define READING_STATUS_OK           0
+#define READING_STATUS_WARMUP       1   // The algorithm is still stabilising, values aren't trustworthy yet
+#define READING_STATUS_DAMAGED      2   // The sensor self-check failed
+
+#define READING_LEGACY_SIZE         7
+
+// First byte of a batch record (readings are untagged 7 byte writes)
+// | Tag | Count | Sample 0 | Sample 1 | ... |
+// Each sample is the zig-zag varint delta of VOC, temperature and battery from the previous sample
+// (sample 0 is relative to zero)
+#define RECORD_TAG_READING_BATCH    0xB0
+// Same again with the sequence number and age (as in READING_FIELD_STAMP) added to each sample's deltas
+// Like the metrics record, padded with a zero if it would be 7 bytes
+#define RECORD_TAG_READING_BATCH_STAMPED 0xB1
+#define READING_BATCH_HEADER_SIZE   2
+// Worst case of a 32 bit, 16 bit and 8 bit zig-zag varint, then two more 16 bit ones
+#define READING_BATCH_MAX_SAMPLE_SIZE (5 + 3 + 2 + 3 + 3)
+
+// First byte of a metrics record, carrying whichever fields are set in the mask, in bit order
+// | Tag | Mask | TVOC (4) | eCO2 (2) | EtOH (2) | IAQ (1) | Temp (2) | Battery % (1) | Status (1) | Seq (2) | Age (2) |
+// All big endian, same units as puck_reading_t. Never 7 bytes long, a trailing zero is added if it would be
+// (7 bytes is how the base station recognises the untagged format)
+#define RECORD_TAG_READING_METRICS  0xA0
+#define READING_FIELD_TVOC          (1 << 0)
+#define READING_FIELD_ECO2          (1 << 1)
+#define READING_FIELD_ETOH          (1 << 2)
+#define READING_FIELD_IAQ           (1 << 3)
+#define READING_FIELD_TEMP          (1 << 4)
+#define READING_FIELD_BATTERY       (1 << 5)
+#define READING_FIELD_STATUS        (1 << 6)
+// Sequence number, and seconds between the reading being taken and the record being written (saturating).
+// Whoever receives the record knows when that was on their own clock, so an age needs no clock sync
+#define READING_FIELD_STAMP         (1 << 7)
+#define READING_FIELDS_ALL          0xFF
+// What the 7 byte and batch formats can carry
+#define READING_FIELDS_LEGACY       (READING_FIELD_TVOC | READING_FIELD_TEMP | READING_FIELD_BATTERY)
+#define READING_METRICS_MAX_SIZE    (2 + 4 + 2 + 2 + 1 + 2 + 1 + 1 + 2 + 2)
+
+size_t ReadingCodec_encodeLegacy(const puck_reading_t *reading, uint8_t *buf, size_t len);
+// nowMs is the time the record is being written, on the same clock as timeMs
+// With buf NULL nothing is written, only the length it would take is returned
+size_t ReadingCodec_encodeBatch(const puck_reading_t *readings, size_t count, bool stamped, uint32_t nowMs,
+                                uint8_t *buf, size_t len, size_t *numEncoded);
+// Bytes all of the readings take as batch records of at most len bytes each, 0 if a reading doesn't fit one
+size_t ReadingCodec_batchSize(const puck_reading_t *readings, size_t count, bool stamped, uint32_t nowMs, size_t len);
+size_t ReadingCodec_encodeMetrics(const puck_reading_t *reading, uint8_t fields, uint32_t nowMs, uint8_t *buf, size_t len);
+
+#endif /* READING_CODEC_H_ */
@@ -0,0 +1,94 @@
+/*
+ * report_policy.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "report_policy.h"
+
+// Weight of the newest sample in the smoothed TVOC is 1 / (1 << REPORT_SMOOTH_SHIFT), enough to keep
+// sample to sample noise from looking like a trend over one rising interval
+#define REPORT_SMOOTH_SHIFT 4
+
+void ReportPolicy_init(report_policy_t *policy, const report_policy_params_t *params) {
+    memset(policy, 0, sizeof(*policy));
+    policy->params = *params;
+}
+
+void ReportPolicy_setParams(report_policy_t *policy, const report_policy_params_t *params) {
+    policy->params = *params;
+}
+
+void ReportPolicy_setBackoff(report_policy_t *policy, uint8_t backoffShift) {
+    policy->backoffShift = backoffShift;
+}
+
+static int32_t ReportPolicy_abs(int32_t val) {
+    return (val < 0) ? -val : val;
+}
+
+static void ReportPolicy_smooth(report_policy_t *policy, int32_t voc) {
+    if (!policy->haveSample) {
+        policy->smoothedVoc = voc;
+        policy->haveSample = true;
+        return;
+    }
+    policy->smoothedVoc += (voc - policy->smoothedVoc) / (1 << REPORT_SMOOTH_SHIFT);
+}
+
+// Smoothed TVOC change per minute since the last report
+static int32_t ReportPolicy_slope(const report_policy_t *policy, uint32_t silentMs) {
+    if (silentMs == 0) {
+        return 0;
+    }
+    return (int32_t) ((int64_t) (policy->smoothedVoc - policy->lastReportSmoothedVoc) * 60000 / silentMs);
+}
+
+static report_reason_t ReportPolicy_decide(const report_policy_t *policy, const puck_reading_t *reading, uint32_t nowMs) {
+    const report_policy_params_t *params = &policy->params;
+    const puck_reading_t *last = &policy->lastReport;
+
+    if (!params->adaptive) {
+        return REPORT_REASON_ALWAYS;
+    }
+    if (!policy->haveReport) {
+        return REPORT_REASON_FIRST;
+    }
+    if (reading->status != last->status) {
+        return REPORT_REASON_STATUS;
+    }
+    uint8_t shift = policy->backoffShift;
+    if (ReportPolicy_abs(reading->voc - last->voc) >= (params->tvocDeadband << shift) ||
+        ReportPolicy_abs(reading->temp - last->temp) >= (params->tempDeadband << shift)) {
+        return REPORT_REASON_DEADBAND;
+    }
+
+    uint32_t silentMs = nowMs - policy->lastReportMs;
+    if (silentMs >= (params->risingIntervalMs << shift) && ReportPolicy_slope(policy, silentMs) >= params->risingSlope) {
+        return REPORT_REASON_RISING;
+    }
+    if (silentMs >= (params->maxSilenceMs << shift)) {
+        return REPORT_REASON_SILENCE;
+    }
+    return REPORT_REASON_NONE;
+}
+
+report_reason_t ReportPolicy_check(report_policy_t *policy, const puck_reading_t *reading, uint32_t nowMs) {
+    ReportPolicy_smooth(policy, reading->voc);
+
+    report_reason_t reason = ReportPolicy_decide(policy, reading, nowMs);
+    policy->considered++;
+    policy->reasons[reason]++;
+    if (reason != REPORT_REASON_NONE) {
+        policy->haveReport = true;
+        policy->lastReport = *reading;
+        policy->lastReportMs = nowMs;
+        policy->lastReportSmoothedVoc = policy->smoothedVoc;
+    }
+    return reason;
+}
@@ -0,0 +1,73 @@
+/*
+ * report_policy.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef REPORT_POLICY_H_
+#define REPORT_POLICY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "reading_codec.h"
+
+// Decides which readings are worth a transmission. The sensor keeps sampling at the fixed IAQ
+// cadence (the algorithm needs every cycle), only the readings sent on are thinned out: one goes
+// out when it has moved past the deadband since the last one sent, when the status changes, when
+// nothing has been sent for the maximum silence, or more often while VOC is climbing.
+// Works in puck_reading_t units and takes the time as an argument, so the replay tool can run it.
+
+typedef struct report_policy_params_t {
+    bool adaptive;              // false sends every reading
+    int32_t tvocDeadband;       // TVOC * 10000
+    int16_t tempDeadband;       // Degrees C * 10
+    uint32_t maxSilenceMs;      // Longest time without a report
+    int32_t risingSlope;        // TVOC * 10000 per minute, at or above this VOC counts as rising
+    uint32_t risingIntervalMs;  // Report at least this often while rising
+} report_policy_params_t;
+
+// 0.05 mg/m^3 is around the sensor's noise floor on a settled fridge
+#define REPORT_POLICY_DEFAULTS { \
+    .adaptive = true, \
+    .tvocDeadband = 500, \
+    .tempDeadband = 10, \
+    .maxSilenceMs = 15 * 60 * 1000, \
+    .risingSlope = 200, \
+    .risingIntervalMs = 30 * 1000, \
+}
+
+typedef enum report_reason_t {
+    REPORT_REASON_NONE = 0,     // Held back
+    REPORT_REASON_ALWAYS,       // Adaptive reporting is off
+    REPORT_REASON_FIRST,
+    REPORT_REASON_STATUS,
+    REPORT_REASON_DEADBAND,
+    REPORT_REASON_RISING,
+    REPORT_REASON_SILENCE,
+    REPORT_REASON_COUNT
+} report_reason_t;
+
+typedef struct report_policy_t {
+    report_policy_params_t params;
+    bool haveReport;
+    puck_reading_t lastReport;
+    uint32_t lastReportMs;
+    bool haveSample;
+    int32_t smoothedVoc;
+    int32_t lastReportSmoothedVoc;
+    uint8_t backoffShift;       // Deadbands and intervals are stretched by 1 << backoffShift
+    uint32_t considered;
+    uint32_t reasons[REPORT_REASON_COUNT];
+} report_policy_t;
+
+void ReportPolicy_init(report_policy_t *policy, const report_policy_params_t *params);
+// Keeps the history, so the new parameters take over from the last report
+void ReportPolicy_setParams(report_policy_t *policy, const report_policy_params_t *params);
+// Makes the policy report less often without touching the tuned parameters, for a puck short on charge
+void ReportPolicy_setBackoff(report_policy_t *policy, uint8_t backoffShift);
+// Call for every reading, in order. Returns why it should be sent, REPORT_REASON_NONE if it shouldn't
+report_reason_t ReportPolicy_check(report_policy_t *policy, const puck_reading_t *reading, uint32_t nowMs);
+
+#endif /* REPORT_POLICY_H_ */
@@ -13,520 +13,488 @@
 #include <pthread.h>
 #include "FreeRTOS.h"
 #include "queue.h"
+#include <task.h>
 #include "ti_ble_config.h"
 #include <ti/drivers/BatteryMonitor.h>
 #include <ti/drivers/GPIO.h>
-#include <ti/drivers/Temperature.h>
-#include <ti/bleapp/ble_app_util/inc/bleapputil_api.h>
-#include <ti/ble5stack_flash/inc/gatt.h>
 #include <app_main.h>
-#include <ti/bleapp/menu_module/menu_module.h>
-
-// Service UUID: 1974e0a6-a490-4869-84b7-5f03cf47ac9d
-const static uint8_t serviceUuid[] = {0x9D, 0xAC, 0x47, 0xCF, 0x03, 0x5F, 0xB7, 0x84, 0x69, 0x48, 0x90, 0xA4, 0xA6, 0xE0, 0x74, 0x19};
-
-// Characteristic UUID: 1974e0a7-a490-4869-84b7-5f03cf47ac9d
-const static uint8_t characteristicUuid[] = {0x9D, 0xAC, 0x47, 0xCF, 0x03, 0x5F, 0xB7, 0x84, 0x69, 0x48, 0x90, 0xA4, 0xA7, 0xE0, 0x74, 0x19};
-
-// Note MAC address must be in reverse
-// TODO: Make this param dynamic
-//const static uint8_t target_addr[B_ADDR_LEN] = {0x56, 0x62, 0xD5, 0x7E, 0xB9, 0x94};  // My thing
-const static uint8_t target_addr[B_ADDR_LEN] = {0x3E, 0x91, 0xA8, 0xFC, 0x8A, 0xD4};
-
-enum async_task_phase {
-    ASYNC_PHASE_IDLE = 0,
-    ASYNC_PHASE_CONNECT,
-    ASYNC_PHASE_SRV_DISCOVER,
-    ASYNC_PHASE_CHR_DISCOVER,
-    ASYNC_PHASE_WRITE_VALUE,
-
-    ASYNC_PHASE_DISCONNECT
-};
-
-#define ErrorSrcOS 0
-#define ErrorSrcQueue 1
-#define ErrorSrcInvoke 2
-#define ErrorSrcQueueFetch 3
-#define ErrorSrcInvalidQueueOpcode 4
-
-enum notify_error_src {
-    NOTIFY_ERRSRC_BLE_RETCODE = 0,
-    NOTIFY_ERRSRC_CONN_CANCELLED = 1,
-    NOTIFY_ERRSRC_GATT_ERROR_REPORT = 2,
-    NOTIFY_ERRSRC_GATT_ERROR_STATUS = 3,
-    NOTIFY_ERRSRC_BLE_STACK_ERROR = 4,
-    NOTIFY_ERRSRC_NO_ENTRIES_FOUND = 5,
+#include "send_stats.h"
+#include "send_link.h"
+#include "send_ble.h"
+#include "reading_codec.h"
+#include "puck_display.h"
+#include "capture_log.h"
+#include "report_policy.h"
+#include "battery_model.h"
+#include "power_mgr.h"
+#include "ota_client.h"
+#include "puck_config.h"
+
+// Readings to collect before opening a connection (puckConfig.batchReadings) can be set by the base station,
+// more per upload means less radio time per reading
+#define SEND_MAX_PENDING_READINGS 32
+// Room for readings taken while an upload is in progress, the zmod thread drops rather than waits
+#define SEND_READING_QUEUE_DEPTH 8
+#define SEND_MAX_BATCH_RECORDS 8
+
+enum send_event_kind {
+    SEND_EVENT_READING = 0,
+    SEND_EVENT_CAPTURE_DOWNLOAD,
 };
 
+// A reading handed over from the zmod thread
+// Requests for the send task (capture downloads) come through the same queue, so it only ever waits in one place
+typedef struct reading_event_t {
+    uint8_t kind;
+    App_measurement measurement;
+} reading_event_t;
+
+// Fields of each reading sent to the base station (READING_FIELD_*)
+// Anything beyond READING_FIELDS_LEGACY and the stamp means one metrics record per reading instead of the packed formats
+#ifndef SEND_READING_FIELDS
+#define SEND_READING_FIELDS (READING_FIELDS_LEGACY | READING_FIELD_STAMP)
+#endif
+// Set to upload readings taken while the algorithm is still stabilising, they're dropped on the puck otherwise
+#ifndef SEND_UPLOAD_DURING_WARMUP
+#define SEND_UPLOAD_DURING_WARMUP 0
+#endif
+static_assert(READING_METRICS_MAX_SIZE + 1 <= SEND_MAX_WRITE_LEN, "Metrics record doesn't fit in a write");
+static_assert(PUCK_CONFIG_MAX_BATCH_READINGS <= SEND_MAX_PENDING_READINGS, "A batch doesn't fit in the pending readings");
+
+static puck_reading_t pendingReadings[SEND_MAX_PENDING_READINGS];
+static size_t numPendingReadings = 0;
+// Only readings queued for upload are numbered, so a gap downstream is always a reading lost on the way
+static uint16_t nextReadingSeq = 0;
+// Readings the zmod thread couldn't queue because the send task was busy
+static volatile uint32_t numDroppedReadings = 0;
+// Warm-up readings never queued for upload
+static uint32_t numWarmupReadings = 0;
+
+// Only the send task touches the policy, parameter changes from the menu are handed over at the next reading
+static report_policy_t reportPolicy;
+static report_policy_params_t reportParams = REPORT_POLICY_DEFAULTS;
+static bool reportParamsChanged = false;
+
+// Pucks low on charge report less often, so they last until someone swaps the cell
+#define SEND_LOW_BATTERY_UPLOADS        20000
+#define SEND_CRITICAL_BATTERY_UPLOADS   5000
+static battery_model_t batteryModel;
 
-static QueueHandle_t connHandleQueue;
 static QueueHandle_t readingEventQueue;
 static pthread_t sendDataThread;
-static uint16_t connHandleCached = 0xFFFF;
-static uint16_t attHandleCached = 0;
-
-#define REPORT_OPCODE_ERROR 0
-#define REPORT_OPCODE_CONNECTED 1
-#define REPORT_OPCODE_SRV_DISCOVERY 2
-#define REPORT_OPCODE_CHR_DISCOVERY 3
-#define REPORT_OPCODE_WRITE_DONE 4
-#define REPORT_OPCODE_DISCONNECT 5
-
-typedef struct async_task_report_t {
-    uint8_t opcode;
-    union val {
-        uint32_t errorCode;
-        uint16_t connHandle;
-        struct service_discovery {
-            uint16_t startHdl;
-            uint16_t endHdl;
-        } service_discovery;
-        uint16_t chrHandle;
-    } data;
-} async_task_report_t;
-
-static enum async_task_phase current_phase = ASYNC_PHASE_IDLE;
-
-
-static void SendNotifyReport(async_task_report_t* report) {
-    assert(uxQueueMessagesWaiting(connHandleQueue) == 0);
-    assert(xQueueSendToBack(connHandleQueue, report, 0) == pdPASS);
-}
 
-static void SendDataNotifyConnect(uint16_t connHandle) {
-    async_task_report_t report;
-    report.opcode = REPORT_OPCODE_CONNECTED;
-    report.data.connHandle = connHandle;
-    SendNotifyReport(&report);
+typedef struct send_payload_t {
+    const uint8_t *data;
+    size_t len;
+} send_payload_t;
+
+typedef struct send_payload_list_t {
+    const send_payload_t *payloads;
+    size_t numPayloads;
+    size_t next;
+} send_payload_list_t;
+
+// Firmware updates are checked for every so often, and while one is being fetched, on every upload
+#define SEND_OTA_CHECK_INTERVAL_MS (6UL * 60 * 60 * 1000)
+// Requests per upload connection, about 30 s of a transfer at a 30 ms connection interval
+#define SEND_OTA_SESSION_EXCHANGES 1000
+
+static ota_client_t otaClient;
+static bool otaAvailable = false;
+static bool otaChecked = false;
+static TickType_t otaLastCheckTick = 0;
+
+// Settings pushed from the base station, checked for every puckConfig.checkIntervalMin and straight after boot
+static puck_config_t puckConfig;
+static bool configChecked = false;
+static TickType_t configLastCheckTick = 0;
+
+static bool SendDataOtaWrite(void *ctx, const uint8_t *buf, size_t len) {
+    return SendLink_write(buf, len) == 0;
 }
 
-static void SendDataNotifyServiceDiscover(uint16_t svcStartHdl, uint16_t svcEndHdl) {
-    async_task_report_t report;
-    report.opcode = REPORT_OPCODE_SRV_DISCOVERY;
-    report.data.service_discovery.startHdl = svcStartHdl;
-    report.data.service_discovery.endHdl = svcEndHdl;
-    SendNotifyReport(&report);
+static size_t SendDataOtaRead(void *ctx, uint8_t *buf, size_t len) {
+    size_t readLen;
+    SendLink_read(buf, len, &readLen);
+    return readLen;
 }
 
-static void SendDataNotifyChrDiscover(uint16_t chrHandle) {
-    async_task_report_t report;
-    report.opcode = REPORT_OPCODE_CHR_DISCOVERY;
-    report.data.chrHandle = chrHandle;
-    SendNotifyReport(&report);
+static bool SendDataOtaDue(void) {
+    if (!otaAvailable || OtaClient_ready(&otaClient)) {
+        return false;
+    }
+    return !otaChecked || OtaClient_inProgress(&otaClient) ||
+           xTaskGetTickCount() - otaLastCheckTick >= pdMS_TO_TICKS(SEND_OTA_CHECK_INTERVAL_MS);
 }
 
-static void SendDataNotifyWriteDone() {
-    async_task_report_t report;
-    report.opcode = REPORT_OPCODE_WRITE_DONE;
-    SendNotifyReport(&report);
+static bool SendDataConfigDue(void) {
+    return !configChecked ||
+           xTaskGetTickCount() - configLastCheckTick >= pdMS_TO_TICKS(puckConfig.checkIntervalMin * 60UL * 1000);
 }
 
-void SendDataNotifyDisconnect() {
-    async_task_report_t report;
-    report.opcode = REPORT_OPCODE_DISCONNECT;
-    SendNotifyReport(&report);
-}
+// Runs on upload connections that something is due on, the configuration first since it's only a few reads
+static void SendDataSession(void) {
+    const ota_link_t link = {
+        .write = SendDataOtaWrite,
+        .read = SendDataOtaRead,
+        .maxRead = SEND_MAX_READ_LEN,
+    };
+
+    if (SendDataConfigDue()) {
+        puck_config_result_t result = PuckConfig_fetch(&puckConfig, &link);
+        if (result == PUCK_CONFIG_RESULT_LINK_FAILED) {
+            return;
+        }
+        configChecked = true;
+        configLastCheckTick = xTaskGetTickCount();
+        if (result == PUCK_CONFIG_RESULT_UPDATED) {
+            // The report parameters go through the same hand over as the menu's, the rest is only read here
+            bool saved = PuckConfig_save(&puckConfig);
+            SendDataSetReportParams(&puckConfig.report);
+            PUCK_DISPLAY_PRINTF(APP_MENU_PROFILE_STATUS_LINE, "Config revision %u applied%s", (unsigned) puckConfig.revision,
+                                saved ? "" : ", not saved");
+        }
+    }
 
-void SendDataNotifyError(enum notify_error_src src, uint16_t errorCode) {
-    async_task_report_t report;
-    report.opcode = REPORT_OPCODE_ERROR;
-    report.data.errorCode = (((uint32_t) src) << 16) | ((uint32_t)errorCode);
-    SendNotifyReport(&report);
+    if (SendDataOtaDue()) {
+        OtaClient_run(&otaClient, &link, SEND_OTA_SESSION_EXCHANGES);
+        otaChecked = true;
+        otaLastCheckTick = xTaskGetTickCount();
+    }
 }
 
+static size_t SendDataPayloadListNext(void *ctx, uint8_t *buf, size_t len) {
+    send_payload_list_t *list = ctx;
+    if (list->next == list->numPayloads) {
+        return 0;
+    }
 
-static void SendData_GattHandler(uint32 event, BLEAppUtil_msgHdr_t *pMsgData);
-static void SendData_ConnectionHandler(uint32 event, BLEAppUtil_msgHdr_t *pMsgData);
-
-BLEAppUtil_EventHandler_t gattEventHandler =
-{
-    .handlerType    = BLEAPPUTIL_GATT_TYPE,
-    .pEventHandler  = SendData_GattHandler,
-    .eventMask      = BLEAPPUTIL_ATT_ERROR_RSP |
-                      BLEAPPUTIL_ATT_FIND_BY_TYPE_VALUE_RSP |
-                      BLEAPPUTIL_ATT_READ_BY_TYPE_RSP |
-                      BLEAPPUTIL_ATT_WRITE_RSP
-};
-
-BLEAppUtil_EventHandler_t sendDataConnHandler =
-{
-    .handlerType    = BLEAPPUTIL_GAP_CONN_TYPE,
-    .pEventHandler  = SendData_ConnectionHandler,
-    .eventMask      = BLEAPPUTIL_LINK_ESTABLISHED_EVENT |
-                      BLEAPPUTIL_LINK_TERMINATED_EVENT |
-                      BLEAPPUTIL_CONNECTING_CANCELLED_EVENT
-};
-
-static void SendData_ConnectionHandler(uint32 event, BLEAppUtil_msgHdr_t *pMsgData) {
-    switch(event)
-        {
-            case BLEAPPUTIL_LINK_ESTABLISHED_EVENT:
-            {
-                if (current_phase == ASYNC_PHASE_CONNECT) {
-                    gapEstLinkReqEvent_t *gapEstMsg = (gapEstLinkReqEvent_t *)pMsgData;
-                    SendDataNotifyConnect(gapEstMsg->connectionHandle);
-                }
-
-                break;
-            }
-
-            case BLEAPPUTIL_LINK_TERMINATED_EVENT:
-            {
-                if (current_phase == ASYNC_PHASE_DISCONNECT) {
-                    SendDataNotifyDisconnect();
-                }
-            }
+    const send_payload_t *payload = &list->payloads[list->next++];
+    assert(payload->len <= len);
+    memcpy(buf, payload->data, payload->len);
+    return payload->len;
+}
 
-            case BLEAPPUTIL_CONNECTING_CANCELLED_EVENT:
-            {
-                if (current_phase == ASYNC_PHASE_CONNECT) {
-                    gapConnCancelledEvent_t *gapCancelledMsg = (gapConnCancelledEvent_t *)pMsgData;
-                    SendDataNotifyError(NOTIFY_ERRSRC_CONN_CANCELLED, gapCancelledMsg->opcode);
-                }
+// PHY switches go on the display as they happen, and out to the base station with the stats records
+static void SendDataPhyLog(void) {
+    static uint32_t switchesShown = 0;
+    const phy_policy_t *policy = SendLink_getPhyPolicy();
+    uint32_t switches = 0;
+    for (int reason = PHY_REASON_NONE + 1; reason < PHY_REASON_COUNT; reason++) {
+        switches += policy->switches[reason];
+    }
+    if (switches == switchesShown) {
+        return;
+    }
+    switchesShown = switches;
+    PUCK_DISPLAY_PRINTF(APP_MENU_CONN_EVENT, "Upload PHY %s -> %s: %s (RSSI %d dBm, %u/255 failing)",
+                        PhyPolicy_modeName(policy->lastFrom), PhyPolicy_modeName(policy->mode),
+                        PhyPolicy_reasonName(policy->lastReason), policy->rssi, PhyPolicy_failRate(policy));
+}
 
-            }
+static size_t SendDataCaptureNext(void *ctx, uint8_t *buf, size_t len) {
+    return CaptureLog_downloadNext((capture_download_t *) ctx, buf, len);
+}
 
-            default:
-            {
-                break;
-            }
-        }
+// Streams the whole capture log to the base station in one connection
+// A failed download starts over from the oldest record next time, the base station keys chunks by their index
+static uint32_t SendDataCaptureDownload(void) {
+    static capture_download_t download;
+    CaptureLog_downloadBegin(&download);
+
+    send_stream_t stream = {
+        .next = SendDataCaptureNext,
+        .ctx = &download,
+    };
+    uint32_t rc = SendLink_transfer(&stream);
+    SendDataPhyLog();
+    CaptureLog_downloadDone(&download, rc);
+    return rc;
 }
 
-static void SendData_GattHandler(uint32 event, BLEAppUtil_msgHdr_t *pMsg) {
-    gattMsgEvent_t * pMsgData = (gattMsgEvent_t *)pMsg;
+static uint32_t SendDataUpdate(const puck_reading_t *readings, size_t count, size_t *numSent) {
+    send_payload_t payloads[SEND_MAX_BATCH_RECORDS + SEND_STATS_NUM_PHASES + 1];
+    size_t numPayloads = 0;
+    *numSent = 0;
+
+    // A lone reading goes out in the plain format, anything more is delta packed into as few writes as possible
+    // Unless it needs fields those can't carry, then every reading gets a metrics record of its own
+    // The packed formats have no status, so they're only used when every reading is good
+    // The stamp costs a few bytes a reading, a batch too small to win that back over the plain format goes without it
+    uint32_t nowMs = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    bool stamped = (SEND_READING_FIELDS & READING_FIELD_STAMP) != 0 &&
+                   ReadingCodec_batchSize(readings, count, true, nowMs, SEND_MAX_WRITE_LEN) <= count * READING_LEGACY_SIZE;
+    bool needsMetrics = (SEND_READING_FIELDS & ~(READING_FIELDS_LEGACY | READING_FIELD_STAMP)) != 0;
+    for (size_t i = 0; i < count && !needsMetrics; i++) {
+        needsMetrics = readings[i].status != READING_STATUS_OK;
+    }
 
-    switch (event) {
-        case BLEAPPUTIL_ATT_ERROR_RSP:
-        {
-            if (pMsgData->hdr.status == SUCCESS) {
-                SendDataNotifyError(NOTIFY_ERRSRC_GATT_ERROR_REPORT, pMsgData->msg.errorRsp.errCode);
-            }
-            else {
-                SendDataNotifyError(NOTIFY_ERRSRC_GATT_ERROR_STATUS, pMsgData->hdr.status);
-            }
-            break;
-        }
-        case BLEAPPUTIL_ATT_FIND_BY_TYPE_VALUE_RSP:
-        {
-            if (current_phase == ASYNC_PHASE_SRV_DISCOVER) {
-                // Needs to be SUCCESS to work?? IDK since the docs say bleProcedureComplete, just accept both
-                if (pMsgData->hdr.status == bleProcedureComplete || pMsgData->hdr.status == SUCCESS) {
-                    if (pMsgData->msg.findByTypeValueRsp.numInfo == 1) {
-                        uint16_t svcStartHdl = ATT_ATTR_HANDLE(pMsgData->msg.findByTypeValueRsp.pHandlesInfo, 0);
-                        uint16_t svcEndHdl = ATT_GRP_END_HANDLE(pMsgData->msg.findByTypeValueRsp.pHandlesInfo, 0);
-                        SendDataNotifyServiceDiscover(svcStartHdl, svcEndHdl);
-                    }
-                    else {
-                        SendDataNotifyError(NOTIFY_ERRSRC_NO_ENTRIES_FOUND, pMsgData->msg.findByTypeValueRsp.numInfo);
-                    }
-                }
-                else {
-                    SendDataNotifyError(NOTIFY_ERRSRC_BLE_STACK_ERROR, pMsgData->hdr.status);
-                }
-            }
-            break;
+    uint8_t reportMsg[SEND_MAX_BATCH_RECORDS][SEND_MAX_WRITE_LEN];
+    if (needsMetrics) {
+        while (*numSent < count && numPayloads < SEND_MAX_BATCH_RECORDS) {
+            payloads[numPayloads].data = reportMsg[numPayloads];
+            payloads[numPayloads].len = ReadingCodec_encodeMetrics(&readings[*numSent], SEND_READING_FIELDS | READING_FIELD_STATUS,
+                                                                   nowMs, reportMsg[numPayloads], SEND_MAX_WRITE_LEN);
+            numPayloads++;
+            (*numSent)++;
         }
-        case BLEAPPUTIL_ATT_READ_BY_TYPE_RSP:
-        {
-            if (current_phase == ASYNC_PHASE_CHR_DISCOVER) {
-                // Again, same as above, it reports SUCCESS rather than bleProcedureComplete, just accept both again
-                if (pMsgData->hdr.status == bleProcedureComplete || pMsgData->hdr.status == SUCCESS) {
-                    if (pMsgData->msg.readByTypeRsp.numPairs == 1) {
-                        uint16_t chrHandle = ATT_PAIR_HANDLE(pMsgData->msg.readByTypeRsp.pDataList, 0);
-
-                        SendDataNotifyChrDiscover(chrHandle);
-                    }
-                    else {
-                        SendDataNotifyError(NOTIFY_ERRSRC_NO_ENTRIES_FOUND, pMsgData->msg.readByTypeRsp.numPairs );
-                    }
-                }
-                else {
-                    SendDataNotifyError(NOTIFY_ERRSRC_BLE_STACK_ERROR, pMsgData->hdr.status);
-                }
-            }
+    }
+    else if (count == 1 && !stamped) {
+        payloads[numPayloads].data = reportMsg[0];
+        payloads[numPayloads].len = ReadingCodec_encodeLegacy(&readings[0], reportMsg[0], SEND_MAX_WRITE_LEN);
+        numPayloads++;
+        *numSent = 1;
+    }
+    else {
+        while (*numSent < count && numPayloads < SEND_MAX_BATCH_RECORDS) {
+            size_t numEncoded;
+            payloads[numPayloads].data = reportMsg[numPayloads];
+            payloads[numPayloads].len = ReadingCodec_encodeBatch(&readings[*numSent], count - *numSent, stamped, nowMs,
+                                                                 reportMsg[numPayloads], SEND_MAX_WRITE_LEN, &numEncoded);
+            numPayloads++;
+            *numSent += numEncoded;
         }
+    }
 
-        case BLEAPPUTIL_ATT_WRITE_RSP:
-        {
-            if (current_phase == ASYNC_PHASE_WRITE_VALUE) {
-                // Again, same as above, it reports SUCCESS rather than bleProcedureComplete, just accept both again
-                if (pMsgData->hdr.status == SUCCESS) {
-                    SendDataNotifyWriteDone();
-                }
-                else {
-                    SendDataNotifyError(NOTIFY_ERRSRC_BLE_STACK_ERROR, pMsgData->hdr.status);
-                }
-            }
+    // Piggyback the phase and PHY stats onto this connection every so often, rather than paying for a connection of their own
+    uint8_t statsMsg[SEND_STATS_NUM_PHASES][SEND_STATS_RECORD_SIZE];
+    uint8_t phyMsg[PHY_POLICY_RECORD_SIZE];
+    bool exportStats = SendStats_exportDue();
+    if (exportStats) {
+        for (uint8_t phase = ASYNC_PHASE_CONNECT; phase <= ASYNC_PHASE_OTA; phase++) {
+            uint8_t *msg = statsMsg[phase - ASYNC_PHASE_CONNECT];
+            payloads[numPayloads].data = msg;
+            payloads[numPayloads].len = SendStats_buildRecord(phase, msg, SEND_STATS_RECORD_SIZE);
+            numPayloads++;
         }
-
-        default:
-            break;
+        payloads[numPayloads].data = phyMsg;
+        payloads[numPayloads].len = PhyPolicy_buildRecord(SendLink_getPhyPolicy(), phyMsg, sizeof(phyMsg));
+        numPayloads++;
     }
-}
 
-#define CheckBleCallFromAsync(func)  { \
-        bStatus_t status = (func); \
-        if (status != SUCCESS) { \
-            SendDataNotifyError(NOTIFY_ERRSRC_BLE_RETCODE, status); \
-        } \
+    send_payload_list_t list = {
+        .payloads = payloads,
+        .numPayloads = numPayloads,
+    };
+    send_stream_t stream = {
+        .next = SendDataPayloadListNext,
+        .ctx = &list,
+        // Configuration and firmware updates ride along on uploads, a puck never opens a connection just to check
+        .session = (SendDataConfigDue() || SendDataOtaDue()) ? SendDataSession : NULL,
+    };
+    uint32_t rc = SendLink_transfer(&stream);
+    SendDataPhyLog();
+    if (rc == 0) {
+        if (exportStats) {
+            SendStats_reset();
+        }
+        SendStats_uploadDone();
+    }
+    else {
+        *numSent = 0;
     }
 
-static void SendData_Connect(char *pData) {
-    CheckBleCallFromAsync(BLEAppUtil_connect((BLEAppUtil_ConnectParams_t*)pData));
-}
-
-static void SendData_DiscoverServce(char *pData) {
-    CheckBleCallFromAsync(GATT_DiscPrimaryServiceByUUID(connHandleCached, serviceUuid, sizeof(serviceUuid), BLEAppUtil_getSelfEntity()));
-}
-
-static void SendData_DiscoverCharacteristic(char *pData) {
-    CheckBleCallFromAsync(GATT_DiscCharsByUUID(connHandleCached, (attReadByTypeReq_t*)pData, BLEAppUtil_getSelfEntity()));
+    return rc;
 }
 
-static void SendData_WriteCharacteristic(char *pData) {
-    bStatus_t status = GATT_WriteCharValue(connHandleCached, (attWriteReq_t*)pData, BLEAppUtil_getSelfEntity());
-    if (status != SUCCESS) {
-        GATT_bm_free((gattMsg_t*) pData, ATT_WRITE_REQ);
-        SendDataNotifyError(NOTIFY_ERRSRC_BLE_RETCODE, status);
+// Scales a value into a fixed point field, saturating rather than wrapping
+static uint32_t SendDataScale(float val, float scale, uint32_t max) {
+    float scaled = val * scale;
+    if (!(scaled > 0)) {
+        return 0;
     }
+    if (scaled >= max) {
+        return max;
+    }
+    return (uint32_t) scaled;
 }
 
-static void SendData_Disconnect(char *pData) {
-    CheckBleCallFromAsync(BLEAppUtil_disconnect(connHandleCached));
-    connHandleCached = 0xFFFF;
-}
-
-static void resetWithBigHammer() {
-    // These are private undocumented functions in the internals of the SimpleLink SDK
-    // However, they won't make it work nicely, so I'll have to do this I guess
-    extern void gattResetClientInfo(void *pClient);
-    extern void* gattFindClientInfo(uint16 connHandle);
+static void SendDataCollectReading(const App_measurement *measurement) {
+    puck_reading_t newReading = {0};
+    puck_reading_t *reading = &newReading;
+    uint32_t nowMs = xTaskGetTickCount() * portTICK_PERIOD_MS;
 
-    void* pClient = gattFindClientInfo(connHandleCached);
-    if (pClient) {
-        gattResetClientInfo(pClient);
+#if !SEND_UPLOAD_DURING_WARMUP
+    // Downstream would throw these away, so don't spend a connection on them
+    if (measurement->status == READING_STATUS_WARMUP) {
+        numWarmupReadings++;
+        return;
     }
-}
-
-#define CheckOSError(cond, unique_id) \
-    if (!(cond)) { \
-        enum async_task_phase last_phase = current_phase; \
-        current_phase = ASYNC_PHASE_IDLE; \
-        rc = (last_phase << 28) | (ErrorSrcOS << 24) | (unique_id & 0xFFFFFF); \
-        goto disconnect; \
+#endif
+
+    reading->voc = (int32_t) (measurement->tvoc * 10000.0);
+    reading->eco2 = SendDataScale(measurement->eco2, 1, UINT16_MAX);
+    reading->etoh = SendDataScale(measurement->etoh, 100, UINT16_MAX);
+    reading->iaq = SendDataScale(measurement->iaq, 10, UINT8_MAX);
+    reading->status = measurement->status;
+    reading->timeMs = nowMs;
+
+    // Temperature was sampled alongside the VOC reading
+    float temperature = measurement->temperatureDegC;
+    int16_t temperatureScaled;
+    if (INT16_MAX / 10 < temperature) {
+        temperatureScaled = INT16_MAX;
     }
-
-#define CheckInvokeStatus(func) { \
-        bStatus_t status = (func); \
-        if (status != SUCCESS) { \
-            enum async_task_phase last_phase = current_phase; \
-            current_phase = ASYNC_PHASE_IDLE; \
-            rc = (last_phase << 28) | (ErrorSrcInvoke << 24) | (status & 0xFFFFFF); \
-            goto disconnect; \
-        } \
+    else if (INT16_MIN / 10 > temperature) {
+        temperatureScaled = INT16_MIN;
     }
-
-#define QueueGetResult(expected_opcode) { \
-        BaseType_t rcTmp = xQueueReceive(connHandleQueue, &report, portMAX_DELAY); \
-        if (rcTmp != pdPASS) { \
-            enum async_task_phase last_phase = current_phase; \
-            current_phase = ASYNC_PHASE_IDLE; \
-            rc = (last_phase << 28) | (ErrorSrcQueueFetch << 24) | (rc & 0xFFFFFF); \
-            goto disconnect; \
-        } \
-        if (report.opcode == REPORT_OPCODE_ERROR) { \
-            enum async_task_phase last_phase = current_phase; \
-            current_phase = ASYNC_PHASE_IDLE; \
-            rc = (last_phase << 28) | (ErrorSrcQueue << 24) | (report.data.errorCode & 0xFFFFFF); \
-            goto disconnect; \
-        } \
-        else if (report.opcode != expected_opcode) { \
-            enum async_task_phase last_phase = current_phase; \
-            current_phase = ASYNC_PHASE_IDLE; \
-            rc = (last_phase << 28) | (ErrorSrcInvalidQueueOpcode << 24); \
-            goto disconnect; \
-        } \
+    else {
+        temperatureScaled = (int16_t) (temperature * 10);
     }
-
-uint32_t SendDataUpdate(uint32_t voc, uint16_t temp, uint8_t batteryLevel) {
-    async_task_report_t report;
-    uint32_t rc = 0;
-
-    while(uxQueueMessagesWaiting(connHandleQueue) != 0) {
-        xQueueReceive(connHandleQueue, &report, 0);
+    reading->temp = temperatureScaled;
+
+    // The radio is idle between uploads, so this is the cell at rest
+    uint16_t currentVoltageMv = BatteryMonitor_getVoltage();
+    BatteryModel_restSample(&batteryModel, currentVoltageMv);
+    uint8_t batteryLevel = BatteryModel_level(&batteryModel);
+    reading->batteryLevel = batteryLevel;
+    reading->batteryPct = BatteryModel_percent(&batteryModel);
+
+    uint32_t remainingUploads = BatteryModel_remainingUploads(&batteryModel);
+    uint8_t backoffShift = 0;
+    if (remainingUploads < SEND_CRITICAL_BATTERY_UPLOADS) {
+        backoffShift = 2;
     }
-
-    // Set the connection parameters to connect to the base station and send the connect request
-    current_phase = ASYNC_PHASE_CONNECT;
-    {
-        BLEAppUtil_ConnectParams_t *connParams = ICall_malloc(sizeof(BLEAppUtil_ConnectParams_t));
-        CheckOSError(connParams != NULL, 2);
-        connParams->peerAddrType = ADDRTYPE_PUBLIC;
-        connParams->phys = INIT_PHY_1M;
-        connParams->timeout = 1000;
-        memcpy(connParams->pPeerAddress, target_addr, B_ADDR_LEN);
-        CheckInvokeStatus(BLEAppUtil_invokeFunction(SendData_Connect, (char*)connParams));
+    else if (remainingUploads < SEND_LOW_BATTERY_UPLOADS) {
+        backoffShift = 1;
     }
+    ReportPolicy_setBackoff(&reportPolicy, backoffShift);
 
-    // Wait for the status to come back from the connect request
-    QueueGetResult(REPORT_OPCODE_CONNECTED);
-    connHandleCached = report.data.connHandle;
-
-    if (attHandleCached == 0) {
-        // Discover the service
-        current_phase = ASYNC_PHASE_SRV_DISCOVER;
-        CheckInvokeStatus(BLEAppUtil_invokeFunctionNoData(SendData_DiscoverServce));
-        QueueGetResult(REPORT_OPCODE_SRV_DISCOVERY);
-        uint16_t srvStartHdl = report.data.service_discovery.startHdl;
-        uint16_t srvEndHdl = report.data.service_discovery.endHdl;
-
-        resetWithBigHammer();
-        vTaskDelay(configTICK_RATE_HZ);
-
-        // Now that we know the service range, discover the characteristic that we want
-        current_phase = ASYNC_PHASE_CHR_DISCOVER;
-        {
-            // Create the characteristic discovery message and send the message over
-            attReadByTypeReq_t *charReadReq = ICall_malloc(sizeof(attReadByTypeReq_t));
-            charReadReq->startHandle = srvStartHdl;
-            charReadReq->endHandle = srvEndHdl;
-            charReadReq->type.len = sizeof(characteristicUuid);
-            static_assert(sizeof(characteristicUuid) <= sizeof(charReadReq->type.uuid), "UUID doesn't fit into UUID list");
-            memcpy(charReadReq->type.uuid, characteristicUuid, sizeof(characteristicUuid));
-            CheckInvokeStatus(BLEAppUtil_invokeFunction(SendData_DiscoverCharacteristic, (char*)charReadReq));
-        }
-        QueueGetResult(REPORT_OPCODE_CHR_DISCOVERY);
-        uint16_t chrHandle = report.data.chrHandle;
-
-        resetWithBigHammer();
-        vTaskDelay(configTICK_RATE_HZ);
-
-        attHandleCached = chrHandle + 1;
+    taskENTER_CRITICAL();
+    if (reportParamsChanged) {
+        ReportPolicy_setParams(&reportPolicy, &reportParams);
+        reportParamsChanged = false;
     }
-
-    // Finally write the characteristic value to the known handle
-    current_phase = ASYNC_PHASE_WRITE_VALUE;
-    {
-        size_t reportSize = 7;
-        uint8_t* reportMsg = GATT_bm_alloc(connHandleCached, ATT_WRITE_REQ, reportSize, NULL);
-        reportMsg[0] = voc >> 24;
-        reportMsg[1] = (voc >> 16) & 0xFF;
-        reportMsg[2] = (voc >> 8) & 0xFF;
-        reportMsg[3] = voc & 0xFF;
-        reportMsg[4] = temp >> 8;
-        reportMsg[5] = temp & 0xFF;
-        reportMsg[6] = batteryLevel;
-
-        // Create the characteristic discovery message and send the message over
-        attWriteReq_t *writeReq = ICall_malloc(sizeof(attWriteReq_t));
-        writeReq->cmd = 0;                   // Bluetooth Request, not a Command (we want an ack)
-        writeReq->handle = attHandleCached;  // Pass handle to characteristic;
-        writeReq->pValue = reportMsg;        // This must be allocated with GATT_bm_alloc
-        writeReq->len = reportSize;
-        writeReq->sig = 0;                   // Not a signed write (see bluetooth spec)
-
-        // Send request
-        // We ned special logic so we don't leak memory
-        {
-            bStatus_t status = (BLEAppUtil_invokeFunction(SendData_WriteCharacteristic, (char*)writeReq));
-            if (status != SUCCESS) {
-                GATT_bm_free((gattMsg_t*) writeReq, ATT_WRITE_REQ);
-                enum async_task_phase last_phase = current_phase;
-                current_phase = ASYNC_PHASE_IDLE;
-                rc = (last_phase << 28) | (ErrorSrcInvoke << 24) | (status & 0xFFFFFF);
-                goto disconnect;
-            }
+    taskEXIT_CRITICAL();
+
+    // Readings that haven't moved enough to be worth a transmission stop here
+    if (ReportPolicy_check(&reportPolicy, reading, nowMs) != REPORT_REASON_NONE) {
+        reading->seq = nextReadingSeq++;
+        // If the base station has been unreachable for a while, keep the newest readings
+        if (numPendingReadings == SEND_MAX_PENDING_READINGS) {
+            memmove(&pendingReadings[0], &pendingReadings[1], sizeof(pendingReadings[0]) * (SEND_MAX_PENDING_READINGS - 1));
+            numPendingReadings--;
         }
-    }
-    QueueGetResult(REPORT_OPCODE_WRITE_DONE);
-
-disconnect:
-    if (connHandleCached != 0xFFFF) {
-        // Disconnect once we're done
-        current_phase = ASYNC_PHASE_DISCONNECT;
-        CheckInvokeStatus(BLEAppUtil_invokeFunctionNoData(SendData_Disconnect));
-        QueueGetResult(REPORT_OPCODE_DISCONNECT);
+        pendingReadings[numPendingReadings++] = newReading;
     }
 
-    current_phase = ASYNC_PHASE_IDLE;
-
-    return rc;
+    puck_display_queued_t queued = {
+        .tvoc = measurement->tvoc,
+        .temperature = (int16_t) temperature,
+        .voltageMv = currentVoltageMv,
+        .batteryPct = reading->batteryPct,
+        .remainingUploads = remainingUploads,
+        .numPending = numPendingReadings,
+        .numDropped = numDroppedReadings,
+        .numWarmup = numWarmupReadings,
+        .numUnreported = reportPolicy.reasons[REPORT_REASON_NONE],
+    };
+    PuckDisplay_updateQueued(&queued);
 }
 
 void* SendDataTask(void * arg) {
     while (true) {
-        float vocValue;
-        BaseType_t rc = xQueueReceive(readingEventQueue, &vocValue, portMAX_DELAY); \
-        if (rc != pdPASS) {
-            MenuModule_printf(APP_MENU_GENERAL_STATUS_LINE, 0, "Failed to Receive VOC!"
-                                      MENU_MODULE_COLOR_BOLD MENU_MODULE_COLOR_RED "0x%08x" MENU_MODULE_COLOR_RESET,
-                                      rc);
-            return NULL;
+        // Block until there is something to do, then pick up anything else that queued up in the meantime
+        reading_event_t event;
+        bool downloadRequested = false;
+        TickType_t waitTime = (numPendingReadings < puckConfig.batchReadings) ? portMAX_DELAY : 0;
+        while (xQueueReceive(readingEventQueue, &event, waitTime) == pdPASS) {
+            if (event.kind == SEND_EVENT_CAPTURE_DOWNLOAD) {
+                downloadRequested = true;
+            }
+            else {
+                SendDataCollectReading(&event.measurement);
+            }
+            waitTime = (numPendingReadings < puckConfig.batchReadings && !downloadRequested) ? portMAX_DELAY : 0;
         }
 
-        int32_t vocFixedPoint = (int32_t) (vocValue * 10000.0);
+        GPIO_write(CONFIG_GPIO_LED_GREEN, CONFIG_GPIO_LED_ON);
+        PowerMgr_begin(POWER_ACTIVITY_RADIO);
 
-        // Fetch Temperature
-        int16_t temperature = Temperature_getTemperature();
-        int16_t temperatureScaled;
-        if (INT16_MAX / 10 < temperature) {
-            temperatureScaled = INT16_MAX;
+        if (downloadRequested) {
+            SendDataCaptureDownload();
         }
-        else if (INT16_MIN / 10 > temperature) {
-            temperatureScaled = INT16_MIN;
-        }
-        else {
-            temperatureScaled = temperature * 10;
+
+        // A download can wake the task up before there are enough readings for an upload
+        if (numPendingReadings >= puckConfig.batchReadings) {
+            size_t numSent;
+            uint32_t result = SendDataUpdate(pendingReadings, numPendingReadings, &numSent);
+            // The cell hasn't recovered from the radio yet, which is what the battery model needs to see
+            BatteryModel_loadSample(&batteryModel, BatteryMonitor_getVoltage());
+            async_op_counters_t counters;
+            SendLink_getCounters(&counters);
+            PuckDisplay_updateSent(numSent, result, counters.staleEvents, counters.timeouts);
+
+            // Anything that didn't make it stays pending, and goes out with the next attempt
+            memmove(&pendingReadings[0], &pendingReadings[numSent], sizeof(pendingReadings[0]) * (numPendingReadings - numSent));
+            numPendingReadings -= numSent;
         }
 
-        // Fetch battery voltage
-        uint16_t currentVoltageMv = BatteryMonitor_getVoltage();
+        PowerMgr_end(POWER_ACTIVITY_RADIO);
+        GPIO_write(CONFIG_GPIO_LED_GREEN, CONFIG_GPIO_LED_OFF);
 
-        // Convert to approximate battery level for CR2032 battery cell
-        uint8_t batteryLevel = 3;
-        if (currentVoltageMv < 2.8) {
-            batteryLevel = 2;
-        }
-        else if (currentVoltageMv < 2.6) {
-            batteryLevel = 1;
-        }
-        else if (currentVoltageMv < 2.2) {
-            batteryLevel = 0;
+        // Once a new image is staged and checks out, reset into the bootloader straight after the upload,
+        // while nothing is left pending. Only returns if the bootloader couldn't be handed the image.
+        if (otaAvailable && OtaClient_ready(&otaClient) && numPendingReadings == 0) {
+            OtaClient_install(&otaClient);
+            otaAvailable = false;
         }
+    }
+}
 
-        MenuModule_printf(APP_MENU_GENERAL_STATUS_LINE, 0,
-                          "Transmitting (TVOC: %6.3f, Temperature: %d C; Voltage: %d mV; Batt Level: %d)...",
-                          vocValue, temperature, currentVoltageMv, batteryLevel);
-        GPIO_write(CONFIG_GPIO_LED_GREEN, CONFIG_GPIO_LED_ON);
+void SendUpdateValue(const App_measurement *measurement) {
+    reading_event_t event = {
+        .kind = SEND_EVENT_READING,
+        .measurement = *measurement,
+    };
+    // Don't hold up the measurement schedule waiting on an upload
+    if (xQueueSendToBack(readingEventQueue, &event, 0) != pdPASS) {
+        numDroppedReadings++;
+    }
+}
 
-        uint32_t result;
-        do {
-            result = SendDataUpdate((uint32_t) vocFixedPoint, (uint16_t)temperatureScaled, batteryLevel);
+void SendDataSetReportParams(const report_policy_params_t *params) {
+    taskENTER_CRITICAL();
+    reportParams = *params;
+    reportParamsChanged = true;
+    taskEXIT_CRITICAL();
+}
 
-            MenuModule_printf(APP_MENU_GENERAL_STATUS_LINE, 0, "Sent Data: Result = "
-                              MENU_MODULE_COLOR_BOLD MENU_MODULE_COLOR_RED "0x%08x" MENU_MODULE_COLOR_RESET,
-                              result);
-        } while (result != 0);
-        GPIO_write(CONFIG_GPIO_LED_GREEN, CONFIG_GPIO_LED_OFF);
-    }
+void SendDataGetReportParams(report_policy_params_t *params, uint32_t *considered, uint32_t *reported) {
+    taskENTER_CRITICAL();
+    *params = reportParams;
+    *considered = reportPolicy.considered;
+    *reported = reportPolicy.considered - reportPolicy.reasons[REPORT_REASON_NONE];
+    taskEXIT_CRITICAL();
 }
 
-void SendUpdateValue(float vocReading) {
-    assert(xQueueSendToBack(readingEventQueue, &vocReading, portMAX_DELAY) == pdPASS);
+bool SendDataRequestCaptureDownload(void) {
+    reading_event_t event = {
+        .kind = SEND_EVENT_CAPTURE_DOWNLOAD,
+    };
+    return xQueueSendToBack(readingEventQueue, &event, 0) == pdPASS;
 }
 
 void SendUpdateInit() {
+    PowerMgr_init();
     app_zmod4xxx_init();
-    Temperature_init();
     BatteryMonitor_init();
 
-    bStatus_t status = BLEAppUtil_registerEventHandler(&gattEventHandler);
-    assert(status == SUCCESS);
-    status = BLEAppUtil_registerEventHandler(&sendDataConnHandler);
-    assert(status == SUCCESS);
+    SendLink_init(SendBle_init());
+
+    // Whatever the base station last sent survives a reset
+    PuckConfig_load(&puckConfig);
+    reportParams = puckConfig.report;
+    ReportPolicy_init(&reportPolicy, &reportParams);
+    BatteryModel_init(&batteryModel);
+
+    // Picks up whatever transfer was in progress before the last reset
+    const ota_store_t *otaStore = OtaClient_flashStore();
+    if (otaStore != NULL) {
+        OtaClient_init(&otaClient, otaStore, OTA_FIRMWARE_VERSION);
+        otaAvailable = true;
+    }
 
-    connHandleQueue = xQueueCreate(1, sizeof(async_task_report_t));
-    readingEventQueue = xQueueCreate(1, sizeof(int32_t));
+    readingEventQueue = xQueueCreate(SEND_READING_QUEUE_DEPTH, sizeof(reading_event_t));
     pthread_create(&sendDataThread, NULL, SendDataTask, NULL);
 }
@@ -0,0 +1,521 @@
+/*
+ * send_ble.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "ti_ble_config.h"
+#include <ti/bleapp/ble_app_util/inc/bleapputil_api.h>
+#include <ti/ble5stack_flash/inc/gatt.h>
+#include <app_main.h>
+#include "send_link.h"
+#include "send_ble.h"
+#include "phy_policy.h"
+
+// The send link's requests, made on the BLE stack thread, and the stack events that answer them
+
+// Service UUID: 1974e0a6-a490-4869-84b7-5f03cf47ac9d
+const static uint8_t serviceUuid[] = APP_FRIDGE_SERVICE_UUID;
+
+// Characteristic UUID: 1974e0a7-a490-4869-84b7-5f03cf47ac9d
+const static uint8_t characteristicUuid[] = {0x9D, 0xAC, 0x47, 0xCF, 0x03, 0x5F, 0xB7, 0x84, 0x69, 0x48, 0x90, 0xA4, 0xA7, 0xE0, 0x74, 0x19};
+
+// How long to scan for base stations when none are known (units of 10ms)
+#define SEND_SCAN_DURATION 300
+
+// Connection the next request on the stack thread is for, there's only ever one request at a time
+static uint16_t connHandleCached = 0xFFFF;
+
+// Stack thread only, set while the stack is working on a connect the send link asked for, to the base station in connectAddr
+static bool connectPending = false;
+static uint8_t connectAddr[B_ADDR_LEN];
+// The PHY request the stack thread is waiting to hear back on, the send link picks the PHY
+static uint16_t phyConnHandle = 0xFFFF;
+static phy_mode_t phyAsked = PHY_MODE_1M;
+
+typedef struct send_ble_phy_req_t {
+    uint16_t connHandle;
+    phy_mode_t mode;
+} send_ble_phy_req_t;
+
+static const uint8_t phyBits[PHY_MODE_COUNT] = {
+    [PHY_MODE_2M] = HCI_PHY_2_MBPS,
+    [PHY_MODE_1M] = HCI_PHY_1_MBPS,
+    [PHY_MODE_CODED_S2] = HCI_PHY_CODED,
+    [PHY_MODE_CODED_S8] = HCI_PHY_CODED,
+};
+
+static const uint16_t phyOpts[PHY_MODE_COUNT] = {
+    [PHY_MODE_2M] = HCI_PHY_OPT_NONE,
+    [PHY_MODE_1M] = HCI_PHY_OPT_NONE,
+    [PHY_MODE_CODED_S2] = HCI_PHY_OPT_S2,
+    [PHY_MODE_CODED_S8] = HCI_PHY_OPT_S8,
+};
+
+// What the PHY update complete event reports once the link is on the mode
+static const uint8_t phyUpdated[PHY_MODE_COUNT] = {
+    [PHY_MODE_2M] = PHY_UPDATE_COMPLETE_EVENT_2M,
+    [PHY_MODE_1M] = PHY_UPDATE_COMPLETE_EVENT_1M,
+    [PHY_MODE_CODED_S2] = PHY_UPDATE_COMPLETE_EVENT_CODED,
+    [PHY_MODE_CODED_S8] = PHY_UPDATE_COMPLETE_EVENT_CODED,
+};
+
+static_assert(SEND_LINK_ADDR_LEN == B_ADDR_LEN, "Address length doesn't match the stack's");
+static_assert(SEND_LINK_SUCCESS == SUCCESS, "Success status doesn't match the stack's");
+
+static uint8_t SendBleAttReqToReport(uint8_t reqOpcode) {
+    switch (reqOpcode) {
+        case ATT_FIND_BY_TYPE_VALUE_REQ:
+            return REPORT_OPCODE_SRV_DISCOVERY;
+        case ATT_READ_BY_TYPE_REQ:
+            return REPORT_OPCODE_CHR_DISCOVERY;
+        case ATT_WRITE_REQ:
+            return REPORT_OPCODE_WRITE_DONE;
+        case ATT_READ_REQ:
+            return REPORT_OPCODE_READ_DONE;
+        default:
+            return REPORT_OPCODE_ERROR;
+    }
+}
+
+static void SendData_GattHandler(uint32 event, BLEAppUtil_msgHdr_t *pMsgData);
+static void SendData_ConnectionHandler(uint32 event, BLEAppUtil_msgHdr_t *pMsgData);
+static void SendData_HciHandler(uint32 event, BLEAppUtil_msgHdr_t *pMsgData);
+
+BLEAppUtil_EventHandler_t gattEventHandler =
+{
+    .handlerType    = BLEAPPUTIL_GATT_TYPE,
+    .pEventHandler  = SendData_GattHandler,
+    .eventMask      = BLEAPPUTIL_ATT_ERROR_RSP |
+                      BLEAPPUTIL_ATT_FIND_BY_TYPE_VALUE_RSP |
+                      BLEAPPUTIL_ATT_READ_BY_TYPE_RSP |
+                      BLEAPPUTIL_ATT_WRITE_RSP |
+                      BLEAPPUTIL_ATT_READ_RSP
+};
+
+BLEAppUtil_EventHandler_t sendDataConnHandler =
+{
+    .handlerType    = BLEAPPUTIL_GAP_CONN_TYPE,
+    .pEventHandler  = SendData_ConnectionHandler,
+    .eventMask      = BLEAPPUTIL_LINK_ESTABLISHED_EVENT |
+                      BLEAPPUTIL_LINK_TERMINATED_EVENT |
+                      BLEAPPUTIL_CONNECTING_CANCELLED_EVENT
+};
+
+BLEAppUtil_EventHandler_t sendDataHciHandler =
+{
+    .handlerType    = BLEAPPUTIL_HCI_GAP_TYPE,
+    .pEventHandler  = SendData_HciHandler,
+    .eventMask      = BLEAPPUTIL_HCI_COMMAND_STATUS_EVENT_CODE |
+                      BLEAPPUTIL_HCI_COMMAND_COMPLETE_EVENT_CODE |
+                      BLEAPPUTIL_HCI_LE_EVENT_CODE
+};
+
+static void SendData_HciHandler(uint32 event, BLEAppUtil_msgHdr_t *pMsgData) {
+    switch (event) {
+        case BLEAPPUTIL_HCI_COMMAND_COMPLETE_EVENT_CODE:
+        {
+            // Status, connection handle and RSSI
+            hciEvt_CmdComplete_t *pHciMsg = (hciEvt_CmdComplete_t *)pMsgData;
+            if (pHciMsg->cmdOpcode == HCI_READ_RSSI && pHciMsg->pReturnParam[0] == SUCCESS) {
+                SendLink_onRssi(BUILD_UINT16(pHciMsg->pReturnParam[1], pHciMsg->pReturnParam[2]), (int8_t)pHciMsg->pReturnParam[3]);
+            }
+            break;
+        }
+
+        case BLEAPPUTIL_HCI_COMMAND_STATUS_EVENT_CODE:
+        {
+            hciEvt_CommandStatus_t *pHciMsg = (hciEvt_CommandStatus_t *)pMsgData;
+            if (phyConnHandle != 0xFFFF && pHciMsg->cmdOpcode == HCI_LE_SET_PHY &&
+                pHciMsg->cmdStatus == HCI_ERROR_CODE_UNSUPPORTED_REMOTE_FEATURE) {
+                SendLink_onPhyRefused(phyConnHandle, phyAsked);
+                phyConnHandle = 0xFFFF;
+            }
+            break;
+        }
+
+        case BLEAPPUTIL_HCI_LE_EVENT_CODE:
+        {
+            hciEvt_BLEPhyUpdateComplete_t *pPUC = (hciEvt_BLEPhyUpdateComplete_t *)pMsgData;
+            if (phyConnHandle == 0xFFFF || pPUC->BLEEventCode != HCI_BLE_PHY_UPDATE_COMPLETE_EVENT ||
+                pPUC->connHandle != phyConnHandle) {
+                break;
+            }
+            // A base station without the PHY either says so or leaves the link where it was
+            if (pPUC->status == HCI_ERROR_CODE_UNSUPPORTED_REMOTE_FEATURE ||
+                (pPUC->status == SUCCESS && pPUC->txPhy != phyUpdated[phyAsked])) {
+                SendLink_onPhyRefused(phyConnHandle, phyAsked);
+            }
+            phyConnHandle = 0xFFFF;
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+static void SendData_ConnectionHandler(uint32 event, BLEAppUtil_msgHdr_t *pMsgData) {
+    switch(event)
+        {
+            case BLEAPPUTIL_LINK_ESTABLISHED_EVENT:
+            {
+                gapEstLinkReqEvent_t *gapEstMsg = (gapEstLinkReqEvent_t *)pMsgData;
+                if (memcmp(gapEstMsg->devAddr, connectAddr, B_ADDR_LEN) == 0) {
+                    connectPending = false;
+                }
+                if (gapEstMsg->hdr.status == SUCCESS) {
+                    SendLink_onConnected(gapEstMsg->connectionHandle, gapEstMsg->devAddr);
+                }
+                else {
+                    SendLink_onConnectFailed(gapEstMsg->devAddr, gapEstMsg->hdr.status);
+                }
+                break;
+            }
+
+            case BLEAPPUTIL_LINK_TERMINATED_EVENT:
+            {
+                gapTerminateLinkEvent_t *gapTermMsg = (gapTerminateLinkEvent_t *)pMsgData;
+                if (gapTermMsg->connectionHandle == phyConnHandle) {
+                    phyConnHandle = 0xFFFF;
+                }
+                SendLink_onDisconnected(gapTermMsg->connectionHandle, gapTermMsg->reason);
+                break;
+            }
+
+            case BLEAPPUTIL_CONNECTING_CANCELLED_EVENT:
+            {
+                gapConnCancelledEvent_t *gapCancelledMsg = (gapConnCancelledEvent_t *)pMsgData;
+                // A connect the menu started and cancelled isn't the send link's to fail
+                if (connectPending) {
+                    connectPending = false;
+                    SendLink_onError(REPORT_OPCODE_CONNECTED, SEND_CONN_HANDLE_ANY, NOTIFY_ERRSRC_CONN_CANCELLED, gapCancelledMsg->opcode);
+                }
+                break;
+            }
+
+            default:
+            {
+                break;
+            }
+        }
+}
+
+static void SendData_GattHandler(uint32 event, BLEAppUtil_msgHdr_t *pMsg) {
+    gattMsgEvent_t * pMsgData = (gattMsgEvent_t *)pMsg;
+    uint16_t connHandle = pMsgData->connHandle;
+
+    switch (event) {
+        case BLEAPPUTIL_ATT_ERROR_RSP:
+        {
+            // The error response says which request it answers
+            uint8_t expectedOpcode = SendBleAttReqToReport(pMsgData->msg.errorRsp.reqOpcode);
+            if (pMsgData->hdr.status == SUCCESS) {
+                SendLink_onError(expectedOpcode, connHandle, NOTIFY_ERRSRC_GATT_ERROR_REPORT, pMsgData->msg.errorRsp.errCode);
+            }
+            else {
+                SendLink_onError(expectedOpcode, connHandle, NOTIFY_ERRSRC_GATT_ERROR_STATUS, pMsgData->hdr.status);
+            }
+            break;
+        }
+        case BLEAPPUTIL_ATT_FIND_BY_TYPE_VALUE_RSP:
+        {
+            // Needs to be SUCCESS to work?? IDK since the docs say bleProcedureComplete, just accept both
+            if (pMsgData->hdr.status == bleProcedureComplete || pMsgData->hdr.status == SUCCESS) {
+                if (pMsgData->msg.findByTypeValueRsp.numInfo == 1) {
+                    uint16_t svcStartHdl = ATT_ATTR_HANDLE(pMsgData->msg.findByTypeValueRsp.pHandlesInfo, 0);
+                    uint16_t svcEndHdl = ATT_GRP_END_HANDLE(pMsgData->msg.findByTypeValueRsp.pHandlesInfo, 0);
+                    SendLink_onServiceFound(connHandle, svcStartHdl, svcEndHdl);
+                }
+                else {
+                    SendLink_onError(REPORT_OPCODE_SRV_DISCOVERY, connHandle, NOTIFY_ERRSRC_NO_ENTRIES_FOUND, pMsgData->msg.findByTypeValueRsp.numInfo);
+                }
+            }
+            else {
+                SendLink_onError(REPORT_OPCODE_SRV_DISCOVERY, connHandle, NOTIFY_ERRSRC_BLE_STACK_ERROR, pMsgData->hdr.status);
+            }
+            break;
+        }
+        case BLEAPPUTIL_ATT_READ_BY_TYPE_RSP:
+        {
+            // Again, same as above, it reports SUCCESS rather than bleProcedureComplete, just accept both again
+            if (pMsgData->hdr.status == bleProcedureComplete || pMsgData->hdr.status == SUCCESS) {
+                if (pMsgData->msg.readByTypeRsp.numPairs == 1) {
+                    uint16_t chrHandle = ATT_PAIR_HANDLE(pMsgData->msg.readByTypeRsp.pDataList, 0);
+
+                    SendLink_onCharacteristicFound(connHandle, chrHandle);
+                }
+                else {
+                    SendLink_onError(REPORT_OPCODE_CHR_DISCOVERY, connHandle, NOTIFY_ERRSRC_NO_ENTRIES_FOUND, pMsgData->msg.readByTypeRsp.numPairs);
+                }
+            }
+            else {
+                SendLink_onError(REPORT_OPCODE_CHR_DISCOVERY, connHandle, NOTIFY_ERRSRC_BLE_STACK_ERROR, pMsgData->hdr.status);
+            }
+            break;
+        }
+
+        case BLEAPPUTIL_ATT_WRITE_RSP:
+        {
+            if (pMsgData->hdr.status == SUCCESS) {
+                SendLink_onWriteDone(connHandle);
+            }
+            else {
+                SendLink_onError(REPORT_OPCODE_WRITE_DONE, connHandle, NOTIFY_ERRSRC_BLE_STACK_ERROR, pMsgData->hdr.status);
+            }
+            break;
+        }
+
+        case BLEAPPUTIL_ATT_READ_RSP:
+        {
+            if (pMsgData->hdr.status == SUCCESS) {
+                SendLink_onReadDone(connHandle, pMsgData->msg.readRsp.pValue, pMsgData->msg.readRsp.len);
+            }
+            else {
+                SendLink_onError(REPORT_OPCODE_READ_DONE, connHandle, NOTIFY_ERRSRC_BLE_STACK_ERROR, pMsgData->hdr.status);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+#define CheckBleCallFromAsync(func, expected_opcode)  { \
+        bStatus_t status = (func); \
+        if (status != SUCCESS) { \
+            SendLink_onError((expected_opcode), SEND_CONN_HANDLE_ANY, NOTIFY_ERRSRC_BLE_RETCODE, status); \
+        } \
+    }
+
+static void SendData_StartScan(char *pData) {
+    const BLEAppUtil_ScanStart_t scanParams =
+    {
+        .scanPeriod     = 0,
+        .scanDuration   = SEND_SCAN_DURATION,
+        .maxNumReport   = APP_MAX_NUM_OF_ADV_REPORTS
+    };
+    // Only gets here once every known base station has failed, so start the list over
+    Central_startSendScan();
+    bStatus_t status = BLEAppUtil_scanStart(&scanParams);
+    if (status != SUCCESS) {
+        Central_cancelSendScan();
+        SendLink_onError(REPORT_OPCODE_SCAN_DONE, SEND_CONN_HANDLE_ANY, NOTIFY_ERRSRC_BLE_RETCODE, status);
+    }
+}
+
+static void SendData_Connect(char *pData) {
+    BLEAppUtil_ConnectParams_t *connParams = (BLEAppUtil_ConnectParams_t*)pData;
+    bStatus_t status = BLEAppUtil_connect(connParams);
+    if (status == SUCCESS) {
+        connectPending = true;
+        memcpy(connectAddr, connParams->pPeerAddress, B_ADDR_LEN);
+    }
+    else {
+        SendLink_onError(REPORT_OPCODE_CONNECTED, SEND_CONN_HANDLE_ANY, NOTIFY_ERRSRC_BLE_RETCODE, status);
+    }
+}
+
+static void SendData_DiscoverServce(char *pData) {
+    CheckBleCallFromAsync(GATT_DiscPrimaryServiceByUUID(connHandleCached, serviceUuid, sizeof(serviceUuid), BLEAppUtil_getSelfEntity()),
+                          REPORT_OPCODE_SRV_DISCOVERY);
+}
+
+static void SendData_DiscoverCharacteristic(char *pData) {
+    CheckBleCallFromAsync(GATT_DiscCharsByUUID(connHandleCached, (attReadByTypeReq_t*)pData, BLEAppUtil_getSelfEntity()),
+                          REPORT_OPCODE_CHR_DISCOVERY);
+}
+
+static void SendData_WriteCharacteristic(char *pData) {
+    bStatus_t status = GATT_WriteCharValue(connHandleCached, (attWriteReq_t*)pData, BLEAppUtil_getSelfEntity());
+    if (status != SUCCESS) {
+        GATT_bm_free((gattMsg_t*) pData, ATT_WRITE_REQ);
+        SendLink_onError(REPORT_OPCODE_WRITE_DONE, SEND_CONN_HANDLE_ANY, NOTIFY_ERRSRC_BLE_RETCODE, status);
+    }
+}
+
+static void SendData_ReadCharacteristic(char *pData) {
+    CheckBleCallFromAsync(GATT_ReadCharValue(connHandleCached, (attReadReq_t*)pData, BLEAppUtil_getSelfEntity()),
+                          REPORT_OPCODE_READ_DONE);
+}
+
+// Nothing goes back to the send link unless the base station refuses the PHY, the upload doesn't wait for it
+static void SendData_SetPhy(char *pData) {
+    send_ble_phy_req_t *req = (send_ble_phy_req_t*)pData;
+    BLEAppUtil_ConnPhyParams_t phyParams =
+    {
+        .connHandle = req->connHandle,
+        .allPhys = 0,
+        .txPhy = phyBits[req->mode],
+        .rxPhy = phyBits[req->mode],
+        .phyOpts = phyOpts[req->mode]
+    };
+    if (BLEAppUtil_setConnPhy(&phyParams) == SUCCESS) {
+        phyConnHandle = req->connHandle;
+        phyAsked = req->mode;
+    }
+}
+
+// Answered by a command complete, if the read fails the send link keeps the scan's RSSI
+static void SendData_ReadRssi(char *pData) {
+    HCI_ReadRssiCmd(*(uint16_t*)pData);
+}
+
+static void SendData_Disconnect(char *pData) {
+    CheckBleCallFromAsync(BLEAppUtil_disconnect(connHandleCached), REPORT_OPCODE_DISCONNECT);
+    connHandleCached = 0xFFFF;
+}
+
+static uint8_t SendBleScan(void) {
+    return BLEAppUtil_invokeFunctionNoData(SendData_StartScan);
+}
+
+static uint8_t SendBleConnect(const send_peer_t *peer) {
+    BLEAppUtil_ConnectParams_t *connParams = ICall_malloc(sizeof(BLEAppUtil_ConnectParams_t));
+    if (connParams == NULL) {
+        return bleMemAllocError;
+    }
+    connParams->peerAddrType = peer->addressType;
+    connParams->phys = INIT_PHY_1M;
+    connParams->timeout = 1000;
+    memcpy(connParams->pPeerAddress, peer->address, B_ADDR_LEN);
+    return BLEAppUtil_invokeFunction(SendData_Connect, (char*)connParams);
+}
+
+static uint8_t SendBleDiscoverService(uint16_t connHandle) {
+    connHandleCached = connHandle;
+    return BLEAppUtil_invokeFunctionNoData(SendData_DiscoverServce);
+}
+
+static uint8_t SendBleDiscoverCharacteristic(uint16_t connHandle, uint16_t startHdl, uint16_t endHdl) {
+    // Create the characteristic discovery message and send the message over
+    attReadByTypeReq_t *charReadReq = ICall_malloc(sizeof(attReadByTypeReq_t));
+    if (charReadReq == NULL) {
+        return bleMemAllocError;
+    }
+    charReadReq->startHandle = startHdl;
+    charReadReq->endHandle = endHdl;
+    charReadReq->type.len = sizeof(characteristicUuid);
+    static_assert(sizeof(characteristicUuid) <= sizeof(charReadReq->type.uuid), "UUID doesn't fit into UUID list");
+    memcpy(charReadReq->type.uuid, characteristicUuid, sizeof(characteristicUuid));
+
+    connHandleCached = connHandle;
+    return BLEAppUtil_invokeFunction(SendData_DiscoverCharacteristic, (char*)charReadReq);
+}
+
+static uint8_t SendBleWrite(uint16_t connHandle, uint16_t attHandle, const uint8_t *value, size_t len) {
+    attWriteReq_t *writeReq = ICall_malloc(sizeof(attWriteReq_t));
+    if (writeReq == NULL) {
+        return bleMemAllocError;
+    }
+    uint8_t* reportMsg = GATT_bm_alloc(connHandle, ATT_WRITE_REQ, len, NULL);
+    if (reportMsg == NULL) {
+        ICall_free(writeReq);
+        return bleMemAllocError;
+    }
+    memcpy(reportMsg, value, len);
+
+    writeReq->cmd = 0;                   // Bluetooth Request, not a Command (we want an ack)
+    writeReq->handle = attHandle;        // Pass handle to characteristic;
+    writeReq->pValue = reportMsg;        // This must be allocated with GATT_bm_alloc
+    writeReq->len = len;
+    writeReq->sig = 0;                   // Not a signed write (see bluetooth spec)
+
+    // We ned special logic so we don't leak memory
+    connHandleCached = connHandle;
+    bStatus_t status = BLEAppUtil_invokeFunction(SendData_WriteCharacteristic, (char*)writeReq);
+    if (status != SUCCESS) {
+        GATT_bm_free((gattMsg_t*) writeReq, ATT_WRITE_REQ);
+    }
+    return status;
+}
+
+static uint8_t SendBleRead(uint16_t connHandle, uint16_t attHandle) {
+    attReadReq_t *readReq = ICall_malloc(sizeof(attReadReq_t));
+    if (readReq == NULL) {
+        return bleMemAllocError;
+    }
+    readReq->handle = attHandle;
+
+    connHandleCached = connHandle;
+    return BLEAppUtil_invokeFunction(SendData_ReadCharacteristic, (char*)readReq);
+}
+
+static uint8_t SendBleSetPhy(uint16_t connHandle, phy_mode_t mode) {
+    send_ble_phy_req_t *req = ICall_malloc(sizeof(send_ble_phy_req_t));
+    if (req == NULL) {
+        return bleMemAllocError;
+    }
+    req->connHandle = connHandle;
+    req->mode = mode;
+    return BLEAppUtil_invokeFunction(SendData_SetPhy, (char*)req);
+}
+
+static uint8_t SendBleReadRssi(uint16_t connHandle) {
+    uint16_t *handle = ICall_malloc(sizeof(uint16_t));
+    if (handle == NULL) {
+        return bleMemAllocError;
+    }
+    *handle = connHandle;
+    return BLEAppUtil_invokeFunction(SendData_ReadRssi, (char*)handle);
+}
+
+static uint8_t SendBleDisconnect(uint16_t connHandle) {
+    connHandleCached = connHandle;
+    return BLEAppUtil_invokeFunctionNoData(SendData_Disconnect);
+}
+
+static void resetWithBigHammer(uint16_t connHandle) {
+    // These are private undocumented functions in the internals of the SimpleLink SDK
+    // However, they won't make it work nicely, so I'll have to do this I guess
+    extern void gattResetClientInfo(void *pClient);
+    extern void* gattFindClientInfo(uint16 connHandle);
+
+    void* pClient = gattFindClientInfo(connHandle);
+    if (pClient) {
+        gattResetClientInfo(pClient);
+    }
+}
+
+static bool SendBleGetBaseStation(send_peer_t *peer) {
+    App_baseStation baseStation;
+    if (!Central_getBaseStation(&baseStation)) {
+        return false;
+    }
+    peer->addressType = baseStation.addressType;
+    memcpy(peer->address, baseStation.address, B_ADDR_LEN);
+    peer->rssi = baseStation.rssi;
+    return true;
+}
+
+static const send_stack_t bleStack = {
+    .scan = SendBleScan,
+    .connect = SendBleConnect,
+    .discoverService = SendBleDiscoverService,
+    .discoverCharacteristic = SendBleDiscoverCharacteristic,
+    .write = SendBleWrite,
+    .read = SendBleRead,
+    .disconnect = SendBleDisconnect,
+    .setPhy = SendBleSetPhy,
+    .readRssi = SendBleReadRssi,
+    .resetClient = resetWithBigHammer,
+    .getBaseStation = SendBleGetBaseStation,
+    .reportBaseStation = Central_reportBaseStation,
+};
+
+const send_stack_t* SendBle_init(void) {
+    bStatus_t status = BLEAppUtil_registerEventHandler(&gattEventHandler);
+    assert(status == SUCCESS);
+    status = BLEAppUtil_registerEventHandler(&sendDataConnHandler);
+    assert(status == SUCCESS);
+    status = BLEAppUtil_registerEventHandler(&sendDataHciHandler);
+    assert(status == SUCCESS);
+    return &bleStack;
+}
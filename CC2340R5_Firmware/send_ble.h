@@ -0,0 +1,16 @@
+/*
+ * send_ble.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef SEND_BLE_H_
+#define SEND_BLE_H_
+
+#include "send_link.h"
+
+// Registers for the stack events the send link waits on, and returns the stack to hand it
+const send_stack_t* SendBle_init(void);
+
+#endif /* SEND_BLE_H_ */
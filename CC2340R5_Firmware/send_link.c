@@ -0,0 +1,617 @@
+/*
+ * send_link.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include <task.h>
+#include "send_link.h"
+#include "send_stats.h"
+
+static_assert(ASYNC_PHASE_OTA == SEND_STATS_NUM_PHASES, "Phase stats don't cover every phase");
+static_assert(SEND_STATS_RECORD_SIZE <= SEND_MAX_WRITE_LEN, "Stats record doesn't fit in a write");
+static_assert(PHY_POLICY_RECORD_SIZE <= SEND_MAX_WRITE_LEN, "PHY stats record doesn't fit in a write");
+
+#define ErrorSrcOS 0
+#define ErrorSrcQueue 1
+#define ErrorSrcInvoke 2
+#define ErrorSrcQueueFetch 3
+#define ErrorSrcInvalidQueueOpcode 4
+#define ErrorSrcNoBaseStation 5
+#define ErrorSrcOpTableFull 6
+
+// Only used to match events that end every operation on a connection (link loss)
+#define REPORT_OPCODE_ANY 0xFF
+
+typedef struct async_task_report_t {
+    uint8_t opId;
+    uint8_t opcode;
+    union val {
+        uint32_t errorCode;
+        uint16_t connHandle;
+        struct service_discovery {
+            uint16_t startHdl;
+            uint16_t endHdl;
+        } service_discovery;
+        uint16_t chrHandle;
+        struct read {
+            uint8_t len;
+            uint8_t value[SEND_MAX_READ_LEN];
+        } read;
+    } data;
+} async_task_report_t;
+
+static const send_stack_t *stack;
+static QueueHandle_t opReportQueue;
+static uint16_t connHandleCached = 0xFFFF;
+static uint16_t attHandleCached = 0;
+static uint8_t attHandleAddr[SEND_LINK_ADDR_LEN];
+
+static enum async_task_phase current_phase = ASYNC_PHASE_IDLE;
+static TickType_t phaseStartTick = 0;
+
+// Every request handed to the stack thread is registered here first, and the event that answers it
+// is matched back by opcode and connection. Anything that doesn't match is a stale or duplicate event.
+#define SEND_MAX_INFLIGHT_OPS 4
+// How long the send task waits on any one operation before abandoning it
+#define SEND_OP_TIMEOUT_MS 10000
+// Writes allowed in flight at once. ATT only allows one outstanding write request per connection,
+// so this has to stay at 1 while writes are requests rather than commands
+#define SEND_WRITE_PIPELINE_DEPTH 1
+
+typedef struct async_op_t {
+    uint8_t id;             // 0 when the slot is free
+    uint8_t opcode;         // Report opcode that completes the operation
+    uint16_t connHandle;    // Connection the response has to come from, or SEND_CONN_HANDLE_ANY
+} async_op_t;
+
+// Shared between the stack thread and the send task, only touched in critical sections
+static async_op_t asyncOps[SEND_MAX_INFLIGHT_OPS];
+static uint8_t nextOpId = 1;
+static async_op_counters_t asyncOpCounters;
+// Base station the pending connect went to, links to anything else belong to someone else (the menu)
+static uint8_t connectAddr[SEND_LINK_ADDR_LEN];
+
+// Connections are always made on 1M, the base station only advertises there. The PHY the policy
+// picked is asked for as soon as the link is up, and the upload carries on at 1M if it's refused.
+// The policy is the send task's, the stack thread only hands back what it learns about the connection.
+static phy_policy_t phyPolicy;
+static uint8_t phyPeerAddr[SEND_LINK_ADDR_LEN];
+static uint16_t phyConnHandle = SEND_CONN_HANDLE_ANY;
+static int8_t phyRssi;
+// PHY_MODE_COUNT unless the base station refused the one asked for
+static phy_mode_t phyRefused = PHY_MODE_COUNT;
+
+static uint8_t SendLinkOpStart(uint8_t opcode, uint16_t connHandle) {
+    uint8_t opId = 0;
+
+    taskENTER_CRITICAL();
+    for (int i = 0; i < SEND_MAX_INFLIGHT_OPS; i++) {
+        if (asyncOps[i].id == 0) {
+            opId = nextOpId;
+            nextOpId = (nextOpId == UINT8_MAX) ? 1 : nextOpId + 1;
+            asyncOps[i].id = opId;
+            asyncOps[i].opcode = opcode;
+            asyncOps[i].connHandle = connHandle;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return opId;
+}
+
+static void SendLinkOpCancel(uint8_t opId) {
+    taskENTER_CRITICAL();
+    for (int i = 0; i < SEND_MAX_INFLIGHT_OPS; i++) {
+        if (asyncOps[i].id == opId) {
+            asyncOps[i].id = 0;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+
+static void SendLinkOpCancelConn(uint16_t connHandle) {
+    taskENTER_CRITICAL();
+    for (int i = 0; i < SEND_MAX_INFLIGHT_OPS; i++) {
+        if (asyncOps[i].connHandle == connHandle) {
+            asyncOps[i].id = 0;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+
+static int SendLinkOpFind(uint8_t opcode, uint16_t connHandle) {
+    // Oldest first, responses on a connection come back in the order the requests went out
+    int found = -1;
+    for (int i = 0; i < SEND_MAX_INFLIGHT_OPS; i++) {
+        async_op_t *op = &asyncOps[i];
+        if (op->id == 0) {
+            continue;
+        }
+        if (opcode == REPORT_OPCODE_ANY) {
+            // Only operations known to be on this connection
+            if (op->connHandle != connHandle) {
+                continue;
+            }
+        }
+        else if (op->opcode != opcode) {
+            continue;
+        }
+        else if (connHandle != SEND_CONN_HANDLE_ANY && op->connHandle != SEND_CONN_HANDLE_ANY && op->connHandle != connHandle) {
+            continue;
+        }
+        if (found < 0 || (int8_t)(op->id - asyncOps[found].id) < 0) {
+            found = i;
+        }
+    }
+    return found;
+}
+
+static bool SendLinkOpPending(uint8_t opcode, uint16_t connHandle) {
+    taskENTER_CRITICAL();
+    bool pending = SendLinkOpFind(opcode, connHandle) >= 0;
+    taskEXIT_CRITICAL();
+    return pending;
+}
+
+// Completes the oldest operation waiting on expectedOpcode and hands the report to the send task
+// Returns false (and counts it) if nothing was waiting, the event is then dropped
+static bool SendLinkNotifyReport(uint8_t expectedOpcode, uint16_t connHandle, async_task_report_t* report) {
+    taskENTER_CRITICAL();
+    int slot = SendLinkOpFind(expectedOpcode, connHandle);
+    if (slot >= 0) {
+        report->opId = asyncOps[slot].id;
+        asyncOps[slot].id = 0;
+    }
+    else {
+        asyncOpCounters.staleEvents++;
+    }
+    taskEXIT_CRITICAL();
+
+    if (slot < 0) {
+        return false;
+    }
+
+    // There is a queue slot per operation, so this only fails if the send task stopped draining it
+    if (xQueueSendToBack(opReportQueue, report, 0) != pdPASS) {
+        asyncOpCounters.queueOverflows++;
+    }
+    return true;
+}
+
+static BaseType_t SendLinkOpAwait(uint8_t opId, async_task_report_t *report) {
+    TickType_t startTick = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(SEND_OP_TIMEOUT_MS);
+
+    while (true) {
+        TickType_t elapsed = xTaskGetTickCount() - startTick;
+        if (elapsed >= timeout || xQueueReceive(opReportQueue, report, timeout - elapsed) != pdPASS) {
+            // Anything that shows up for it later gets dropped as stale
+            SendLinkOpCancel(opId);
+            asyncOpCounters.timeouts++;
+            return pdFAIL;
+        }
+        if (report->opId == opId) {
+            return pdPASS;
+        }
+        asyncOpCounters.staleReports++;
+    }
+}
+
+static bool SendLinkOwnPeer(const uint8_t *peerAddress) {
+    taskENTER_CRITICAL();
+    bool own = memcmp(peerAddress, connectAddr, SEND_LINK_ADDR_LEN) == 0;
+    if (!own) {
+        asyncOpCounters.staleEvents++;
+    }
+    taskEXIT_CRITICAL();
+    return own;
+}
+
+void SendLink_onConnected(uint16_t connHandle, const uint8_t *peerAddress) {
+    if (!SendLinkOwnPeer(peerAddress)) {
+        return;
+    }
+    async_task_report_t report;
+    report.opcode = REPORT_OPCODE_CONNECTED;
+    report.data.connHandle = connHandle;
+    SendLinkNotifyReport(REPORT_OPCODE_CONNECTED, SEND_CONN_HANDLE_ANY, &report);
+}
+
+void SendLink_onConnectFailed(const uint8_t *peerAddress, uint16_t status) {
+    if (SendLinkOwnPeer(peerAddress)) {
+        SendLink_onError(REPORT_OPCODE_CONNECTED, SEND_CONN_HANDLE_ANY, NOTIFY_ERRSRC_BLE_STACK_ERROR, status);
+    }
+}
+
+void SendLink_onServiceFound(uint16_t connHandle, uint16_t startHdl, uint16_t endHdl) {
+    async_task_report_t report;
+    report.opcode = REPORT_OPCODE_SRV_DISCOVERY;
+    report.data.service_discovery.startHdl = startHdl;
+    report.data.service_discovery.endHdl = endHdl;
+    SendLinkNotifyReport(REPORT_OPCODE_SRV_DISCOVERY, connHandle, &report);
+}
+
+void SendLink_onCharacteristicFound(uint16_t connHandle, uint16_t chrHandle) {
+    async_task_report_t report;
+    report.opcode = REPORT_OPCODE_CHR_DISCOVERY;
+    report.data.chrHandle = chrHandle;
+    SendLinkNotifyReport(REPORT_OPCODE_CHR_DISCOVERY, connHandle, &report);
+}
+
+void SendLink_onWriteDone(uint16_t connHandle) {
+    async_task_report_t report;
+    report.opcode = REPORT_OPCODE_WRITE_DONE;
+    SendLinkNotifyReport(REPORT_OPCODE_WRITE_DONE, connHandle, &report);
+}
+
+void SendLink_onReadDone(uint16_t connHandle, const uint8_t *value, size_t len) {
+    async_task_report_t report;
+    report.opcode = REPORT_OPCODE_READ_DONE;
+    report.data.read.len = (len < SEND_MAX_READ_LEN) ? len : SEND_MAX_READ_LEN;
+    memcpy(report.data.read.value, value, report.data.read.len);
+    SendLinkNotifyReport(REPORT_OPCODE_READ_DONE, connHandle, &report);
+}
+
+void SendLink_onScanDone(void) {
+    // Only reported for scans the send path started, menu scans are filtered out in app_central.c
+    async_task_report_t report;
+    report.opcode = REPORT_OPCODE_SCAN_DONE;
+    SendLinkNotifyReport(REPORT_OPCODE_SCAN_DONE, SEND_CONN_HANDLE_ANY, &report);
+}
+
+void SendLink_onError(uint8_t expectedOpcode, uint16_t connHandle, enum notify_error_src src, uint16_t errorCode) {
+    async_task_report_t report;
+    report.opcode = REPORT_OPCODE_ERROR;
+    report.data.errorCode = (((uint32_t) src) << 16) | ((uint32_t)errorCode);
+    SendLinkNotifyReport(expectedOpcode, connHandle, &report);
+}
+
+// Answers that turn up after the transfer has let go of the connection are stale
+static bool SendLinkPhyConn(uint16_t connHandle) {
+    bool own = connHandle != SEND_CONN_HANDLE_ANY && connHandle == phyConnHandle;
+    if (!own) {
+        asyncOpCounters.staleEvents++;
+    }
+    return own;
+}
+
+void SendLink_onPhyRefused(uint16_t connHandle, phy_mode_t mode) {
+    taskENTER_CRITICAL();
+    if (SendLinkPhyConn(connHandle)) {
+        phyRefused = mode;
+    }
+    taskEXIT_CRITICAL();
+}
+
+void SendLink_onRssi(uint16_t connHandle, int8_t rssi) {
+    taskENTER_CRITICAL();
+    if (SendLinkPhyConn(connHandle)) {
+        phyRssi = rssi;
+    }
+    taskEXIT_CRITICAL();
+}
+
+void SendLink_onDisconnected(uint16_t connHandle, uint8_t reason) {
+    async_task_report_t report;
+    if (SendLinkOpPending(REPORT_OPCODE_DISCONNECT, connHandle)) {
+        report.opcode = REPORT_OPCODE_DISCONNECT;
+        SendLinkNotifyReport(REPORT_OPCODE_DISCONNECT, connHandle, &report);
+        return;
+    }
+
+    // Fail everything still waiting on the link straight away, rather than leaving it to time out
+    report.opcode = REPORT_OPCODE_ERROR;
+    report.data.errorCode = (((uint32_t) NOTIFY_ERRSRC_LINK_LOST) << 16) | reason;
+    while (SendLinkOpPending(REPORT_OPCODE_ANY, connHandle)) {
+        SendLinkNotifyReport(REPORT_OPCODE_ANY, connHandle, &report);
+    }
+}
+
+static void SendLinkEnterPhase(enum async_task_phase phase) {
+    current_phase = phase;
+    phaseStartTick = xTaskGetTickCount();
+}
+
+static void SendLinkPhaseDone(TickType_t startTick) {
+    TickType_t elapsed = xTaskGetTickCount() - startTick;
+    SendStats_recordPhase(current_phase, (uint32_t)(((uint64_t)elapsed * 1000) / configTICK_RATE_HZ));
+}
+
+// Keeps the first failure, so a failed disconnect doesn't hide why we were disconnecting
+#define FailPhase(src, code) { \
+        enum async_task_phase last_phase = current_phase; \
+        current_phase = ASYNC_PHASE_IDLE; \
+        SendStats_recordFailure(last_phase); \
+        if (rc == 0) { \
+            rc = (last_phase << 28) | ((src) << 24) | ((code) & 0xFFFFFF); \
+        } \
+        goto disconnect; \
+    }
+
+// Registers the operation before handing it to the stack thread, so the response can never beat it
+#define InvokeOp(opId, expected_opcode, conn_handle, func) { \
+        opId = SendLinkOpStart((expected_opcode), (conn_handle)); \
+        if (opId == 0) { \
+            FailPhase(ErrorSrcOpTableFull, 0); \
+        } \
+        uint8_t status = (func); \
+        if (status != SEND_LINK_SUCCESS) { \
+            SendLinkOpCancel(opId); \
+            FailPhase(ErrorSrcInvoke, status); \
+        } \
+    }
+
+#define QueueGetResultSince(opId, expected_opcode, start_tick) { \
+        BaseType_t rcTmp = SendLinkOpAwait((opId), &report); \
+        if (rcTmp != pdPASS) { \
+            FailPhase(ErrorSrcQueueFetch, rcTmp); \
+        } \
+        if (report.opcode == REPORT_OPCODE_ERROR) { \
+            FailPhase(ErrorSrcQueue, report.data.errorCode); \
+        } \
+        else if (report.opcode != expected_opcode) { \
+            FailPhase(ErrorSrcInvalidQueueOpcode, 0); \
+        } \
+        SendLinkPhaseDone(start_tick); \
+    }
+
+#define QueueGetResult(opId, expected_opcode) QueueGetResultSince(opId, expected_opcode, phaseStartTick)
+
+static void SendLinkPhyBegin(const send_peer_t *peer) {
+    // What was learnt about the last base station says nothing about this one
+    if (memcmp(peer->address, phyPeerAddr, SEND_LINK_ADDR_LEN) != 0) {
+        memcpy(phyPeerAddr, peer->address, SEND_LINK_ADDR_LEN);
+        PhyPolicy_reset(&phyPolicy);
+    }
+
+    // The scan's RSSI only stands in until the connection's own is read
+    taskENTER_CRITICAL();
+    phyRssi = (peer->rssi < INT8_MIN) ? INT8_MIN : (peer->rssi > INT8_MAX) ? INT8_MAX : peer->rssi;
+    phyRefused = PHY_MODE_COUNT;
+    taskEXIT_CRITICAL();
+}
+
+// Neither request is waited on, the upload goes ahead while the PHY changes under it
+static void SendLinkPhyConnected(uint16_t connHandle) {
+    taskENTER_CRITICAL();
+    phyConnHandle = connHandle;
+    taskEXIT_CRITICAL();
+
+    if (phyPolicy.mode != PHY_MODE_1M) {
+        stack->setPhy(connHandle, phyPolicy.mode);
+    }
+    stack->readRssi(connHandle);
+}
+
+static void SendLinkPhyRelease(void) {
+    taskENTER_CRITICAL();
+    phyConnHandle = SEND_CONN_HANDLE_ANY;
+    taskEXIT_CRITICAL();
+}
+
+static void SendLinkPhyDone(bool success) {
+    SendLinkPhyRelease();
+
+    taskENTER_CRITICAL();
+    phy_mode_t refused = phyRefused;
+    int8_t rssi = phyRssi;
+    taskEXIT_CRITICAL();
+
+    // The upload ran at 1M if the PHY was refused, so that's what it counts against
+    if (refused != PHY_MODE_COUNT) {
+        PhyPolicy_unsupported(&phyPolicy, refused);
+    }
+    PhyPolicy_uploadDone(&phyPolicy, rssi, success);
+}
+
+uint32_t SendLink_transfer(const send_stream_t *stream) {
+    async_task_report_t report;
+    uint32_t rc = 0;
+    uint32_t transferRc = 0;
+    uint8_t opId;
+    send_peer_t baseStation;
+    bool baseStationValid = false;
+    bool disconnectTried = false;
+
+    // Reports for operations abandoned by an earlier transfer
+    while (xQueueReceive(opReportQueue, &report, 0) == pdPASS) {
+        asyncOpCounters.staleReports++;
+    }
+
+    // Pick the strongest base station that is still working, scanning for them if there are none left
+    baseStationValid = stack->getBaseStation(&baseStation);
+    if (!baseStationValid) {
+        SendLinkEnterPhase(ASYNC_PHASE_SCAN);
+        InvokeOp(opId, REPORT_OPCODE_SCAN_DONE, SEND_CONN_HANDLE_ANY, stack->scan());
+        QueueGetResult(opId, REPORT_OPCODE_SCAN_DONE);
+
+        baseStationValid = stack->getBaseStation(&baseStation);
+        if (!baseStationValid) {
+            SendLinkEnterPhase(ASYNC_PHASE_SCAN);
+            FailPhase(ErrorSrcNoBaseStation, 0);
+        }
+    }
+
+    // The characteristic handle belongs to whichever base station we discovered it on
+    if (memcmp(baseStation.address, attHandleAddr, SEND_LINK_ADDR_LEN) != 0) {
+        attHandleCached = 0;
+    }
+
+    SendLinkPhyBegin(&baseStation);
+
+    // Send the connect request, and wait for the status to come back from it
+    SendLinkEnterPhase(ASYNC_PHASE_CONNECT);
+    taskENTER_CRITICAL();
+    memcpy(connectAddr, baseStation.address, SEND_LINK_ADDR_LEN);
+    taskEXIT_CRITICAL();
+    InvokeOp(opId, REPORT_OPCODE_CONNECTED, SEND_CONN_HANDLE_ANY, stack->connect(&baseStation));
+    QueueGetResult(opId, REPORT_OPCODE_CONNECTED);
+    connHandleCached = report.data.connHandle;
+    SendLinkPhyConnected(connHandleCached);
+
+    if (attHandleCached == 0) {
+        // Discover the service
+        SendLinkEnterPhase(ASYNC_PHASE_SRV_DISCOVER);
+        InvokeOp(opId, REPORT_OPCODE_SRV_DISCOVERY, connHandleCached, stack->discoverService(connHandleCached));
+        QueueGetResult(opId, REPORT_OPCODE_SRV_DISCOVERY);
+        uint16_t srvStartHdl = report.data.service_discovery.startHdl;
+        uint16_t srvEndHdl = report.data.service_discovery.endHdl;
+
+        stack->resetClient(connHandleCached);
+        vTaskDelay(configTICK_RATE_HZ);
+
+        // Now that we know the service range, discover the characteristic that we want
+        SendLinkEnterPhase(ASYNC_PHASE_CHR_DISCOVER);
+        InvokeOp(opId, REPORT_OPCODE_CHR_DISCOVERY, connHandleCached,
+                 stack->discoverCharacteristic(connHandleCached, srvStartHdl, srvEndHdl));
+        QueueGetResult(opId, REPORT_OPCODE_CHR_DISCOVERY);
+        uint16_t chrHandle = report.data.chrHandle;
+
+        stack->resetClient(connHandleCached);
+        vTaskDelay(configTICK_RATE_HZ);
+
+        attHandleCached = chrHandle + 1;
+        memcpy(attHandleAddr, baseStation.address, SEND_LINK_ADDR_LEN);
+    }
+
+    // Finally write each payload to the known handle, all within the one connection
+    // Up to SEND_WRITE_PIPELINE_DEPTH writes are kept in flight, and complete in the order they were issued
+    SendLinkEnterPhase(ASYNC_PHASE_WRITE_VALUE);
+    {
+        uint8_t writeOps[SEND_WRITE_PIPELINE_DEPTH] = {0};
+        TickType_t writeStartTicks[SEND_WRITE_PIPELINE_DEPTH] = {0};
+        size_t numIssued = 0;
+        size_t numDone = 0;
+        bool streamDone = false;
+
+        while (!streamDone || numDone < numIssued) {
+            while (!streamDone && numIssued - numDone < SEND_WRITE_PIPELINE_DEPTH) {
+                uint8_t payload[SEND_MAX_WRITE_LEN];
+                size_t reportSize = stream->next(stream->ctx, payload, sizeof(payload));
+                if (reportSize == 0) {
+                    streamDone = true;
+                    break;
+                }
+
+                size_t slot = numIssued % SEND_WRITE_PIPELINE_DEPTH;
+                writeStartTicks[slot] = xTaskGetTickCount();
+                InvokeOp(writeOps[slot], REPORT_OPCODE_WRITE_DONE, connHandleCached,
+                         stack->write(connHandleCached, attHandleCached, payload, reportSize));
+                numIssued++;
+            }
+
+            if (numDone < numIssued) {
+                size_t slot = numDone % SEND_WRITE_PIPELINE_DEPTH;
+                QueueGetResultSince(writeOps[slot], REPORT_OPCODE_WRITE_DONE, writeStartTicks[slot]);
+                numDone++;
+            }
+        }
+    }
+
+    // The writes have all been acknowledged by now, so a session that fails doesn't fail the transfer
+    if (stream->session != NULL) {
+        SendLinkEnterPhase(ASYNC_PHASE_OTA);
+        stream->session();
+        current_phase = ASYNC_PHASE_IDLE;
+    }
+
+disconnect:
+    // Only ever tried once, a failure in here jumps straight back to this label
+    if (!disconnectTried) {
+        disconnectTried = true;
+        // The writes went through or they didn't by now, a failed disconnect only shows in the stats
+        // Failing the transfer for it would send the same readings again
+        transferRc = rc;
+
+        if (connHandleCached != 0xFFFF) {
+            // Whatever is still in flight on this connection is abandoned along with it
+            SendLinkOpCancelConn(connHandleCached);
+            SendLinkPhyRelease();
+
+            // Disconnect once we're done
+            SendLinkEnterPhase(ASYNC_PHASE_DISCONNECT);
+            uint16_t connHandle = connHandleCached;
+            connHandleCached = 0xFFFF;
+            InvokeOp(opId, REPORT_OPCODE_DISCONNECT, connHandle, stack->disconnect(connHandle));
+            QueueGetResult(opId, REPORT_OPCODE_DISCONNECT);
+        }
+    }
+
+    current_phase = ASYNC_PHASE_IDLE;
+
+    // Enough failures and the next attempt fails over to another base station
+    if (baseStationValid) {
+        stack->reportBaseStation(baseStation.address, transferRc == 0);
+        SendLinkPhyDone(transferRc == 0);
+    }
+
+    return transferRc;
+}
+
+// A request that failed because the link went down leaves nothing for the transfer to disconnect
+static void SendLinkSessionDone(uint32_t rc, const async_task_report_t *report) {
+    if (rc != 0 && report->opcode == REPORT_OPCODE_ERROR && (report->data.errorCode >> 16) == NOTIFY_ERRSRC_LINK_LOST) {
+        connHandleCached = 0xFFFF;
+    }
+}
+
+// Writes and reads made by a session. Each is timed on its own.
+uint32_t SendLink_write(const uint8_t *buf, size_t len) {
+    async_task_report_t report = {0};
+    uint32_t rc = 0;
+    uint8_t opId;
+    TickType_t startTick = xTaskGetTickCount();
+
+    InvokeOp(opId, REPORT_OPCODE_WRITE_DONE, connHandleCached, stack->write(connHandleCached, attHandleCached, buf, len));
+    QueueGetResultSince(opId, REPORT_OPCODE_WRITE_DONE, startTick);
+
+disconnect:
+    SendLinkSessionDone(rc, &report);
+    return rc;
+}
+
+uint32_t SendLink_read(uint8_t *buf, size_t len, size_t *readLen) {
+    async_task_report_t report = {0};
+    uint32_t rc = 0;
+    uint8_t opId;
+    TickType_t startTick = xTaskGetTickCount();
+    *readLen = 0;
+
+    InvokeOp(opId, REPORT_OPCODE_READ_DONE, connHandleCached, stack->read(connHandleCached, attHandleCached));
+    QueueGetResultSince(opId, REPORT_OPCODE_READ_DONE, startTick);
+
+    *readLen = (report.data.read.len < len) ? report.data.read.len : len;
+    memcpy(buf, report.data.read.value, *readLen);
+
+disconnect:
+    SendLinkSessionDone(rc, &report);
+    return rc;
+}
+
+void SendLink_getCounters(async_op_counters_t *counters) {
+    taskENTER_CRITICAL();
+    *counters = asyncOpCounters;
+    taskEXIT_CRITICAL();
+}
+
+const phy_policy_t* SendLink_getPhyPolicy(void) {
+    return &phyPolicy;
+}
+
+void SendLink_init(const send_stack_t *sendStack) {
+    const phy_policy_params_t phyParams = PHY_POLICY_DEFAULTS;
+    PhyPolicy_init(&phyPolicy, &phyParams);
+    stack = sendStack;
+    opReportQueue = xQueueCreate(SEND_MAX_INFLIGHT_OPS, sizeof(async_task_report_t));
+    assert(opReportQueue != NULL);
+}
@@ -0,0 +1,134 @@
+/*
+ * send_link.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef SEND_LINK_H_
+#define SEND_LINK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "phy_policy.h"
+
+// The upload connection to the base station: scan, connect, discovery, writes and disconnect.
+// Every request goes to the BLE stack through a send_stack_t, and every answer comes back through
+// the SendLink_on* calls, so none of this depends on the stack. send_ble.c is the real one, the
+// simulation tool runs the same state machine against a fake one on a PC.
+
+// Default ATT MTU (23) less the write request header
+#define SEND_MAX_WRITE_LEN 20
+// Default ATT MTU less the read response header
+#define SEND_MAX_READ_LEN 22
+
+#define SEND_LINK_ADDR_LEN 6
+#define SEND_LINK_SUCCESS 0
+#define SEND_CONN_HANDLE_ANY 0xFFFF
+
+// Phases of a transfer, each one is timed in the send stats
+enum async_task_phase {
+    ASYNC_PHASE_IDLE = 0,
+    ASYNC_PHASE_CONNECT,
+    ASYNC_PHASE_SRV_DISCOVER,
+    ASYNC_PHASE_CHR_DISCOVER,
+    ASYNC_PHASE_WRITE_VALUE,
+
+    ASYNC_PHASE_DISCONNECT,
+    ASYNC_PHASE_SCAN,
+    ASYNC_PHASE_OTA
+};
+
+// What a stack event answers
+#define REPORT_OPCODE_ERROR 0
+#define REPORT_OPCODE_CONNECTED 1
+#define REPORT_OPCODE_SRV_DISCOVERY 2
+#define REPORT_OPCODE_CHR_DISCOVERY 3
+#define REPORT_OPCODE_WRITE_DONE 4
+#define REPORT_OPCODE_DISCONNECT 5
+#define REPORT_OPCODE_SCAN_DONE 6
+#define REPORT_OPCODE_READ_DONE 7
+
+enum notify_error_src {
+    NOTIFY_ERRSRC_BLE_RETCODE = 0,
+    NOTIFY_ERRSRC_CONN_CANCELLED = 1,
+    NOTIFY_ERRSRC_GATT_ERROR_REPORT = 2,
+    NOTIFY_ERRSRC_GATT_ERROR_STATUS = 3,
+    NOTIFY_ERRSRC_BLE_STACK_ERROR = 4,
+    NOTIFY_ERRSRC_NO_ENTRIES_FOUND = 5,
+    NOTIFY_ERRSRC_LINK_LOST = 6,
+};
+
+typedef struct send_peer_t {
+    uint8_t addressType;
+    uint8_t address[SEND_LINK_ADDR_LEN];
+    int rssi;
+} send_peer_t;
+
+// Requests return SEND_LINK_SUCCESS once they've been handed to the stack, the answer comes later
+// through SendLink_on*, possibly from another thread
+typedef struct send_stack_t {
+    uint8_t (*scan)(void);
+    uint8_t (*connect)(const send_peer_t *peer);
+    uint8_t (*discoverService)(uint16_t connHandle);
+    uint8_t (*discoverCharacteristic)(uint16_t connHandle, uint16_t startHdl, uint16_t endHdl);
+    uint8_t (*write)(uint16_t connHandle, uint16_t attHandle, const uint8_t *value, size_t len);
+    uint8_t (*read)(uint16_t connHandle, uint16_t attHandle);
+    uint8_t (*disconnect)(uint16_t connHandle);
+    // Neither of these is waited on. The PHY is only answered if the base station refuses it, through
+    // SendLink_onPhyRefused, and the RSSI through SendLink_onRssi.
+    uint8_t (*setPhy)(uint16_t connHandle, phy_mode_t mode);
+    uint8_t (*readRssi)(uint16_t connHandle);
+    // Discovery leaves the stack's GATT client stuck, this gets it going again
+    void (*resetClient)(uint16_t connHandle);
+    // Base stations found by scanning, false if there are none left to try
+    bool (*getBaseStation)(send_peer_t *peer);
+    void (*reportBaseStation)(const uint8_t *address, bool success);
+} send_stack_t;
+
+// Where the writes of a transfer come from, so long transfers (capture downloads) never need to be held in RAM
+typedef struct send_stream_t {
+    // Fills buf with the next write, returns 0 once there is nothing left
+    size_t (*next)(void *ctx, uint8_t *buf, size_t len);
+    void *ctx;
+    // Optional, run on the same connection once every write is done (firmware update sessions)
+    void (*session)(void);
+} send_stream_t;
+
+typedef struct async_op_counters_t {
+    uint32_t staleEvents;       // Stack events that didn't answer any operation in flight
+    uint32_t staleReports;      // Reports for operations the send task had already given up on
+    uint32_t timeouts;
+    uint32_t queueOverflows;
+} async_op_counters_t;
+
+void SendLink_init(const send_stack_t *stack);
+// Runs one connection, returns 0 if every write went through, or (phase << 28 | source << 24 | code) for the first failure
+// A disconnect that fails after that is counted in the stats but doesn't fail the transfer
+uint32_t SendLink_transfer(const send_stream_t *stream);
+// For sessions, on the connection the transfer opened
+uint32_t SendLink_write(const uint8_t *buf, size_t len);
+uint32_t SendLink_read(uint8_t *buf, size_t len, size_t *readLen);
+void SendLink_getCounters(async_op_counters_t *counters);
+// Picks the PHY of every connection, send task only
+const phy_policy_t* SendLink_getPhyPolicy(void);
+
+// Stack events
+void SendLink_onScanDone(void);
+// Links to any peer but the base station the transfer is connecting to are someone else's, and ignored
+void SendLink_onConnected(uint16_t connHandle, const uint8_t *peerAddress);
+void SendLink_onConnectFailed(const uint8_t *peerAddress, uint16_t status);
+void SendLink_onServiceFound(uint16_t connHandle, uint16_t startHdl, uint16_t endHdl);
+void SendLink_onCharacteristicFound(uint16_t connHandle, uint16_t chrHandle);
+void SendLink_onWriteDone(uint16_t connHandle);
+void SendLink_onReadDone(uint16_t connHandle, const uint8_t *value, size_t len);
+void SendLink_onDisconnected(uint16_t connHandle, uint8_t reason);
+// Only count for the connection a transfer has open
+void SendLink_onPhyRefused(uint16_t connHandle, phy_mode_t mode);
+void SendLink_onRssi(uint16_t connHandle, int8_t rssi);
+// Fails the operation that was waiting on expectedOpcode
+void SendLink_onError(uint8_t expectedOpcode, uint16_t connHandle, enum notify_error_src src, uint16_t errorCode);
+
+#endif /* SEND_LINK_H_ */
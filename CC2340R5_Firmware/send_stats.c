@@ -0,0 +1,118 @@
+/*
+ * send_stats.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "send_stats.h"
+
+typedef struct phase_stats_t {
+    uint32_t count;
+    uint32_t failures;
+    uint32_t minMs;
+    uint32_t maxMs;
+    uint32_t sumMs;
+    uint32_t histogram[SEND_STATS_NUM_BUCKETS];
+} phase_stats_t;
+
+// Stats are windowed: they accumulate between exports and are cleared once sent
+// Only touched from the send data thread, so no locking is needed
+static phase_stats_t phaseStats[SEND_STATS_NUM_PHASES];
+static uint32_t uploadsSinceExport = 0;
+
+static phase_stats_t* SendStats_getPhase(uint8_t phase) {
+    // Phase 0 is idle, which is never timed
+    if (phase == 0 || phase > SEND_STATS_NUM_PHASES) {
+        return NULL;
+    }
+    return &phaseStats[phase - 1];
+}
+
+static uint8_t SendStats_bucket(uint32_t elapsedMs) {
+    uint8_t bucket = 0;
+    uint32_t limit = SEND_STATS_BUCKET0_MS;
+    while (bucket < SEND_STATS_NUM_BUCKETS - 1 && elapsedMs >= limit) {
+        bucket++;
+        limit <<= 1;
+    }
+    return bucket;
+}
+
+static uint16_t SendStats_saturate16(uint32_t val) {
+    return (val > UINT16_MAX) ? UINT16_MAX : (uint16_t) val;
+}
+
+void SendStats_recordPhase(uint8_t phase, uint32_t elapsedMs) {
+    phase_stats_t *stats = SendStats_getPhase(phase);
+    if (stats == NULL) {
+        return;
+    }
+
+    if (stats->count == 0 || elapsedMs < stats->minMs) {
+        stats->minMs = elapsedMs;
+    }
+    if (elapsedMs > stats->maxMs) {
+        stats->maxMs = elapsedMs;
+    }
+    stats->count++;
+    stats->sumMs += elapsedMs;
+    stats->histogram[SendStats_bucket(elapsedMs)]++;
+}
+
+void SendStats_recordFailure(uint8_t phase) {
+    phase_stats_t *stats = SendStats_getPhase(phase);
+    if (stats != NULL) {
+        stats->failures++;
+    }
+}
+
+void SendStats_uploadDone(void) {
+    uploadsSinceExport++;
+}
+
+bool SendStats_exportDue(void) {
+    return uploadsSinceExport >= SEND_STATS_EXPORT_INTERVAL;
+}
+
+size_t SendStats_buildRecord(uint8_t phase, uint8_t *buf, size_t len) {
+    phase_stats_t *stats = SendStats_getPhase(phase);
+    if (stats == NULL || len < SEND_STATS_RECORD_SIZE) {
+        return 0;
+    }
+
+    uint16_t count = SendStats_saturate16(stats->count);
+    uint16_t failures = SendStats_saturate16(stats->failures);
+    uint16_t minMs = SendStats_saturate16(stats->minMs);
+    uint16_t meanMs = SendStats_saturate16(stats->count ? stats->sumMs / stats->count : 0);
+    uint16_t maxMs = SendStats_saturate16(stats->maxMs);
+
+    // Big endian, same as the reading format
+    size_t idx = 0;
+    buf[idx++] = RECORD_TAG_PHASE_STATS;
+    buf[idx++] = phase;
+    buf[idx++] = count >> 8;
+    buf[idx++] = count & 0xFF;
+    buf[idx++] = failures >> 8;
+    buf[idx++] = failures & 0xFF;
+    buf[idx++] = minMs >> 8;
+    buf[idx++] = minMs & 0xFF;
+    buf[idx++] = meanMs >> 8;
+    buf[idx++] = meanMs & 0xFF;
+    buf[idx++] = maxMs >> 8;
+    buf[idx++] = maxMs & 0xFF;
+    for (int i = 0; i < SEND_STATS_NUM_BUCKETS; i++) {
+        buf[idx++] = (stats->histogram[i] > UINT8_MAX) ? UINT8_MAX : (uint8_t) stats->histogram[i];
+    }
+
+    return idx;
+}
+
+void SendStats_reset(void) {
+    memset(phaseStats, 0, sizeof(phaseStats));
+    uploadsSinceExport = 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * send_stats.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef SEND_STATS_H_
+#define SEND_STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Phases of the send state machine that get timed (matches enum async_task_phase in sendData.c, minus idle)
+#define SEND_STATS_NUM_PHASES       7
+// Latency histogram buckets: <32ms, <64ms, <128ms, ... <2048ms, >=2048ms
+#define SEND_STATS_NUM_BUCKETS      8
+#define SEND_STATS_BUCKET0_MS       32
+
+// Number of completed uploads between exporting the stats records to the base station
+#define SEND_STATS_EXPORT_INTERVAL  32
+
+// First byte of a stats record written to the base station (readings are untagged 7 byte writes)
+#define RECORD_TAG_PHASE_STATS      0xF0
+// | Tag | Phase | Count (2) | Failures (2) | Min ms (2) | Mean ms (2) | Max ms (2) | Histogram (8) |
+#define SEND_STATS_RECORD_SIZE      (2 + 10 + SEND_STATS_NUM_BUCKETS)
+
+void SendStats_recordPhase(uint8_t phase, uint32_t elapsedMs);
+void SendStats_recordFailure(uint8_t phase);
+void SendStats_uploadDone(void);
+bool SendStats_exportDue(void);
+size_t SendStats_buildRecord(uint8_t phase, uint8_t *buf, size_t len);
+void SendStats_reset(void);
+
+#endif /* SEND_STATS_H_ */
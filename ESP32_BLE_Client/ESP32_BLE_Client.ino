@@ -2,6 +2,8 @@
 #include <Wire.h>
 #include "ccs811.h"
 #include "driver/temp_sensor.h"
+#include "driver/rtc_io.h"
+#include "esp_sleep.h"
 
 // === Wiring ===
 // CCS811 -> ESP32 / ESP32Se
@@ -10,11 +12,53 @@
 // SDA    ->  D21  / D6
 // SCL    ->  D22  / D7
 // Wake   ->  D23  / D5
+// INT    ->  D19  / D4
 
 #define SDA0_Pin 6   // select ESP32  I2C pins
 #define SCL0_Pin 7
+#define CCS811_NWAKE_PIN 5
+#define CCS811_NINT_PIN  4   // Must be an RTC GPIO to wake from deep sleep
 
-CCS811 ccs811(5);
+CCS811 ccs811(CCS811_NWAKE_PIN);
+
+// Sleep between readings instead of staying up with BLE on, for running from a battery. The CCS811
+// keeps measuring on its own and pulls nINT low when a reading is ready, which wakes the ESP32.
+// Readings wait in RTC memory and go up in batches. Set to 0 to stay awake, which is easier to debug
+#ifndef DEEP_SLEEP_MODE
+#define DEEP_SLEEP_MODE 1
+#endif
+#define SLEEP_CCS811_MODE         CCS811_MODE_60SEC
+// With DEEP_SLEEP_MODE off the ESP32 waits for the interrupt instead of polling
+#define AWAKE_CCS811_MODE         CCS811_MODE_10SEC
+
+// Only interrupt on readings where eCO2 crosses one of these thresholds (ppm), rather than on every
+// reading. Steady air then costs no wakes at all, the timer still takes a reading every so often
+#ifndef CCS811_THRESHOLD_WAKE
+#define CCS811_THRESHOLD_WAKE     0
+#endif
+#define CCS811_THRESH_LOW_MED     800
+#define CCS811_THRESH_MED_HIGH    1500
+#define CCS811_THRESH_HYSTERESIS  50
+
+// Timer wake in case an interrupt is missed, a little longer than the sensor's period. With
+// threshold interrupts it is what takes the readings in between crossings
+#if CCS811_THRESHOLD_WAKE
+#define SLEEP_FALLBACK_SEC        (10 * 60)
+#else
+#define SLEEP_FALLBACK_SEC        75
+#endif
+#define AWAKE_FALLBACK_MS         15000
+
+// The S3 only has its die temperature, which is close to ambient after a sleep. There is no
+// humidity sensor, so the CCS811's own default is kept for that
+#define ENV_HUMIDITY_PCT          50
+#define ENV_UPDATE_DEGC           1
+// Readings collected before an upload is attempted
+#define UPLOAD_BATCH_READINGS     10
+// Readings kept while no base station can be reached, the oldest are dropped past this
+#define RTC_READING_BUFFER        48
+// Largest batch record, well inside the base station's MTU
+#define BATCH_RECORD_MAX          240
 
 void initTempSensor(){
     temp_sensor_config_t temp_sensor = TSENS_CONFIG_DEFAULT();
@@ -30,8 +74,97 @@ static BLEUUID    charUUID("1974e0a7-a490-4869-84b7-5f03cf47ac9d");
 
 BLEClient*  pClient;
 static BLERemoteCharacteristic* pRemoteCharacteristic;
-// static BLEAddress targetAddress("94:B9:7E:D5:62:56");
-static BLEAddress targetAddress("D4:8A:FC:A8:91:3E");
+
+// Base stations are found by scanning for the service UUID rather than a hard coded address
+#define SCAN_DURATION_SEC         3
+#define MAX_BASE_STATIONS         4
+// Connection failures before a base station is skipped until the next scan
+#define BASE_STATION_MAX_FAILURES 3
+
+struct BaseStation {
+  esp_bd_addr_t address;
+  esp_ble_addr_type_t addressType;
+  int rssi;
+  uint8_t failures;
+  uint16_t mtu;             // Negotiated ATT MTU, 0 until an exchange has been done with this station
+};
+
+// ATT MTU every connection starts with, a write can carry this less the 3 byte header
+#define BLE_DEFAULT_MTU           23
+#define ATT_WRITE_HEADER_LEN      3
+#define BLE_MAX_MTU               517
+
+// In RTC memory so a wake from deep sleep doesn't have to scan again
+RTC_DATA_ATTR static BaseStation baseStations[MAX_BASE_STATIONS];
+RTC_DATA_ATTR static int numBaseStations = 0;
+
+void scanForBaseStations() {
+  Serial.println("Scanning for base stations");
+  // Stations found again keep the MTU they negotiated last time
+  BaseStation previous[MAX_BASE_STATIONS];
+  int numPrevious = numBaseStations;
+  memcpy(previous, baseStations, sizeof(previous));
+  numBaseStations = 0;
+
+  BLEScan* pScan = BLEDevice::getScan();
+  pScan->setActiveScan(false);  // The UUID is in the advertisement itself, no need for scan responses
+  BLEScanResults results = pScan->start(SCAN_DURATION_SEC, false);
+
+  for (int i = 0; i < results.getCount(); i++) {
+    BLEAdvertisedDevice device = results.getDevice(i);
+    if (!device.haveServiceUUID() || !device.isAdvertisingService(serviceUUID)) {
+      continue;
+    }
+
+    // Keep the strongest stations if more are in range than fit
+    int slot = numBaseStations;
+    if (numBaseStations == MAX_BASE_STATIONS) {
+      slot = 0;
+      for (int j = 1; j < numBaseStations; j++) {
+        if (baseStations[j].rssi < baseStations[slot].rssi) {
+          slot = j;
+        }
+      }
+      if (baseStations[slot].rssi >= device.getRSSI()) {
+        continue;
+      }
+    }
+    else {
+      numBaseStations++;
+    }
+
+    memcpy(baseStations[slot].address, *device.getAddress().getNative(), sizeof(esp_bd_addr_t));
+    baseStations[slot].addressType = device.getAddressType();
+    baseStations[slot].rssi = device.getRSSI();
+    baseStations[slot].failures = 0;
+    baseStations[slot].mtu = 0;
+    for (int j = 0; j < numPrevious; j++) {
+      if (memcmp(previous[j].address, baseStations[slot].address, sizeof(esp_bd_addr_t)) == 0) {
+        baseStations[slot].mtu = previous[j].mtu;
+      }
+    }
+    Serial.print(" - Found base station ");
+    Serial.print(device.getAddress().toString().c_str());
+    Serial.print(" rssi=");
+    Serial.println(device.getRSSI());
+  }
+
+  pScan->clearResults();  // Free the scan results memory
+}
+
+// Strongest base station that hasn't failed too many times in a row, or nullptr if there are none
+BaseStation* selectBaseStation() {
+  BaseStation* best = nullptr;
+  for (int i = 0; i < numBaseStations; i++) {
+    if (baseStations[i].failures >= BASE_STATION_MAX_FAILURES) {
+      continue;
+    }
+    if (best == nullptr || baseStations[i].rssi > best->rssi) {
+      best = &baseStations[i];
+    }
+  }
+  return best;
+}
 
 class MyClientCallback : public BLEClientCallbacks {
   void onConnect(BLEClient* pclient) {
@@ -42,102 +175,343 @@ class MyClientCallback : public BLEClientCallbacks {
   }
 };
 
-bool connectToServer() {
+// The client and its callbacks live for the whole run. Creating them per reading leaked both, as
+// nothing ever deleted them, and eventually ran the heap out
+static MyClientCallback clientCallbacks;
+
+// writeValue() doesn't say whether the base station took the write, and setMTU() returns before the
+// exchange is done. Both answers come from the GATT client events instead
+#define GATT_RESPONSE_TIMEOUT_MS  2000
+static QueueHandle_t writeStatusQueue;
+static QueueHandle_t mtuQueue;
+
+void onGattcEvent(esp_gattc_cb_event_t event, esp_gatt_if_t gattcIf, esp_ble_gattc_cb_param_t* param) {
+  if (event == ESP_GATTC_WRITE_CHAR_EVT) {
+    xQueueOverwrite(writeStatusQueue, &param->write.status);
+  }
+  else if (event == ESP_GATTC_CFG_MTU_EVT) {
+    uint16_t mtu = (param->cfg_mtu.status == ESP_GATT_OK) ? param->cfg_mtu.mtu : BLE_DEFAULT_MTU;
+    xQueueOverwrite(mtuQueue, &mtu);
+  }
+}
+
+void initBleClient() {
+  writeStatusQueue = xQueueCreate(1, sizeof(esp_gatt_status_t));
+  mtuQueue = xQueueCreate(1, sizeof(uint16_t));
+  BLEDevice::setCustomGattcHandler(onGattcEvent);
+  BLEDevice::init("");
+  pClient = BLEDevice::createClient();
+  pClient->setClientCallbacks(&clientCallbacks);
+}
+
+// The characteristic found on the last base station, so reconnecting to the same one skips discovery.
+// The client keeps the discovered services between connections
+static esp_bd_addr_t cachedCharAddress;
+static bool haveCachedChar = false;
+
+// Heap and connection counters, printed every HEAP_REPORT_INTERVAL_MS, or after each upload with
+// DEEP_SLEEP_MODE on. Every wake starts with a fresh heap then, so the change is what one upload
+// kept hold of. The counters are in RTC memory so they add up across wakes
+#define HEAP_REPORT_INTERVAL_MS   (60 * 1000)
+static uint32_t heapAtStart;
+RTC_DATA_ATTR static uint32_t numConnects;
+RTC_DATA_ATTR static uint32_t numDiscoveries;
+RTC_DATA_ATTR static uint32_t numCacheHits;
+RTC_DATA_ATTR static uint32_t numMtuExchanges;
+
+void reportHeap() {
+  uint32_t freeHeap = ESP.getFreeHeap();
+  Serial.print("Heap: free="); Serial.print(freeHeap);
+  Serial.print(" min="); Serial.print(ESP.getMinFreeHeap());
+  Serial.print(" largest="); Serial.print(ESP.getMaxAllocHeap());
+  Serial.print(" change="); Serial.print((int32_t)(freeHeap - heapAtStart));
+  Serial.print("  connects="); Serial.print(numConnects);
+  Serial.print(" discoveries="); Serial.print(numDiscoveries);
+  Serial.print(" cached="); Serial.print(numCacheHits);
+  Serial.print(" mtuExchanges="); Serial.println(numMtuExchanges);
+}
+
+bool discoverCharacteristic() {
+  numDiscoveries++;
+
+  // Obtain a reference to the service we are after in the remote BLE server.
+  BLERemoteService* pRemoteService = pClient->getService(serviceUUID);
+  if (pRemoteService == nullptr) {
+    Serial.print("Failed to find our service UUID: ");
+    Serial.println(serviceUUID.toString().c_str());
+    return false;
+  }
+  Serial.println(" - Found our service");
+
+  // Obtain a reference to the characteristic in the service of the remote BLE server.
+  pRemoteCharacteristic = pRemoteService->getCharacteristic(charUUID);
+  if (pRemoteCharacteristic == nullptr) {
+    Serial.print("Failed to find our characteristic UUID: ");
+    Serial.println(charUUID.toString().c_str());
+    return false;
+  }
+  Serial.println(" - Found our characteristic");
+  return true;
+}
+
+bool connectToServer(BaseStation* station) {
+    BLEAddress targetAddress(station->address);
     Serial.print("Forming a connection to ");
     // Serial.println(myDevice->getAddress().toString().c_str());
     Serial.println(targetAddress.toString().c_str());
-    
-    pClient  = BLEDevice::createClient();
-    Serial.println(" - Created client");
-
-    pClient->setClientCallbacks(new MyClientCallback());
 
     // Connect to the remove BLE Server.
     // pClient->connect(myDevice);  // if you pass BLEAdvertisedDevice instead of address, it will be recognized type of peer device address (public or private)
-    if (!pClient->connect(targetAddress)) {
+    if (!pClient->connect(targetAddress, station->addressType)) {
       return false;
     }
+    numConnects++;
     Serial.println(" - Connected to server");
-    pClient->setMTU(517); //set client to request maximum MTU from server (default is 23 otherwise)
-  
-    // Obtain a reference to the service we are after in the remote BLE server.
-    BLERemoteService* pRemoteService = pClient->getService(serviceUUID);
-    if (pRemoteService == nullptr) {
-      Serial.print("Failed to find our service UUID: ");
-      Serial.println(serviceUUID.toString().c_str());
-      pClient->disconnect();
-      return false;
-    }
-    Serial.println(" - Found our service");
 
+    if (haveCachedChar && memcmp(cachedCharAddress, station->address, sizeof(esp_bd_addr_t)) == 0) {
+      numCacheHits++;
+      return true;
+    }
 
-    // Obtain a reference to the characteristic in the service of the remote BLE server.
-    pRemoteCharacteristic = pRemoteService->getCharacteristic(charUUID);
-    if (pRemoteCharacteristic == nullptr) {
-      Serial.print("Failed to find our characteristic UUID: ");
-      Serial.println(charUUID.toString().c_str());
+    haveCachedChar = false;
+    if (!discoverCharacteristic()) {
       pClient->disconnect();
       return false;
     }
-    Serial.println(" - Found our characteristic");
+    memcpy(cachedCharAddress, station->address, sizeof(esp_bd_addr_t));
+    haveCachedChar = true;
 
     return true;
 }
 
-void reportReading(float vocReadingPpm, float temperature, uint8_t battLevel) {
+// The MTU exchange costs a round trip on every connection, so it is only done when the record won't
+// fit a default sized write, and not at all with a station that has already shown it can't go bigger.
+// Returns the MTU the record has to fit
+uint16_t negotiateMtu(BaseStation* station, size_t recordLen) {
+  if (recordLen <= BLE_DEFAULT_MTU - ATT_WRITE_HEADER_LEN) {
+    return pClient->getMTU();
+  }
+  if (station->mtu != 0 && station->mtu <= BLE_DEFAULT_MTU) {
+    return station->mtu;
+  }
+  uint16_t wanted = recordLen + ATT_WRITE_HEADER_LEN;
+  if (station->mtu > wanted) {
+    wanted = station->mtu;  // Ask for what it gave last time, one exchange still covers later records
+  }
+  if (wanted > BLE_MAX_MTU) {
+    wanted = BLE_MAX_MTU;
+  }
 
-  if (connectToServer()) {
-    int16_t temperatureInt;
-    if (temperature < (INT16_MIN / 10)) {
-      temperatureInt = INT16_MIN;
-    }
-    else if (temperature > (INT16_MAX / 10)) {
-      temperatureInt = INT16_MAX;
-    }
-    else {
-      temperatureInt = temperature * 10;
+  uint16_t mtu;
+  xQueueReset(mtuQueue);
+  if (pClient->setMTU(wanted) != ESP_OK) {
+    return pClient->getMTU();
+  }
+  numMtuExchanges++;
+  if (xQueueReceive(mtuQueue, &mtu, pdMS_TO_TICKS(GATT_RESPONSE_TIMEOUT_MS)) != pdTRUE) {
+    return pClient->getMTU();
+  }
+  station->mtu = mtu;
+  return mtu;
+}
+
+// Writes with a response and waits for it, false if the base station refused the write or never answered
+bool writeRecord(const uint8_t* record, size_t recordLen) {
+  esp_gatt_status_t status;
+  xQueueReset(writeStatusQueue);
+  pRemoteCharacteristic->writeValue((uint8_t*)record, recordLen, true);
+  if (xQueueReceive(writeStatusQueue, &status, pdMS_TO_TICKS(GATT_RESPONSE_TIMEOUT_MS)) != pdTRUE) {
+    return false;
+  }
+  return status == ESP_GATT_OK;
+}
+
+// Connects to the best base station and writes the record. The base station takes each write as a
+// whole record, so a record is never split across writes. Only returns true once the base station
+// has acknowledged it, anything else leaves the readings to go again
+bool uploadRecord(const uint8_t* record, size_t recordLen) {
+  BaseStation* station = selectBaseStation();
+  if (station == nullptr) {
+    // Nothing known or everything known has been failing, look again
+    scanForBaseStations();
+    station = selectBaseStation();
+    if (station == nullptr) {
+      Serial.println("No base station found");
+      return false;
     }
+  }
 
-    int32_t vocRounded = (int32_t)(vocReadingPpm * 10000);
-    uint32_t vocData = (uint32_t) vocRounded;
+  if (!connectToServer(station)) {
+    // Fail over to the next strongest station on the next reading
+    station->failures++;
+    Serial.println("Failed to connect");
+    return false;
+  }
+  station->failures = 0;
 
-    uint8_t dataMsg[] = {vocData >> 24, (vocData >> 16) & 0xFF, (vocData >> 8) & 0xFF, vocData & 0xFF,
-                        ((uint16_t)temperatureInt) >> 8, ((uint16_t)temperatureInt) & 0xFF, battLevel};
-    pRemoteCharacteristic->writeValue(dataMsg, sizeof(dataMsg), true);
-    Serial.println("Wrote characteristic");
+  uint16_t mtu = negotiateMtu(station, recordLen);
+  if (recordLen > mtu - ATT_WRITE_HEADER_LEN) {
+    // Encoded for more than the station gave, the next try is sized to what it did
+    Serial.println("Record doesn't fit the MTU");
+    pClient->disconnect();
+    return false;
+  }
+  if (!writeRecord(record, recordLen)) {
+    station->failures++;
+    Serial.println("Failed to write characteristic");
     pClient->disconnect();
+    return false;
+  }
+  Serial.println("Wrote characteristic");
+  pClient->disconnect();
+  return true;
+}
+
+// A reading in the units the base station takes
+struct Reading {
+  int32_t voc;              // mg/m^3 * 10000
+  int16_t temp;             // Degrees C * 10
+  uint8_t battLevel;
+  uint16_t seq;             // Counts up for every reading taken, so the receiver can spot gaps and repeats
+  uint32_t timeMs;          // When it was taken, sent as its age when it is uploaded
+};
+
+// Kept through deep sleep, like the system time that readings are stamped with
+RTC_DATA_ATTR static uint16_t nextReadingSeq;
+
+// The system time carries on through deep sleep, millis() starts again at every wake
+uint32_t clockMs() {
+  struct timeval now;
+  gettimeofday(&now, nullptr);
+  return (uint32_t) now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+Reading makeReading(float vocReadingPpm, float temperature, uint8_t battLevel) {
+  Reading reading;
+  reading.seq = nextReadingSeq++;
+  reading.timeMs = clockMs();
+  if (temperature < (INT16_MIN / 10)) {
+    reading.temp = INT16_MIN;
+  }
+  else if (temperature > (INT16_MAX / 10)) {
+    reading.temp = INT16_MAX;
   }
   else {
-    Serial.println("Failed to connect");
+    reading.temp = temperature * 10;
   }
+  reading.voc = (int32_t)(vocReadingPpm * 10000);
+  reading.battLevel = battLevel;
+  return reading;
 }
 
-void setup() {
-  Serial.begin(115200);
-  Serial.println("Starting Arduino BLE Client application...");
-  BLEDevice::init("");
+// Stamped batch record, the same format the CC2340 pucks send: | 0xB1 | Count | Sample 0 | Sample 1 | ... |
+// Each sample is the zig-zag varint delta of VOC, temperature, battery, sequence number and age (seconds
+// since it was taken) from the previous sample. Padded with a zero if it would be 7 bytes, that is the
+// untagged single reading format. Even a lone reading goes this way, the untagged format has no stamp
+#define RECORD_TAG_READING_BATCH_STAMPED  0xB1
+#define UNTAGGED_READING_LEN      7
 
-  // Enable I2C
-  Wire.begin(SDA0_Pin, SCL0_Pin);
-  
-  // Enable CCS811
-  ccs811.set_i2cdelay(50); // Needed for ESP8266 because it doesn't handle I2C clock stretch correctly
-  bool ok= ccs811.begin();
-  if( !ok ) Serial.println("setup: CCS811 begin FAILED");
+size_t putVarint(int32_t val, uint8_t* buf) {
+  uint32_t zz = ((uint32_t) val << 1) ^ (uint32_t) (val >> 31);
+  size_t idx = 0;
+  while (zz >= 0x80) {
+    buf[idx++] = (zz & 0x7F) | 0x80;
+    zz >>= 7;
+  }
+  buf[idx++] = zz;
+  return idx;
+}
 
-  // Print CCS811 versions
-  Serial.print("setup: hardware    version: "); Serial.println(ccs811.hardware_version(),HEX);
-  Serial.print("setup: bootloader  version: "); Serial.println(ccs811.bootloader_version(),HEX);
-  Serial.print("setup: application version: "); Serial.println(ccs811.application_version(),HEX);
-  
-  // Start measuring
-  ok= ccs811.start(CCS811_MODE_1SEC);
-  if( !ok ) Serial.println("setup: CCS811 start FAILED"); 
+size_t encodeBatch(const Reading* readings, int count, uint8_t* buf, size_t len, int* numEncoded) {
+  size_t idx = 2;
+  Reading prev = {0, 0, 0, 0, 0};
+  uint16_t prevAge = 0;
+  uint32_t now = clockMs();
+  *numEncoded = 0;
+  while (*numEncoded < count && *numEncoded < UINT8_MAX) {
+    const Reading* cur = &readings[*numEncoded];
+    uint32_t ageSec = (now - cur->timeMs) / 1000;
+    uint16_t age = (ageSec > UINT16_MAX) ? UINT16_MAX : ageSec;
+    uint8_t sample[5 + 3 + 2 + 3 + 3];
+    size_t sampleLen = 0;
+    sampleLen += putVarint((int32_t) ((uint32_t) cur->voc - (uint32_t) prev.voc), &sample[sampleLen]);
+    sampleLen += putVarint((int32_t) cur->temp - prev.temp, &sample[sampleLen]);
+    sampleLen += putVarint((int32_t) cur->battLevel - prev.battLevel, &sample[sampleLen]);
+    sampleLen += putVarint((int16_t) (uint16_t) (cur->seq - prev.seq), &sample[sampleLen]);
+    sampleLen += putVarint((int32_t) age - prevAge, &sample[sampleLen]);
+    if (idx + sampleLen > len) {
+      break;
+    }
+    memcpy(&buf[idx], sample, sampleLen);
+    idx += sampleLen;
+    prev = *cur;
+    prevAge = age;
+    (*numEncoded)++;
+  }
+  buf[0] = RECORD_TAG_READING_BATCH_STAMPED;
+  buf[1] = *numEncoded;
+  if (idx == UNTAGGED_READING_LEN) {
+    buf[idx++] = 0;
+  }
+  return idx;
+}
 
-  initTempSensor();
+// Registers the library doesn't cover, its start() has no way to set the interrupt bits
+#define CCS811_REG_MEAS_MODE      0x01
+#define CCS811_REG_ENV_DATA       0x05
+#define CCS811_REG_THRESHOLDS     0x10
+#define CCS811_MEAS_INT_DATARDY   0x08
+#define CCS811_MEAS_INT_THRESH    0x04
+
+bool ccs811WriteReg(uint8_t reg, const uint8_t* data, size_t len) {
+  digitalWrite(CCS811_NWAKE_PIN, LOW);
+  delayMicroseconds(50);
+  Wire.beginTransmission(CCS811_SLAVEADDR_0);
+  Wire.write(reg);
+  Wire.write(data, len);
+  bool ok = Wire.endTransmission() == 0;
+  digitalWrite(CCS811_NWAKE_PIN, HIGH);
+  delayMicroseconds(20);
+  return ok;
 }
 
-void loop() {
+// Starts measuring with nINT pulled low on every new reading, or with CCS811_THRESHOLD_WAKE only on
+// readings that cross a threshold
+bool startCcs811(uint8_t mode) {
+  uint8_t measMode = (mode << 4) | CCS811_MEAS_INT_DATARDY;
+#if CCS811_THRESHOLD_WAKE
+  uint8_t thresholds[] = {CCS811_THRESH_LOW_MED >> 8, CCS811_THRESH_LOW_MED & 0xFF,
+                          CCS811_THRESH_MED_HIGH >> 8, CCS811_THRESH_MED_HIGH & 0xFF, CCS811_THRESH_HYSTERESIS};
+  if (!ccs811WriteReg(CCS811_REG_THRESHOLDS, thresholds, sizeof(thresholds))) {
+    return false;
+  }
+  measMode |= CCS811_MEAS_INT_THRESH;
+#endif
+  return ccs811WriteReg(CCS811_REG_MEAS_MODE, &measMode, 1);
+}
+
+// Compensation the CCS811 applies, it assumes 25 C and 50 % until told otherwise. Only rewritten
+// when the temperature has moved, each write costs a wake of its I2C side
+RTC_DATA_ATTR static bool haveEnvData = false;
+RTC_DATA_ATTR static int16_t envTempX10;
+
+void updateEnvData(float temperature) {
+  int16_t tempX10 = temperature * 10;
+  if (haveEnvData && abs(tempX10 - envTempX10) < ENV_UPDATE_DEGC * 10) {
+    return;
+  }
+  // Both in 1/512ths, temperature offset by 25 C
+  uint16_t hum = ENV_HUMIDITY_PCT * 512;
+  uint16_t temp = (uint16_t) ((temperature + 25) * 512);
+  uint8_t envData[] = {hum >> 8, hum & 0xFF, temp >> 8, temp & 0xFF};
+  if (ccs811WriteReg(CCS811_REG_ENV_DATA, envData, sizeof(envData))) {
+    haveEnvData = true;
+    envTempX10 = tempX10;
+  }
+}
+
+// Reads the CCS811 and prints the result, true if there was a new reading
+bool takeReading(Reading* reading) {
   // Read
   uint16_t eco2, etvoc, errstat, raw;
   ccs811.read(&eco2,&etvoc,&errstat,&raw); 
@@ -154,7 +528,9 @@ void loop() {
     // Conversion from ppm to mg/m^3 src: http://niosh.dnacih.com/nioshdbs/calc.htm
     float intTemp = 0;
     temp_sensor_read_celsius(&intTemp);
-    reportReading(etvoc / (1000.0 * 24.45), intTemp, 3);
+    updateEnvData(intTemp);
+    *reading = makeReading(etvoc / (1000.0 * 24.45), intTemp, 3);
+    return true;
   } else if( errstat==CCS811_ERRSTAT_OK_NODATA ) {
     Serial.println("CCS811: waiting for (new) data");
   } else if( errstat & CCS811_ERRSTAT_I2CFAIL ) { 
@@ -163,6 +539,250 @@ void loop() {
     Serial.print("CCS811: errstat="); Serial.print(errstat,HEX); 
     Serial.print("="); Serial.println( ccs811.errstat_str(errstat) ); 
   }
+  return false;
+}
+
+// Readings waiting for an upload, and duty cycle counters. RTC memory survives deep sleep
+RTC_DATA_ATTR static Reading pendingReadings[RTC_READING_BUFFER];
+RTC_DATA_ATTR static int numPendingReadings;
+RTC_DATA_ATTR static int nextUploadAt = UPLOAD_BATCH_READINGS;
+RTC_DATA_ATTR static uint32_t numWakes;
+RTC_DATA_ATTR static uint32_t totalAwakeMs;
+RTC_DATA_ATTR static uint32_t numUploads;
+RTC_DATA_ATTR static uint32_t totalUploadMs;
+RTC_DATA_ATTR static uint32_t numDroppedReadings;
+
+void storeReading(const Reading& reading) {
+  if (numPendingReadings == RTC_READING_BUFFER) {
+    // Out of room, the newest readings are the ones worth keeping
+    memmove(&pendingReadings[0], &pendingReadings[1], (RTC_READING_BUFFER - 1) * sizeof(Reading));
+    numPendingReadings--;
+    numDroppedReadings++;
+  }
+  pendingReadings[numPendingReadings++] = reading;
+}
+
+// Longest record the station the next upload will go to takes in one write. Stations that have
+// negotiated before are held to what they gave, the rest are assumed to take a full batch
+size_t uploadRecordLimit() {
+  BaseStation* station = selectBaseStation();
+  if (station == nullptr || station->mtu == 0 || station->mtu - ATT_WRITE_HEADER_LEN > BATCH_RECORD_MAX) {
+    return BATCH_RECORD_MAX;
+  }
+  return station->mtu - ATT_WRITE_HEADER_LEN;
+}
+
+// Uploads what is pending in as few records as fit, keeping anything that didn't go
+void uploadPendingReadings() {
+  uint32_t start = millis();
+  initBleClient();
+  heapAtStart = ESP.getFreeHeap();
+
+  bool ok = true;
+  while (numPendingReadings > 0 && ok) {
+    uint8_t record[BATCH_RECORD_MAX];
+    int numEncoded;
+    size_t len = encodeBatch(pendingReadings, numPendingReadings, record, uploadRecordLimit(), &numEncoded);
+    ok = uploadRecord(record, len);
+    if (ok) {
+      numPendingReadings -= numEncoded;
+      memmove(&pendingReadings[0], &pendingReadings[numEncoded], numPendingReadings * sizeof(Reading));
+    }
+  }
+
+  // Try again after half a batch more rather than on every wake, a scan that finds nothing is expensive
+  nextUploadAt = ok ? UPLOAD_BATCH_READINGS : numPendingReadings + UPLOAD_BATCH_READINGS / 2;
+  if (nextUploadAt > RTC_READING_BUFFER) {
+    nextUploadAt = RTC_READING_BUFFER;
+  }
+  numUploads++;
+  totalUploadMs += millis() - start;
+  reportHeap();
+}
+
+// Brings the CCS811 back under control after a wake. begin() would reset it and restart its warm up
+void resumeCcs811() {
+  gpio_hold_dis((gpio_num_t) CCS811_NWAKE_PIN);
+  pinMode(CCS811_NWAKE_PIN, OUTPUT);
+  digitalWrite(CCS811_NWAKE_PIN, HIGH);
+  ccs811.set_i2cdelay(50);
+}
+
+void goToSleep() {
+  // nWAKE stays high through sleep so the sensor's I2C side stays asleep too
+  gpio_hold_en((gpio_num_t) CCS811_NWAKE_PIN);
+  gpio_deep_sleep_hold_en();
+  rtc_gpio_pullup_en((gpio_num_t) CCS811_NINT_PIN);
+  esp_sleep_enable_ext0_wakeup((gpio_num_t) CCS811_NINT_PIN, 0);
+  esp_sleep_enable_timer_wakeup((uint64_t) SLEEP_FALLBACK_SEC * 1000000);
+
+  uint32_t awakeMs = millis();
+  numWakes++;
+  totalAwakeMs += awakeMs;
+  Serial.print("Awake "); Serial.print(awakeMs); Serial.print(" ms, average ");
+  Serial.print(totalAwakeMs / numWakes); Serial.print(" ms over "); Serial.print(numWakes);
+  Serial.print(" wakes. Uploads="); Serial.print(numUploads);
+  if (numUploads) {
+    Serial.print(" average "); Serial.print(totalUploadMs / numUploads); Serial.print(" ms");
+  }
+  Serial.print(" pending="); Serial.print(numPendingReadings);
+  Serial.print(" dropped="); Serial.println(numDroppedReadings);
+  Serial.flush();
+  esp_deep_sleep_start();
+}
+
+// With DEEP_SLEEP_MODE off sampling and uploading run as separate tasks, so a slow or failing
+// upload never holds up the sensor. Readings go through a bounded queue, the oldest is dropped
+// when it is full. Uploads run on the core the BLE stack runs on, sampling on the other.
+// Deep sleep has nothing to split: the CCS811 measures on its own and holds nINT low until its
+// reading is taken, so a long upload only delays the next wake. The RTC buffer is the queue there,
+// failed uploads leave their readings in it, and goToSleep() prints its depth and drops
+#define READING_QUEUE_LEN         32
+// Readings the upload task takes off the queue for one connection
+#define UPLOAD_BATCH_MAX          16
+#define UPLOAD_BACKOFF_MIN_MS     1000
+#define UPLOAD_BACKOFF_MAX_MS     (60 * 1000)
+#define SAMPLING_TASK_CORE        1
+#define UPLOAD_TASK_CORE          0
+
+static QueueHandle_t readingQueue;
+static volatile uint32_t numQueued;
+static volatile uint32_t numQueueDrops;
+static volatile uint32_t numUploadRetries;
+static volatile uint32_t numUploaded;
+
+void reportPipeline() {
+  Serial.print("Pipeline: depth="); Serial.print(uxQueueMessagesWaiting(readingQueue));
+  Serial.print(" queued="); Serial.print(numQueued);
+  Serial.print(" uploaded="); Serial.print(numUploaded);
+  Serial.print(" dropped="); Serial.print(numQueueDrops);
+  Serial.print(" retries="); Serial.println(numUploadRetries);
+}
+
+// Given by nINT. The line stays low until the reading is read, so it only ever gives once per reading
+static SemaphoreHandle_t ccs811DataReady;
+
+void IRAM_ATTR onCcs811Interrupt() {
+  BaseType_t woken = pdFALSE;
+  xSemaphoreGiveFromISR(ccs811DataReady, &woken);
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
 
-  delay(3000);
+void samplingTask(void* arg) {
+  for (;;) {
+    // Times out if an edge was missed, a read that failed leaves nINT low with no new edge to come
+    xSemaphoreTake(ccs811DataReady, pdMS_TO_TICKS(AWAKE_FALLBACK_MS));
+
+    Reading reading;
+    if (!takeReading(&reading)) {
+      continue;
+    }
+    if (xQueueSend(readingQueue, &reading, 0) != pdTRUE) {
+      // Full, keep the newest
+      Reading dropped;
+      xQueueReceive(readingQueue, &dropped, 0);
+      xQueueSend(readingQueue, &reading, 0);
+      numQueueDrops++;
+    }
+    numQueued++;
+  }
+}
+
+void uploadTask(void* arg) {
+  Reading batch[UPLOAD_BATCH_MAX];
+  int count = 0;
+  uint32_t backoffMs = UPLOAD_BACKOFF_MIN_MS;
+
+  for (;;) {
+    if (count == 0) {
+      xQueueReceive(readingQueue, &batch[count++], portMAX_DELAY);
+    }
+    // Everything else that is waiting goes on the same connection
+    while (count < UPLOAD_BATCH_MAX && xQueueReceive(readingQueue, &batch[count], 0) == pdTRUE) {
+      count++;
+    }
+
+    int numSent;
+    uint8_t record[BATCH_RECORD_MAX];
+    size_t len = encodeBatch(batch, count, record, uploadRecordLimit(), &numSent);
+    bool ok = uploadRecord(record, len);
+
+    if (ok) {
+      count -= numSent;
+      memmove(&batch[0], &batch[numSent], count * sizeof(Reading));
+      numUploaded += numSent;
+      backoffMs = UPLOAD_BACKOFF_MIN_MS;
+    }
+    else {
+      // Hold on to the readings, more collect in the queue while we wait
+      numUploadRetries++;
+      vTaskDelay(pdMS_TO_TICKS(backoffMs));
+      backoffMs = (backoffMs * 2 > UPLOAD_BACKOFF_MAX_MS) ? UPLOAD_BACKOFF_MAX_MS : backoffMs * 2;
+    }
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  bool coldBoot = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UNDEFINED;
+
+  // Enable I2C
+  Wire.begin(SDA0_Pin, SCL0_Pin);
+  initTempSensor();
+
+#if DEEP_SLEEP_MODE
+  if (!coldBoot) {
+    resumeCcs811();
+    Reading reading;
+    if (takeReading(&reading)) {
+      storeReading(reading);
+    }
+    if (numPendingReadings >= nextUploadAt) {
+      uploadPendingReadings();
+    }
+    goToSleep();
+  }
+#endif
+
+  Serial.println("Starting Arduino BLE Client application...");
+
+  // Enable CCS811
+  ccs811.set_i2cdelay(50); // Needed for ESP8266 because it doesn't handle I2C clock stretch correctly
+  bool ok= ccs811.begin();
+  if( !ok ) Serial.println("setup: CCS811 begin FAILED");
+
+  // Print CCS811 versions
+  Serial.print("setup: hardware    version: "); Serial.println(ccs811.hardware_version(),HEX);
+  Serial.print("setup: bootloader  version: "); Serial.println(ccs811.bootloader_version(),HEX);
+  Serial.print("setup: application version: "); Serial.println(ccs811.application_version(),HEX);
+  
+#if DEEP_SLEEP_MODE
+  // Start measuring, nINT wakes us
+  ok= startCcs811(SLEEP_CCS811_MODE);
+  if( !ok ) Serial.println("setup: CCS811 start FAILED"); 
+  goToSleep();
+#else
+  // Start measuring
+  ccs811DataReady = xSemaphoreCreateBinary();
+  pinMode(CCS811_NINT_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(CCS811_NINT_PIN), onCcs811Interrupt, FALLING);
+  ok= startCcs811(AWAKE_CCS811_MODE);
+  if( !ok ) Serial.println("setup: CCS811 start FAILED"); 
+
+  initBleClient();
+  heapAtStart = ESP.getFreeHeap();
+
+  readingQueue = xQueueCreate(READING_QUEUE_LEN, sizeof(Reading));
+  xTaskCreatePinnedToCore(samplingTask, "sampling", 4096, nullptr, 2, nullptr, SAMPLING_TASK_CORE);
+  xTaskCreatePinnedToCore(uploadTask, "upload", 8192, nullptr, 1, nullptr, UPLOAD_TASK_CORE);
+#endif
+}
+
+// Only runs with DEEP_SLEEP_MODE off, setup() never returns otherwise. The work is in the tasks
+void loop() {
+  delay(HEAP_REPORT_INTERVAL_MS);
+  reportHeap();
+  reportPipeline();
 }
@@ -0,0 +1,313 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "config_dist.h"
+
+#ifdef CONFIG_DIST_HOST
+#define CONFIG_LOCK()
+#define CONFIG_UNLOCK()
+#else
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static SemaphoreHandle_t config_mutex = NULL;
+#define CONFIG_LOCK()      xSemaphoreTake(config_mutex, portMAX_DELAY)
+#define CONFIG_UNLOCK()    xSemaphoreGive(config_mutex)
+#endif
+
+static const uint8_t every_puck[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+// A copy of the configuration being read, so staging a new one can't tear it
+typedef struct {
+    bool in_use;
+    uint16_t conn_id;
+    uint8_t status;
+    uint8_t position;
+    config_dist_entry_t entry;
+} config_session_t;
+
+static const config_dist_store_t *store = NULL;
+static config_dist_entry_t entries[CONFIG_DIST_MAX_ENTRIES];
+
+// Staging in progress, replaces the address's configuration when it ends
+static bool staging = false;
+static config_dist_entry_t stage;
+
+static config_session_t sessions[CONFIG_DIST_MAX_SESSIONS];
+static config_dist_stats_t dist_stats;
+
+static void put_u32(uint8_t *buf, uint32_t val)
+{
+    buf[0] = val >> 24;
+    buf[1] = val >> 16;
+    buf[2] = val >> 8;
+    buf[3] = val;
+}
+
+static uint32_t get_u32(const uint8_t *buf)
+{
+    return ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) | ((uint32_t) buf[2] << 8) | buf[3];
+}
+
+// Every TLV has to fit, the puck refuses the whole list otherwise
+static bool tlv_valid(const uint8_t *tlv, size_t len)
+{
+    size_t pos = 0;
+    while (pos < len) {
+        if (len - pos < 2 || len - pos - 2 < tlv[pos + 1]) {
+            return false;
+        }
+        pos += 2 + tlv[pos + 1];
+    }
+    return true;
+}
+
+static config_dist_entry_t *find_entry(const uint8_t *address)
+{
+    for (int i = 0; i < CONFIG_DIST_MAX_ENTRIES; i++) {
+        if (entries[i].in_use && memcmp(entries[i].address, address, sizeof(entries[i].address)) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Pick up whatever was staged before the last reset
+ *
+ * @return Number of configurations on offer
+ */
+int config_dist_init(const config_dist_store_t *config_store)
+{
+#ifndef CONFIG_DIST_HOST
+    if (config_mutex == NULL) {
+        config_mutex = xSemaphoreCreateMutex();
+    }
+#endif
+    CONFIG_LOCK();
+    store = config_store;
+    staging = false;
+    memset(sessions, 0, sizeof(sessions));
+    if (!store->load(store->ctx, entries, sizeof(entries))) {
+        memset(entries, 0, sizeof(entries));
+    }
+
+    int count = 0;
+    for (int i = 0; i < CONFIG_DIST_MAX_ENTRIES; i++) {
+        if (entries[i].in_use && (entries[i].len > CONFIG_DIST_MAX_TLV_LEN || !tlv_valid(entries[i].tlv, entries[i].len))) {
+            entries[i].in_use = false;
+        }
+        count += entries[i].in_use;
+    }
+    CONFIG_UNLOCK();
+    return count;
+}
+
+static uint8_t stage_end(void)
+{
+    if (!staging) {
+        return CONFIG_STATUS_NO_REQUEST;
+    }
+    staging = false;
+    if (!tlv_valid(stage.tlv, stage.len)) {
+        return CONFIG_STATUS_BAD_REQUEST;
+    }
+
+    config_dist_entry_t *entry = find_entry(stage.address);
+    if (stage.revision == 0) {
+        if (entry) {
+            entry->in_use = false;
+        }
+    }
+    else {
+        for (int i = 0; i < CONFIG_DIST_MAX_ENTRIES && entry == NULL; i++) {
+            if (!entries[i].in_use) {
+                entry = &entries[i];
+            }
+        }
+        if (entry == NULL) {
+            return CONFIG_STATUS_FULL;
+        }
+        *entry = stage;
+        entry->in_use = true;
+    }
+
+    // Handed out either way, it just won't survive a reset
+    return store->save(store->ctx, entries, sizeof(entries)) ? CONFIG_STATUS_OK : CONFIG_STATUS_STORE_FAILED;
+}
+
+/**
+ * @brief Handle a staging message off the UART link
+ *
+ * @return Length of the acknowledgement written to ack (CONFIG_STAGE_ACK_LEN), 0 if the message isn't one
+ */
+size_t config_dist_handle_stage_msg(const uint8_t *msg, size_t len, uint8_t *ack)
+{
+    if (len == 0 || msg[0] < RECORD_TAG_CONFIG_STAGE_BEGIN || msg[0] > RECORD_TAG_CONFIG_STAGE_END) {
+        return 0;
+    }
+
+    CONFIG_LOCK();
+    uint8_t status = CONFIG_STATUS_OK;
+    if (msg[0] == RECORD_TAG_CONFIG_STAGE_BEGIN && len == 11) {
+        memset(&stage, 0, sizeof(stage));
+        memcpy(stage.address, &msg[1], sizeof(stage.address));
+        stage.revision = get_u32(&msg[7]);
+        staging = true;
+    }
+    else if (msg[0] == RECORD_TAG_CONFIG_STAGE_WRITE && len >= 2) {
+        if (!staging) {
+            status = CONFIG_STATUS_NO_REQUEST;
+        }
+        else if (msg[1] != stage.len || len - 2 > (size_t) (CONFIG_DIST_MAX_TLV_LEN - stage.len)) {
+            status = CONFIG_STATUS_BAD_REQUEST;
+        }
+        else {
+            memcpy(&stage.tlv[stage.len], &msg[2], len - 2);
+            stage.len += len - 2;
+        }
+    }
+    else if (msg[0] == RECORD_TAG_CONFIG_STAGE_END && len == 1) {
+        status = stage_end();
+    }
+    else {
+        status = CONFIG_STATUS_BAD_REQUEST;
+    }
+
+    ack[0] = RECORD_TAG_CONFIG_STAGE_ACK;
+    ack[1] = status;
+    ack[2] = staging ? stage.len : 0;
+    CONFIG_UNLOCK();
+    return CONFIG_STAGE_ACK_LEN;
+}
+
+static config_session_t *find_session(uint16_t conn_id, bool create)
+{
+    config_session_t *free_slot = NULL;
+    for (int i = 0; i < CONFIG_DIST_MAX_SESSIONS; i++) {
+        if (sessions[i].in_use && sessions[i].conn_id == conn_id) {
+            return &sessions[i];
+        }
+        if (!sessions[i].in_use && free_slot == NULL) {
+            free_slot = &sessions[i];
+        }
+    }
+    if (create && free_slot != NULL) {
+        memset(free_slot, 0, sizeof(*free_slot));
+        free_slot->in_use = true;
+        free_slot->conn_id = conn_id;
+        return free_slot;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Handle a request written by a puck, the answer is returned by the reads that follow
+ *
+ * @return CONFIG_STATUS_*, also what the next read reports
+ */
+uint8_t config_dist_handle_request(uint16_t conn_id, const uint8_t *bda, const uint8_t *req, size_t len)
+{
+    CONFIG_LOCK();
+    config_session_t *session = find_session(conn_id, true);
+    if (session == NULL) {
+        CONFIG_UNLOCK();
+        return CONFIG_STATUS_BAD_REQUEST;
+    }
+
+    uint8_t status = CONFIG_STATUS_OK;
+    if (len != CONFIG_REQUEST_LEN || req[0] != RECORD_TAG_CONFIG_REQUEST) {
+        status = CONFIG_STATUS_BAD_REQUEST;
+    }
+    else {
+        dist_stats.requests++;
+        const config_dist_entry_t *entry = find_entry(bda);
+        if (entry == NULL) {
+            entry = find_entry(every_puck);
+        }
+        if (entry == NULL) {
+            status = CONFIG_STATUS_NONE;
+        }
+        else if (entry->revision == get_u32(&req[1])) {
+            dist_stats.up_to_date++;
+            status = CONFIG_STATUS_UP_TO_DATE;
+        }
+        else {
+            dist_stats.sent++;
+            session->entry = *entry;
+            session->position = 0;
+        }
+    }
+    session->status = status;
+    CONFIG_UNLOCK();
+    return status;
+}
+
+/**
+ * @brief Build the response to a read of the characteristic by a puck that made a request
+ *
+ * @return Length of the response, at most max_len
+ */
+size_t config_dist_read(uint16_t conn_id, uint8_t *buf, size_t max_len)
+{
+    CONFIG_LOCK();
+    config_session_t *session = find_session(conn_id, false);
+    size_t len = 0;
+    buf[len++] = RECORD_TAG_CONFIG_DATA;
+    if (session == NULL || session->status != CONFIG_STATUS_OK) {
+        buf[len++] = session ? session->status : CONFIG_STATUS_NO_REQUEST;
+        if (session) {
+            session->in_use = false;
+        }
+    }
+    else {
+        const config_dist_entry_t *entry = &session->entry;
+        size_t chunk = max_len - CONFIG_DATA_HEADER_LEN;
+        if (chunk > (size_t) (entry->len - session->position)) {
+            chunk = entry->len - session->position;
+        }
+        buf[len++] = CONFIG_STATUS_OK;
+        put_u32(&buf[len], entry->revision);
+        len += 4;
+        buf[len++] = session->position;
+        buf[len++] = entry->len;
+        memcpy(&buf[len], &entry->tlv[session->position], chunk);
+        len += chunk;
+        session->position += chunk;
+        if (session->position == entry->len) {
+            session->in_use = false;
+        }
+    }
+    CONFIG_UNLOCK();
+    return len;
+}
+
+/**
+ * @brief Whether the connection is part way through reading a configuration, its reads are answered by config_dist_read
+ */
+bool config_dist_has_session(uint16_t conn_id)
+{
+    CONFIG_LOCK();
+    bool found = find_session(conn_id, false) != NULL;
+    CONFIG_UNLOCK();
+    return found;
+}
+
+void config_dist_disconnect(uint16_t conn_id)
+{
+    CONFIG_LOCK();
+    config_session_t *session = find_session(conn_id, false);
+    if (session) {
+        session->in_use = false;
+    }
+    CONFIG_UNLOCK();
+}
+
+void config_dist_get_stats(config_dist_stats_t *stats)
+{
+    CONFIG_LOCK();
+    *stats = dist_stats;
+    CONFIG_UNLOCK();
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Settings for the pucks (report thresholds, readings per upload and so on, see puck_config.h on the
+// puck for the list). A configuration is staged here over the UART link, either for one puck or for
+// every puck, and each puck pulls it through the upload characteristic during its own uploads, the
+// same way firmware updates are handed out by ota_dist. Staged configurations are kept in NVS.
+//
+// Request (written by the puck, 5 bytes so it can't be mistaken for a reading):
+//   | 0xD8 | Revision held (4) |
+// Response (each read after the request returns the next part, as big as the MTU allows):
+//   | 0xD9 | Status | Revision (4) | Offset (1) | Total length (1) | TLVs ... |
+//   | 0xD9 | Status |                                                           when the status isn't OK
+// The TLVs are | Type | Length | Value |, the whole list replaces whatever the puck had, so anything
+// left out goes back to the puck's defaults. A puck that already holds the revision is told it's up to
+// date. A configuration staged for a puck's address takes precedence over one for every puck.
+#define RECORD_TAG_CONFIG_REQUEST   0xD8
+#define RECORD_TAG_CONFIG_DATA      0xD9
+
+#define CONFIG_STATUS_OK            0
+#define CONFIG_STATUS_UP_TO_DATE    1
+#define CONFIG_STATUS_NONE          2   // Nothing staged for this puck
+#define CONFIG_STATUS_BAD_REQUEST   3
+#define CONFIG_STATUS_NO_REQUEST    4   // Read without a request before it
+#define CONFIG_STATUS_FULL          5   // No room for another puck's configuration
+#define CONFIG_STATUS_STORE_FAILED  6
+
+#define CONFIG_REQUEST_LEN          5
+#define CONFIG_DATA_HEADER_LEN      8
+
+// Staging messages, sent over the UART link with id COMM_ID_CONFIG (payloads of at most 20 bytes):
+//   | 0xE8 | Puck address (6) | Revision (4) |     Begin, the address as the base station logs it, FF:FF:FF:FF:FF:FF for every puck
+//   | 0xE9 | Offset (1) | TLVs (up to 18) |        Write, has to continue exactly where the last one ended
+//   | 0xEA |                                       End, checks the TLVs and hands them out. Revision 0 withdraws
+//                                                  the address's configuration instead, pucks keep what they have.
+// Each is answered with | 0xEB | Status | Next offset (1) |
+#define RECORD_TAG_CONFIG_STAGE_BEGIN   0xE8
+#define RECORD_TAG_CONFIG_STAGE_WRITE   0xE9
+#define RECORD_TAG_CONFIG_STAGE_END     0xEA
+#define RECORD_TAG_CONFIG_STAGE_ACK     0xEB
+#define CONFIG_STAGE_ACK_LEN            3
+#define COMM_ID_CONFIG                  0xFD
+
+// Longest TLV list, matches PUCK_CONFIG_MAX_TLV_LEN
+#define CONFIG_DIST_MAX_TLV_LEN     48
+// Pucks with a configuration of their own, plus the one for every puck
+#define CONFIG_DIST_MAX_ENTRIES     8
+// Concurrent puck connections, matches CONFIG_BT_ACL_CONNECTIONS
+#define CONFIG_DIST_MAX_SESSIONS    4
+
+typedef struct {
+    bool in_use;
+    uint8_t address[6];
+    uint32_t revision;
+    uint8_t len;
+    uint8_t tlv[CONFIG_DIST_MAX_TLV_LEN];
+} config_dist_entry_t;
+
+// Where the staged configurations are kept, as one blob
+typedef struct {
+    bool (*load)(void *ctx, config_dist_entry_t *entries, size_t len);
+    bool (*save)(void *ctx, const config_dist_entry_t *entries, size_t len);
+    void *ctx;
+} config_dist_store_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t sent;              // Requests answered with a configuration
+    uint32_t up_to_date;
+} config_dist_stats_t;
+
+// Returns how many configurations were picked up from the store
+int config_dist_init(const config_dist_store_t *store);
+size_t config_dist_handle_stage_msg(const uint8_t *msg, size_t len, uint8_t *ack);
+
+uint8_t config_dist_handle_request(uint16_t conn_id, const uint8_t *bda, const uint8_t *req, size_t len);
+size_t config_dist_read(uint16_t conn_id, uint8_t *buf, size_t max_len);
+bool config_dist_has_session(uint16_t conn_id);
+void config_dist_disconnect(uint16_t conn_id);
+void config_dist_get_stats(config_dist_stats_t *stats);
@@ -24,8 +24,13 @@
 #include "esp_system.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 #include "esp_bt.h"
 #include "uart_tx.h"  // Custom API for init and transmit over UART on the ESP32
+#include "reading_codec.h"
+#include "ota_dist.h"
+#include "config_dist.h"
+#include "esp_partition.h"
 
 #include "esp_gap_ble_api.h"
 #include "esp_gatts_api.h"
@@ -83,6 +88,369 @@ static void gatts_profile_b_event_handler(esp_gatts_cb_event_t event, esp_gatt_i
  */
 uint8_t charData[ATT_DATA_BUF_MAX_SIZE];
 
+// Length of a plain reading written by a puck (Bytes 0-6 above)
+#define PUCK_READING_LEN            7
+
+/**
+ * @brief Pucks periodically append send phase stats records to their upload connection.
+ *        These are never 7 bytes long, which is how they are told apart from readings.
+ *
+ *        | Byte 0 | Byte 1 | Bytes 2-3 | Bytes 4-5 | Bytes 6-7 | Bytes 8-9 | Bytes 10-11 | Bytes 12-19 |
+ *           Tag     Phase     Count      Failures     Min ms     Mean ms      Max ms      Histogram
+ *          (0xF0)                                                                     (<32ms .. >=2048ms)
+ */
+#define RECORD_TAG_PHASE_STATS      0xF0
+#define PHASE_STATS_RECORD_LEN      20
+#define PHASE_STATS_NUM_BUCKETS     8
+
+/**
+ * @brief The upload PHY the puck picked and why, sent along with the phase stats. The switch counts
+ *        go back to the puck's last reset, the reasons are strong signal, weak signal, failures,
+ *        unsupported and new base station.
+ *
+ *        | Byte 0 | Byte 1 | Byte 2 | Byte 3 | Byte 4 | Byte 5 |  Byte 6   | Bytes 7-16  |
+ *           Tag     Mode     Last     Last     RSSI     Fail   Unsupported   Switches
+ *          (0xF1)            from    reason   (dBm)   (/255)   (mode bits)  (2 per reason)
+ */
+#define RECORD_TAG_PHY_STATS        0xF1
+#define PHY_STATS_RECORD_LEN        17
+
+/**
+ * @brief Capture log downloads from a puck, streamed as chunks of its flash records.
+ *        They are printed as CAPTURE lines for the capture_replay tool to reassemble.
+ *
+ *        | Byte 0 | Bytes 1-2 | Bytes 3-19 |        | Byte 0 | Bytes 1-2 | Bytes 3-6 | Bytes 7-10 |
+ *           Tag      Chunk      Record                  Tag      Chunks     Records    Records
+ *          (0xC0)               stream                 (0xC1)     sent       sent       lost
+ */
+#define RECORD_TAG_CAPTURE_CHUNK    0xC0
+#define RECORD_TAG_CAPTURE_END      0xC1
+#define CAPTURE_CHUNK_HEADER_LEN    3
+#define CAPTURE_END_RECORD_LEN      11
+
+static void log_capture_record(const esp_bd_addr_t bda, const uint8_t *record, uint16_t len)
+{
+    if (record[0] == RECORD_TAG_CAPTURE_END) {
+        if (len != CAPTURE_END_RECORD_LEN) {
+            ESP_LOGW(GATTS_TAG, "Capture end record from 0x%02X has bad length %d", bda[5], len);
+            return;
+        }
+        ESP_LOGI(GATTS_TAG, "CAPTURE_END %02X %u %" PRIu32 " %" PRIu32, bda[5],
+                 (record[1] << 8) | record[2],
+                 ((uint32_t) record[3] << 24) | (record[4] << 16) | (record[5] << 8) | record[6],
+                 ((uint32_t) record[7] << 24) | (record[8] << 16) | (record[9] << 8) | record[10]);
+        return;
+    }
+
+    if (len <= CAPTURE_CHUNK_HEADER_LEN) {
+        ESP_LOGW(GATTS_TAG, "Capture chunk from 0x%02X has bad length %d", bda[5], len);
+        return;
+    }
+    char hex[2 * GATTS_DEMO_CHAR_VAL_LEN_MAX + 1];
+    int hex_len = 0;
+    for (int i = CAPTURE_CHUNK_HEADER_LEN; i < len && hex_len + 2 < (int) sizeof(hex); i++) {
+        hex_len += snprintf(&hex[hex_len], sizeof(hex) - hex_len, "%02X", record[i]);
+    }
+    ESP_LOGI(GATTS_TAG, "CAPTURE %02X %u %s", bda[5], (record[1] << 8) | record[2], hex);
+}
+
+// Batches carry the 0-3 battery level, metrics records a percentage. The lowest percentage of the
+// puck's band for that level decodes back to the same level
+static uint8_t battery_level_pct(uint8_t level)
+{
+    static const uint8_t band_pct[] = {0, 5, 20, 50};
+    return band_pct[(level < sizeof(band_pct)) ? level : sizeof(band_pct) - 1];
+}
+
+static void forward_reading_batch(const esp_bd_addr_t bda, const uint8_t *record, uint16_t len)
+{
+    static puck_reading_t readings[READING_BATCH_MAX_COUNT];
+    bool stamped;
+    int count = reading_codec_decode_batch(record, len, readings, READING_BATCH_MAX_COUNT, &stamped);
+    if (count < 0) {
+        ESP_LOGW(GATTS_TAG, "Malformed reading batch from 0x%02X (len %d)", bda[5], len);
+        return;
+    }
+
+    ESP_LOGI(GATTS_TAG, "Reading batch from 0x%02X: %d readings in %d bytes", bda[5], count, len);
+    for (int i = 0; i < count; i++) {
+        reading_codec_encode_legacy(&readings[i], charData);
+        if (stamped) {
+            // The 7 byte format has nowhere for the stamp, so these go down as metrics records
+            uint8_t metrics[READING_METRICS_MAX_SIZE + 1];
+            readings[i].battery_pct = battery_level_pct(readings[i].battery_level);
+            size_t metrics_len = reading_codec_encode_metrics(&readings[i], READING_FIELDS_LEGACY | READING_FIELD_STAMP, metrics);
+            comm_tx_msg(bda[5], metrics, metrics_len);
+        }
+        else {
+            comm_tx_msg(bda[5], charData, PUCK_READING_LEN);
+        }
+    }
+}
+
+static void forward_reading_metrics(const esp_bd_addr_t bda, uint8_t *record, uint16_t len)
+{
+    puck_reading_t reading;
+    int fields = reading_codec_decode_metrics(record, len, &reading);
+    if (fields < 0) {
+        ESP_LOGW(GATTS_TAG, "Malformed metrics record from 0x%02X (len %d)", bda[5], len);
+        return;
+    }
+
+    // Readers of the characteristic only know the 7 byte format, keep it current when the record has those fields
+    // It has no status either, so it only ever holds a good reading
+    bool valid = !(fields & READING_FIELD_STATUS) || reading.status == READING_STATUS_OK;
+    if (!valid) {
+        ESP_LOGI(GATTS_TAG, "Reading from 0x%02X has status %d", bda[5], reading.status);
+    }
+    if ((fields & READING_FIELDS_LEGACY) == READING_FIELDS_LEGACY && valid) {
+        reading_codec_encode_legacy(&reading, charData);
+    }
+
+    // The app decodes the mask itself, so the record goes down untouched
+    comm_tx_msg(bda[5], record, len);
+}
+
+static const char *phase_stats_names[] = {"idle", "connect", "srv discover", "chr discover", "write", "disconnect", "scan", "ota"};
+
+static void log_phase_stats(const esp_bd_addr_t bda, const uint8_t *record, uint16_t len)
+{
+    if (len != PHASE_STATS_RECORD_LEN) {
+        ESP_LOGW(GATTS_TAG, "Phase stats record from 0x%02X has bad length %d", bda[5], len);
+        return;
+    }
+
+    uint8_t phase = record[1];
+    const char *phase_name = (phase < sizeof(phase_stats_names) / sizeof(phase_stats_names[0])) ? phase_stats_names[phase] : "unknown";
+    const uint8_t *hist = &record[12];
+    ESP_LOGI(GATTS_TAG, "Phase stats 0x%02X %-12s n=%u fail=%u min=%ums mean=%ums max=%ums hist=[%u %u %u %u %u %u %u %u]",
+             bda[5], phase_name,
+             (record[2] << 8) | record[3], (record[4] << 8) | record[5],
+             (record[6] << 8) | record[7], (record[8] << 8) | record[9], (record[10] << 8) | record[11],
+             hist[0], hist[1], hist[2], hist[3], hist[4], hist[5], hist[6], hist[7]);
+}
+
+static const char *phy_stats_modes[] = {"2M", "1M", "Coded S2", "Coded S8"};
+static const char *phy_stats_reasons[] = {"none", "strong signal", "weak signal", "failures", "unsupported", "new base station"};
+
+static void log_phy_stats(const esp_bd_addr_t bda, const uint8_t *record, uint16_t len)
+{
+    if (len != PHY_STATS_RECORD_LEN) {
+        ESP_LOGW(GATTS_TAG, "PHY stats record from 0x%02X has bad length %d", bda[5], len);
+        return;
+    }
+
+    const int num_modes = sizeof(phy_stats_modes) / sizeof(phy_stats_modes[0]);
+    const int num_reasons = sizeof(phy_stats_reasons) / sizeof(phy_stats_reasons[0]);
+    const char *mode = (record[1] < num_modes) ? phy_stats_modes[record[1]] : "unknown";
+    const char *last_from = (record[2] < num_modes) ? phy_stats_modes[record[2]] : "unknown";
+    const char *last_reason = (record[3] < num_reasons) ? phy_stats_reasons[record[3]] : "unknown";
+    const uint8_t *sw = &record[7];
+    ESP_LOGI(GATTS_TAG, "PHY stats 0x%02X %s (last from %s: %s) rssi=%ddBm fail=%u/255 unsupported=0x%02X "
+             "switches strong=%u weak=%u failures=%u unsupported=%u new=%u",
+             bda[5], mode, last_from, last_reason, (int8_t) record[4], record[5], record[6],
+             (sw[0] << 8) | sw[1], (sw[2] << 8) | sw[3], (sw[4] << 8) | sw[5], (sw[6] << 8) | sw[7], (sw[8] << 8) | sw[9]);
+}
+
+/**
+ * @brief Puck firmware images are staged in their own data partition (see partitions.csv),
+ *        and handed out to the pucks by ota_dist.
+ */
+#define OTA_STAGE_PARTITION_SUBTYPE 0x40
+#define OTA_STAGE_PARTITION_LABEL   "puck_ota"
+
+static bool ota_partition_read(void *ctx, uint32_t offset, void *buf, size_t len)
+{
+    return esp_partition_read((const esp_partition_t *) ctx, offset, buf, len) == ESP_OK;
+}
+
+static bool ota_partition_write(void *ctx, uint32_t offset, const void *buf, size_t len)
+{
+    return esp_partition_write((const esp_partition_t *) ctx, offset, buf, len) == ESP_OK;
+}
+
+static bool ota_partition_erase(void *ctx, uint32_t offset, size_t len)
+{
+    return esp_partition_erase_range((const esp_partition_t *) ctx, offset, len) == ESP_OK;
+}
+
+static ota_dist_store_t ota_store = {
+    .read = ota_partition_read,
+    .write = ota_partition_write,
+    .erase = ota_partition_erase,
+};
+
+/**
+ * @brief MTU of each puck connection, OTA responses are as big as it allows
+ */
+static struct {
+    bool in_use;
+    uint16_t conn_id;
+    uint16_t mtu;
+} conn_mtus[OTA_DIST_MAX_SESSIONS];
+
+static void conn_mtu_set(uint16_t conn_id, uint16_t mtu)
+{
+    int free_slot = -1;
+    for (int i = 0; i < OTA_DIST_MAX_SESSIONS; i++) {
+        if (conn_mtus[i].in_use && conn_mtus[i].conn_id == conn_id) {
+            conn_mtus[i].mtu = mtu;
+            return;
+        }
+        if (!conn_mtus[i].in_use && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+    if (free_slot >= 0) {
+        conn_mtus[free_slot].in_use = true;
+        conn_mtus[free_slot].conn_id = conn_id;
+        conn_mtus[free_slot].mtu = mtu;
+    }
+}
+
+static uint16_t conn_mtu_get(uint16_t conn_id)
+{
+    for (int i = 0; i < OTA_DIST_MAX_SESSIONS; i++) {
+        if (conn_mtus[i].in_use && conn_mtus[i].conn_id == conn_id) {
+            return conn_mtus[i].mtu;
+        }
+    }
+    return ESP_GATT_DEF_BLE_MTU_SIZE;
+}
+
+static void conn_mtu_clear(uint16_t conn_id)
+{
+    for (int i = 0; i < OTA_DIST_MAX_SESSIONS; i++) {
+        if (conn_mtus[i].conn_id == conn_id) {
+            conn_mtus[i].in_use = false;
+        }
+    }
+}
+
+static void handle_ota_request(const esp_bd_addr_t bda, uint16_t conn_id, const uint8_t *record, uint16_t len)
+{
+    // Reads answer whichever request came last
+    config_dist_disconnect(conn_id);
+    uint8_t status = ota_dist_handle_request(conn_id, record, len);
+    if (len >= 2 && record[1] == OTA_OP_QUERY) {
+        ESP_LOGI(GATTS_TAG, "OTA query from 0x%02X, status %d", bda[5], status);
+    }
+    else if (status != OTA_STATUS_OK) {
+        ESP_LOGW(GATTS_TAG, "OTA request 0x%02X from 0x%02X refused, status %d", len >= 2 ? record[1] : 0, bda[5], status);
+    }
+}
+
+static void handle_config_request(const esp_bd_addr_t bda, uint16_t conn_id, const uint8_t *record, uint16_t len)
+{
+    ota_dist_disconnect(conn_id);
+    uint8_t status = config_dist_handle_request(conn_id, bda, record, len);
+    ESP_LOGI(GATTS_TAG, "Config request from 0x%02X, status %d", bda[5], status);
+}
+
+static void handle_config_stage_msg(const uint8_t *msg, size_t len)
+{
+    uint8_t ack[CONFIG_STAGE_ACK_LEN];
+    size_t ack_len = config_dist_handle_stage_msg(msg, len, ack);
+    if (ack_len == 0) {
+        ESP_LOGW(GATTS_TAG, "Dropping a %d byte config message off the UART link", (int) len);
+        return;
+    }
+
+    if (msg[0] != RECORD_TAG_CONFIG_STAGE_WRITE || ack[1] != CONFIG_STATUS_OK) {
+        ESP_LOGI(GATTS_TAG, "Config staging message 0x%02X, status %d", msg[0], ack[1]);
+    }
+    comm_tx_msg(COMM_ID_CONFIG, ack, ack_len);
+}
+
+static bool ota_enabled = false;
+
+// Staging messages come from the WiFi server, everything else on the link is unexpected
+static void handle_comm_rx(uint8_t id, const uint8_t *msg, size_t len)
+{
+    if (id == COMM_ID_CONFIG) {
+        handle_config_stage_msg(msg, len);
+        return;
+    }
+
+    uint8_t ack[OTA_STAGE_ACK_LEN];
+    size_t ack_len = (id == COMM_ID_OTA && ota_enabled) ? ota_dist_handle_stage_msg(msg, len, ack) : 0;
+    if (ack_len == 0) {
+        ESP_LOGW(GATTS_TAG, "Dropping a %d byte message with id 0x%02X off the UART link", (int) len, id);
+        return;
+    }
+
+    if (msg[0] != RECORD_TAG_OTA_STAGE_WRITE || ack[1] != OTA_STATUS_OK) {
+        ESP_LOGI(GATTS_TAG, "OTA staging message 0x%02X, status %d, next offset %" PRIu32, msg[0], ack[1],
+                 ota_dist_stage_next_offset());
+    }
+    if (msg[0] == RECORD_TAG_OTA_STAGE_END && ack[1] == OTA_STATUS_OK) {
+        uint32_t version, size, crc;
+        ota_dist_get_image(&version, &size, &crc);
+        ESP_LOGI(GATTS_TAG, "Offering puck firmware version %" PRIu32 " (%" PRIu32 " bytes, CRC %08" PRIX32 ")", version, size, crc);
+    }
+    comm_tx_msg(COMM_ID_OTA, ack, ack_len);
+}
+
+static void ota_init(void)
+{
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, OTA_STAGE_PARTITION_SUBTYPE,
+                                                                OTA_STAGE_PARTITION_LABEL);
+    if (partition == NULL) {
+        ESP_LOGW(GATTS_TAG, "No %s partition, puck firmware updates are disabled", OTA_STAGE_PARTITION_LABEL);
+        return;
+    }
+
+    ota_store.ctx = (void *) partition;
+    ota_store.size = partition->size;
+    ota_store.sector_size = partition->erase_size;
+    if (ota_dist_init(&ota_store)) {
+        uint32_t version, size, crc;
+        ota_dist_get_image(&version, &size, &crc);
+        ESP_LOGI(GATTS_TAG, "Offering puck firmware version %" PRIu32 " (%" PRIu32 " bytes, CRC %08" PRIX32 ")", version, size, crc);
+    }
+    ota_enabled = true;
+}
+
+/**
+ * @brief Puck configurations are kept as one blob in NVS
+ */
+#define CONFIG_NVS_NAMESPACE        "puck_cfg"
+#define CONFIG_NVS_KEY              "entries"
+
+static bool config_nvs_load(void *ctx, config_dist_entry_t *entries, size_t len)
+{
+    nvs_handle_t handle;
+    if (nvs_open(CONFIG_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    size_t stored_len = len;
+    bool ok = nvs_get_blob(handle, CONFIG_NVS_KEY, entries, &stored_len) == ESP_OK && stored_len == len;
+    nvs_close(handle);
+    return ok;
+}
+
+static bool config_nvs_save(void *ctx, const config_dist_entry_t *entries, size_t len)
+{
+    nvs_handle_t handle;
+    if (nvs_open(CONFIG_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return false;
+    }
+    bool ok = nvs_set_blob(handle, CONFIG_NVS_KEY, entries, len) == ESP_OK && nvs_commit(handle) == ESP_OK;
+    nvs_close(handle);
+    return ok;
+}
+
+static const config_dist_store_t config_store = {
+    .load = config_nvs_load,
+    .save = config_nvs_save,
+};
+
+static void config_init(void)
+{
+    int count = config_dist_init(&config_store);
+    ESP_LOGI(GATTS_TAG, "Offering %d puck configuration(s)", count);
+}
+
 static uint8_t char1_str[] = {0x11,0x22,0x33};
 static esp_gatt_char_prop_t a_property = 0;
 static esp_gatt_char_prop_t b_property = 0;
@@ -102,7 +470,8 @@ static uint8_t adv_config_done = 0;
 static uint8_t raw_adv_data[] = {
         0x02, 0x01, 0x06,                  // Length 2, Data Type 1 (Flags), Data 1 (LE General Discoverable Mode, BR/EDR Not Supported)
         0x02, 0x0a, 0xeb,                  // Length 2, Data Type 10 (TX power leve), Data 2 (-21)
-        0x03, 0x03, 0xab, 0xcd,            // Length 3, Data Type 3 (Complete 16-bit Service UUIDs), Data 3 (UUID)
+        0x11, 0x07,                        // Length 17, Data Type 7 (Complete 128-bit Service UUIDs), Data 3 (Fridge Monitor UUID)
+        0x9D, 0xAC, 0x47, 0xCF, 0x03, 0x5F, 0xB7, 0x84, 0x69, 0x48, 0x90, 0xA4, 0xA6, 0xE0, 0x74, 0x19,
 };
 static uint8_t raw_scan_rsp_data[] = {     // Length 15, Data Type 9 (Complete Local Name), Data 1 (ESP_GATTS_DEMO)
         0x0f, 0x09, 0x45, 0x53, 0x50, 0x5f, 0x47, 0x41, 0x54, 0x54, 0x53, 0x5f, 0x44,
@@ -110,20 +479,16 @@ static uint8_t raw_scan_rsp_data[] = {     // Length 15, Data Type 9 (Complete L
 };
 #else
 
-static uint8_t adv_service_uuid128[32] = {
-    /* LSB <--------------------------------------------------------------------------------> MSB */
-    //first uuid, 16bit, [12],[13] is the value
-    0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0xEE, 0x00, 0x00, 0x00,
-    //second uuid, 32bit, [12], [13], [14], [15] is the value
-    0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00,
-};
+// Pucks scan for the Fridge Monitor service UUID to find base stations, so it has to be advertised
+static uint8_t adv_service_uuid128[16] = GATTS_SERVICE_UUID_TEST_A;
 
 // The length of adv data must be less than 31 bytes
 //static uint8_t test_manufacturer[TEST_MANUFACTURER_DATA_LEN] =  {0x12, 0x23, 0x45, 0x56};
 //adv data
+//The name is left to the scan response, the 128-bit UUID doesn't fit alongside it in 31 bytes
 static esp_ble_adv_data_t adv_data = {
     .set_scan_rsp = false,
-    .include_name = true,
+    .include_name = false,
     .include_txpower = false,
     .min_interval = 0x0006, //slave connection min interval, Time = min_interval * 1.25 msec
     .max_interval = 0x0010, //slave connection max interval, Time = max_interval * 1.25 msec
@@ -148,8 +513,8 @@ static esp_ble_adv_data_t scan_rsp_data = {
     .p_manufacturer_data =  NULL, //&test_manufacturer[0],
     .service_data_len = 0,
     .p_service_data = NULL,
-    .service_uuid_len = sizeof(adv_service_uuid128),
-    .p_service_uuid = adv_service_uuid128,
+    .service_uuid_len = 0,
+    .p_service_uuid = NULL,
     .flag = (ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
 };
 
@@ -386,9 +751,19 @@ static void gatts_profile_a_event_handler(esp_gatts_cb_event_t event, esp_gatt_i
         memset(&rsp, 0, sizeof(esp_gatt_rsp_t));
         rsp.attr_value.handle = param->read.handle;
 
-        // Filling the response value with the dynamically stored attribute value
-        rsp.attr_value.len = ATT_DATA_BUF_MAX_SIZE;
-        memcpy(rsp.attr_value.value, charData, ATT_DATA_BUF_MAX_SIZE);
+        if (config_dist_has_session(param->read.conn_id)) {
+            // A puck reading back the configuration it asked for
+            rsp.attr_value.len = config_dist_read(param->read.conn_id, rsp.attr_value.value, conn_mtu_get(param->read.conn_id) - 1);
+        }
+        else if (ota_dist_has_session(param->read.conn_id)) {
+            // A puck part way through a firmware transfer, reading back the answer to its last request
+            rsp.attr_value.len = ota_dist_read(param->read.conn_id, rsp.attr_value.value, conn_mtu_get(param->read.conn_id) - 1);
+        }
+        else {
+            // Filling the response value with the dynamically stored attribute value
+            rsp.attr_value.len = ATT_DATA_BUF_MAX_SIZE;
+            memcpy(rsp.attr_value.value, charData, ATT_DATA_BUF_MAX_SIZE);
+        }
         
         esp_ble_gatts_send_response(gatts_if, param->read.conn_id, param->read.trans_id,
                                     ESP_GATT_OK, &rsp);
@@ -399,13 +774,52 @@ static void gatts_profile_a_event_handler(esp_gatts_cb_event_t event, esp_gatt_i
         ESP_LOGI(GATTS_TAG, "GATT_WRITE_EVT, conn_id %d, trans_id %" PRIu32 ", handle %d", param->write.conn_id, param->write.trans_id, param->write.handle);
         if (!param->write.is_prep){
             ESP_LOGI(GATTS_TAG, "GATT_WRITE_EVT, value len %d, value :", param->write.len);
-            
-            // Always ensuring the new value being written overwrites what existed
-            // Saving the written value to the stored attribute data buffer
-            memcpy(charData, param->write.value, ATT_DATA_BUF_MAX_SIZE);
 
-            // Writing the message over UART connection - using the last byte of the MAC addr as the ID for now
-            comm_tx_msg(param->write.bda[5], charData, ATT_DATA_BUF_MAX_SIZE);
+            // Records are told apart by their tag before their length. A reading starts with the top byte of
+            // its TVOC, which never gets anywhere near the tags, so only an untagged 7 byte write is a reading
+            uint8_t tag = (param->write.len > 0) ? param->write.value[0] : 0;
+            switch (tag) {
+            case RECORD_TAG_PHASE_STATS:
+                // Stats are for us to log, they don't go down to the app
+                log_phase_stats(param->write.bda, param->write.value, param->write.len);
+                break;
+            case RECORD_TAG_PHY_STATS:
+                log_phy_stats(param->write.bda, param->write.value, param->write.len);
+                break;
+            case RECORD_TAG_CAPTURE_CHUNK:
+            case RECORD_TAG_CAPTURE_END:
+                // Capture downloads are only for offline tuning, they go to the log
+                log_capture_record(param->write.bda, param->write.value, param->write.len);
+                break;
+            case RECORD_TAG_READING_BATCH:
+            case RECORD_TAG_READING_BATCH_STAMPED:
+                // Unpack the batch so the UART link and app still see one reading at a time
+                forward_reading_batch(param->write.bda, param->write.value, param->write.len);
+                break;
+            case RECORD_TAG_READING_METRICS:
+                forward_reading_metrics(param->write.bda, param->write.value, param->write.len);
+                break;
+            case RECORD_TAG_OTA_REQUEST:
+                // Firmware transfers stay between us and the puck
+                handle_ota_request(param->write.bda, param->write.conn_id, param->write.value, param->write.len);
+                break;
+            case RECORD_TAG_CONFIG_REQUEST:
+                handle_config_request(param->write.bda, param->write.conn_id, param->write.value, param->write.len);
+                break;
+            default:
+                if (param->write.len == PUCK_READING_LEN) {
+                    // Always ensuring the new value being written overwrites what existed
+                    // Saving the written value to the stored attribute data buffer
+                    memcpy(charData, param->write.value, PUCK_READING_LEN);
+
+                    // Writing the message over UART connection - using the last byte of the MAC addr as the ID for now
+                    comm_tx_msg(param->write.bda[5], charData, PUCK_READING_LEN);
+                }
+                else if (param->write.handle != gl_profile_tab[PROFILE_A_APP_ID].descr_handle) {
+                    ESP_LOGW(GATTS_TAG, "Unknown %d byte write from 0x%02X, tag 0x%02X", param->write.len, param->write.bda[5], tag);
+                }
+                break;
+            }
 
             esp_log_buffer_hex(GATTS_TAG, param->write.value, param->write.len);
             if (gl_profile_tab[PROFILE_A_APP_ID].descr_handle == param->write.handle && param->write.len == 2){
@@ -454,6 +868,7 @@ static void gatts_profile_a_event_handler(esp_gatts_cb_event_t event, esp_gatt_i
         break;
     case ESP_GATTS_MTU_EVT:
         ESP_LOGI(GATTS_TAG, "ESP_GATTS_MTU_EVT, MTU %d", param->mtu.mtu);
+        conn_mtu_set(param->mtu.conn_id, param->mtu.mtu);
         break;
     case ESP_GATTS_UNREG_EVT:
         break;
@@ -543,6 +958,10 @@ static void gatts_profile_a_event_handler(esp_gatts_cb_event_t event, esp_gatt_i
     }
     case ESP_GATTS_DISCONNECT_EVT:
         ESP_LOGI(GATTS_TAG, "ESP_GATTS_DISCONNECT_EVT, disconnect reason 0x%x", param->disconnect.reason);
+        // A puck that drops part way through an update picks up where it left off next time
+        ota_dist_disconnect(param->disconnect.conn_id);
+        config_dist_disconnect(param->disconnect.conn_id);
+        conn_mtu_clear(param->disconnect.conn_id);
         esp_ble_gap_start_advertising(&adv_params);
         break;
     case ESP_GATTS_CONF_EVT:
@@ -802,5 +1221,10 @@ void app_main(void)
     // Initializing the UART (serial) communication link
     comm_tx_init();
 
+    // Staging puck firmware and configurations needs the UART link to be up
+    ota_init();
+    config_init();
+    comm_rx_init(handle_comm_rx);
+
     return;
 }
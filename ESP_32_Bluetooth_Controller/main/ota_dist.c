@@ -0,0 +1,502 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "ota_dist.h"
+
+// The staged image's header lives in the first sector of the store, the image itself starts on the next one
+// | Magic (4) | Version (4) | Size (4) | Image CRC (4) |, only written once the whole image has checked out
+#define OTA_HEADER_MAGIC    0x4F544131
+#define OTA_HEADER_LEN      16
+
+#ifdef OTA_DIST_HOST
+#define OTA_LOCK()
+#define OTA_UNLOCK()
+#else
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+// Requests come from the Bluetooth task, staging from the UART task
+static SemaphoreHandle_t ota_mutex = NULL;
+#define OTA_LOCK()      xSemaphoreTake(ota_mutex, portMAX_DELAY)
+#define OTA_UNLOCK()    xSemaphoreGive(ota_mutex)
+#endif
+
+enum ota_cursor_kind {
+    OTA_CURSOR_NONE = 0,
+    OTA_CURSOR_OFFER,
+    OTA_CURSOR_MAP,
+    OTA_CURSOR_DATA,
+    OTA_CURSOR_ERROR,
+};
+
+// What the next read on a connection returns
+typedef struct {
+    bool in_use;
+    uint16_t conn_id;
+    uint8_t kind;
+    uint8_t status;
+    uint32_t position;      // Block for a map, byte offset for data
+} ota_session_t;
+
+static const ota_dist_store_t *store = NULL;
+
+static bool published = false;
+static uint32_t image_version;
+static uint32_t image_size;
+static uint32_t image_crc;
+static uint32_t num_blocks;
+static uint32_t block_crcs[OTA_DIST_MAX_BLOCKS];
+
+// Staging in progress, nothing is offered until it ends
+static bool staging = false;
+static uint32_t stage_size;
+static uint32_t stage_crc;
+static uint32_t stage_version;
+static uint32_t stage_next;
+
+static ota_session_t sessions[OTA_DIST_MAX_SESSIONS];
+static ota_dist_stats_t dist_stats;
+
+static void put_u16(uint8_t *buf, uint16_t val)
+{
+    buf[0] = val >> 8;
+    buf[1] = val;
+}
+
+static void put_u32(uint8_t *buf, uint32_t val)
+{
+    buf[0] = val >> 24;
+    buf[1] = val >> 16;
+    buf[2] = val >> 8;
+    buf[3] = val;
+}
+
+static uint16_t get_u16(const uint8_t *buf)
+{
+    return (buf[0] << 8) | buf[1];
+}
+
+static uint32_t get_u32(const uint8_t *buf)
+{
+    return ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) | ((uint32_t) buf[2] << 8) | buf[3];
+}
+
+/**
+ * @brief CRC-32 (IEEE, as zlib), continued from crc. Start from 0.
+ */
+uint32_t ota_crc32(uint32_t crc, const void *buf, size_t len)
+{
+    const uint8_t *bytes = buf;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *bytes++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t image_offset(void)
+{
+    return store->sector_size;
+}
+
+// CRCs the staged image, and fills in the block table as it goes
+static bool scan_image(uint32_t size, uint32_t *crc)
+{
+    uint8_t buf[OTA_BLOCK_SIZE];
+    uint32_t blocks = (size + OTA_BLOCK_SIZE - 1) >> OTA_BLOCK_SHIFT;
+    if (blocks > OTA_DIST_MAX_BLOCKS || image_offset() + size > store->size) {
+        return false;
+    }
+
+    *crc = 0;
+    for (uint32_t block = 0; block < blocks; block++) {
+        uint32_t offset = block << OTA_BLOCK_SHIFT;
+        size_t len = (size - offset < OTA_BLOCK_SIZE) ? size - offset : OTA_BLOCK_SIZE;
+        if (!store->read(store->ctx, image_offset() + offset, buf, len)) {
+            return false;
+        }
+        block_crcs[block] = ota_crc32(0, buf, len);
+        *crc = ota_crc32(*crc, buf, len);
+    }
+    num_blocks = blocks;
+    return true;
+}
+
+// Every session was talking about the old image, they all have to start over
+static void reset_sessions(void)
+{
+    for (int i = 0; i < OTA_DIST_MAX_SESSIONS; i++) {
+        sessions[i].kind = OTA_CURSOR_NONE;
+    }
+}
+
+/**
+ * @brief Pick up whatever image was staged before the last reset
+ *
+ * @return Whether there is an image to offer
+ */
+bool ota_dist_init(const ota_dist_store_t *image_store)
+{
+#ifndef OTA_DIST_HOST
+    if (ota_mutex == NULL) {
+        ota_mutex = xSemaphoreCreateMutex();
+    }
+#endif
+    OTA_LOCK();
+    store = image_store;
+    published = false;
+    staging = false;
+    memset(sessions, 0, sizeof(sessions));
+
+    uint8_t header[OTA_HEADER_LEN];
+    if (store->read(store->ctx, 0, header, sizeof(header)) && get_u32(&header[0]) == OTA_HEADER_MAGIC) {
+        uint32_t crc;
+        uint32_t size = get_u32(&header[8]);
+        if (scan_image(size, &crc) && crc == get_u32(&header[12])) {
+            image_version = get_u32(&header[4]);
+            image_size = size;
+            image_crc = crc;
+            published = true;
+        }
+    }
+    OTA_UNLOCK();
+    return published;
+}
+
+/**
+ * @brief Start staging a new image, withdrawing the one on offer
+ *
+ * @return OTA_STATUS_*
+ */
+uint8_t ota_dist_stage_begin(uint32_t size, uint32_t crc, uint32_t version)
+{
+    OTA_LOCK();
+    published = false;
+    staging = false;
+    reset_sessions();
+
+    uint8_t status = OTA_STATUS_OK;
+    uint32_t blocks = (size + OTA_BLOCK_SIZE - 1) >> OTA_BLOCK_SHIFT;
+    if (size == 0 || blocks > OTA_DIST_MAX_BLOCKS || image_offset() + size > store->size) {
+        status = OTA_STATUS_BAD_REQUEST;
+    }
+    else {
+        // The header sector goes too, so a reset part way through never offers a half written image
+        size_t erase_len = image_offset() + size;
+        erase_len = (erase_len + store->sector_size - 1) / store->sector_size * store->sector_size;
+        if (!store->erase(store->ctx, 0, erase_len)) {
+            status = OTA_STATUS_STORE_FAILED;
+        }
+        else {
+            staging = true;
+            stage_size = size;
+            stage_crc = crc;
+            stage_version = version;
+            stage_next = 0;
+        }
+    }
+    OTA_UNLOCK();
+    return status;
+}
+
+/**
+ * @brief Add the next part of the image being staged
+ *
+ * Writes have to come in order. One that repeats or skips ahead is refused, and the acknowledgement
+ * carries the offset the sender should continue from.
+ *
+ * @return OTA_STATUS_*
+ */
+uint8_t ota_dist_stage_write(uint32_t offset, const uint8_t *data, size_t len)
+{
+    OTA_LOCK();
+    uint8_t status = OTA_STATUS_OK;
+    if (!staging || offset != stage_next || len > stage_size - stage_next) {
+        status = staging ? OTA_STATUS_BAD_REQUEST : OTA_STATUS_NO_IMAGE;
+    }
+    else if (!store->write(store->ctx, image_offset() + offset, data, len)) {
+        status = OTA_STATUS_STORE_FAILED;
+    }
+    else {
+        stage_next += len;
+    }
+    OTA_UNLOCK();
+    return status;
+}
+
+/**
+ * @brief Check the staged image, and offer it to the pucks if it came through intact
+ *
+ * @return OTA_STATUS_*
+ */
+uint8_t ota_dist_stage_end(void)
+{
+    OTA_LOCK();
+    uint8_t status = OTA_STATUS_OK;
+    uint32_t crc;
+    if (!staging || stage_next != stage_size) {
+        status = staging ? OTA_STATUS_BAD_REQUEST : OTA_STATUS_NO_IMAGE;
+    }
+    else if (!scan_image(stage_size, &crc) || crc != stage_crc) {
+        // Nothing to salvage, the sender has to begin again
+        staging = false;
+        status = OTA_STATUS_STORE_FAILED;
+    }
+    else {
+        uint8_t header[OTA_HEADER_LEN];
+        put_u32(&header[0], OTA_HEADER_MAGIC);
+        put_u32(&header[4], stage_version);
+        put_u32(&header[8], stage_size);
+        put_u32(&header[12], crc);
+        staging = false;
+        if (!store->write(store->ctx, 0, header, sizeof(header))) {
+            status = OTA_STATUS_STORE_FAILED;
+        }
+        else {
+            image_version = stage_version;
+            image_size = stage_size;
+            image_crc = crc;
+            published = true;
+        }
+    }
+    OTA_UNLOCK();
+    return status;
+}
+
+uint32_t ota_dist_stage_next_offset(void)
+{
+    OTA_LOCK();
+    uint32_t next = staging ? stage_next : 0;
+    OTA_UNLOCK();
+    return next;
+}
+
+/**
+ * @brief Handle a staging message off the UART link
+ *
+ * @return Length of the acknowledgement written to ack (OTA_STAGE_ACK_LEN), 0 if the message isn't one
+ */
+size_t ota_dist_handle_stage_msg(const uint8_t *msg, size_t len, uint8_t *ack)
+{
+    if (len == 0) {
+        return 0;
+    }
+
+    uint8_t status;
+    if (msg[0] == RECORD_TAG_OTA_STAGE_BEGIN && len == 13) {
+        status = ota_dist_stage_begin(get_u32(&msg[1]), get_u32(&msg[5]), get_u32(&msg[9]));
+    }
+    else if (msg[0] == RECORD_TAG_OTA_STAGE_WRITE && len > 5) {
+        status = ota_dist_stage_write(get_u32(&msg[1]), &msg[5], len - 5);
+    }
+    else if (msg[0] == RECORD_TAG_OTA_STAGE_END && len == 1) {
+        status = ota_dist_stage_end();
+    }
+    else if (msg[0] >= RECORD_TAG_OTA_STAGE_BEGIN && msg[0] <= RECORD_TAG_OTA_STAGE_END) {
+        status = OTA_STATUS_BAD_REQUEST;
+    }
+    else {
+        return 0;
+    }
+
+    ack[0] = RECORD_TAG_OTA_STAGE_ACK;
+    ack[1] = status;
+    put_u32(&ack[2], ota_dist_stage_next_offset());
+    return OTA_STAGE_ACK_LEN;
+}
+
+static ota_session_t *find_session(uint16_t conn_id, bool create)
+{
+    ota_session_t *free_slot = NULL;
+    for (int i = 0; i < OTA_DIST_MAX_SESSIONS; i++) {
+        if (sessions[i].in_use && sessions[i].conn_id == conn_id) {
+            return &sessions[i];
+        }
+        if (!sessions[i].in_use && free_slot == NULL) {
+            free_slot = &sessions[i];
+        }
+    }
+    if (create && free_slot != NULL) {
+        memset(free_slot, 0, sizeof(*free_slot));
+        free_slot->in_use = true;
+        free_slot->conn_id = conn_id;
+        return free_slot;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Handle a request written by a puck, the answer is returned by the reads that follow
+ *
+ * @return OTA_STATUS_*, also what the next read reports if it isn't OTA_STATUS_OK
+ */
+uint8_t ota_dist_handle_request(uint16_t conn_id, const uint8_t *req, size_t len)
+{
+    OTA_LOCK();
+    ota_session_t *session = find_session(conn_id, true);
+    if (session == NULL) {
+        OTA_UNLOCK();
+        return OTA_STATUS_BAD_REQUEST;
+    }
+
+    uint8_t status = OTA_STATUS_OK;
+    uint8_t op = (len >= 2 && req[0] == RECORD_TAG_OTA_REQUEST) ? req[1] : 0;
+    if (op == OTA_OP_QUERY && len == 6) {
+        dist_stats.queries++;
+        if (!published) {
+            status = OTA_STATUS_NO_IMAGE;
+        }
+        else if (get_u32(&req[2]) >= image_version) {
+            status = OTA_STATUS_UP_TO_DATE;
+        }
+        else {
+            dist_stats.offers++;
+        }
+        // Even a puck that is up to date is told what's on offer
+        session->kind = OTA_CURSOR_OFFER;
+        session->status = status;
+    }
+    else if ((op == OTA_OP_MAP && len == 8) || (op == OTA_OP_READ && len == 10)) {
+        uint32_t position = (op == OTA_OP_MAP) ? get_u16(&req[6]) : get_u32(&req[6]);
+        uint32_t end = (op == OTA_OP_MAP) ? num_blocks : image_size;
+        if (!published || get_u32(&req[2]) != image_crc) {
+            dist_stats.stale_requests++;
+            status = published ? OTA_STATUS_STALE : OTA_STATUS_NO_IMAGE;
+        }
+        else if (position >= end) {
+            status = OTA_STATUS_BAD_REQUEST;
+        }
+        else {
+            session->kind = (op == OTA_OP_MAP) ? OTA_CURSOR_MAP : OTA_CURSOR_DATA;
+            session->position = position;
+        }
+    }
+    else {
+        status = OTA_STATUS_BAD_REQUEST;
+    }
+
+    if (status != OTA_STATUS_OK && session->kind != OTA_CURSOR_OFFER) {
+        session->kind = OTA_CURSOR_ERROR;
+        session->status = status;
+    }
+    OTA_UNLOCK();
+    return status;
+}
+
+/**
+ * @brief Build the response to a read of the characteristic by a puck that made a request
+ *
+ * @return Length of the response, at most max_len
+ */
+size_t ota_dist_read(uint16_t conn_id, uint8_t *buf, size_t max_len)
+{
+    OTA_LOCK();
+    ota_session_t *session = find_session(conn_id, false);
+    uint8_t kind = session ? session->kind : OTA_CURSOR_NONE;
+    size_t len = 0;
+
+    // The cursors were started on an image that has since been withdrawn
+    if ((kind == OTA_CURSOR_MAP || kind == OTA_CURSOR_DATA) && !published) {
+        kind = OTA_CURSOR_ERROR;
+        session->status = OTA_STATUS_STALE;
+    }
+
+    if (kind == OTA_CURSOR_OFFER) {
+        buf[len++] = RECORD_TAG_OTA_OFFER;
+        buf[len++] = session->status;
+        put_u32(&buf[len], published ? image_version : 0);
+        put_u32(&buf[len + 4], published ? image_size : 0);
+        put_u32(&buf[len + 8], published ? image_crc : 0);
+        len += 12;
+        buf[len++] = OTA_BLOCK_SHIFT;
+        session->kind = OTA_CURSOR_NONE;
+    }
+    else if (kind == OTA_CURSOR_MAP) {
+        dist_stats.map_reads++;
+        buf[len++] = RECORD_TAG_OTA_MAP;
+        put_u16(&buf[len], session->position);
+        len += 2;
+        while (len + 4 <= max_len && session->position < num_blocks) {
+            put_u32(&buf[len], block_crcs[session->position++]);
+            len += 4;
+        }
+        if (session->position == num_blocks) {
+            session->kind = OTA_CURSOR_NONE;
+        }
+    }
+    else if (kind == OTA_CURSOR_DATA) {
+        dist_stats.data_reads++;
+        size_t chunk = max_len - OTA_DATA_HEADER_LEN;
+        if (chunk > image_size - session->position) {
+            chunk = image_size - session->position;
+        }
+        buf[len++] = RECORD_TAG_OTA_DATA;
+        put_u32(&buf[len], session->position);
+        len += 4;
+        if (!store->read(store->ctx, image_offset() + session->position, &buf[len], chunk)) {
+            len = 0;
+            buf[len++] = RECORD_TAG_OTA_ERROR;
+            buf[len++] = OTA_STATUS_STORE_FAILED;
+        }
+        else {
+            len += chunk;
+            session->position += chunk;
+            dist_stats.bytes_served += chunk;
+            if (session->position == image_size) {
+                session->kind = OTA_CURSOR_NONE;
+            }
+        }
+    }
+    else {
+        buf[len++] = RECORD_TAG_OTA_ERROR;
+        buf[len++] = (kind == OTA_CURSOR_ERROR) ? session->status : OTA_STATUS_NO_REQUEST;
+        if (session) {
+            session->kind = OTA_CURSOR_NONE;
+        }
+    }
+    OTA_UNLOCK();
+    return len;
+}
+
+/**
+ * @brief Whether the connection has an OTA transfer going, its reads are answered by ota_dist_read
+ */
+bool ota_dist_has_session(uint16_t conn_id)
+{
+    OTA_LOCK();
+    bool found = find_session(conn_id, false) != NULL;
+    OTA_UNLOCK();
+    return found;
+}
+
+void ota_dist_disconnect(uint16_t conn_id)
+{
+    OTA_LOCK();
+    ota_session_t *session = find_session(conn_id, false);
+    if (session) {
+        session->in_use = false;
+    }
+    OTA_UNLOCK();
+}
+
+bool ota_dist_get_image(uint32_t *version, uint32_t *size, uint32_t *crc)
+{
+    OTA_LOCK();
+    bool valid = published;
+    *version = image_version;
+    *size = image_size;
+    *crc = image_crc;
+    OTA_UNLOCK();
+    return valid;
+}
+
+void ota_dist_get_stats(ota_dist_stats_t *stats)
+{
+    OTA_LOCK();
+    *stats = dist_stats;
+    OTA_UNLOCK();
+}
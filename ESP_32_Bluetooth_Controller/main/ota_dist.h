@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Firmware distribution to the pucks. A puck image is staged here (over the UART link, from the WiFi server),
+// then each puck pulls it through the same characteristic it uploads readings to, during its own upload
+// connections. Pucks are GATT clients and only ever talk to us while they have something to send, so the
+// transfer is driven entirely by the puck: it writes a request, then reads the characteristic for the answer.
+//
+// Requests (written by the puck, never 7 bytes long so they can't be mistaken for a reading):
+//   | 0xD0 | Query (0x01) | Running version (4) |
+//   | 0xD0 | Map (0x02)   | Image CRC (4) | First block (2) |
+//   | 0xD0 | Read (0x03)  | Image CRC (4) | Offset (4) |
+// Responses (each read of the characteristic after a request returns the next one, as big as the MTU allows):
+//   | 0xD1 | Status | Version (4) | Size (4) | Image CRC (4) | Block shift |     answers Query
+//   | 0xD2 | First block (2) | Block CRC (4) ... |                             answers Map, then continues
+//   | 0xD3 | Offset (4) | Data ... |                                           answers Read, then continues
+//   | 0xDF | Status |                                                         anything that went wrong
+// All big endian. The image CRC doubles as its id: a puck that asks for a different one gets OTA_STATUS_STALE,
+// and starts over with a query. Block CRCs let a puck skip every block it already has in its running image,
+// so a small change to the firmware only costs the blocks it touched.
+#define RECORD_TAG_OTA_REQUEST      0xD0
+#define RECORD_TAG_OTA_OFFER        0xD1
+#define RECORD_TAG_OTA_MAP          0xD2
+#define RECORD_TAG_OTA_DATA         0xD3
+#define RECORD_TAG_OTA_ERROR        0xDF
+
+#define OTA_OP_QUERY                0x01
+#define OTA_OP_MAP                  0x02
+#define OTA_OP_READ                 0x03
+
+#define OTA_STATUS_OK               0
+#define OTA_STATUS_NO_IMAGE         1   // Nothing staged, or staging in progress
+#define OTA_STATUS_UP_TO_DATE       2   // The puck already runs this version (or a newer one)
+#define OTA_STATUS_STALE            3   // The request names an image that isn't the one staged any more
+#define OTA_STATUS_BAD_REQUEST      4
+#define OTA_STATUS_NO_REQUEST       5   // Read without a request before it
+#define OTA_STATUS_STORE_FAILED     6
+
+#define OTA_OFFER_LEN               15
+#define OTA_MAP_HEADER_LEN          3
+#define OTA_DATA_HEADER_LEN         5
+// Smallest response that still makes progress, the default MTU (23) less the read response header
+#define OTA_MIN_RESPONSE_LEN        22
+
+// Blocks of 512 bytes, the granularity of the delta
+#define OTA_BLOCK_SHIFT             9
+#define OTA_BLOCK_SIZE              (1 << OTA_BLOCK_SHIFT)
+
+// Staging messages, sent over the UART link with id COMM_ID_OTA (payloads of at most 20 bytes):
+//   | 0xE0 | Size (4) | Image CRC (4) | Version (4) |     Begin, erases whatever was staged before
+//   | 0xE1 | Offset (4) | Data (up to 15) |              Write, has to continue exactly where the last one ended
+//   | 0xE2 |                                              End, checks the CRC and offers the image to pucks
+// Each is answered with | 0xE3 | Status | Next offset (4) |, so a sender that lost its place can pick up again
+#define RECORD_TAG_OTA_STAGE_BEGIN  0xE0
+#define RECORD_TAG_OTA_STAGE_WRITE  0xE1
+#define RECORD_TAG_OTA_STAGE_END    0xE2
+#define RECORD_TAG_OTA_STAGE_ACK    0xE3
+#define OTA_STAGE_ACK_LEN           6
+#define COMM_ID_OTA                 0xFE
+
+// Where the image is kept. Offsets are from the start of the region, erases are in whole sectors.
+typedef struct {
+    bool (*read)(void *ctx, uint32_t offset, void *buf, size_t len);
+    bool (*write)(void *ctx, uint32_t offset, const void *buf, size_t len);
+    bool (*erase)(void *ctx, uint32_t offset, size_t len);
+    size_t size;
+    size_t sector_size;
+    void *ctx;
+} ota_dist_store_t;
+
+// Concurrent puck connections, matches CONFIG_BT_ACL_CONNECTIONS
+#define OTA_DIST_MAX_SESSIONS       4
+// Largest image the block CRC table is sized for
+#define OTA_DIST_MAX_BLOCKS         1024
+
+typedef struct {
+    uint32_t queries;
+    uint32_t offers;            // Queries answered with an image to fetch
+    uint32_t map_reads;
+    uint32_t data_reads;
+    uint32_t bytes_served;
+    uint32_t stale_requests;
+} ota_dist_stats_t;
+
+uint32_t ota_crc32(uint32_t crc, const void *buf, size_t len);
+
+bool ota_dist_init(const ota_dist_store_t *store);
+uint8_t ota_dist_stage_begin(uint32_t size, uint32_t crc, uint32_t version);
+uint8_t ota_dist_stage_write(uint32_t offset, const uint8_t *data, size_t len);
+uint8_t ota_dist_stage_end(void);
+uint32_t ota_dist_stage_next_offset(void);
+size_t ota_dist_handle_stage_msg(const uint8_t *msg, size_t len, uint8_t *ack);
+
+uint8_t ota_dist_handle_request(uint16_t conn_id, const uint8_t *req, size_t len);
+size_t ota_dist_read(uint16_t conn_id, uint8_t *buf, size_t max_len);
+bool ota_dist_has_session(uint16_t conn_id);
+void ota_dist_disconnect(uint16_t conn_id);
+bool ota_dist_get_image(uint32_t *version, uint32_t *size, uint32_t *crc);
+void ota_dist_get_stats(ota_dist_stats_t *stats);
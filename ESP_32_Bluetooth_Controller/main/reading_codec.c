@@ -0,0 +1,211 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "reading_codec.h"
+
+static bool get_varint(const uint8_t *buf, size_t len, size_t *idx, int32_t *val)
+{
+    uint32_t zz = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (*idx >= len) {
+            return false;
+        }
+        uint8_t byte = buf[(*idx)++];
+        zz |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            // Undo the zig-zag
+            *val = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Expand a batch record written by a puck back into individual readings
+ *
+ * @return Number of readings decoded, or -1 if the record is malformed
+ */
+int reading_codec_decode_batch(const uint8_t *buf, size_t len, puck_reading_t *readings, size_t max_readings, bool *stamped)
+{
+    if (len < 2 || (buf[0] != RECORD_TAG_READING_BATCH && buf[0] != RECORD_TAG_READING_BATCH_STAMPED)) {
+        return -1;
+    }
+    *stamped = (buf[0] == RECORD_TAG_READING_BATCH_STAMPED);
+
+    size_t count = buf[1];
+    if (count > max_readings) {
+        return -1;
+    }
+
+    size_t idx = 2;
+    int32_t voc = 0, temp = 0, batt = 0, age = 0;
+    uint16_t seq = 0;
+    for (size_t i = 0; i < count; i++) {
+        int32_t d_voc, d_temp, d_batt, d_seq = 0, d_age = 0;
+        if (!get_varint(buf, len, &idx, &d_voc) ||
+            !get_varint(buf, len, &idx, &d_temp) ||
+            !get_varint(buf, len, &idx, &d_batt)) {
+            return -1;
+        }
+        if (*stamped && (!get_varint(buf, len, &idx, &d_seq) || !get_varint(buf, len, &idx, &d_age))) {
+            return -1;
+        }
+        voc = (int32_t)((uint32_t)voc + (uint32_t)d_voc);
+        temp += d_temp;
+        batt += d_batt;
+        seq += (uint16_t)d_seq;
+        age += d_age;
+
+        memset(&readings[i], 0, sizeof(readings[i]));
+        readings[i].voc = voc;
+        readings[i].temp = (int16_t)temp;
+        readings[i].battery_level = (uint8_t)batt;
+        readings[i].seq = seq;
+        readings[i].age_s = (uint16_t)age;
+    }
+
+    // Trailing bytes mean we disagree with the puck on the format, other than the padding a 7 byte record gets
+    return (idx == len || (idx == READING_LEGACY_SIZE && len == READING_LEGACY_SIZE + 1)) ? (int)count : -1;
+}
+
+static bool get_be(const uint8_t *buf, size_t len, size_t *idx, size_t size, uint32_t *val)
+{
+    if (*idx + size > len) {
+        return false;
+    }
+    *val = 0;
+    for (size_t i = 0; i < size; i++) {
+        *val = (*val << 8) | buf[(*idx)++];
+    }
+    return true;
+}
+
+/**
+ * @brief Decode a metrics record written by a puck
+ *
+ * @return The field mask, with the fields it names filled in and the rest zeroed, or -1 if the record is malformed
+ */
+int reading_codec_decode_metrics(const uint8_t *buf, size_t len, puck_reading_t *reading)
+{
+    if (len < 2 || buf[0] != RECORD_TAG_READING_METRICS) {
+        return -1;
+    }
+
+    uint8_t fields = buf[1];
+    memset(reading, 0, sizeof(*reading));
+    size_t idx = 2;
+    uint32_t val = 0;
+    bool ok = true;
+    if (fields & READING_FIELD_TVOC) {
+        ok = ok && get_be(buf, len, &idx, 4, &val);
+        reading->voc = (int32_t)val;
+    }
+    if (fields & READING_FIELD_ECO2) {
+        ok = ok && get_be(buf, len, &idx, 2, &val);
+        reading->eco2 = (uint16_t)val;
+    }
+    if (fields & READING_FIELD_ETOH) {
+        ok = ok && get_be(buf, len, &idx, 2, &val);
+        reading->etoh = (uint16_t)val;
+    }
+    if (fields & READING_FIELD_IAQ) {
+        ok = ok && get_be(buf, len, &idx, 1, &val);
+        reading->iaq = (uint8_t)val;
+    }
+    if (fields & READING_FIELD_TEMP) {
+        ok = ok && get_be(buf, len, &idx, 2, &val);
+        reading->temp = (int16_t)val;
+    }
+    if (fields & READING_FIELD_BATTERY) {
+        ok = ok && get_be(buf, len, &idx, 1, &val);
+        reading->battery_pct = (uint8_t)val;
+        // Same bands the puck uses for the 7 byte format
+        reading->battery_level = (val >= 50) ? 3 : (val >= 20) ? 2 : (val >= 5) ? 1 : 0;
+    }
+    if (fields & READING_FIELD_STATUS) {
+        ok = ok && get_be(buf, len, &idx, 1, &val);
+        reading->status = (uint8_t)val;
+    }
+    if (fields & READING_FIELD_STAMP) {
+        ok = ok && get_be(buf, len, &idx, 2, &val);
+        reading->seq = (uint16_t)val;
+        ok = ok && get_be(buf, len, &idx, 2, &val);
+        reading->age_s = (uint16_t)val;
+    }
+
+    // Only the padding byte may follow the fields
+    if (!ok || !(idx == len || (idx == READING_LEGACY_SIZE && len == READING_LEGACY_SIZE + 1))) {
+        return -1;
+    }
+    return fields;
+}
+
+void reading_codec_encode_legacy(const puck_reading_t *reading, uint8_t *buf)
+{
+    uint32_t voc = (uint32_t)reading->voc;
+    uint16_t temp = (uint16_t)reading->temp;
+    buf[0] = voc >> 24;
+    buf[1] = (voc >> 16) & 0xFF;
+    buf[2] = (voc >> 8) & 0xFF;
+    buf[3] = voc & 0xFF;
+    buf[4] = temp >> 8;
+    buf[5] = temp & 0xFF;
+    buf[6] = reading->battery_level;
+}
+
+static size_t put_be(uint32_t val, size_t size, uint8_t *buf)
+{
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = val >> (8 * (size - 1 - i));
+    }
+    return size;
+}
+
+/**
+ * @brief Encode a metrics record, the same way the pucks do
+ *
+ * Used to pass readings from batches on with their stamp, which the 7 byte format has no room for
+ *
+ * @param buf At least READING_METRICS_MAX_SIZE + 1 bytes
+ * @return Length of the record
+ */
+size_t reading_codec_encode_metrics(const puck_reading_t *reading, uint8_t fields, uint8_t *buf)
+{
+    size_t idx = 0;
+    buf[idx++] = RECORD_TAG_READING_METRICS;
+    buf[idx++] = fields;
+    if (fields & READING_FIELD_TVOC) {
+        idx += put_be((uint32_t)reading->voc, 4, &buf[idx]);
+    }
+    if (fields & READING_FIELD_ECO2) {
+        idx += put_be(reading->eco2, 2, &buf[idx]);
+    }
+    if (fields & READING_FIELD_ETOH) {
+        idx += put_be(reading->etoh, 2, &buf[idx]);
+    }
+    if (fields & READING_FIELD_IAQ) {
+        buf[idx++] = reading->iaq;
+    }
+    if (fields & READING_FIELD_TEMP) {
+        idx += put_be((uint16_t)reading->temp, 2, &buf[idx]);
+    }
+    if (fields & READING_FIELD_BATTERY) {
+        buf[idx++] = reading->battery_pct;
+    }
+    if (fields & READING_FIELD_STATUS) {
+        buf[idx++] = reading->status;
+    }
+    if (fields & READING_FIELD_STAMP) {
+        idx += put_be(reading->seq, 2, &buf[idx]);
+        idx += put_be(reading->age_s, 2, &buf[idx]);
+    }
+
+    // 7 bytes is the untagged format
+    if (idx == READING_LEGACY_SIZE) {
+        buf[idx++] = 0;
+    }
+    return idx;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// A single reading, in the same fixed point units as the records it arrives in
+// The batch and 7 byte formats only carry voc, temp and battery_level
+typedef struct {
+    int32_t voc;            // TVOC * 10000
+    int16_t temp;           // Degrees C * 10
+    uint8_t battery_level;  // 0 (empty) to 3 (good)
+    uint16_t eco2;          // ppm
+    uint16_t etoh;          // ppm * 100
+    uint8_t iaq;            // IAQ index * 10
+    uint8_t status;         // READING_STATUS_*
+    uint8_t battery_pct;    // Only in metrics records
+    uint16_t seq;           // Only in stamped records, per puck, wraps
+    uint16_t age_s;         // Only in stamped records, seconds between the reading and the record being written
+} puck_reading_t;
+
+#define READING_STATUS_OK           0
+#define READING_STATUS_WARMUP       1
+#define READING_STATUS_DAMAGED      2
+
+#define READING_LEGACY_SIZE         7
+
+// Batch record: | 0xB0 | Count | Sample 0 | Sample 1 | ... |
+// Each sample is the zig-zag varint delta of VOC, temperature and battery from the previous sample
+#define RECORD_TAG_READING_BATCH    0xB0
+// Stamped batch: each sample also has the deltas of the sequence number and age
+#define RECORD_TAG_READING_BATCH_STAMPED 0xB1
+#define READING_BATCH_MAX_COUNT     255
+
+// Metrics record: | 0xA0 | Mask | TVOC (4) | eCO2 (2) | EtOH (2) | IAQ (1) | Temp (2) | Battery % (1) | Status (1) | Seq (2) | Age (2) |
+// Only the fields set in the mask are present, in bit order, big endian. Padded with a zero if it would be 7 bytes.
+// Forwarded to the app as is, decoded here only to keep the readable characteristic current.
+#define RECORD_TAG_READING_METRICS  0xA0
+#define READING_FIELD_TVOC          (1 << 0)
+#define READING_FIELD_ECO2          (1 << 1)
+#define READING_FIELD_ETOH          (1 << 2)
+#define READING_FIELD_IAQ           (1 << 3)
+#define READING_FIELD_TEMP          (1 << 4)
+#define READING_FIELD_BATTERY       (1 << 5)
+#define READING_FIELD_STATUS        (1 << 6)
+#define READING_FIELD_STAMP         (1 << 7)
+#define READING_FIELDS_LEGACY       (READING_FIELD_TVOC | READING_FIELD_TEMP | READING_FIELD_BATTERY)
+#define READING_METRICS_MAX_SIZE    (2 + 4 + 2 + 2 + 1 + 2 + 1 + 1 + 2 + 2)
+
+// Returns the count, and sets *stamped to whether seq and age_s were filled in
+int reading_codec_decode_batch(const uint8_t *buf, size_t len, puck_reading_t *readings, size_t max_readings, bool *stamped);
+int reading_codec_decode_metrics(const uint8_t *buf, size_t len, puck_reading_t *reading);
+void reading_codec_encode_legacy(const puck_reading_t *reading, uint8_t *buf);
+size_t reading_codec_encode_metrics(const puck_reading_t *reading, uint8_t fields, uint8_t *buf);
@@ -1,5 +1,7 @@
 #include <stdio.h>
+#include <stdbool.h>
 #include <string.h>
+#include <assert.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
@@ -10,8 +12,10 @@
 
 #include "uart_tx.h"
 
-#define COMM_MSG_SIZE         8
-#define COMM_MSG_RAW_SIZE     COMM_MSG_SIZE + 1
+// | Sync | Len | Id | Payload (Len bytes) | Checksum |, everything after the sync char escaped
+// The checksum covers Len, Id and the payload
+#define COMM_MSG_MAX_PAYLOAD  20
+#define COMM_MSG_RAW_SIZE     (COMM_MSG_MAX_PAYLOAD + 3)
 #define COMM_SYNC_CHAR        0xA5
 #define COMM_ESCAPE_CHAR      0x5A
 #define COMM_ESCAPE_ESCAPE    0x23
@@ -24,9 +28,12 @@
 
 #define COMM_UART_PORT_NUM      UART_NUM_2
 #define COMM_UART_BAUD_RATE     115200
+#define COMM_RX_TASK_STACK_SIZE 4096
 
 static const char *TAG = "UART TX";
 
+static comm_rx_handler_t rx_handler = NULL;
+
 void comm_tx_init()
 {
     /* Configure parameters of an UART driver,
@@ -51,24 +58,31 @@ void comm_tx_init()
 }
 
 void comm_tx_msg(uint8_t id, uint8_t* msg, size_t len) {
-    // Generate message
+    // Generate message, anything past the largest payload is dropped
+    if (len > COMM_MSG_MAX_PAYLOAD) {
+      ESP_LOGW(TAG, "Message from 0x%02X truncated from %d bytes", id, (int)len);
+      len = COMM_MSG_MAX_PAYLOAD;
+    }
     uint8_t msg_buf_local[COMM_MSG_RAW_SIZE] = {0};
-    memcpy(msg_buf_local, msg, (len > COMM_MSG_SIZE - 1 ? COMM_MSG_SIZE - 1 : len));
-    msg_buf_local[COMM_MSG_SIZE - 1] = id;
+    size_t raw_len = 0;
+    msg_buf_local[raw_len++] = (uint8_t)len;
+    msg_buf_local[raw_len++] = id;
+    memcpy(&msg_buf_local[raw_len], msg, len);
+    raw_len += len;
 
     // Compute Checksum
     uint8_t checksum = 0x32;
-    for (int i = 0; i < COMM_MSG_SIZE; i++) {
+    for (size_t i = 0; i < raw_len; i++) {
       checksum += msg_buf_local[i];
     }
     checksum ^= 0x5A;
-    msg_buf_local[COMM_MSG_SIZE] = checksum;
+    msg_buf_local[raw_len++] = checksum;
 
     // Escape the proper characters
     uint8_t msg_buf_encoded[1 + COMM_MSG_RAW_SIZE * 2];
     msg_buf_encoded[0] = COMM_SYNC_CHAR;
     size_t encoded_len = 1;
-    for (int i = 0; i < COMM_MSG_RAW_SIZE; i++) {
+    for (size_t i = 0; i < raw_len; i++) {
       uint8_t msg_data = msg_buf_local[i];
       if (msg_data == COMM_SYNC_CHAR) {
         msg_buf_encoded[encoded_len++] = COMM_ESCAPE_CHAR;
@@ -84,4 +98,85 @@ void comm_tx_msg(uint8_t id, uint8_t* msg, size_t len) {
     }
 
     uart_write_bytes(COMM_UART_PORT_NUM, msg_buf_encoded, encoded_len);
-}
\ No newline at end of file
+}
+
+// Same framing as comm_tx_msg, decoded the same way the WiFi server does
+static void comm_rx_task(void *arg)
+{
+    uint8_t rx_buf[32];
+    uint8_t partial_buf[COMM_MSG_RAW_SIZE];
+    size_t partial_idx = 0;
+    bool needs_sync = true;
+    bool is_escaped = false;
+
+    while (1) {
+        int len = uart_read_bytes(COMM_UART_PORT_NUM, rx_buf, sizeof(rx_buf), 50 / portTICK_PERIOD_MS);
+
+        for (int i = 0; i < len; i++) {
+            uint8_t cur_byte = rx_buf[i];
+
+            // Handle framing characters
+            if (cur_byte == COMM_SYNC_CHAR) {
+                needs_sync = false;
+                is_escaped = false;
+                partial_idx = 0;
+                continue;
+            }
+            else if (needs_sync) {
+                continue;
+            }
+            else if (is_escaped) {
+                is_escaped = false;
+                if (cur_byte == COMM_ESCAPE_ESCAPE) {
+                    cur_byte = COMM_ESCAPE_CHAR;
+                }
+                else if (cur_byte == COMM_ESCAPE_SYNC) {
+                    cur_byte = COMM_SYNC_CHAR;
+                }
+                else {
+                    needs_sync = true;
+                    ESP_LOGW(TAG, "Unexpected escaped token: %d - requiring resync", cur_byte);
+                    continue;
+                }
+            }
+            else if (cur_byte == COMM_ESCAPE_CHAR) {
+                is_escaped = true;
+                continue;
+            }
+
+            partial_buf[partial_idx++] = cur_byte;
+            if (partial_idx == 1 && (cur_byte == 0 || cur_byte > COMM_MSG_MAX_PAYLOAD)) {
+                // A length we can't hold means we synced on the middle of something
+                needs_sync = true;
+                partial_idx = 0;
+                ESP_LOGW(TAG, "Invalid message length: %d - requiring resync", cur_byte);
+                continue;
+            }
+            size_t raw_len = partial_buf[0] + 3;
+            if (partial_idx > 1 && partial_idx == raw_len) {
+                needs_sync = true;
+                partial_idx = 0;
+
+                uint8_t checksum = 0x32;
+                for (size_t j = 0; j < raw_len - 1; j++) {
+                    checksum += partial_buf[j];
+                }
+                checksum ^= 0x5A;
+
+                if (partial_buf[raw_len - 1] != checksum) {
+                    ESP_LOGW(TAG, "Invalid Checksum: %d computed, %d received", checksum, partial_buf[raw_len - 1]);
+                }
+                else if (rx_handler) {
+                    rx_handler(partial_buf[1], &partial_buf[2], partial_buf[0]);
+                }
+            }
+        }
+    }
+}
+
+void comm_rx_init(comm_rx_handler_t handler)
+{
+    rx_handler = handler;
+    BaseType_t ret = xTaskCreate(comm_rx_task, "comm_rx_task", COMM_RX_TASK_STACK_SIZE, NULL, 10, NULL);
+    assert(ret == pdPASS);
+}
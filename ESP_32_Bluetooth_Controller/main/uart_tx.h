@@ -1,4 +1,11 @@
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
+
+// Called from the receive task with each message that arrives intact
+typedef void (*comm_rx_handler_t)(uint8_t id, const uint8_t* msg, size_t len);
+
 void comm_tx_init();
-void comm_tx_msg(uint8_t id, uint8_t* msg, size_t len);
\ No newline at end of file
+void comm_tx_msg(uint8_t id, uint8_t* msg, size_t len);
+void comm_rx_init(comm_rx_handler_t handler);
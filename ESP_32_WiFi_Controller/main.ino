@@ -30,6 +30,22 @@ JsonDocument ble_gatt_message;
 
 #define USE_SERIAL Serial
 
+// Untagged reading: | VOC (4) | Temp (2) | Battery |
+#define READING_LEGACY_LEN          7
+// Multi-metric reading, passed to the app untouched since it decodes the field mask itself
+#define RECORD_TAG_READING_METRICS  0xA0
+// Puck firmware staging, see ota_dist.h on the Bluetooth server. Binary WebSocket messages starting with
+// one of the staging tags are passed down the UART link as they are, and its acknowledgements come back up
+#define RECORD_TAG_OTA_STAGE_BEGIN  0xE0
+#define RECORD_TAG_OTA_STAGE_END    0xE2
+#define RECORD_TAG_OTA_STAGE_ACK    0xE3
+#define COMM_ID_OTA                 0xFE
+// Puck configuration staging, see config_dist.h on the Bluetooth server, passed through the same way
+#define RECORD_TAG_CONFIG_STAGE_BEGIN   0xE8
+#define RECORD_TAG_CONFIG_STAGE_END     0xEA
+#define RECORD_TAG_CONFIG_STAGE_ACK     0xEB
+#define COMM_ID_CONFIG                  0xFD
+
 void hexdump(const void *mem, uint32_t len, uint8_t cols = 16) {
 	const uint8_t* src = (const uint8_t*) mem;
 	USE_SERIAL.printf("\n[HEXDUMP] Address: 0x%08X len: 0x%X (%d)", (ptrdiff_t)src, len, len);
@@ -43,6 +59,34 @@ void hexdump(const void *mem, uint32_t len, uint8_t cols = 16) {
 	USE_SERIAL.printf("\n");
 }
 
+// Tagged records go to the app as "<Kind><client>;<hex record>"
+void forwardRecord(const comm_msg_t *msg) {
+    const char *kind;
+    if (msg->data[0] == RECORD_TAG_READING_METRICS) {
+        kind = "Metrics";
+    }
+    else if (msg->data[0] == RECORD_TAG_OTA_STAGE_ACK && msg->id == COMM_ID_OTA) {
+        kind = "Ota";
+    }
+    else if (msg->data[0] == RECORD_TAG_CONFIG_STAGE_ACK && msg->id == COMM_ID_CONFIG) {
+        kind = "Config";
+    }
+    else {
+        USE_SERIAL.printf("Dropping a record with unknown tag 0x%02X from 0x%02X\n", msg->data[0], msg->id);
+        return;
+    }
+
+    int len = snprintf(msgBuf, sizeof(msgBuf), "%s%d;", kind, msg->id);
+    for (uint8_t i = 0; i < msg->len && len + 2 < (int) sizeof(msgBuf); i++) {
+        len += snprintf(&msgBuf[len], sizeof(msgBuf) - len, "%02X", msg->data[i]);
+    }
+    USE_SERIAL.printf("Forwarding a %d byte record from 0x%02X: %s\n", msg->len, msg->id, msgBuf);
+
+    if (listenerValid) {
+        webSocket.sendTXT(listener, msgBuf);
+    }
+}
+
 void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
 
     switch(type) {
@@ -77,6 +121,17 @@ void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length
             break;
         case WStype_BIN:
             USE_SERIAL.printf("[%u] get binary length: %u\n", num, length);
+            if (length > 0 && length <= COMM_MSG_MAX_PAYLOAD &&
+                payload[0] >= RECORD_TAG_OTA_STAGE_BEGIN && payload[0] <= RECORD_TAG_OTA_STAGE_END) {
+                // The acknowledgement goes to the listener, so whoever is staging should be it
+                comm_tx_msg(COMM_ID_OTA, payload, length);
+                break;
+            }
+            if (length > 0 && length <= COMM_MSG_MAX_PAYLOAD &&
+                payload[0] >= RECORD_TAG_CONFIG_STAGE_BEGIN && payload[0] <= RECORD_TAG_CONFIG_STAGE_END) {
+                comm_tx_msg(COMM_ID_CONFIG, payload, length);
+                break;
+            }
             hexdump(payload, length);
 
             // send message to client
@@ -127,12 +182,19 @@ void setup() {
 void loop() {
     webSocket.loop();
     if (uxQueueMessagesWaiting(comm_msg_queue) > 0) {
-      uint8_t rxBuf[COMM_MSG_SIZE];
-      if (xQueueReceive(comm_msg_queue, rxBuf, 0) == pdPASS) {
+      comm_msg_t msg;
+      if (xQueueReceive(comm_msg_queue, &msg, 0) == pdPASS) {
+        const uint8_t *rxBuf = msg.data;
+        int client = msg.id;
+
+        if (msg.len != READING_LEGACY_LEN) {
+          forwardRecord(&msg);
+          return;
+        }
+
         float voc = ((rxBuf[0] << 24) | (rxBuf[1] << 16) | (rxBuf[2] << 8) | rxBuf[3]) / 10000.0;
         float temp = ((rxBuf[4] << 8) | rxBuf[5]) / 10.0;
         int battLvl = rxBuf[6];
-        int client = rxBuf[7];
 
         ble_gatt_message["voc"] = voc;
         ble_gatt_message["temp"] = temp;
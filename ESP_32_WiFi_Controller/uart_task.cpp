@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
@@ -10,7 +11,7 @@
 #include "uart_task.hpp"
 
 #define COMM_MSG_QUEUE_DEPTH  10
-#define COMM_MSG_RAW_SIZE     COMM_MSG_SIZE + 1
+#define COMM_MSG_RAW_SIZE     (COMM_MSG_MAX_PAYLOAD + 3)
 #define COMM_SYNC_CHAR        0xA5
 #define COMM_ESCAPE_CHAR      0x5A
 #define COMM_ESCAPE_ESCAPE    0x23
@@ -97,7 +98,15 @@ static void uart_comm_task(void *arg)
 
           // Anything else is a decode success, add to buffer
           partial_buf[partial_idx++] = cur_byte;
-          if (partial_idx == COMM_MSG_RAW_SIZE) {
+          if (partial_idx == 1 && (cur_byte == 0 || cur_byte > COMM_MSG_MAX_PAYLOAD)) {
+            // A length we can't hold means we synced on the middle of something
+            needs_sync = true;
+            partial_idx = 0;
+            ESP_LOGW(TAG, "Invalid message length: %d - requiring resync", cur_byte);
+            continue;
+          }
+          size_t raw_len = partial_buf[0] + 3;
+          if (partial_idx > 1 && partial_idx == raw_len) {
             // Clear the state to begin receiving a new messgae when we finish
             needs_sync = true;
             partial_idx = 0;
@@ -106,18 +115,22 @@ static void uart_comm_task(void *arg)
 
             // Compute message checksum
             uint8_t checksum = 0x32;
-            for (int i = 0; i < COMM_MSG_RAW_SIZE - 1; i++) {
+            for (size_t i = 0; i < raw_len - 1; i++) {
               checksum += partial_buf[i];
             }
             checksum ^= 0x5A;
 
             // Make sure the checksum matches
-            if (partial_buf[COMM_MSG_RAW_SIZE - 1] != checksum) {
-              ESP_LOGW(TAG, "Invalid Checksum: %d computed, %d received", checksum, partial_buf[COMM_MSG_RAW_SIZE - 1]);
+            if (partial_buf[raw_len - 1] != checksum) {
+              ESP_LOGW(TAG, "Invalid Checksum: %d computed, %d received", checksum, partial_buf[raw_len - 1]);
             }
             else {
               // We received it, push it to the queue
-              BaseType_t ret = xQueueSendToBack(comm_msg_queue, partial_buf, 50 / portTICK_PERIOD_MS);
+              comm_msg_t msg;
+              msg.len = partial_buf[0];
+              msg.id = partial_buf[1];
+              memcpy(msg.data, &partial_buf[2], msg.len);
+              BaseType_t ret = xQueueSendToBack(comm_msg_queue, &msg, 50 / portTICK_PERIOD_MS);
               if (ret != pdPASS) {
                 ESP_LOGW(TAG, "Message lost, could not push to queue (error %d)", ret);
               }
@@ -130,8 +143,50 @@ static void uart_comm_task(void *arg)
 
 void comm_task_init()
 {
-    comm_msg_queue = xQueueCreate(COMM_MSG_QUEUE_DEPTH, COMM_MSG_SIZE);
+    comm_msg_queue = xQueueCreate(COMM_MSG_QUEUE_DEPTH, sizeof(comm_msg_t));
     assert(comm_msg_queue != NULL);
     BaseType_t ret = xTaskCreate(uart_comm_task, "uart_comm_task", COMM_TASK_STACK_SIZE, NULL, 10, NULL);
     assert(ret == pdPASS);
 }
+
+// Same framing as the receive side, only used to stage puck firmware on the Bluetooth server
+void comm_tx_msg(uint8_t id, const uint8_t *msg, size_t len)
+{
+    if (len == 0 || len > COMM_MSG_MAX_PAYLOAD) {
+        ESP_LOGW(TAG, "Not sending a %d byte message to 0x%02X", (int)len, id);
+        return;
+    }
+    uint8_t msg_buf_local[COMM_MSG_RAW_SIZE];
+    size_t raw_len = 0;
+    msg_buf_local[raw_len++] = (uint8_t)len;
+    msg_buf_local[raw_len++] = id;
+    memcpy(&msg_buf_local[raw_len], msg, len);
+    raw_len += len;
+
+    uint8_t checksum = 0x32;
+    for (size_t i = 0; i < raw_len; i++) {
+      checksum += msg_buf_local[i];
+    }
+    checksum ^= 0x5A;
+    msg_buf_local[raw_len++] = checksum;
+
+    uint8_t msg_buf_encoded[1 + COMM_MSG_RAW_SIZE * 2];
+    msg_buf_encoded[0] = COMM_SYNC_CHAR;
+    size_t encoded_len = 1;
+    for (size_t i = 0; i < raw_len; i++) {
+      uint8_t msg_data = msg_buf_local[i];
+      if (msg_data == COMM_SYNC_CHAR) {
+        msg_buf_encoded[encoded_len++] = COMM_ESCAPE_CHAR;
+        msg_buf_encoded[encoded_len++] = COMM_ESCAPE_SYNC;
+      }
+      else if (msg_data == COMM_ESCAPE_CHAR) {
+        msg_buf_encoded[encoded_len++] = COMM_ESCAPE_CHAR;
+        msg_buf_encoded[encoded_len++] = COMM_ESCAPE_ESCAPE;
+      }
+      else {
+        msg_buf_encoded[encoded_len++] = msg_data;
+      }
+    }
+
+    uart_write_bytes(COMM_UART_PORT_NUM, msg_buf_encoded, encoded_len);
+}
@@ -1 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// | Sync | Len | Id | Payload (Len bytes) | Checksum |, everything after the sync char escaped
+// The checksum covers Len, Id and the payload
+#define COMM_MSG_MAX_PAYLOAD  20
+
+// One message off the link, as queued on comm_msg_queue
+typedef struct {
+    uint8_t id;
+    uint8_t len;
+    uint8_t data[COMM_MSG_MAX_PAYLOAD];
+} comm_msg_t;
+
+extern QueueHandle_t comm_msg_queue;
+
 void comm_task_init();
+void comm_tx_msg(uint8_t id, const uint8_t *msg, size_t len);
@@ -10,8 +10,7 @@
 
 #include "uart_task.hpp"
 
-#define COMM_MSG_SIZE         8
-#define COMM_MSG_RAW_SIZE     COMM_MSG_SIZE + 1
+#define COMM_MSG_RAW_SIZE     (COMM_MSG_MAX_PAYLOAD + 3)
 #define COMM_SYNC_CHAR        0xA5
 #define COMM_ESCAPE_CHAR      0x5A
 #define COMM_ESCAPE_ESCAPE    0x23
@@ -51,24 +50,31 @@ void comm_tx_init()
 }
 
 void comm_tx_msg(uint8_t id, uint8_t* msg, size_t len) {
-    // Generate message
+    // Generate message, anything past the largest payload is dropped
+    if (len > COMM_MSG_MAX_PAYLOAD) {
+      ESP_LOGW(TAG, "Message from 0x%02X truncated from %d bytes", id, (int)len);
+      len = COMM_MSG_MAX_PAYLOAD;
+    }
     uint8_t msg_buf_local[COMM_MSG_RAW_SIZE] = {0};
-    memcpy(msg_buf_local, msg, (len > COMM_MSG_SIZE - 1 ? COMM_MSG_SIZE - 1 : len));
-    msg_buf_local[COMM_MSG_SIZE - 1] = id;
+    size_t raw_len = 0;
+    msg_buf_local[raw_len++] = (uint8_t)len;
+    msg_buf_local[raw_len++] = id;
+    memcpy(&msg_buf_local[raw_len], msg, len);
+    raw_len += len;
 
     // Compute Checksum
     uint8_t checksum = 0x32;
-    for (int i = 0; i < COMM_MSG_SIZE; i++) {
+    for (size_t i = 0; i < raw_len; i++) {
       checksum += msg_buf_local[i];
     }
     checksum ^= 0x5A;
-    msg_buf_local[COMM_MSG_SIZE] = checksum;
+    msg_buf_local[raw_len++] = checksum;
 
     // Escape the proper characters
     uint8_t msg_buf_encoded[1 + COMM_MSG_RAW_SIZE * 2];
     msg_buf_encoded[0] = COMM_SYNC_CHAR;
     size_t encoded_len = 1;
-    for (int i = 0; i < COMM_MSG_RAW_SIZE; i++) {
+    for (size_t i = 0; i < raw_len; i++) {
       uint8_t msg_data = msg_buf_local[i];
       if (msg_data == COMM_SYNC_CHAR) {
         msg_buf_encoded[encoded_len++] = COMM_ESCAPE_CHAR;
@@ -0,0 +1,280 @@
+/*
+ * capture_replay.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ *
+ * Replays a puck's capture log through the IAQ 2nd Gen algorithm on a PC, so thresholds and
+ * ambient inputs can be tuned without a fridge. Reads the Bluetooth server's log output (the
+ * CAPTURE lines it prints for a capture download) and writes one CSV line per sample, with the
+ * outputs the puck logged next to the outputs of the replay. The replayed readings are also run
+ * through the puck's report policy, to show how many of them it would have transmitted.
+ *
+ * Build against the Linux x86_64 build of the algorithm from the Renesas download
+ * (gas-algorithm-libraries/iaq_2nd_gen/x86_64/...) and the headers from zmod4xxx_evk_example/src:
+ *
+ *   gcc -O2 -DCAPTURE_LOG_HOST -I../../CC2340R5_Firmware -I<renesas headers> \
+ *       capture_replay.c ../../CC2340R5_Firmware/capture_log.c \
+ *       ../../CC2340R5_Firmware/report_policy.c <lib_iaq_2nd_gen.a> -lm -o capture_replay
+ *
+ * Usage: capture_replay [-p puck id] [-t temperature offset] [-h humidity override] [-a tvoc alarm]
+ *                       [-d report deadband mg/m^3] [-s report max silence s] < server.log
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "zmod4xxx_types.h"
+#include "iaq_2nd_gen.h"
+#include "capture_log.h"
+#include "report_policy.h"
+
+// Largest log we'll reassemble, far more than the puck's flash region holds
+#define REPLAY_MAX_STREAM   (4 * 1024 * 1024)
+
+static uint8_t stream[REPLAY_MAX_STREAM];
+static size_t streamLen = 0;
+
+typedef struct replay_options_t {
+    int puckId;                 // -1 takes whichever puck sends first
+    float temperatureOffset;    // Added to the logged temperature input
+    float humidityOverride;     // Replaces the logged humidity input when >= 0
+    float tvocAlarm;            // Counts samples above this TVOC for both the logged and replayed results
+    report_policy_params_t report;
+} replay_options_t;
+
+static const char *reportReasonNames[REPORT_REASON_COUNT] = {"held", "always", "first", "status", "deadband", "rising", "silence"};
+
+static int hexNibble(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+// Chunks are appended in order, a chunk 0 means the download was restarted and replaces the earlier attempt
+static bool readStream(FILE *in, replay_options_t *opts) {
+    char line[512];
+    long expectedChunk = 0;
+    bool ended = false;
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        unsigned puckId;
+        unsigned long chunk;
+        char hex[256];
+        const char *capture;
+
+        if ((capture = strstr(line, "CAPTURE_END ")) != NULL) {
+            unsigned long records, lost;
+            if (sscanf(capture, "CAPTURE_END %x %lu %lu %lu", &puckId, &chunk, &records, &lost) == 4 &&
+                (int) puckId == opts->puckId) {
+                fprintf(stderr, "Download ended: %lu chunks, %lu records, %lu lost on the puck\n", chunk, records, lost);
+                if ((long) chunk != expectedChunk) {
+                    fprintf(stderr, "Only %ld of the chunks were in the log\n", expectedChunk);
+                }
+                ended = true;
+            }
+            continue;
+        }
+        if ((capture = strstr(line, "CAPTURE ")) == NULL ||
+            sscanf(capture, "CAPTURE %x %lu %255s", &puckId, &chunk, hex) != 3) {
+            continue;
+        }
+        if (opts->puckId < 0) {
+            opts->puckId = puckId;
+        }
+        if ((int) puckId != opts->puckId) {
+            continue;
+        }
+
+        if (chunk == 0) {
+            streamLen = 0;
+            expectedChunk = 0;
+            ended = false;
+        }
+        if ((long) chunk != expectedChunk) {
+            // Stop at the first gap, the records after it can't be lined up
+            continue;
+        }
+        expectedChunk++;
+
+        for (size_t i = 0; hex[i] != '\0' && hex[i + 1] != '\0' && streamLen < sizeof(stream); i += 2) {
+            int hi = hexNibble(hex[i]);
+            int lo = hexNibble(hex[i + 1]);
+            if (hi < 0 || lo < 0) {
+                break;
+            }
+            stream[streamLen++] = (hi << 4) | lo;
+        }
+    }
+
+    if (!ended) {
+        fprintf(stderr, "No end marker, the download may be incomplete\n");
+    }
+    return streamLen > 0;
+}
+
+int main(int argc, char **argv) {
+    replay_options_t opts = {
+        .puckId = -1,
+        .temperatureOffset = 0.0f,
+        .humidityOverride = -1.0f,
+        .tvocAlarm = -1.0f,
+        .report = REPORT_POLICY_DEFAULTS,
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:t:h:a:d:s:")) != -1) {
+        switch (opt) {
+        case 'p':
+            opts.puckId = (int) strtol(optarg, NULL, 16);
+            break;
+        case 't':
+            opts.temperatureOffset = strtof(optarg, NULL);
+            break;
+        case 'h':
+            opts.humidityOverride = strtof(optarg, NULL);
+            break;
+        case 'a':
+            opts.tvocAlarm = strtof(optarg, NULL);
+            break;
+        case 'd':
+            opts.report.tvocDeadband = (int32_t) (strtof(optarg, NULL) * 10000);
+            break;
+        case 's':
+            opts.report.maxSilenceMs = (uint32_t) (strtof(optarg, NULL) * 1000);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-p puck id] [-t temperature offset] [-h humidity override] [-a tvoc alarm] "
+                            "[-d report deadband] [-s report max silence] < server.log\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (!readStream(stdin, &opts)) {
+        fprintf(stderr, "No capture download found\n");
+        return 1;
+    }
+
+    zmod4xxx_dev_t dev;
+    uint8_t prodData[CAPTURE_PROD_DATA_LEN];
+    iaq_2nd_gen_handle_t algoHandle;
+    bool haveSession = false;
+    uint32_t samples = 0, skipped = 0, corrupt = 0, statusMismatches = 0;
+    uint32_t loggedAlarms = 0, replayedAlarms = 0;
+    uint32_t lastSeq = 0;
+    // Time as the puck would have seen it, one sample period per cycle
+    uint32_t sessionPeriodMs = 0;
+    uint32_t nowMs = 0;
+    report_policy_t policy;
+    ReportPolicy_init(&policy, &opts.report);
+
+    printf("seq,logged_status,replayed_status,temperature,humidity,logged_tvoc,replayed_tvoc,logged_etoh,replayed_etoh,logged_eco2,replayed_eco2,logged_iaq,replayed_iaq\n");
+
+    for (size_t offset = 0; offset + CAPTURE_RECORD_SIZE <= streamLen; offset += CAPTURE_RECORD_SIZE) {
+        capture_record_t record;
+        memcpy(&record, &stream[offset], sizeof(record));
+        if (record.crc != CaptureLog_crc(&record)) {
+            corrupt++;
+            continue;
+        }
+
+        // The algorithm keeps state between cycles, a gap means starting it over like a reset would
+        bool gap = haveSession && record.seq != lastSeq + 1;
+        lastSeq = record.seq;
+
+        if (record.kind == CAPTURE_KIND_SESSION) {
+            const capture_session_t *session = &record.body.session;
+            // Repeats only matter to a download that starts part way through a capture
+            if (haveSession && !gap && !session->restart) {
+                continue;
+            }
+            memset(&dev, 0, sizeof(dev));
+            dev.pid = session->pid;
+            dev.mox_lr = session->moxLr;
+            dev.mox_er = session->moxEr;
+            memcpy(dev.config, session->config, sizeof(dev.config));
+            memcpy(prodData, session->prodData, sizeof(prodData));
+            dev.prod_data = prodData;
+            if (init_iaq_2nd_gen(&algoHandle) != 0) {
+                fprintf(stderr, "Algorithm init failed\n");
+                return 1;
+            }
+            sessionPeriodMs = session->samplePeriodMs;
+            fprintf(stderr, "Session at seq %u: pid 0x%04x, sample period %u ms\n",
+                    (unsigned) record.seq, session->pid, (unsigned) session->samplePeriodMs);
+            haveSession = true;
+            continue;
+        }
+        if (record.kind != CAPTURE_KIND_SAMPLE || !haveSession) {
+            skipped++;
+            continue;
+        }
+        if (gap) {
+            fprintf(stderr, "Gap before seq %u, restarting the algorithm\n", (unsigned) record.seq);
+            init_iaq_2nd_gen(&algoHandle);
+        }
+
+        const capture_sample_t *sample = &record.body.sample;
+        uint8_t adc[CAPTURE_ADC_LEN];
+        memcpy(adc, sample->adc, sizeof(adc));
+
+        iaq_2nd_gen_inputs_t input;
+        iaq_2nd_gen_results_t results;
+        input.adc_result = adc;
+        input.temperature_degc = sample->temperatureCentiDegC / 100.0f + opts.temperatureOffset;
+        input.humidity_pct = (opts.humidityOverride >= 0) ? opts.humidityOverride : sample->humidityCentiPct / 100.0f;
+        int8_t status = calc_iaq_2nd_gen(&algoHandle, &dev, &input, &results);
+
+        samples++;
+        nowMs += sessionPeriodMs;
+        // Warm-up readings never reach the policy on the puck
+        if (status != IAQ_2ND_GEN_STABILIZATION) {
+            puck_reading_t reading = {
+                .voc = (int32_t) (results.tvoc * 10000),
+                .temp = (int16_t) (input.temperature_degc * 10),
+                .status = (status == IAQ_2ND_GEN_OK) ? READING_STATUS_OK : READING_STATUS_DAMAGED,
+            };
+            ReportPolicy_check(&policy, &reading, nowMs);
+        }
+        if ((uint8_t) status != record.algoStatus) {
+            statusMismatches++;
+        }
+        if (opts.tvocAlarm >= 0) {
+            loggedAlarms += sample->tvoc > opts.tvocAlarm;
+            replayedAlarms += results.tvoc > opts.tvocAlarm;
+        }
+
+        printf("%u,%d,%d,%.2f,%.2f,%.4f,%.4f,%.4f,%.4f,%.1f,%.1f,%.2f,%.2f\n",
+               (unsigned) record.seq, (int8_t) record.algoStatus, status,
+               input.temperature_degc, input.humidity_pct,
+               sample->tvoc, results.tvoc, sample->etoh, results.etoh,
+               sample->eco2, results.eco2, sample->iaq, results.iaq);
+    }
+
+    fprintf(stderr, "%u samples replayed, %u status mismatches, %u corrupt and %u skipped records\n",
+            (unsigned) samples, (unsigned) statusMismatches, (unsigned) corrupt, (unsigned) skipped);
+    if (opts.tvocAlarm >= 0) {
+        fprintf(stderr, "TVOC above %.3f: %u logged, %u replayed\n", opts.tvocAlarm, (unsigned) loggedAlarms, (unsigned) replayedAlarms);
+    }
+    if (policy.considered > 0) {
+        uint32_t reported = policy.considered - policy.reasons[REPORT_REASON_NONE];
+        fprintf(stderr, "Report policy: %u of %u readings sent (%.1f%%):", (unsigned) reported, (unsigned) policy.considered,
+                100.0 * reported / policy.considered);
+        for (int reason = REPORT_REASON_ALWAYS; reason < REPORT_REASON_COUNT; reason++) {
+            fprintf(stderr, " %s %u", reportReasonNames[reason], (unsigned) policy.reasons[reason]);
+        }
+        fprintf(stderr, "\n");
+    }
+    return 0;
+}
@@ -0,0 +1,355 @@
+/*
+ * codec_test.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ *
+ * Round trips readings through the puck's encoders (reading_codec.c) and the Bluetooth server's
+ * decoders, and measures how much the batch format saves over one 7 byte write per reading. The
+ * readings come from a trace: the CSV that capture_replay writes (the TVOC the puck logged and the
+ * temperature it measured), or a made-up fridge trace without one. Every record is checked to
+ * decode to exactly what went in, and to never be 7 bytes long, which the server would take for an
+ * untagged reading. Edge cases the trace won't reach (huge jumps, negative temperatures, sequence
+ * wrap, saturated ages) are run as well, along with every field mask of the metrics record. The
+ * puck rows are what the puck sends when it wants the stamp, which it drops from batches too small
+ * to carry it for less than the 7 byte writes.
+ *
+ * The puck's and the server's reading_codec.h share a name, so each side is built with its own include path:
+ *
+ *   gcc -O2 -I../../CC2340R5_Firmware -c codec_test.c ../../CC2340R5_Firmware/reading_codec.c
+ *   gcc -O2 -I../../ESP_32_Bluetooth_Controller/main -c server_codec.c
+ *   gcc -O2 -I../../ESP_32_Bluetooth_Controller/main -c ../../ESP_32_Bluetooth_Controller/main/reading_codec.c \
+ *       -o server_reading_codec.o
+ *   gcc codec_test.o reading_codec.o server_codec.o server_reading_codec.o -lm -o codec_test
+ *
+ * Usage: codec_test [-p sample period ms] [replay.csv]
+ *
+ * Exits with an error if any record doesn't round trip.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "reading_codec.h"
+#include "server_codec.h"
+
+// A day of IAQ 2nd Gen samples
+#define TEST_MAX_READINGS       (24 * 60 * 20)
+#define TEST_SYNTHETIC_READINGS (6 * 60 * 20)
+// Default write with no MTU exchange, and the largest the CC2340R5 negotiates
+#define TEST_WRITE_DEFAULT      20
+#define TEST_WRITE_LARGE        244
+
+static puck_reading_t readings[TEST_MAX_READINGS];
+static size_t numReadings = 0;
+static uint32_t failures = 0;
+
+// Index of the named column in a CSV header, -1 if it isn't there
+static int csvColumn(const char *header, const char *name) {
+    int col = 0;
+    size_t nameLen = strlen(name);
+    const char *pos = header;
+    while (*pos != '\0') {
+        if (strncmp(pos, name, nameLen) == 0 && (pos[nameLen] == ',' || pos[nameLen] == '\n' || pos[nameLen] == '\r' ||
+                                                 pos[nameLen] == '\0')) {
+            return col;
+        }
+        pos = strchr(pos, ',');
+        if (pos == NULL) {
+            break;
+        }
+        pos++;
+        col++;
+    }
+    return -1;
+}
+
+static const char *csvField(const char *line, int col) {
+    for (int i = 0; i < col && line != NULL; i++) {
+        line = strchr(line, ',');
+        if (line != NULL) {
+            line++;
+        }
+    }
+    return line;
+}
+
+static bool readTrace(const char *path, uint32_t periodMs) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        perror(path);
+        return false;
+    }
+
+    char line[512];
+    if (fgets(line, sizeof(line), in) == NULL) {
+        fclose(in);
+        return false;
+    }
+    int tvocCol = csvColumn(line, "logged_tvoc");
+    int tempCol = csvColumn(line, "temperature");
+    if (tvocCol < 0 || tempCol < 0) {
+        fprintf(stderr, "%s isn't a capture_replay CSV\n", path);
+        fclose(in);
+        return false;
+    }
+
+    while (numReadings < TEST_MAX_READINGS && fgets(line, sizeof(line), in) != NULL) {
+        const char *tvoc = csvField(line, tvocCol);
+        const char *temp = csvField(line, tempCol);
+        if (tvoc == NULL || temp == NULL) {
+            continue;
+        }
+        puck_reading_t *reading = &readings[numReadings];
+        memset(reading, 0, sizeof(*reading));
+        reading->voc = (int32_t) lroundf(strtof(tvoc, NULL) * 10000);
+        reading->temp = (int16_t) lroundf(strtof(temp, NULL) * 10);
+        reading->batteryLevel = 3;
+        reading->seq = (uint16_t) numReadings;
+        reading->timeMs = numReadings * periodMs;
+        numReadings++;
+    }
+    fclose(in);
+    return numReadings > 0;
+}
+
+// A fridge at 4 C with the door opened every so often, and VOC creeping up as food goes off
+static void makeTrace(uint32_t periodMs) {
+    srand(1);
+    double voc = 0.2;
+    double temp = 4.0;
+    for (numReadings = 0; numReadings < TEST_SYNTHETIC_READINGS; numReadings++) {
+        if (rand() % 400 == 0) {
+            temp += 3.0;
+        }
+        temp += (4.0 - temp) * 0.01 + ((rand() % 21) - 10) * 0.002;
+        voc += 0.00005 + ((rand() % 21) - 10) * 0.0004;
+        if (voc < 0) {
+            voc = 0;
+        }
+
+        puck_reading_t *reading = &readings[numReadings];
+        memset(reading, 0, sizeof(*reading));
+        reading->voc = (int32_t) lround(voc * 10000);
+        reading->temp = (int16_t) lround(temp * 10);
+        reading->batteryLevel = (numReadings < TEST_SYNTHETIC_READINGS * 3 / 4) ? 3 : 2;
+        reading->seq = (uint16_t) numReadings;
+        reading->timeMs = numReadings * periodMs;
+    }
+}
+
+static void fail(const char *what, size_t index) {
+    if (failures < 20) {
+        fprintf(stderr, "FAIL %s at reading %zu\n", what, index);
+    }
+    failures++;
+}
+
+typedef struct batch_result_t {
+    size_t records;
+    size_t bytes;
+} batch_result_t;
+
+// Sends the readings in groups of batchSize, each group in as many records of at most writeLen as it takes,
+// the way SendDataUpdate does, and checks every record decodes back to its readings
+static batch_result_t runBatches(const puck_reading_t *in, size_t count, size_t batchSize, bool stamped,
+                                 size_t writeLen, uint32_t periodMs) {
+    batch_result_t result = {0, 0};
+    size_t pos = 0;
+    while (pos < count) {
+        size_t group = (count - pos < batchSize) ? count - pos : batchSize;
+        // The group is written once the last reading of it has been taken
+        uint32_t nowMs = in[pos + group - 1].timeMs + periodMs;
+        size_t groupDone = 0;
+        while (groupDone < group) {
+            uint8_t record[TEST_WRITE_LARGE];
+            size_t numEncoded;
+            size_t len = ReadingCodec_encodeBatch(&in[pos + groupDone], group - groupDone, stamped, nowMs,
+                                                  record, writeLen, &numEncoded);
+            if (len == 0 || numEncoded == 0) {
+                fail("encode", pos + groupDone);
+                return result;
+            }
+            if (len == READING_LEGACY_SIZE) {
+                fail("7 byte record", pos + groupDone);
+            }
+            if (len > writeLen) {
+                fail("record too long", pos + groupDone);
+            }
+
+            server_reading_t decoded[255];
+            bool decodedStamped;
+            int decodedCount = serverDecodeBatch(record, len, decoded, 255, &decodedStamped);
+            if (decodedCount != (int) numEncoded || decodedStamped != stamped) {
+                fail("decode", pos + groupDone);
+            }
+            else {
+                for (size_t i = 0; i < numEncoded; i++) {
+                    const puck_reading_t *want = &in[pos + groupDone + i];
+                    uint32_t ageS = (nowMs - want->timeMs) / 1000;
+                    if (decoded[i].voc != want->voc || decoded[i].temp != want->temp ||
+                        decoded[i].batteryLevel != want->batteryLevel ||
+                        (stamped && (decoded[i].seq != want->seq || decoded[i].ageS != (ageS > UINT16_MAX ? UINT16_MAX : ageS)))) {
+                        fail("mismatch", pos + groupDone + i);
+                    }
+                }
+            }
+
+            result.records++;
+            result.bytes += len;
+            groupDone += numEncoded;
+        }
+        pos += group;
+    }
+    return result;
+}
+// What SendDataUpdate sends when the stamp is wanted: a stamped batch if it's no bigger than 7 byte writes,
+// otherwise a 7 byte write for a lone reading or a batch without the stamp
+static batch_result_t runPuck(const puck_reading_t *in, size_t count, size_t batchSize, size_t writeLen,
+                              uint32_t periodMs, size_t *numStamped) {
+    batch_result_t result = {0, 0};
+    *numStamped = 0;
+    for (size_t pos = 0; pos < count; pos += batchSize) {
+        size_t group = (count - pos < batchSize) ? count - pos : batchSize;
+        uint32_t nowMs = in[pos + group - 1].timeMs + periodMs;
+        size_t stampedBytes = ReadingCodec_batchSize(&in[pos], group, true, nowMs, writeLen);
+        bool stamped = stampedBytes <= group * READING_LEGACY_SIZE;
+
+        batch_result_t groupResult;
+        if (!stamped && group == 1) {
+            groupResult.records = 1;
+            groupResult.bytes = READING_LEGACY_SIZE;
+        }
+        else {
+            groupResult = runBatches(&in[pos], group, group, stamped, writeLen, periodMs);
+        }
+        if (stamped && groupResult.bytes != stampedBytes) {
+            fail("batch size doesn't match the encoding", pos);
+        }
+        if (stamped) {
+            *numStamped += group;
+        }
+        result.records += groupResult.records;
+        result.bytes += groupResult.bytes;
+    }
+    return result;
+}
+
+static void edgeCases(uint32_t periodMs) {
+    static const int32_t vocs[] = {0, INT32_MAX, 0, -1, 1, INT32_MIN, 123456, 123457, 0x7F, 0x80, 0x3FFF, 0x4000};
+    static const int16_t temps[] = {-400, 850, -1, 0, INT16_MAX, INT16_MIN, 40, 41, -64, 63, -65, 64};
+    static const uint16_t seqs[] = {65530, 65531, 65535, 0, 1, 40000, 3, 65535, 0, 2, 1, 0};
+    const size_t count = sizeof(vocs) / sizeof(vocs[0]);
+    puck_reading_t edge[sizeof(vocs) / sizeof(vocs[0])];
+
+    for (size_t i = 0; i < count; i++) {
+        memset(&edge[i], 0, sizeof(edge[i]));
+        edge[i].voc = vocs[i];
+        edge[i].temp = temps[i];
+        edge[i].batteryLevel = i % 4;
+        edge[i].seq = seqs[i];
+        // The first few are older than an age can say
+        edge[i].timeMs = (i < 3) ? 0 : 70000000 + i * periodMs;
+    }
+    for (size_t batch = 1; batch <= count; batch++) {
+        runBatches(edge, count, batch, false, TEST_WRITE_DEFAULT, periodMs);
+        runBatches(edge, count, batch, true, TEST_WRITE_DEFAULT, periodMs);
+        runBatches(edge, count, batch, true, TEST_WRITE_LARGE, periodMs);
+    }
+
+    // Every field mask, with values that need every byte
+    puck_reading_t full = {
+        .voc = 0x12345678, .temp = -123, .batteryLevel = 2, .eco2 = 0xBEEF, .etoh = 0x1234, .iaq = 0xAB,
+        .status = READING_STATUS_WARMUP, .batteryPct = 77, .seq = 0xFEDC, .timeMs = 1000,
+    };
+    uint32_t nowMs = 1000 + 4321 * 1000;
+    for (unsigned fields = 0; fields <= READING_FIELDS_ALL; fields++) {
+        uint8_t record[READING_METRICS_MAX_SIZE + 1];
+        size_t len = ReadingCodec_encodeMetrics(&full, (uint8_t) fields, nowMs, record, sizeof(record));
+        server_reading_t decoded;
+        if (len == READING_LEGACY_SIZE) {
+            fail("7 byte metrics record", fields);
+        }
+        if (serverDecodeMetrics(record, len, &decoded) != (int) fields ||
+            ((fields & READING_FIELD_TVOC) && decoded.voc != full.voc) ||
+            ((fields & READING_FIELD_ECO2) && decoded.eco2 != full.eco2) ||
+            ((fields & READING_FIELD_ETOH) && decoded.etoh != full.etoh) ||
+            ((fields & READING_FIELD_IAQ) && decoded.iaq != full.iaq) ||
+            ((fields & READING_FIELD_TEMP) && decoded.temp != full.temp) ||
+            ((fields & READING_FIELD_BATTERY) && decoded.batteryPct != full.batteryPct) ||
+            ((fields & READING_FIELD_STATUS) && decoded.status != full.status) ||
+            ((fields & READING_FIELD_STAMP) && (decoded.seq != full.seq || decoded.ageS != 4321))) {
+            fail("metrics round trip, mask", fields);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t periodMs = 3000;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:")) != -1) {
+        switch (opt) {
+        case 'p':
+            periodMs = (uint32_t) strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-p sample period ms] [replay.csv]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (optind < argc) {
+        if (!readTrace(argv[optind], periodMs)) {
+            return 1;
+        }
+        printf("%zu readings from %s\n", numReadings, argv[optind]);
+    }
+    else {
+        makeTrace(periodMs);
+        printf("%zu readings of a made-up fridge trace\n", numReadings);
+    }
+
+    edgeCases(periodMs);
+
+    // One 7 byte write per reading is what the batch format is measured against
+    size_t legacyBytes = numReadings * READING_LEGACY_SIZE;
+    printf("\n%-9s %-6s %-6s %10s %10s %9s %8s\n", "format", "batch", "write", "records", "bytes", "B/reading", "ratio");
+    printf("%-9s %-6d %-6d %10zu %10zu %9.2f %8.2f\n", "7 byte", 1, READING_LEGACY_SIZE, numReadings, legacyBytes,
+           (double) READING_LEGACY_SIZE, 1.0);
+
+    static const size_t batchSizes[] = {1, 2, 4, 8, 16, 32};
+    static const size_t writeLens[] = {TEST_WRITE_DEFAULT, TEST_WRITE_LARGE};
+    for (int stamped = 0; stamped <= 1; stamped++) {
+        for (size_t w = 0; w < sizeof(writeLens) / sizeof(writeLens[0]); w++) {
+            for (size_t b = 0; b < sizeof(batchSizes) / sizeof(batchSizes[0]); b++) {
+                batch_result_t result = runBatches(readings, numReadings, batchSizes[b], stamped, writeLens[w], periodMs);
+                printf("%-9s %-6zu %-6zu %10zu %10zu %9.2f %8.2f\n", stamped ? "stamped" : "batch", batchSizes[b], writeLens[w],
+                       result.records, result.bytes, (double) result.bytes / numReadings,
+                       result.bytes ? (double) legacyBytes / result.bytes : 0.0);
+            }
+        }
+    }
+
+    // The puck only stamps a batch when it's no bigger than the 7 byte writes it replaces
+    for (size_t w = 0; w < sizeof(writeLens) / sizeof(writeLens[0]); w++) {
+        for (size_t b = 0; b < sizeof(batchSizes) / sizeof(batchSizes[0]); b++) {
+            size_t numStamped;
+            batch_result_t result = runPuck(readings, numReadings, batchSizes[b], writeLens[w], periodMs, &numStamped);
+            printf("%-9s %-6zu %-6zu %10zu %10zu %9.2f %8.2f  %3.0f%% stamped\n", "puck", batchSizes[b], writeLens[w],
+                   result.records, result.bytes, (double) result.bytes / numReadings,
+                   result.bytes ? (double) legacyBytes / result.bytes : 0.0, 100.0 * numStamped / numReadings);
+        }
+    }
+
+    if (failures > 0) {
+        printf("\n%u failures\n", (unsigned) failures);
+        return 1;
+    }
+    printf("\nEvery record round tripped\n");
+    return 0;
+}
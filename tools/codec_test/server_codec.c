@@ -0,0 +1,49 @@
+/*
+ * server_codec.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ *
+ * Built against the Bluetooth server's reading_codec.h, see server_codec.h.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "reading_codec.h"
+#include "server_codec.h"
+
+static void serverCopy(const puck_reading_t *in, server_reading_t *out) {
+    out->voc = in->voc;
+    out->temp = in->temp;
+    out->batteryLevel = in->battery_level;
+    out->eco2 = in->eco2;
+    out->etoh = in->etoh;
+    out->iaq = in->iaq;
+    out->status = in->status;
+    out->batteryPct = in->battery_pct;
+    out->seq = in->seq;
+    out->ageS = in->age_s;
+}
+
+int serverDecodeBatch(const uint8_t *buf, size_t len, server_reading_t *readings, size_t maxReadings, bool *stamped) {
+    static puck_reading_t decoded[READING_BATCH_MAX_COUNT];
+    if (maxReadings > READING_BATCH_MAX_COUNT) {
+        maxReadings = READING_BATCH_MAX_COUNT;
+    }
+    int count = reading_codec_decode_batch(buf, len, decoded, maxReadings, stamped);
+    for (int i = 0; i < count; i++) {
+        serverCopy(&decoded[i], &readings[i]);
+    }
+    return count;
+}
+
+int serverDecodeMetrics(const uint8_t *buf, size_t len, server_reading_t *reading) {
+    puck_reading_t decoded;
+    int fields = reading_codec_decode_metrics(buf, len, &decoded);
+    if (fields >= 0) {
+        serverCopy(&decoded, reading);
+    }
+    return fields;
+}
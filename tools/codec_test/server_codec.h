@@ -0,0 +1,35 @@
+/*
+ * server_codec.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ *
+ * The Bluetooth server's decoders, behind names and a reading type that don't clash with the puck's
+ * reading_codec.h, so codec_test can hold both ends at once.
+ */
+
+#ifndef SERVER_CODEC_H_
+#define SERVER_CODEC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef struct server_reading_t {
+    int32_t voc;
+    int16_t temp;
+    uint8_t batteryLevel;
+    uint16_t eco2;
+    uint16_t etoh;
+    uint8_t iaq;
+    uint8_t status;
+    uint8_t batteryPct;
+    uint16_t seq;
+    uint16_t ageS;
+} server_reading_t;
+
+// Same returns as reading_codec_decode_batch and reading_codec_decode_metrics
+int serverDecodeBatch(const uint8_t *buf, size_t len, server_reading_t *readings, size_t maxReadings, bool *stamped);
+int serverDecodeMetrics(const uint8_t *buf, size_t len, server_reading_t *reading);
+
+#endif /* SERVER_CODEC_H_ */
@@ -0,0 +1,348 @@
+/*
+ * env_fusion_test.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ *
+ * Feeds a temperature and humidity trace through the puck's ambient input fusion (env_fusion.c) and
+ * checks every output against a model of what it should do: the first good sample goes straight
+ * through, later ones are filtered, out of range values are clamped, failed reads hold the last
+ * values until there have been too many of them and then fall back to the defaults. The trace is the
+ * CSV that capture_replay writes (the temperature and humidity the puck fed the algorithm), or a
+ * made-up fridge trace read through the die sensor's 1 C resolution without one. The trace is run
+ * with and without humidity and with runs of failed reads of every length, along with edge cases
+ * the trace won't reach.
+ *
+ *   gcc -O2 -I../../CC2340R5_Firmware env_fusion_test.c ../../CC2340R5_Firmware/env_fusion.c -lm -o env_fusion_test
+ *
+ * Usage: env_fusion_test [-f samples between failed reads] [replay.csv]
+ *
+ * Exits with an error if any output is off.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "env_fusion.h"
+
+// A day of IAQ 2nd Gen samples
+#define TEST_MAX_SAMPLES        (24 * 60 * 20)
+#define TEST_SYNTHETIC_SAMPLES  (6 * 60 * 20)
+// The filter runs in float on the puck, the model in double
+#define TEST_TOLERANCE          0.01
+
+typedef struct trace_sample_t {
+    float temperatureDegC;
+    float humidityPct;
+} trace_sample_t;
+
+static trace_sample_t trace[TEST_MAX_SAMPLES];
+static size_t numSamples = 0;
+static uint32_t failures = 0;
+
+// Index of the named column in a CSV header, -1 if it isn't there
+static int csvColumn(const char *header, const char *name) {
+    int col = 0;
+    size_t nameLen = strlen(name);
+    const char *pos = header;
+    while (*pos != '\0') {
+        if (strncmp(pos, name, nameLen) == 0 && (pos[nameLen] == ',' || pos[nameLen] == '\n' || pos[nameLen] == '\r' ||
+                                                 pos[nameLen] == '\0')) {
+            return col;
+        }
+        pos = strchr(pos, ',');
+        if (pos == NULL) {
+            break;
+        }
+        pos++;
+        col++;
+    }
+    return -1;
+}
+
+static const char *csvField(const char *line, int col) {
+    for (int i = 0; i < col && line != NULL; i++) {
+        line = strchr(line, ',');
+        if (line != NULL) {
+            line++;
+        }
+    }
+    return line;
+}
+
+static bool readTrace(const char *path) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        perror(path);
+        return false;
+    }
+
+    char line[512];
+    if (fgets(line, sizeof(line), in) == NULL) {
+        fclose(in);
+        return false;
+    }
+    int tempCol = csvColumn(line, "temperature");
+    int humidityCol = csvColumn(line, "humidity");
+    if (tempCol < 0 || humidityCol < 0) {
+        fprintf(stderr, "%s isn't a capture_replay CSV\n", path);
+        fclose(in);
+        return false;
+    }
+
+    while (numSamples < TEST_MAX_SAMPLES && fgets(line, sizeof(line), in) != NULL) {
+        const char *temp = csvField(line, tempCol);
+        const char *humidity = csvField(line, humidityCol);
+        if (temp == NULL || humidity == NULL) {
+            continue;
+        }
+        trace[numSamples].temperatureDegC = strtof(temp, NULL);
+        trace[numSamples].humidityPct = strtof(humidity, NULL);
+        numSamples++;
+    }
+    fclose(in);
+    return numSamples > 0;
+}
+
+// A fridge at 4 C with the door opened every so often, read by a sensor with 1 C and 1 % resolution
+static void makeTrace(void) {
+    srand(1);
+    double temp = 4.0;
+    double humidity = 45.0;
+    for (numSamples = 0; numSamples < TEST_SYNTHETIC_SAMPLES; numSamples++) {
+        if (rand() % 400 == 0) {
+            temp += 8.0;
+            humidity += 20.0;
+        }
+        temp += (4.0 - temp) * 0.01 + ((rand() % 21) - 10) * 0.02;
+        humidity += (45.0 - humidity) * 0.02 + ((rand() % 21) - 10) * 0.05;
+        trace[numSamples].temperatureDegC = (float) round(temp);
+        trace[numSamples].humidityPct = (float) round(humidity);
+    }
+}
+
+static void fail(const char *run, const char *what, size_t index) {
+    if (failures < 20) {
+        fprintf(stderr, "FAIL %s: %s at sample %zu\n", run, what, index);
+    }
+    failures++;
+}
+
+// What env_fusion.c is meant to do, written from env_fusion.h
+typedef struct fusion_model_t {
+    double temperature;
+    double humidity;
+    bool hasTemperature;
+    bool hasHumidity;
+    uint32_t staleSamples;
+} fusion_model_t;
+
+static double clampD(double val, double min, double max) {
+    return (val < min) ? min : (val > max) ? max : val;
+}
+
+static void modelReset(fusion_model_t *model) {
+    memset(model, 0, sizeof(*model));
+}
+
+static void modelSample(fusion_model_t *model, const env_sample_t *sample, env_fusion_result_t *result) {
+    if (sample != NULL) {
+        double temp = clampD(sample->temperatureDegC, ENV_FUSION_MIN_TEMPERATURE_DEGC, ENV_FUSION_MAX_TEMPERATURE_DEGC);
+        model->temperature = model->hasTemperature ? model->temperature + ENV_FUSION_FILTER_ALPHA * (temp - model->temperature) : temp;
+        model->hasTemperature = true;
+        if (sample->hasHumidity) {
+            double humidity = clampD(sample->humidityPct, 0.0, 100.0);
+            model->humidity = model->hasHumidity ? model->humidity + ENV_FUSION_FILTER_ALPHA * (humidity - model->humidity) : humidity;
+            model->hasHumidity = true;
+        }
+        model->staleSamples = 0;
+    }
+    else if (model->staleSamples < ENV_FUSION_MAX_STALE_SAMPLES) {
+        model->staleSamples++;
+    }
+    else {
+        modelReset(model);
+    }
+    result->temperatureDegC = model->hasTemperature ? (float) model->temperature : ENV_FUSION_DEFAULT_TEMPERATURE_DEGC;
+    result->humidityPct = model->hasHumidity ? (float) model->humidity : ENV_FUSION_DEFAULT_HUMIDITY_PCT;
+    result->measured = model->hasTemperature;
+}
+
+// The source the fusion reads, playing the trace back and failing reads where it's told to
+typedef struct trace_source_t {
+    const trace_sample_t *samples;
+    size_t count;
+    size_t pos;
+    bool hasHumidity;
+    const bool *readFails;      // Per sample, NULL if every read works
+} trace_source_t;
+
+static bool traceRead(void *ctx, env_sample_t *sample) {
+    trace_source_t *source = ctx;
+    size_t pos = source->pos++;
+    if (pos >= source->count || (source->readFails != NULL && source->readFails[pos])) {
+        return false;
+    }
+    sample->temperatureDegC = source->samples[pos].temperatureDegC;
+    sample->humidityPct = source->samples[pos].humidityPct;
+    sample->hasHumidity = source->hasHumidity;
+    return true;
+}
+
+static bool resultsMatch(const env_fusion_result_t *got, const env_fusion_result_t *want) {
+    return got->measured == want->measured && fabs(got->temperatureDegC - want->temperatureDegC) <= TEST_TOLERANCE &&
+           fabs(got->humidityPct - want->humidityPct) <= TEST_TOLERANCE;
+}
+
+typedef struct run_result_t {
+    uint32_t resets;            // Times the output went back to the defaults
+    double maxStepIn;           // Largest change between good samples
+    double maxStepOut;          // Largest change between outputs while measured
+} run_result_t;
+
+// Plays the samples through EnvFusion and the model side by side
+static run_result_t runTrace(const char *name, const trace_sample_t *samples, size_t count, bool hasHumidity,
+                             const bool *readFails) {
+    run_result_t run = {0, 0, 0};
+    trace_source_t trace = {samples, count, 0, hasHumidity, readFails};
+    env_source_t source = {name, traceRead, &trace};
+    fusion_model_t model;
+    modelReset(&model);
+    EnvFusion_setSource(&source);
+
+    env_fusion_result_t prev = {0};
+    const trace_sample_t *prevSample = NULL;
+    for (size_t i = 0; i < count; i++) {
+        env_fusion_result_t got;
+        env_fusion_result_t want;
+        EnvFusion_sample(&got);
+
+        bool good = readFails == NULL || !readFails[i];
+        env_sample_t sample = {samples[i].temperatureDegC, samples[i].humidityPct, hasHumidity};
+        modelSample(&model, good ? &sample : NULL, &want);
+
+        if (!resultsMatch(&got, &want)) {
+            fail(name, "output differs from the model", i);
+        }
+        if (!isfinite(got.temperatureDegC) || got.temperatureDegC < ENV_FUSION_MIN_TEMPERATURE_DEGC ||
+            got.temperatureDegC > ENV_FUSION_MAX_TEMPERATURE_DEGC || !isfinite(got.humidityPct) ||
+            got.humidityPct < 0.0f || got.humidityPct > 100.0f) {
+            fail(name, "output out of range", i);
+        }
+        if (!hasHumidity && got.humidityPct != ENV_FUSION_DEFAULT_HUMIDITY_PCT) {
+            fail(name, "humidity without a humidity sensor", i);
+        }
+
+        if (i > 0 && prev.measured && !got.measured) {
+            run.resets++;
+        }
+        if (good) {
+            if (prevSample != NULL && fabs(samples[i].temperatureDegC - prevSample->temperatureDegC) > run.maxStepIn) {
+                run.maxStepIn = fabs(samples[i].temperatureDegC - prevSample->temperatureDegC);
+            }
+            prevSample = &samples[i];
+        }
+        if (i > 0 && prev.measured && got.measured && fabs(got.temperatureDegC - prev.temperatureDegC) > run.maxStepOut) {
+            run.maxStepOut = fabs(got.temperatureDegC - prev.temperatureDegC);
+        }
+        prev = got;
+    }
+    return run;
+}
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        fail("edge cases", what, 0);
+    }
+}
+
+static void runEdgeCases(void) {
+    env_fusion_result_t result;
+
+    // No source at all, or one that never answers: the defaults, not measured
+    EnvFusion_setSource(NULL);
+    EnvFusion_sample(&result);
+    check(!result.measured && result.temperatureDegC == ENV_FUSION_DEFAULT_TEMPERATURE_DEGC &&
+          result.humidityPct == ENV_FUSION_DEFAULT_HUMIDITY_PCT, "defaults without a source");
+
+    // Out of range samples are clamped, and the first one isn't eased into from the default
+    static const trace_sample_t extremes[] = {{120.0f, 130.0f}, {-60.0f, -5.0f}};
+    trace_source_t trace = {extremes, 1, 0, true, NULL};
+    env_source_t source = {"extremes", traceRead, &trace};
+    EnvFusion_setSource(&source);
+    EnvFusion_sample(&result);
+    check(result.measured && result.temperatureDegC == ENV_FUSION_MAX_TEMPERATURE_DEGC && result.humidityPct == 100.0f,
+          "clamped to the top of the range");
+    trace = (trace_source_t) {&extremes[1], 1, 0, true, NULL};
+    EnvFusion_setSource(&source);
+    EnvFusion_sample(&result);
+    check(result.temperatureDegC == ENV_FUSION_MIN_TEMPERATURE_DEGC && result.humidityPct == 0.0f,
+          "clamped to the bottom of the range");
+
+    // Setting a source starts over
+    static const trace_sample_t cold[] = {{2.0f, 80.0f}};
+    trace = (trace_source_t) {cold, 1, 0, true, NULL};
+    EnvFusion_setSource(&source);
+    EnvFusion_sample(&result);
+    check(result.temperatureDegC == 2.0f && result.humidityPct == 80.0f, "new source starts from its first sample");
+
+    // Holds through ENV_FUSION_MAX_STALE_SAMPLES failed reads, the next one drops to the defaults
+    for (int i = 0; i < ENV_FUSION_MAX_STALE_SAMPLES; i++) {
+        EnvFusion_sample(&result);
+        check(result.measured && result.temperatureDegC == 2.0f, "held through failed reads");
+    }
+    EnvFusion_sample(&result);
+    check(!result.measured && result.temperatureDegC == ENV_FUSION_DEFAULT_TEMPERATURE_DEGC &&
+          result.humidityPct == ENV_FUSION_DEFAULT_HUMIDITY_PCT, "defaults once too stale");
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t failEvery = 200;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:")) != -1) {
+        switch (opt) {
+            case 'f': failEvery = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "Usage: %s [-f samples between failed reads] [replay.csv]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind < argc) {
+        if (!readTrace(argv[optind])) {
+            return 1;
+        }
+    }
+    else {
+        makeTrace();
+    }
+
+    // Runs of failed reads from 1 to a few past the point the values stop being trusted
+    static bool readFails[TEST_MAX_SAMPLES];
+    uint32_t failedReads = 0;
+    uint32_t runLength = 1;
+    for (size_t i = (failEvery > 0) ? failEvery : numSamples; i < numSamples; i += failEvery + runLength) {
+        for (uint32_t j = 0; j < runLength && i + j < numSamples; j++) {
+            readFails[i + j] = true;
+            failedReads++;
+        }
+        runLength = (runLength % (ENV_FUSION_MAX_STALE_SAMPLES + 3)) + 1;
+    }
+
+    run_result_t clean = runTrace("trace", trace, numSamples, true, NULL);
+    run_result_t noHumidity = runTrace("trace without humidity", trace, numSamples, false, NULL);
+    run_result_t flaky = runTrace("trace with failed reads", trace, numSamples, true, readFails);
+    runEdgeCases();
+
+    printf("Trace:         %zu samples%s\n", numSamples, (optind < argc) ? "" : " (made up)");
+    printf("Clean:         largest step %.2f C in, %.2f C out, %u resets\n", clean.maxStepIn, clean.maxStepOut,
+           clean.resets);
+    printf("No humidity:   %u resets\n", noHumidity.resets);
+    printf("Failed reads:  %u of them, %u resets to the defaults\n", failedReads, flaky.resets);
+    printf("Checks:        %u failures\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,34 @@
+/*
+ * FreeRTOS.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ *
+ * Just enough of FreeRTOS for i2c_bus.c to build on a PC. There is only the one thread, time is the
+ * mock bus's clock, and the critical sections and the mutex are tracked so the benchmark can check
+ * how the bus layer uses them.
+ */
+
+#ifndef BENCH_FREERTOS_H_
+#define BENCH_FREERTOS_H_
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+
+#define pdPASS                  1
+#define pdFAIL                  0
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define portMAX_DELAY           ((TickType_t) 0xFFFFFFFF)
+#define configTICK_RATE_HZ      1000
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t) (((uint64_t) (ms) * configTICK_RATE_HZ) / 1000))
+
+void vTaskEnterCritical(void);
+void vTaskExitCritical(void);
+#define taskENTER_CRITICAL()    vTaskEnterCritical()
+#define taskEXIT_CRITICAL()     vTaskExitCritical()
+
+#endif /* BENCH_FREERTOS_H_ */
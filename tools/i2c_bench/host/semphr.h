@@ -0,0 +1,19 @@
+/*
+ * semphr.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef BENCH_SEMPHR_H_
+#define BENCH_SEMPHR_H_
+
+#include "FreeRTOS.h"
+
+typedef struct bench_mutex_t *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticksToWait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex);
+
+#endif /* BENCH_SEMPHR_H_ */
@@ -0,0 +1,15 @@
+/*
+ * task.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef BENCH_TASK_H_
+#define BENCH_TASK_H_
+
+#include "FreeRTOS.h"
+
+TickType_t xTaskGetTickCount(void);
+
+#endif /* BENCH_TASK_H_ */
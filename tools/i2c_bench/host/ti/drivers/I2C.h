@@ -0,0 +1,42 @@
+/*
+ * I2C.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef BENCH_I2C_H_
+#define BENCH_I2C_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// The subset of the TI I2C driver i2c_bus.c uses, answered by the mock bus in i2c_bench.c
+
+typedef enum I2C_BitRate {
+    I2C_100kHz = 0,
+    I2C_400kHz = 1,
+    I2C_1000kHz = 2,
+} I2C_BitRate;
+
+typedef struct I2C_Params {
+    I2C_BitRate bitRate;
+} I2C_Params;
+
+typedef struct I2C_Transaction {
+    const void *writeBuf;
+    size_t writeCount;
+    void *readBuf;
+    size_t readCount;
+    uint_least8_t targetAddress;
+} I2C_Transaction;
+
+typedef struct bench_i2c_t *I2C_Handle;
+
+void I2C_init(void);
+void I2C_Params_init(I2C_Params *params);
+I2C_Handle I2C_open(uint_least8_t index, I2C_Params *params);
+bool I2C_transfer(I2C_Handle handle, I2C_Transaction *transaction);
+
+#endif /* BENCH_I2C_H_ */
@@ -0,0 +1,17 @@
+/*
+ * ti_drivers_config.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef BENCH_TI_DRIVERS_CONFIG_H_
+#define BENCH_TI_DRIVERS_CONFIG_H_
+
+#include <ti/drivers/I2C.h>
+
+// What SysConfig generates for the ZMOD's bus in fridge_puck.syscfg
+#define CONFIG_I2C_0            0
+#define CONFIG_I2C_0_MAXBITRATE I2C_400kHz
+
+#endif /* BENCH_TI_DRIVERS_CONFIG_H_ */
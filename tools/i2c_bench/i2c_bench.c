@@ -0,0 +1,351 @@
+/*
+ * i2c_bench.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ *
+ * Runs the puck's shared I2C bus layer (i2c_bus.c) on a PC against a mock bus and a mock ZMOD with
+ * an auto incrementing register file. Checks that register writes of every length are framed in
+ * chunks that read back as written, that a failed transfer stops a write and is counted, that every
+ * transfer happens with the bus lock held, and that the lock is created once, outside a critical
+ * section, before anyone opens the bus. Then measures how long the bus is held for the sensor's
+ * init and measurement cycle at each bit rate, from the bits on the wire and a per transfer and per
+ * byte driver overhead, next to what the puck's own bus stats make of it in 1 ms ticks.
+ *
+ *   gcc -O2 -Ihost -I../../CC2340R5_Firmware i2c_bench.c ../../CC2340R5_Firmware/i2c_bus.c -o i2c_bench
+ *
+ * Usage: i2c_bench [-n measurement cycles] [-t transfer overhead us] [-b byte overhead us] [-r seed]
+ *
+ * Exits with an error if any check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "ti_drivers_config.h"
+#include "i2c_bus.h"
+
+#define BENCH_ZMOD_ADDR         0x32
+#define BENCH_ROUND_TRIPS       2000
+
+static const uint32_t bitRates[] = {[I2C_100kHz] = 100000, [I2C_400kHz] = 400000, [I2C_1000kHz] = 1000000};
+static const char *bitRateNames[] = {[I2C_100kHz] = "100 kHz", [I2C_400kHz] = "400 kHz", [I2C_1000kHz] = "1 MHz"};
+
+struct bench_mutex_t {
+    bool held;
+};
+
+struct bench_i2c_t {
+    I2C_BitRate bitRate;
+};
+
+// The mock bus, timed in microseconds
+static uint64_t nowUs = 0;
+static uint32_t transferOverheadUs = 30;
+static uint32_t byteOverheadUs = 2;
+static struct bench_i2c_t bus;
+static bool busOpen = false;
+static uint32_t busOpens = 0;
+static int criticalNesting = 0;
+static uint32_t mutexesCreated = 0;
+static struct bench_mutex_t mutexes[4];
+
+// The mock target
+static uint8_t regs[256];
+static uint32_t failTransfer = 0;       // Transfer number the target NACKs, 0 for none
+static uint32_t transfers = 0;
+static size_t maxWriteCount = 0;
+
+static uint32_t failures = 0;
+
+static void fail(const char *what) {
+    if (failures < 20) {
+        fprintf(stderr, "FAIL %s\n", what);
+    }
+    failures++;
+}
+
+void vTaskEnterCritical(void) {
+    criticalNesting++;
+}
+
+void vTaskExitCritical(void) {
+    criticalNesting--;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t) (nowUs / 1000);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    // Allocates from the FreeRTOS heap, which isn't allowed with interrupts off
+    if (criticalNesting > 0) {
+        fail("mutex created inside a critical section");
+    }
+    if (mutexesCreated == sizeof(mutexes) / sizeof(mutexes[0])) {
+        return NULL;
+    }
+    return &mutexes[mutexesCreated++];
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticksToWait) {
+    (void) ticksToWait;
+    // One thread, so it can only already be held if someone forgot to give it back
+    if (mutex->held) {
+        fail("bus lock taken twice");
+    }
+    mutex->held = true;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+    if (!mutex->held) {
+        fail("bus lock given back without being held");
+    }
+    mutex->held = false;
+    return pdTRUE;
+}
+
+void I2C_init(void) {
+}
+
+void I2C_Params_init(I2C_Params *params) {
+    params->bitRate = I2C_100kHz;
+}
+
+I2C_Handle I2C_open(uint_least8_t index, I2C_Params *params) {
+    if (busOpen || index != CONFIG_I2C_0) {
+        return NULL;
+    }
+    busOpen = true;
+    busOpens++;
+    bus.bitRate = params->bitRate;
+    return &bus;
+}
+
+// Start, address and ack, the bytes with their acks, then a repeated start for the read, and stop
+static uint64_t transferBits(size_t writeCount, size_t readCount) {
+    uint64_t bits = 1 + 9 + 9 * (uint64_t) writeCount + 1;
+    if (readCount > 0) {
+        bits += 1 + 9 + 9 * (uint64_t) readCount;
+    }
+    return bits;
+}
+
+static uint64_t transferUs(I2C_BitRate bitRate, size_t writeCount, size_t readCount) {
+    return (transferBits(writeCount, readCount) * 1000000 + bitRates[bitRate] - 1) / bitRates[bitRate] +
+           transferOverheadUs + byteOverheadUs * (writeCount + readCount);
+}
+
+bool I2C_transfer(I2C_Handle handle, I2C_Transaction *transaction) {
+    if (handle != &bus || !busOpen) {
+        fail("transfer on a bus that isn't open");
+        return false;
+    }
+    if (mutexesCreated == 0 || !mutexes[0].held) {
+        fail("transfer without holding the bus lock");
+    }
+    transfers++;
+    if (transaction->writeCount > maxWriteCount) {
+        maxWriteCount = transaction->writeCount;
+    }
+    nowUs += transferUs(handle->bitRate, transaction->writeCount, transaction->readCount);
+    if (transaction->targetAddress != BENCH_ZMOD_ADDR || transaction->writeCount == 0 || transfers == failTransfer) {
+        return false;
+    }
+
+    // The first byte written sets the register address, everything after it auto increments
+    const uint8_t *write = transaction->writeBuf;
+    uint8_t reg = write[0];
+    for (size_t i = 1; i < transaction->writeCount; i++) {
+        regs[reg++] = write[i];
+    }
+    uint8_t *read = transaction->readBuf;
+    for (size_t i = 0; i < transaction->readCount; i++) {
+        read[i] = regs[reg++];
+    }
+    return true;
+}
+
+static void runChecks(void) {
+    uint8_t buf[256];
+
+    if (I2CBus_open()) {
+        fail("bus opened before the lock was created");
+    }
+    if (!I2CBus_init() || !I2CBus_init() || mutexesCreated != 1) {
+        fail("bus lock not created exactly once");
+    }
+    if (!I2CBus_open() || !I2CBus_open() || busOpens != 1) {
+        fail("bus not opened exactly once");
+    }
+
+    // Random lengths up to a few chunks, at offsets they fit in
+    for (int i = 0; i < BENCH_ROUND_TRIPS; i++) {
+        size_t len = 1 + rand() % (4 * I2C_BUS_WRITE_CHUNK);
+        uint8_t reg = (uint8_t) (rand() % (256 - len));
+        uint8_t data[4 * I2C_BUS_WRITE_CHUNK];
+        for (size_t j = 0; j < len; j++) {
+            data[j] = (uint8_t) rand();
+        }
+        uint32_t before = transfers;
+        if (!I2CBus_writeReg(BENCH_ZMOD_ADDR, reg, data, len)) {
+            fail("write failed");
+        }
+        if (transfers - before != (len + I2C_BUS_WRITE_CHUNK - 1) / I2C_BUS_WRITE_CHUNK) {
+            fail("write not split into the fewest chunks");
+        }
+        if (!I2CBus_readReg(BENCH_ZMOD_ADDR, reg, buf, len) || memcmp(buf, data, len) != 0) {
+            fail("register doesn't read back as written");
+        }
+    }
+    if (maxWriteCount > 1 + I2C_BUS_WRITE_CHUNK) {
+        fail("write frame longer than a chunk");
+    }
+
+    // A NACK part way through a write stops it there, and both kinds of failure are counted
+    i2c_bus_stats_t before;
+    i2c_bus_stats_t after;
+    I2CBus_getStats(&before);
+    memset(regs, 0, sizeof(regs));
+    memset(buf, 0xAA, sizeof(buf));
+    failTransfer = transfers + 2;
+    if (I2CBus_writeReg(BENCH_ZMOD_ADDR, 0, buf, 3 * I2C_BUS_WRITE_CHUNK)) {
+        fail("write succeeded through a NACK");
+    }
+    if (transfers != failTransfer || regs[I2C_BUS_WRITE_CHUNK] != 0 || regs[I2C_BUS_WRITE_CHUNK - 1] != 0xAA) {
+        fail("write went on after a NACK");
+    }
+    failTransfer = transfers + 1;
+    if (I2CBus_readReg(BENCH_ZMOD_ADDR, 0, buf, 1)) {
+        fail("read succeeded through a NACK");
+    }
+    failTransfer = 0;
+    I2CBus_getStats(&after);
+    if (after.transfers != before.transfers + 2 || after.failures != before.failures + 2) {
+        fail("failed transfers not counted");
+    }
+    if (mutexes[0].held) {
+        fail("bus lock still held");
+    }
+}
+
+// Register accesses of the ZMOD4410 running IAQ 2nd Gen, roughly as the Renesas driver makes them
+typedef struct bench_access_t {
+    bool write;
+    uint8_t reg;
+    uint8_t len;
+} bench_access_t;
+
+static const bench_access_t initAccesses[] = {
+    {false, 0x00, 2},   // Product ID
+    {false, 0x3A, 6},   // Tracking number
+    {false, 0x26, 7},   // Production data
+    {true, 0x40, 8},    // Heater, delay, measurement and sequencer configuration
+    {true, 0x50, 8},
+    {true, 0x60, 4},
+    {true, 0x68, 36},
+};
+
+static const bench_access_t cycleAccesses[] = {
+    {true, 0x93, 1},    // Start the measurement
+    {false, 0x94, 1},   // Status
+    {false, 0x97, 32},  // ADC results
+    {false, 0xB7, 1},   // Error event
+};
+
+typedef struct bench_result_t {
+    uint64_t busUs;
+    uint32_t transfers;
+    uint32_t statsTicks;
+} bench_result_t;
+
+static bench_result_t runAccesses(const bench_access_t *accesses, size_t count, uint32_t repeats) {
+    uint8_t buf[256] = {0};
+    i2c_bus_stats_t before;
+    i2c_bus_stats_t after;
+    I2CBus_getStats(&before);
+    uint64_t startUs = nowUs;
+    uint32_t startTransfers = transfers;
+    uint64_t gapUs = 0;
+
+    for (uint32_t i = 0; i < repeats; i++) {
+        for (size_t j = 0; j < count; j++) {
+            bool ok = accesses[j].write ? I2CBus_writeReg(BENCH_ZMOD_ADDR, accesses[j].reg, buf, accesses[j].len)
+                                        : I2CBus_readReg(BENCH_ZMOD_ADDR, accesses[j].reg, buf, accesses[j].len);
+            if (!ok) {
+                fail("benchmark access failed");
+            }
+        }
+        // Whatever the sensor thread does between cycles, so the tick rounding lands anywhere
+        uint64_t gap = 3000000 + rand() % 1000;
+        nowUs += gap;
+        gapUs += gap;
+    }
+
+    I2CBus_getStats(&after);
+    bench_result_t result = {
+        .busUs = (nowUs - startUs) - gapUs,
+        .transfers = transfers - startTransfers,
+        .statsTicks = after.busTicks - before.busTicks,
+    };
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t cycles = 1200;
+    unsigned seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:b:r:")) != -1) {
+        switch (opt) {
+            case 'n': cycles = strtoul(optarg, NULL, 0); break;
+            case 't': transferOverheadUs = strtoul(optarg, NULL, 0); break;
+            case 'b': byteOverheadUs = strtoul(optarg, NULL, 0); break;
+            case 'r': seed = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "Usage: %s [-n measurement cycles] [-t transfer overhead us] [-b byte overhead us] "
+                                "[-r seed]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (cycles == 0) {
+        fprintf(stderr, "Needs at least one measurement cycle\n");
+        return 1;
+    }
+    srand(seed);
+
+    runChecks();
+
+    printf("Overhead:      %u us per transfer, %u us per byte\n", transferOverheadUs, byteOverheadUs);
+    printf("\n%-8s %14s %14s %14s %22s\n", "Bit rate", "init us", "cycle us", "busy per hour", "stats ms (modelled)");
+    for (int rate = I2C_100kHz; rate <= I2C_1000kHz; rate++) {
+        bus.bitRate = (I2C_BitRate) rate;
+        bench_result_t init = runAccesses(initAccesses, sizeof(initAccesses) / sizeof(initAccesses[0]), 1);
+        bench_result_t cycle = runAccesses(cycleAccesses, sizeof(cycleAccesses) / sizeof(cycleAccesses[0]), cycles);
+        double cycleUs = (double) cycle.busUs / cycles;
+        printf("%-8s %14llu %14.1f %11.1f ms %14u (%.0f)\n", bitRateNames[rate], (unsigned long long) init.busUs,
+               cycleUs, cycleUs * 1200 / 1000, cycle.statsTicks, cycle.busUs / 1000.0);
+    }
+
+    // What the chunking costs over one frame per write, for the sequencer sized write
+    bus.bitRate = CONFIG_I2C_0_MAXBITRATE;
+    size_t len = initAccesses[sizeof(initAccesses) / sizeof(initAccesses[0]) - 1].len;
+    size_t chunks = (len + I2C_BUS_WRITE_CHUNK - 1) / I2C_BUS_WRITE_CHUNK;
+    uint64_t chunkedUs = 0;
+    for (size_t i = 0; i < chunks; i++) {
+        size_t chunkLen = (i + 1 < chunks) ? I2C_BUS_WRITE_CHUNK : len - i * I2C_BUS_WRITE_CHUNK;
+        chunkedUs += transferUs(bus.bitRate, 1 + chunkLen, 0);
+    }
+    printf("\nChunking:      a %zu byte write at %s is %zu transfers, %llu us against %llu us in one\n", len,
+           bitRateNames[bus.bitRate], chunks, (unsigned long long) chunkedUs,
+           (unsigned long long) transferUs(bus.bitRate, 1 + len, 0));
+    printf("Checks:        %u failures\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
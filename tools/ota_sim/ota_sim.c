@@ -0,0 +1,392 @@
+/*
+ * ota_sim.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ *
+ * Runs a puck firmware update on a PC: the base station's distributor (ota_dist.c) and the puck's
+ * client (ota_client.c) talk over a simulated link, with both flash stores held in RAM. The image is
+ * staged the way the WiFi server would stage it, then the puck pulls it over as many upload
+ * connections as it takes. Connections drop at random, and the puck starts every connection from what
+ * it left in flash, so resuming gets exercised as much as the transfer. Prints how long it took on the
+ * air and how much of the image had to be sent.
+ *
+ *   gcc -O2 -DOTA_CLIENT_HOST -DOTA_DIST_HOST -I../../CC2340R5_Firmware -I../../ESP_32_Bluetooth_Controller/main \
+ *       ota_sim.c ../../CC2340R5_Firmware/ota_client.c ../../ESP_32_Bluetooth_Controller/main/ota_dist.c -o ota_sim
+ *
+ * Usage: ota_sim [-o old image] [-n new image] [-s synthetic size] [-c % of blocks changed] [-m MTU]
+ *                [-i connection interval ms] [-p packet error rate] [-d disconnect chance per request]
+ *                [-x requests per connection] [-u upload period s] [-f] [-r seed]
+ *
+ * Without -o and -n, a random image of -s bytes is made up, and -c % of its blocks changed for the new one.
+ * -f fetches everything, as a puck with nothing in common with the new image would.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ota_client.h"
+#include "ota_dist.h"
+
+// Same layout as the real regions: 4 KB sectors on the ESP32, 2 KB on the CC2340R5
+#define SIM_DIST_STORE_SIZE     (512 * 1024)
+#define SIM_DIST_SECTOR_SIZE    4096
+#define SIM_PUCK_STORE_SIZE     0x39800
+#define SIM_PUCK_SECTOR_SIZE    2048
+#define SIM_MAX_IMAGE           (SIM_PUCK_STORE_SIZE - SIM_PUCK_SECTOR_SIZE)
+// Connection events for a request and its response, the response goes out on the event after the request
+#define SIM_EVENTS_PER_REQUEST  2
+// Connect, discovery and disconnect, on top of the requests (roughly what the phase stats show)
+#define SIM_CONNECT_OVERHEAD_MS 1500
+#define SIM_MAX_CONNECTIONS     100000
+#define SIM_CONN_ID             0
+
+typedef struct sim_flash_t {
+    uint8_t *data;
+    size_t size;
+    size_t sectorSize;
+    uint32_t erases;
+    uint32_t badWrites;     // Writes that tried to turn a zero back into a one
+} sim_flash_t;
+
+typedef struct sim_link_t {
+    size_t mtu;
+    double intervalMs;
+    double per;
+    double disconnectChance;
+    bool down;
+    double airMs;
+    uint64_t bytesOnAir;
+    uint32_t requests;
+    uint32_t disconnects;
+} sim_link_t;
+
+static uint8_t oldImage[SIM_MAX_IMAGE];
+static uint8_t newImage[SIM_MAX_IMAGE];
+static size_t oldSize = 0;
+static size_t newSize = 0;
+
+static uint8_t distFlash[SIM_DIST_STORE_SIZE];
+static uint8_t puckFlash[SIM_PUCK_STORE_SIZE];
+
+static double randUnit(void) {
+    return rand() / (RAND_MAX + 1.0);
+}
+
+static bool flashRead(void *ctx, uint32_t offset, void *buf, size_t len) {
+    sim_flash_t *flash = ctx;
+    if (offset + len > flash->size) {
+        return false;
+    }
+    memcpy(buf, &flash->data[offset], len);
+    return true;
+}
+
+// NOR flash only clears bits, which is what the puck's progress words rely on
+static bool flashWrite(void *ctx, uint32_t offset, const void *buf, size_t len) {
+    sim_flash_t *flash = ctx;
+    const uint8_t *bytes = buf;
+    if (offset + len > flash->size) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (bytes[i] & ~flash->data[offset + i]) {
+            flash->badWrites++;
+        }
+        flash->data[offset + i] &= bytes[i];
+    }
+    return true;
+}
+
+static bool flashErase(void *ctx, uint32_t offset, size_t len) {
+    sim_flash_t *flash = ctx;
+    if (offset % flash->sectorSize != 0 || len % flash->sectorSize != 0 || offset + len > flash->size) {
+        return false;
+    }
+    memset(&flash->data[offset], 0xFF, len);
+    flash->erases += len / flash->sectorSize;
+    return true;
+}
+
+static bool runningRead(void *ctx, uint32_t offset, void *buf, size_t len) {
+    (void) ctx;
+    if (offset + len > oldSize) {
+        return false;
+    }
+    memcpy(buf, &oldImage[offset], len);
+    return true;
+}
+
+// One ATT request and its response, each retried until it gets through
+static bool linkRequest(sim_link_t *link, size_t reqLen, size_t rspLen) {
+    if (link->down) {
+        return false;
+    }
+    link->requests++;
+    link->airMs += SIM_EVENTS_PER_REQUEST * link->intervalMs;
+    while (randUnit() < link->per) {
+        link->airMs += link->intervalMs;
+    }
+    // ATT and L2CAP headers on both packets
+    link->bytesOnAir += reqLen + rspLen + 2 * 4 + 1;
+    if (randUnit() < link->disconnectChance) {
+        link->down = true;
+        link->disconnects++;
+        ota_dist_disconnect(SIM_CONN_ID);
+        return false;
+    }
+    return true;
+}
+
+static bool linkWrite(void *ctx, const uint8_t *buf, size_t len) {
+    sim_link_t *link = ctx;
+    if (!linkRequest(link, len + 2, 0)) {
+        return false;
+    }
+    ota_dist_handle_request(SIM_CONN_ID, buf, len);
+    return true;
+}
+
+static size_t linkRead(void *ctx, uint8_t *buf, size_t len) {
+    sim_link_t *link = ctx;
+    uint8_t rsp[OTA_CLIENT_MAX_READ];
+    size_t maxLen = (len < link->mtu - 1) ? len : link->mtu - 1;
+    size_t rspLen = ota_dist_read(SIM_CONN_ID, rsp, maxLen);
+    if (!linkRequest(link, 2, rspLen)) {
+        return 0;
+    }
+    memcpy(buf, rsp, rspLen);
+    return rspLen;
+}
+
+static size_t loadImage(const char *path, uint8_t *buf) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    }
+    size_t len = fread(buf, 1, SIM_MAX_IMAGE, file);
+    if (!feof(file)) {
+        fprintf(stderr, "%s is bigger than the puck's staging region (%d bytes)\n", path, SIM_MAX_IMAGE);
+        exit(1);
+    }
+    fclose(file);
+    return len;
+}
+
+// Stages the image the way the WiFi server passes it down the UART link, returns the number of messages
+static uint32_t stageImage(uint32_t version, double *uartMs) {
+    uint8_t msg[20];
+    uint8_t ack[OTA_STAGE_ACK_LEN];
+    uint32_t crc = ota_crc32(0, newImage, newSize);
+    uint32_t numMsgs = 0;
+    size_t uartBytes = 0;
+
+    msg[0] = RECORD_TAG_OTA_STAGE_BEGIN;
+    for (int i = 0; i < 4; i++) {
+        msg[1 + i] = newSize >> (24 - 8 * i);
+        msg[5 + i] = crc >> (24 - 8 * i);
+        msg[9 + i] = version >> (24 - 8 * i);
+    }
+    ota_dist_handle_stage_msg(msg, 13, ack);
+    numMsgs++;
+    uartBytes += 13 + OTA_STAGE_ACK_LEN;
+
+    for (size_t offset = 0; offset < newSize; ) {
+        size_t len = (newSize - offset < 15) ? newSize - offset : 15;
+        msg[0] = RECORD_TAG_OTA_STAGE_WRITE;
+        for (int i = 0; i < 4; i++) {
+            msg[1 + i] = offset >> (24 - 8 * i);
+        }
+        memcpy(&msg[5], &newImage[offset], len);
+        ota_dist_handle_stage_msg(msg, 5 + len, ack);
+        numMsgs++;
+        uartBytes += 5 + len + OTA_STAGE_ACK_LEN;
+        offset = ((uint32_t) ack[2] << 24) | (ack[3] << 16) | (ack[4] << 8) | ack[5];
+        if (ack[1] != OTA_STATUS_OK) {
+            fprintf(stderr, "Staging refused at offset %zu, status %d\n", offset, ack[1]);
+            exit(1);
+        }
+    }
+
+    msg[0] = RECORD_TAG_OTA_STAGE_END;
+    ota_dist_handle_stage_msg(msg, 1, ack);
+    numMsgs++;
+    uartBytes += 1 + OTA_STAGE_ACK_LEN;
+    if (ack[1] != OTA_STATUS_OK) {
+        fprintf(stderr, "Staged image didn't check out, status %d\n", ack[1]);
+        exit(1);
+    }
+
+    // Sync, length, id and checksum on every message, 10 bits a byte at 115200 baud
+    *uartMs = (uartBytes + 4.0 * 2 * numMsgs) * 10 * 1000 / 115200;
+    return numMsgs;
+}
+
+int main(int argc, char *argv[]) {
+    const char *oldPath = NULL;
+    const char *newPath = NULL;
+    size_t syntheticSize = 200 * 1024;
+    double changedPct = 5;
+    bool fullFetch = false;
+    uint32_t maxRequests = 1000;
+    double uploadPeriodS = 60;
+    unsigned seed = 1;
+    sim_link_t link = {
+        .mtu = 23,
+        .intervalMs = 30,
+        .per = 0.05,
+        .disconnectChance = 0.001,
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:n:s:c:m:i:p:d:x:u:fr:")) != -1) {
+        switch (opt) {
+            case 'o': oldPath = optarg; break;
+            case 'n': newPath = optarg; break;
+            case 's': syntheticSize = strtoul(optarg, NULL, 0); break;
+            case 'c': changedPct = atof(optarg); break;
+            case 'm': link.mtu = strtoul(optarg, NULL, 0); break;
+            case 'i': link.intervalMs = atof(optarg); break;
+            case 'p': link.per = atof(optarg); break;
+            case 'd': link.disconnectChance = atof(optarg); break;
+            case 'x': maxRequests = strtoul(optarg, NULL, 0); break;
+            case 'u': uploadPeriodS = atof(optarg); break;
+            case 'f': fullFetch = true; break;
+            case 'r': seed = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "Usage: %s [-o old] [-n new] [-s size] [-c %%changed] [-m mtu] [-i interval ms] "
+                                "[-p per] [-d disconnect chance] [-x requests per connection] [-u upload period s] "
+                                "[-f] [-r seed]\n", argv[0]);
+                return 1;
+        }
+    }
+    srand(seed);
+    if (link.mtu < 23 || link.mtu - 1 > OTA_CLIENT_MAX_READ) {
+        fprintf(stderr, "MTU has to be between 23 and %d\n", OTA_CLIENT_MAX_READ + 1);
+        return 1;
+    }
+
+    if (oldPath != NULL && newPath != NULL) {
+        oldSize = loadImage(oldPath, oldImage);
+        newSize = loadImage(newPath, newImage);
+    }
+    else {
+        if (syntheticSize == 0 || syntheticSize > SIM_MAX_IMAGE) {
+            fprintf(stderr, "Size has to be between 1 and %d\n", SIM_MAX_IMAGE);
+            return 1;
+        }
+        oldSize = newSize = syntheticSize;
+        for (size_t i = 0; i < oldSize; i++) {
+            oldImage[i] = rand();
+        }
+        memcpy(newImage, oldImage, newSize);
+        for (size_t block = 0; block * OTA_BLOCK_SIZE < newSize; block++) {
+            if (randUnit() * 100 < changedPct) {
+                newImage[block * OTA_BLOCK_SIZE + rand() % OTA_BLOCK_SIZE % (newSize - block * OTA_BLOCK_SIZE)] ^= 0x5A;
+            }
+        }
+    }
+    if (fullFetch) {
+        oldSize = 0;
+    }
+
+    sim_flash_t dist = {.data = distFlash, .size = sizeof(distFlash), .sectorSize = SIM_DIST_SECTOR_SIZE};
+    sim_flash_t puck = {.data = puckFlash, .size = sizeof(puckFlash), .sectorSize = SIM_PUCK_SECTOR_SIZE};
+    memset(distFlash, 0xFF, sizeof(distFlash));
+    memset(puckFlash, 0xFF, sizeof(puckFlash));
+
+    ota_dist_store_t distStore = {
+        .read = flashRead,
+        .write = flashWrite,
+        .erase = flashErase,
+        .size = dist.size,
+        .sector_size = dist.sectorSize,
+        .ctx = &dist,
+    };
+    ota_store_t puckStore = {
+        .read = flashRead,
+        .write = flashWrite,
+        .erase = flashErase,
+        .size = puck.size,
+        .sectorSize = puck.sectorSize,
+        .readRunning = runningRead,
+        .runningSize = oldSize,
+        .ctx = &puck,
+    };
+
+    ota_dist_init(&distStore);
+    double uartMs;
+    uint32_t stageMsgs = stageImage(2, &uartMs);
+    printf("Staged %zu bytes in %u UART messages, %.1f s at 115200 baud\n", newSize, stageMsgs, uartMs / 1000);
+
+    ota_link_t otaLink = {
+        .write = linkWrite,
+        .read = linkRead,
+        .maxRead = link.mtu - 1,
+        .ctx = &link,
+    };
+
+    // Every connection starts from flash, as if the puck had reset in between
+    ota_client_t client;
+    ota_client_stats_t totals = {0};
+    ota_result_t result = OTA_RESULT_LINK_FAILED;
+    uint32_t connections = 0;
+    while (result != OTA_RESULT_READY && result != OTA_RESULT_TOO_BIG && connections < SIM_MAX_CONNECTIONS) {
+        OtaClient_init(&client, &puckStore, 1);
+        link.down = false;
+        link.airMs += SIM_CONNECT_OVERHEAD_MS;
+        result = OtaClient_run(&client, &otaLink, maxRequests);
+        ota_dist_disconnect(SIM_CONN_ID);
+        connections++;
+
+        totals.sessions += client.stats.sessions;
+        totals.resumes += client.stats.resumes;
+        totals.restarts += client.stats.restarts;
+        totals.exchanges += client.stats.exchanges;
+        totals.bytesRead += client.stats.bytesRead;
+        totals.blocksFetched += client.stats.blocksFetched;
+        totals.blocksCopied += client.stats.blocksCopied;
+        totals.badBlocks += client.stats.badBlocks;
+        for (int i = 0; i < OTA_RESULT_COUNT; i++) {
+            totals.results[i] += client.stats.results[i];
+        }
+    }
+
+    bool match = result == OTA_RESULT_READY &&
+                 memcmp(&puckFlash[SIM_PUCK_SECTOR_SIZE], newImage, newSize) == 0;
+    ota_dist_stats_t distStats;
+    ota_dist_get_stats(&distStats);
+
+    printf("Image:         %zu bytes, %zu byte blocks, %s\n", newSize, (size_t) OTA_BLOCK_SIZE,
+           match ? "staged intact" : "NOT staged intact");
+    printf("Link:          MTU %zu, %.1f ms interval, PER %.3f, disconnect chance %.4f, %u requests per connection\n",
+           link.mtu, link.intervalMs, link.per, link.disconnectChance, maxRequests);
+    printf("Connections:   %u (%u resumed, %u dropped, %u restarts)\n", connections, totals.resumes,
+           link.disconnects, totals.restarts);
+    printf("Blocks:        %u fetched, %u copied from the running image, %u bad\n", totals.blocksFetched,
+           totals.blocksCopied, totals.badBlocks);
+    printf("Requests:      %u (%u data reads, %u map reads)\n", totals.exchanges, distStats.data_reads,
+           distStats.map_reads);
+    printf("On air:        %llu bytes, %.1f s with connection overhead\n", (unsigned long long) link.bytesOnAir,
+           link.airMs / 1000);
+    printf("Throughput:    %.0f B/s of image data fetched, %.0f B/s of image staged\n",
+           distStats.bytes_served / (link.airMs / 1000), newSize / (link.airMs / 1000));
+    printf("Wall clock:    %.1f h at one connection every %.0f s\n", connections * uploadPeriodS / 3600, uploadPeriodS);
+    printf("Puck flash:    %u sector erases, %u bad writes\n", puck.erases, puck.badWrites);
+    printf("Results:       ");
+    static const char *resultNames[OTA_RESULT_COUNT] = {
+        "up to date", "in progress", "ready", "link failed", "stale", "bad data", "too big", "store failed"
+    };
+    for (int i = 0; i < OTA_RESULT_COUNT; i++) {
+        if (totals.results[i]) {
+            printf("%s %u  ", resultNames[i], totals.results[i]);
+        }
+    }
+    printf("\n");
+    return match ? 0 : 1;
+}
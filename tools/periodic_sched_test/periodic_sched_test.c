@@ -0,0 +1,209 @@
+/*
+ * periodic_sched_test.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ *
+ * Drives the measurement deadline scheduler (periodic_sched.c) with a fake tick source, the way the
+ * zmod task does: sleep until the deadline, start a cycle, spend a while on it. Waking up is a few
+ * ticks late, and now and then a cycle runs past one or more deadlines. Every cycle is checked to
+ * start on the original grid (never early, never drifting), every overrun to be counted as exactly
+ * the periods it skipped, and the jitter stats to match what the test saw. The same cycles are run
+ * through a plain sleep for the period after each cycle too, to show the drift the scheduler avoids.
+ * The tick counter starts just short of wrapping so the wrap is crossed in every run.
+ *
+ *   gcc -O2 -I../../CC2340R5_Firmware periodic_sched_test.c ../../CC2340R5_Firmware/periodic_sched.c -o periodic_sched_test
+ *
+ * Usage: periodic_sched_test [-n cycles] [-p period ticks] [-w max work ticks] [-l max wake latency ticks]
+ *                            [-o overrun chance] [-r seed]
+ *
+ * Exits with an error if any check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "periodic_sched.h"
+
+typedef struct test_options_t {
+    uint32_t cycles;
+    uint32_t periodTicks;
+    uint32_t maxWorkTicks;
+    uint32_t maxLatencyTicks;
+    double overrunChance;
+    unsigned seed;
+} test_options_t;
+
+// The fake tick source, only moves when the test sleeps or works
+static uint32_t tick;
+static uint32_t failures = 0;
+
+static double randUnit(void) {
+    return rand() / (RAND_MAX + 1.0);
+}
+
+static uint32_t randTicks(uint32_t max) {
+    return (max > 0) ? (uint32_t) (rand() % (max + 1)) : 0;
+}
+
+static void fail(const char *what, uint32_t cycle) {
+    if (failures < 20) {
+        fprintf(stderr, "FAIL %s at cycle %u\n", what, cycle);
+    }
+    failures++;
+}
+
+// How long each cycle's work takes, the same for both schedulers
+static uint32_t cycleWork(const test_options_t *opts) {
+    if (randUnit() < opts->overrunChance) {
+        // Up to a few periods, as a slow flash erase or a long upload on the same task would
+        return opts->periodTicks + randTicks(3 * opts->periodTicks);
+    }
+    return randTicks(opts->maxWorkTicks);
+}
+
+typedef struct run_result_t {
+    uint32_t missed;
+    uint32_t maxJitter;
+    uint64_t sumJitter;
+    int64_t drift;              // Last cycle's start against the first one's plus the periods counted since
+    uint32_t lastLate;
+} run_result_t;
+
+static run_result_t runScheduler(const test_options_t *opts, const uint32_t *work, const uint32_t *latency) {
+    run_result_t run = {0, 0, 0, 0, 0};
+    const uint32_t start = UINT32_MAX - 5 * opts->periodTicks;
+    periodic_sched_t sched;
+
+    tick = start;
+    PeriodicSched_init(&sched, tick, opts->periodTicks);
+    uint32_t slot = 0;
+    for (uint32_t cycle = 0; cycle < opts->cycles; cycle++) {
+        uint32_t wait = PeriodicSched_ticksUntilDue(&sched, tick);
+        if (wait > opts->periodTicks) {
+            fail("sleeps longer than a period", cycle);
+        }
+        tick += wait + latency[cycle];
+
+        uint32_t deadline = start + slot * opts->periodTicks;
+        if (sched.deadline != deadline) {
+            fail("deadline off the grid", cycle);
+        }
+        // Never early, and late by only the wake latency unless the last cycle overran
+        int32_t late = (int32_t) (tick - deadline);
+        if (late < 0) {
+            fail("cycle started early", cycle);
+        }
+        if (wait > 0 && (uint32_t) late != latency[cycle]) {
+            fail("cycle late by more than the wake latency", cycle);
+        }
+        PeriodicSched_cycleStarted(&sched, tick);
+
+        uint32_t jitter = (late > 0) ? (uint32_t) late : 0;
+        run.sumJitter += jitter;
+        if (jitter > run.maxJitter) {
+            run.maxJitter = jitter;
+        }
+
+        // The next slot is the first one still ahead of the cycle's start
+        uint32_t skipped = 0;
+        slot++;
+        while ((int32_t) (tick - (start + slot * opts->periodTicks)) >= 0) {
+            slot++;
+            skipped++;
+        }
+        run.missed += skipped;
+        if (sched.missedDeadlines != run.missed) {
+            fail("missed deadlines miscounted", cycle);
+        }
+        run.lastLate = jitter;
+        if (cycle == opts->cycles - 1) {
+            uint64_t periods = (uint64_t) (opts->cycles - 1) + sched.missedDeadlines;
+            run.drift = (int64_t) (uint32_t) (tick - start) - (int64_t) (periods * opts->periodTicks);
+        }
+
+        tick += work[cycle];
+    }
+
+    if (sched.cycles != opts->cycles) {
+        fail("cycle count", opts->cycles);
+    }
+    if (sched.maxJitterTicks != run.maxJitter || sched.sumJitterTicks != run.sumJitter ||
+        PeriodicSched_meanJitterTicks(&sched) != (uint32_t) (run.sumJitter / opts->cycles)) {
+        fail("jitter stats", opts->cycles);
+    }
+    return run;
+}
+
+// What the task did before the scheduler: sleep a period after each cycle, however long the cycle took
+// Returns how far the last cycle started past where the period alone puts it
+static int64_t runRelative(const test_options_t *opts, const uint32_t *work, const uint32_t *latency) {
+    uint64_t elapsed = 0;
+    for (uint32_t cycle = 1; cycle < opts->cycles; cycle++) {
+        elapsed += work[cycle - 1] + opts->periodTicks + latency[cycle];
+    }
+    return (int64_t) elapsed - (int64_t) (opts->cycles - 1) * opts->periodTicks;
+}
+
+int main(int argc, char *argv[]) {
+    // IAQ 2nd Gen's 3 s sample period in 1 ms ticks, a day of cycles
+    test_options_t opts = {
+        .cycles = 28800,
+        .periodTicks = 3000,
+        .maxWorkTicks = 1200,
+        .maxLatencyTicks = 2,
+        .overrunChance = 0.002,
+        .seed = 1,
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:w:l:o:r:")) != -1) {
+        switch (opt) {
+            case 'n': opts.cycles = strtoul(optarg, NULL, 0); break;
+            case 'p': opts.periodTicks = strtoul(optarg, NULL, 0); break;
+            case 'w': opts.maxWorkTicks = strtoul(optarg, NULL, 0); break;
+            case 'l': opts.maxLatencyTicks = strtoul(optarg, NULL, 0); break;
+            case 'o': opts.overrunChance = strtod(optarg, NULL); break;
+            case 'r': opts.seed = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "Usage: %s [-n cycles] [-p period ticks] [-w max work ticks] "
+                                "[-l max wake latency ticks] [-o overrun chance] [-r seed]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (opts.cycles == 0 || opts.periodTicks == 0 || opts.maxWorkTicks + opts.maxLatencyTicks >= opts.periodTicks) {
+        fprintf(stderr, "Needs at least one cycle, and work plus wake latency has to fit in a period\n");
+        return 1;
+    }
+
+    uint32_t *work = malloc(opts.cycles * sizeof(uint32_t));
+    uint32_t *latency = malloc(opts.cycles * sizeof(uint32_t));
+    srand(opts.seed);
+    for (uint32_t i = 0; i < opts.cycles; i++) {
+        work[i] = cycleWork(&opts);
+        latency[i] = randTicks(opts.maxLatencyTicks);
+    }
+
+    run_result_t sched = runScheduler(&opts, work, latency);
+    int64_t relativeDrift = runRelative(&opts, work, latency);
+
+    // Whatever the overruns, the last cycle is only as late as its own start was, nothing carried over
+    if (sched.drift != (int64_t) sched.lastLate || sched.drift >= opts.periodTicks) {
+        fail("drifted off the grid", opts.cycles - 1);
+    }
+
+    printf("Cycles:        %u of %u ticks, work up to %u ticks, %.1f%% overrunning\n", opts.cycles, opts.periodTicks,
+           opts.maxWorkTicks, 100.0 * opts.overrunChance);
+    printf("Deadlines:     %u missed, jitter max %u mean %.2f ticks, drift %lld ticks\n", sched.missed,
+           sched.maxJitter, (double) sched.sumJitter / opts.cycles, (long long) sched.drift);
+    printf("Sleep period:  drift %lld ticks (%.1f%% of the run)\n", (long long) relativeDrift,
+           100.0 * relativeDrift / ((double) opts.cycles * opts.periodTicks));
+    printf("Checks:        %u failures\n", failures);
+
+    free(work);
+    free(latency);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * FreeRTOS.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ *
+ * Just enough of FreeRTOS for send_link.c to build on a PC. There is only the one thread, and time
+ * is simulated: blocking on a queue runs the fake stack's events until something arrives.
+ */
+
+#ifndef SIM_FREERTOS_H_
+#define SIM_FREERTOS_H_
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+
+#define pdPASS                  1
+#define pdFAIL                  0
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define portMAX_DELAY           ((TickType_t) 0xFFFFFFFF)
+#define configTICK_RATE_HZ      1000
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t) (((uint64_t) (ms) * configTICK_RATE_HZ) / 1000))
+
+// Nothing runs concurrently
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+#endif /* SIM_FREERTOS_H_ */
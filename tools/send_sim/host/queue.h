@@ -0,0 +1,20 @@
+/*
+ * queue.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef SIM_QUEUE_H_
+#define SIM_QUEUE_H_
+
+#include <stddef.h>
+#include "FreeRTOS.h"
+
+typedef struct sim_queue_t *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(size_t length, size_t itemSize);
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticksToWait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticksToWait);
+
+#endif /* SIM_QUEUE_H_ */
@@ -0,0 +1,16 @@
+/*
+ * task.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ */
+
+#ifndef SIM_TASK_H_
+#define SIM_TASK_H_
+
+#include "FreeRTOS.h"
+
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t ticks);
+
+#endif /* SIM_TASK_H_ */
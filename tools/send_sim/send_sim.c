@@ -0,0 +1,985 @@
+/*
+ * send_sim.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: rjp5t
+ *
+ * Runs the puck's send state machine (send_link.c) on a PC against a fake BLE stack. Every request
+ * the state machine makes is answered after a simulated latency, and a script can make the stack
+ * refuse requests, answer with errors, never answer, answer late or twice, drop the link, or deliver
+ * events nobody asked for. Time is simulated, so thousands of uploads take a moment, and the same
+ * seed always gives the same run. Prints how long each phase took (the distribution, not just the
+ * histogram the puck exports), why transfers failed, and checks that every transfer reported as good
+ * delivered exactly what it was given, asked for the PHY the policy picked, and fed the policy the
+ * connection's RSSI and any refusal, that none was failed just for its disconnect, and that no
+ * transfer left its connection open. Exits with an error if any check fails. The first base station
+ * takes every PHY, the second only 1M, like the classic ESP32.
+ *
+ *   gcc -O2 -Ihost -I../../CC2340R5_Firmware send_sim.c ../../CC2340R5_Firmware/send_link.c \
+ *       ../../CC2340R5_Firmware/phy_policy.c -o send_sim
+ *
+ * Usage: send_sim [-n uploads] [-w writes per upload] [-x session exchanges] [-p upload period ms] [-r seed] [script]
+ *
+ * Script lines (# starts a comment), requests are scan, connect, srv, chr, write, read, disconnect, phy and rssi:
+ *   latency <request> <min ms> <max ms>       Answered somewhere in between
+ *   tail <request> <chance> <ms>              Sometimes takes this much longer on top
+ *   error <request> <chance> [code]           Answered with an error (an ATT error response, or a failed connect),
+ *                                             phy and rssi aren't answered at all
+ *   reject <request> <chance>                 Refused straight away, as the stack does when it's out of buffers
+ *   drop <request> <chance>                   Never answered
+ *   late <request> <chance> <ms>              Answered this much later, after the state machine gave up on it
+ *   duplicate <request> <chance>              Answered twice
+ *   linkloss <chance>                         Per request on a connection, the link drops instead of answering
+ *   stray <chance>                            Per request, an event for something else arrives too
+ *   uploads|writes|session|period|seed <n>    Same as the options, which take precedence
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "task.h"
+#include "send_link.h"
+#include "send_stats.h"
+
+enum sim_request {
+    SIM_REQ_SCAN = 0,
+    SIM_REQ_CONNECT,
+    SIM_REQ_SRV,
+    SIM_REQ_CHR,
+    SIM_REQ_WRITE,
+    SIM_REQ_READ,
+    SIM_REQ_DISCONNECT,
+    SIM_REQ_PHY,
+    SIM_REQ_RSSI,
+    SIM_NUM_REQUESTS
+};
+
+static const char *requestNames[SIM_NUM_REQUESTS] = {
+    "scan", "connect", "srv", "chr", "write", "read", "disconnect", "phy", "rssi"
+};
+// The state machine doesn't wait on the PHY or the RSSI
+static const uint8_t requestOpcodes[SIM_NUM_REQUESTS] = {
+    REPORT_OPCODE_SCAN_DONE, REPORT_OPCODE_CONNECTED, REPORT_OPCODE_SRV_DISCOVERY, REPORT_OPCODE_CHR_DISCOVERY,
+    REPORT_OPCODE_WRITE_DONE, REPORT_OPCODE_READ_DONE, REPORT_OPCODE_DISCONNECT, REPORT_OPCODE_ERROR, REPORT_OPCODE_ERROR
+};
+static const char *phaseNames[SEND_STATS_NUM_PHASES + 1] = {
+    "idle", "connect", "srv discover", "chr discover", "write", "disconnect", "scan", "session"
+};
+// Matches the ErrorSrc codes in send_link.c
+static const char *errorSrcNames[] = {
+    "os", "stack event", "request refused", "timeout", "wrong event", "no base station", "op table full"
+};
+
+// Statuses the fake stack hands back (bleNotReady, bleNotConnected, LL connection failed to be established,
+// ATT unlikely error, remote user terminated and local host terminated, as the real stack uses them)
+#define SIM_STATUS_REJECTED         0x10
+#define SIM_STATUS_NOT_CONNECTED    0x14
+#define SIM_STATUS_CONNECT_FAILED   0x3E
+#define SIM_STATUS_UNLIKELY         0x0E
+#define SIM_REASON_LINK_LOST        0x08
+#define SIM_REASON_LOCAL_HOST       0x16
+
+#define SIM_ATT_SERVICE_START       0x0028
+#define SIM_ATT_SERVICE_END         0x002F
+#define SIM_ATT_CHR_HANDLE          0x002A
+// Connection handle and peer of other links (the menu can open its own)
+#define SIM_OTHER_CONN_HANDLE       0x0040
+#define SIM_OTHER_PEER_ADDR         0x5A
+#define SIM_NUM_STATIONS            2
+// Failures in a row before the fake stack stops offering a base station, as app_central does
+#define SIM_MAX_STATION_FAILURES    3
+#define SIM_RSSI_SPREAD             3
+
+typedef struct sim_fault_t {
+    uint32_t minMs;
+    uint32_t maxMs;
+    double tailChance;
+    uint32_t tailMs;
+    double errorChance;
+    uint16_t errorCode;
+    double rejectChance;
+    double dropChance;
+    double lateChance;
+    uint32_t lateMs;
+    double duplicateChance;
+} sim_fault_t;
+
+typedef struct sim_fault_counters_t {
+    uint32_t requests;
+    uint32_t rejected;
+    uint32_t errors;
+    uint32_t dropped;
+    uint32_t late;
+    uint32_t duplicated;
+    uint32_t linkLosses;
+} sim_fault_counters_t;
+
+enum sim_event_kind {
+    SIM_EV_SCAN_DONE = 0,
+    SIM_EV_CONNECTED,
+    SIM_EV_SRV_FOUND,
+    SIM_EV_CHR_FOUND,
+    SIM_EV_WRITE_DONE,
+    SIM_EV_READ_DONE,
+    SIM_EV_DISCONNECTED,
+    SIM_EV_ERROR,
+    SIM_EV_PHY_DONE,
+    SIM_EV_RSSI,
+};
+
+typedef struct sim_event_t {
+    uint64_t time;
+    uint32_t seq;           // Events due at the same time are delivered in the order they were scheduled
+    uint8_t kind;
+    uint8_t opcode;         // What an error answers
+    uint8_t src;
+    uint16_t connHandle;
+    uint8_t address[SEND_LINK_ADDR_LEN];    // Peer a connection (or a failed one) is with
+    uint16_t code;
+    int8_t rssi;
+    uint8_t len;
+    uint8_t value[SEND_MAX_READ_LEN];
+} sim_event_t;
+
+typedef struct sim_station_t {
+    send_peer_t peer;           // RSSI as the scan saw it
+    int connRssi;               // What the connection reads, give or take SIM_RSSI_SPREAD
+    uint8_t phyRefused;         // Bit per phy_mode_t
+    bool known;
+    uint8_t failures;
+} sim_station_t;
+
+// What the transfer's connection asked for and was told, to check against the PHY policy afterwards
+typedef struct sim_phy_check_t {
+    int station;
+    phy_mode_t wanted;          // The policy's choice when the connect went out
+    uint32_t requests;
+    phy_mode_t asked;
+    uint16_t liveConn;          // Connection the state machine takes answers for, as send_link.c does
+    int8_t rssi;                // The RSSI the policy should be fed
+    phy_mode_t refused;
+} sim_phy_check_t;
+
+struct sim_queue_t {
+    size_t length;
+    size_t itemSize;
+    size_t count;
+    size_t head;
+    uint8_t *items;
+};
+
+#define SIM_MAX_EVENTS      1024
+#define SIM_MAX_SAMPLES     (1 << 20)
+#define SIM_MAX_WRITES      64
+
+static sim_fault_t faults[SIM_NUM_REQUESTS];
+static sim_fault_counters_t faultCounters[SIM_NUM_REQUESTS];
+static double linkLossChance = 0;
+static double strayChance = 0;
+static uint32_t numStrays = 0;
+
+static uint64_t now = 0;
+static sim_event_t events[SIM_MAX_EVENTS];
+static size_t numEvents = 0;
+static uint32_t nextEventSeq = 0;
+
+static sim_station_t stations[SIM_NUM_STATIONS];
+static bool connOpen = false;
+static uint16_t connHandle = 0xFFFF;
+static uint16_t nextConnHandle = 0;
+static uint32_t connectionsLeftOpen = 0;
+static sim_phy_check_t phyCheck;
+static uint32_t phyRequests[PHY_MODE_COUNT];
+static uint32_t phyRefusals = 0;
+
+// What the base station received on the current connection
+static uint8_t received[SIM_MAX_WRITES * SEND_MAX_WRITE_LEN];
+static size_t receivedLen = 0;
+// Session writes aren't readings
+static bool inSession = false;
+static uint32_t nextReadValue = 0;
+
+static uint32_t *phaseSamples[SEND_STATS_NUM_PHASES + 1];
+static uint32_t numPhaseSamples[SEND_STATS_NUM_PHASES + 1];
+static uint32_t phaseFailures[SEND_STATS_NUM_PHASES + 1];
+
+static double randUnit(void) {
+    return rand() / (RAND_MAX + 1.0);
+}
+
+static bool chance(double p) {
+    return p > 0 && randUnit() < p;
+}
+
+// Simulated time, and the events the fake stack has scheduled
+
+static void SimSchedule(const sim_event_t *event, uint64_t delayMs) {
+    if (numEvents == SIM_MAX_EVENTS) {
+        fprintf(stderr, "Too many events scheduled\n");
+        exit(2);
+    }
+    events[numEvents] = *event;
+    events[numEvents].time = now + pdMS_TO_TICKS(delayMs);
+    events[numEvents].seq = nextEventSeq++;
+    numEvents++;
+}
+
+static void SimDeliver(const sim_event_t *event) {
+    switch (event->kind) {
+        case SIM_EV_SCAN_DONE:
+            for (int i = 0; i < SIM_NUM_STATIONS; i++) {
+                stations[i].known = true;
+                stations[i].failures = 0;
+            }
+            SendLink_onScanDone();
+            break;
+        case SIM_EV_CONNECTED:
+            // Whatever the state machine makes of it, the link is up now
+            if (event->connHandle != SIM_OTHER_CONN_HANDLE) {
+                connOpen = true;
+                connHandle = event->connHandle;
+                receivedLen = 0;
+            }
+            SendLink_onConnected(event->connHandle, event->address);
+            break;
+        case SIM_EV_SRV_FOUND:
+            SendLink_onServiceFound(event->connHandle, SIM_ATT_SERVICE_START, SIM_ATT_SERVICE_END);
+            break;
+        case SIM_EV_CHR_FOUND:
+            SendLink_onCharacteristicFound(event->connHandle, SIM_ATT_CHR_HANDLE);
+            break;
+        case SIM_EV_WRITE_DONE:
+            SendLink_onWriteDone(event->connHandle);
+            break;
+        case SIM_EV_READ_DONE:
+            SendLink_onReadDone(event->connHandle, event->value, event->len);
+            break;
+        case SIM_EV_DISCONNECTED:
+            SendLink_onDisconnected(event->connHandle, event->code);
+            break;
+        case SIM_EV_ERROR:
+            if (event->opcode == REPORT_OPCODE_CONNECTED) {
+                SendLink_onConnectFailed(event->address, event->code);
+            }
+            else {
+                SendLink_onError(event->opcode, event->connHandle, event->src, event->code);
+            }
+            break;
+        case SIM_EV_PHY_DONE:
+            // The link just moves if the base station takes the PHY, only a refusal gets back to the puck
+            if (event->code == PHY_MODE_COUNT) {
+                break;
+            }
+            phyRefusals++;
+            if (event->connHandle == phyCheck.liveConn) {
+                phyCheck.refused = event->code;
+            }
+            SendLink_onPhyRefused(event->connHandle, event->code);
+            break;
+        case SIM_EV_RSSI:
+            if (event->connHandle == phyCheck.liveConn) {
+                phyCheck.rssi = event->rssi;
+            }
+            SendLink_onRssi(event->connHandle, event->rssi);
+            break;
+    }
+}
+
+// Delivers the next event due by the deadline, false if there isn't one
+static bool SimRunNext(uint64_t deadline) {
+    size_t next = numEvents;
+    for (size_t i = 0; i < numEvents; i++) {
+        if (next == numEvents || events[i].time < events[next].time ||
+            (events[i].time == events[next].time && events[i].seq < events[next].seq)) {
+            next = i;
+        }
+    }
+    if (next == numEvents || events[next].time > deadline) {
+        return false;
+    }
+
+    sim_event_t event = events[next];
+    events[next] = events[--numEvents];
+    if (event.time > now) {
+        now = event.time;
+    }
+    SimDeliver(&event);
+    return true;
+}
+
+QueueHandle_t xQueueCreate(size_t length, size_t itemSize) {
+    QueueHandle_t queue = calloc(1, sizeof(*queue));
+    queue->length = length;
+    queue->itemSize = itemSize;
+    queue->items = calloc(length, itemSize);
+    return queue;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticksToWait) {
+    // Nothing else runs to make room, so a full queue stays full
+    (void) ticksToWait;
+    if (queue->count == queue->length) {
+        return pdFAIL;
+    }
+    memcpy(&queue->items[((queue->head + queue->count) % queue->length) * queue->itemSize], item, queue->itemSize);
+    queue->count++;
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticksToWait) {
+    uint64_t deadline = (ticksToWait == portMAX_DELAY) ? UINT64_MAX : now + ticksToWait;
+    while (queue->count == 0) {
+        if (!SimRunNext(deadline)) {
+            if (deadline == UINT64_MAX) {
+                fprintf(stderr, "Waiting forever on a queue with nothing scheduled\n");
+                exit(2);
+            }
+            now = deadline;
+            return pdFAIL;
+        }
+    }
+    memcpy(item, &queue->items[queue->head * queue->itemSize], queue->itemSize);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    return pdPASS;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t) now;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    uint64_t deadline = now + ticks;
+    while (SimRunNext(deadline)) {
+    }
+    now = deadline;
+}
+
+// Stand-ins for send_stats.c, keeping every sample rather than a histogram
+
+void SendStats_recordPhase(uint8_t phase, uint32_t elapsedMs) {
+    if (phase == 0 || phase > SEND_STATS_NUM_PHASES || numPhaseSamples[phase] == SIM_MAX_SAMPLES) {
+        return;
+    }
+    phaseSamples[phase][numPhaseSamples[phase]++] = elapsedMs;
+}
+
+void SendStats_recordFailure(uint8_t phase) {
+    if (phase <= SEND_STATS_NUM_PHASES) {
+        phaseFailures[phase]++;
+    }
+}
+
+// The fake stack
+
+static void SimStray(void) {
+    static const uint8_t strayKinds[] = {SIM_EV_SCAN_DONE, SIM_EV_CONNECTED, SIM_EV_WRITE_DONE, SIM_EV_DISCONNECTED};
+    sim_event_t event = {
+        .kind = strayKinds[rand() % sizeof(strayKinds)],
+        .connHandle = SIM_OTHER_CONN_HANDLE,
+        .code = SIM_REASON_LINK_LOST,
+    };
+    memset(event.address, SIM_OTHER_PEER_ADDR, SEND_LINK_ADDR_LEN);
+    numStrays++;
+    SimSchedule(&event, rand() % 200);
+}
+
+// Decides what becomes of a request, and schedules its answer (or not)
+// Returns the status the request call hands back, and whether it reached the base station
+static uint8_t SimRequest(enum sim_request req, uint16_t conn, sim_event_t *answer, bool *delivered) {
+    const sim_fault_t *fault = &faults[req];
+    sim_fault_counters_t *counters = &faultCounters[req];
+    bool onConnection = req != SIM_REQ_SCAN && req != SIM_REQ_CONNECT;
+    bool awaited = requestOpcodes[req] != REPORT_OPCODE_ERROR;
+    *delivered = false;
+    counters->requests++;
+
+    if (chance(strayChance)) {
+        SimStray();
+    }
+    if (onConnection && (!connOpen || conn != connHandle)) {
+        return SIM_STATUS_NOT_CONNECTED;
+    }
+    if (chance(fault->rejectChance)) {
+        counters->rejected++;
+        return SIM_STATUS_REJECTED;
+    }
+
+    uint64_t latency = fault->minMs + (fault->maxMs > fault->minMs ? rand() % (fault->maxMs - fault->minMs + 1) : 0);
+    if (chance(fault->tailChance)) {
+        latency += fault->tailMs;
+    }
+
+    if (onConnection && chance(linkLossChance)) {
+        counters->linkLosses++;
+        connOpen = false;
+        sim_event_t event = {.kind = SIM_EV_DISCONNECTED, .connHandle = conn, .code = SIM_REASON_LINK_LOST};
+        SimSchedule(&event, latency);
+        return SEND_LINK_SUCCESS;
+    }
+
+    if (chance(fault->errorChance)) {
+        counters->errors++;
+        if (!awaited) {
+            return SEND_LINK_SUCCESS;
+        }
+        answer->kind = SIM_EV_ERROR;
+        answer->opcode = requestOpcodes[req];
+        if (req == SIM_REQ_CONNECT) {
+            answer->src = NOTIFY_ERRSRC_BLE_STACK_ERROR;
+            answer->connHandle = SEND_CONN_HANDLE_ANY;
+        }
+        else {
+            answer->src = NOTIFY_ERRSRC_GATT_ERROR_REPORT;
+            answer->connHandle = conn;
+        }
+        answer->code = fault->errorCode;
+    }
+    else {
+        *delivered = true;
+    }
+
+    if (chance(fault->dropChance)) {
+        counters->dropped++;
+        return SEND_LINK_SUCCESS;
+    }
+    if (chance(fault->lateChance)) {
+        counters->late++;
+        latency += fault->lateMs;
+    }
+    SimSchedule(answer, latency);
+    if (chance(fault->duplicateChance)) {
+        counters->duplicated++;
+        SimSchedule(answer, latency + 1 + rand() % 100);
+    }
+    return SEND_LINK_SUCCESS;
+}
+
+static uint8_t SimScan(void) {
+    sim_event_t answer = {.kind = SIM_EV_SCAN_DONE};
+    bool delivered;
+    return SimRequest(SIM_REQ_SCAN, SEND_CONN_HANDLE_ANY, &answer, &delivered);
+}
+
+static uint8_t SimConnect(const send_peer_t *peer) {
+    sim_event_t answer = {.kind = SIM_EV_CONNECTED, .connHandle = nextConnHandle};
+    bool delivered;
+    memcpy(answer.address, peer->address, SEND_LINK_ADDR_LEN);
+
+    // The policy has been reset for a new base station by now, so this is what the connection should ask for
+    const phy_policy_t *policy = SendLink_getPhyPolicy();
+    phyCheck.station = 0;
+    for (int i = 0; i < SIM_NUM_STATIONS; i++) {
+        if (memcmp(stations[i].peer.address, peer->address, SEND_LINK_ADDR_LEN) == 0) {
+            phyCheck.station = i;
+        }
+    }
+    phyCheck.wanted = policy->mode;
+    phyCheck.requests = 0;
+    phyCheck.asked = PHY_MODE_COUNT;
+    phyCheck.rssi = (int8_t) peer->rssi;
+    phyCheck.refused = PHY_MODE_COUNT;
+    uint8_t status = SimRequest(SIM_REQ_CONNECT, SEND_CONN_HANDLE_ANY, &answer, &delivered);
+    if (status == SEND_LINK_SUCCESS) {
+        nextConnHandle = (nextConnHandle + 1) % 8;
+    }
+    return status;
+}
+
+static uint8_t SimDiscoverService(uint16_t conn) {
+    sim_event_t answer = {.kind = SIM_EV_SRV_FOUND, .connHandle = conn};
+    bool delivered;
+    return SimRequest(SIM_REQ_SRV, conn, &answer, &delivered);
+}
+
+static uint8_t SimDiscoverCharacteristic(uint16_t conn, uint16_t startHdl, uint16_t endHdl) {
+    sim_event_t answer = {.kind = SIM_EV_CHR_FOUND, .connHandle = conn};
+    bool delivered;
+    if (startHdl != SIM_ATT_SERVICE_START || endHdl != SIM_ATT_SERVICE_END) {
+        fprintf(stderr, "Characteristic discovery outside the service (0x%04X-0x%04X)\n", startHdl, endHdl);
+    }
+    return SimRequest(SIM_REQ_CHR, conn, &answer, &delivered);
+}
+
+static uint8_t SimWrite(uint16_t conn, uint16_t attHandle, const uint8_t *value, size_t len) {
+    sim_event_t answer = {.kind = SIM_EV_WRITE_DONE, .connHandle = conn};
+    bool delivered;
+    uint8_t status = SimRequest(SIM_REQ_WRITE, conn, &answer, &delivered);
+    if (delivered && !inSession && attHandle == SIM_ATT_CHR_HANDLE + 1 && receivedLen + len <= sizeof(received)) {
+        memcpy(&received[receivedLen], value, len);
+        receivedLen += len;
+    }
+    return status;
+}
+
+static uint8_t SimRead(uint16_t conn, uint16_t attHandle) {
+    sim_event_t answer = {.kind = SIM_EV_READ_DONE, .connHandle = conn, .len = SEND_MAX_READ_LEN};
+    bool delivered;
+    uint32_t value = nextReadValue;
+    memset(answer.value, 0, sizeof(answer.value));
+    memcpy(answer.value, &value, sizeof(value));
+    if (attHandle != SIM_ATT_CHR_HANDLE + 1) {
+        fprintf(stderr, "Read of handle 0x%04X, not the characteristic's value\n", attHandle);
+    }
+    uint8_t status = SimRequest(SIM_REQ_READ, conn, &answer, &delivered);
+    if (delivered) {
+        nextReadValue++;
+    }
+    return status;
+}
+
+static uint8_t SimDisconnect(uint16_t conn) {
+    sim_event_t answer = {.kind = SIM_EV_DISCONNECTED, .connHandle = conn, .code = SIM_REASON_LOCAL_HOST};
+    bool delivered;
+    phyCheck.liveConn = SEND_CONN_HANDLE_ANY;
+    uint8_t status = SimRequest(SIM_REQ_DISCONNECT, conn, &answer, &delivered);
+    if (delivered) {
+        connOpen = false;
+    }
+    return status;
+}
+
+static uint8_t SimSetPhy(uint16_t conn, phy_mode_t mode) {
+    sim_event_t answer = {.kind = SIM_EV_PHY_DONE, .connHandle = conn, .code = PHY_MODE_COUNT};
+    bool delivered;
+    if (mode < PHY_MODE_COUNT) {
+        phyRequests[mode]++;
+    }
+    phyCheck.requests++;
+    phyCheck.asked = mode;
+    phyCheck.liveConn = conn;
+    if (mode >= PHY_MODE_COUNT || (stations[phyCheck.station].phyRefused & (1 << mode))) {
+        answer.code = mode;
+    }
+    return SimRequest(SIM_REQ_PHY, conn, &answer, &delivered);
+}
+
+static uint8_t SimReadRssi(uint16_t conn) {
+    const sim_station_t *station = &stations[phyCheck.station];
+    sim_event_t answer = {
+        .kind = SIM_EV_RSSI,
+        .connHandle = conn,
+        .rssi = (int8_t) (station->connRssi - SIM_RSSI_SPREAD + rand() % (2 * SIM_RSSI_SPREAD + 1)),
+    };
+    bool delivered;
+    phyCheck.liveConn = conn;
+    return SimRequest(SIM_REQ_RSSI, conn, &answer, &delivered);
+}
+
+static void SimResetClient(uint16_t conn) {
+    // The fake stack keeps no per connection client state
+    (void) conn;
+}
+
+static bool SimGetBaseStation(send_peer_t *peer) {
+    int best = -1;
+    for (int i = 0; i < SIM_NUM_STATIONS; i++) {
+        if (stations[i].known && stations[i].failures < SIM_MAX_STATION_FAILURES &&
+            (best < 0 || stations[i].peer.rssi > stations[best].peer.rssi)) {
+            best = i;
+        }
+    }
+    if (best < 0) {
+        return false;
+    }
+    *peer = stations[best].peer;
+    return true;
+}
+
+static void SimReportBaseStation(const uint8_t *address, bool success) {
+    for (int i = 0; i < SIM_NUM_STATIONS; i++) {
+        if (memcmp(stations[i].peer.address, address, SEND_LINK_ADDR_LEN) == 0) {
+            stations[i].failures = success ? 0 : stations[i].failures + 1;
+        }
+    }
+}
+
+static const send_stack_t simStack = {
+    .scan = SimScan,
+    .connect = SimConnect,
+    .discoverService = SimDiscoverService,
+    .discoverCharacteristic = SimDiscoverCharacteristic,
+    .write = SimWrite,
+    .read = SimRead,
+    .disconnect = SimDisconnect,
+    .setPhy = SimSetPhy,
+    .readRssi = SimReadRssi,
+    .resetClient = SimResetClient,
+    .getBaseStation = SimGetBaseStation,
+    .reportBaseStation = SimReportBaseStation,
+};
+
+// What the puck uploads: writes of readings, then a session of write and read pairs
+
+typedef struct sim_upload_t {
+    uint32_t firstWrite;
+    uint32_t numWrites;
+    uint32_t next;
+} sim_upload_t;
+
+static uint32_t sessionExchanges = 0;
+static uint32_t sessionMismatches = 0;
+static uint32_t sessionsCompleted = 0;
+
+static void SimPayload(uint32_t index, uint8_t *buf) {
+    for (int i = 0; i < SEND_MAX_WRITE_LEN; i++) {
+        buf[i] = (uint8_t) (index * 31 + i);
+    }
+}
+
+static size_t SimUploadNext(void *ctx, uint8_t *buf, size_t len) {
+    sim_upload_t *upload = ctx;
+    if (upload->next == upload->numWrites || len < SEND_MAX_WRITE_LEN) {
+        return 0;
+    }
+    SimPayload(upload->firstWrite + upload->next++, buf);
+    return SEND_MAX_WRITE_LEN;
+}
+
+static void SimSession(void) {
+    uint8_t req[10] = {0xD0};
+    inSession = true;
+    for (uint32_t i = 0; i < sessionExchanges; i++) {
+        if (SendLink_write(req, sizeof(req)) != 0) {
+            inSession = false;
+            return;
+        }
+        // Every read should get the value the fake stack served for it, and nothing else
+        uint32_t expected = nextReadValue;
+        uint8_t rsp[SEND_MAX_READ_LEN];
+        size_t rspLen;
+        if (SendLink_read(rsp, sizeof(rsp), &rspLen) != 0) {
+            inSession = false;
+            return;
+        }
+        uint32_t value;
+        memcpy(&value, rsp, sizeof(value));
+        if (rspLen != SEND_MAX_READ_LEN || value != expected) {
+            sessionMismatches++;
+        }
+    }
+    inSession = false;
+    sessionsCompleted++;
+}
+
+static int compareU32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentile(const uint32_t *sorted, uint32_t count, double pct) {
+    uint32_t index = (uint32_t) (pct / 100 * (count - 1) + 0.5);
+    return sorted[index];
+}
+
+static enum sim_request parseRequest(const char *name, int lineNum) {
+    for (int i = 0; i < SIM_NUM_REQUESTS; i++) {
+        if (strcmp(name, requestNames[i]) == 0) {
+            return i;
+        }
+    }
+    fprintf(stderr, "Line %d: unknown request '%s'\n", lineNum, name);
+    exit(1);
+}
+
+typedef struct sim_run_t {
+    uint32_t uploads;
+    uint32_t writes;
+    uint32_t session;
+    uint32_t periodMs;
+    uint32_t seed;
+} sim_run_t;
+
+static void loadScript(const char *path, sim_run_t *run) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    }
+
+    char line[256];
+    int lineNum = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        lineNum++;
+        char *comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        char keyword[32], name[32];
+        double a = 0, b = 0;
+        int fields = sscanf(line, "%31s %31s %lf %lf", keyword, name, &a, &b);
+        if (fields <= 0) {
+            continue;
+        }
+
+        if (strcmp(keyword, "linkloss") == 0 || strcmp(keyword, "stray") == 0 || strcmp(keyword, "uploads") == 0 ||
+            strcmp(keyword, "writes") == 0 || strcmp(keyword, "session") == 0 || strcmp(keyword, "period") == 0 ||
+            strcmp(keyword, "seed") == 0) {
+            double val = (fields >= 2) ? atof(name) : 0;
+            if (strcmp(keyword, "linkloss") == 0) linkLossChance = val;
+            else if (strcmp(keyword, "stray") == 0) strayChance = val;
+            else if (strcmp(keyword, "uploads") == 0) run->uploads = val;
+            else if (strcmp(keyword, "writes") == 0) run->writes = val;
+            else if (strcmp(keyword, "session") == 0) run->session = val;
+            else if (strcmp(keyword, "period") == 0) run->periodMs = val;
+            else run->seed = val;
+            continue;
+        }
+        if (fields < 3) {
+            fprintf(stderr, "Line %d: '%s' needs a request and a value\n", lineNum, keyword);
+            exit(1);
+        }
+
+        sim_fault_t *fault = &faults[parseRequest(name, lineNum)];
+        if (strcmp(keyword, "latency") == 0) {
+            fault->minMs = a;
+            fault->maxMs = (fields >= 4) ? b : a;
+        }
+        else if (strcmp(keyword, "tail") == 0) {
+            fault->tailChance = a;
+            fault->tailMs = b;
+        }
+        else if (strcmp(keyword, "error") == 0) {
+            fault->errorChance = a;
+            if (fields >= 4) {
+                fault->errorCode = b;
+            }
+        }
+        else if (strcmp(keyword, "reject") == 0) {
+            fault->rejectChance = a;
+        }
+        else if (strcmp(keyword, "drop") == 0) {
+            fault->dropChance = a;
+        }
+        else if (strcmp(keyword, "late") == 0) {
+            fault->lateChance = a;
+            fault->lateMs = b;
+        }
+        else if (strcmp(keyword, "duplicate") == 0) {
+            fault->duplicateChance = a;
+        }
+        else {
+            fprintf(stderr, "Line %d: unknown keyword '%s'\n", lineNum, keyword);
+            exit(1);
+        }
+    }
+    fclose(file);
+}
+
+int main(int argc, char *argv[]) {
+    // A healthy link at a 30 ms connection interval, scans last SEND_SCAN_DURATION
+    static const sim_fault_t defaults[SIM_NUM_REQUESTS] = {
+        [SIM_REQ_SCAN] = {.minMs = 3000, .maxMs = 3000},
+        [SIM_REQ_CONNECT] = {.minMs = 35, .maxMs = 300, .tailChance = 0.05, .tailMs = 700,
+                             .errorChance = 0.02, .errorCode = SIM_STATUS_CONNECT_FAILED},
+        [SIM_REQ_SRV] = {.minMs = 60, .maxMs = 150},
+        [SIM_REQ_CHR] = {.minMs = 60, .maxMs = 150},
+        [SIM_REQ_WRITE] = {.minMs = 30, .maxMs = 70},
+        [SIM_REQ_READ] = {.minMs = 30, .maxMs = 70},
+        [SIM_REQ_DISCONNECT] = {.minMs = 30, .maxMs = 100},
+        [SIM_REQ_PHY] = {.minMs = 60, .maxMs = 200},
+        [SIM_REQ_RSSI] = {.minMs = 1, .maxMs = 5},
+    };
+    memcpy(faults, defaults, sizeof(faults));
+    for (int i = 0; i < SIM_NUM_REQUESTS; i++) {
+        if (faults[i].errorCode == 0) {
+            faults[i].errorCode = SIM_STATUS_UNLIKELY;
+        }
+    }
+    linkLossChance = 0.002;
+
+    sim_run_t run = {.uploads = 1000, .writes = 2, .session = 0, .periodMs = 60000, .seed = 1};
+    sim_run_t options = {0};
+    bool haveOptions[5] = {false};
+    int opt;
+    while ((opt = getopt(argc, argv, "n:w:x:p:r:")) != -1) {
+        switch (opt) {
+            case 'n': options.uploads = strtoul(optarg, NULL, 0); haveOptions[0] = true; break;
+            case 'w': options.writes = strtoul(optarg, NULL, 0); haveOptions[1] = true; break;
+            case 'x': options.session = strtoul(optarg, NULL, 0); haveOptions[2] = true; break;
+            case 'p': options.periodMs = strtoul(optarg, NULL, 0); haveOptions[3] = true; break;
+            case 'r': options.seed = strtoul(optarg, NULL, 0); haveOptions[4] = true; break;
+            default:
+                fprintf(stderr, "Usage: %s [-n uploads] [-w writes per upload] [-x session exchanges] "
+                                "[-p upload period ms] [-r seed] [script]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind < argc) {
+        loadScript(argv[optind], &run);
+    }
+    if (haveOptions[0]) run.uploads = options.uploads;
+    if (haveOptions[1]) run.writes = options.writes;
+    if (haveOptions[2]) run.session = options.session;
+    if (haveOptions[3]) run.periodMs = options.periodMs;
+    if (haveOptions[4]) run.seed = options.seed;
+    if (run.writes == 0 || run.writes > SIM_MAX_WRITES) {
+        fprintf(stderr, "Writes per upload has to be between 1 and %d\n", SIM_MAX_WRITES);
+        return 1;
+    }
+    srand(run.seed);
+    sessionExchanges = run.session;
+
+    for (int i = 0; i <= SEND_STATS_NUM_PHASES; i++) {
+        phaseSamples[i] = malloc(SIM_MAX_SAMPLES * sizeof(uint32_t));
+    }
+    // A base station in the same room, and one across the house that only does 1M.
+    // Both scan a lot stronger than their connections read, the advertisement caught on a good channel.
+    for (int i = 0; i < SIM_NUM_STATIONS; i++) {
+        stations[i].peer.addressType = 0;
+        memset(stations[i].peer.address, 0xB0 + i, SEND_LINK_ADDR_LEN);
+        stations[i].peer.rssi = -50 - 15 * i;
+    }
+    stations[0].connRssi = -55;
+    stations[1].connRssi = -88;
+    stations[1].phyRefused = (1 << PHY_MODE_2M) | (1 << PHY_MODE_CODED_S2) | (1 << PHY_MODE_CODED_S8);
+    SendLink_init(&simStack);
+
+    // Failed uploads go again with the same writes, like readings left pending
+    uint32_t succeeded = 0;
+    uint32_t mismatches = 0;
+    uint32_t disconnectFailed = 0;
+    uint32_t phyWrongRequests = 0;
+    uint32_t phyWrongRssi = 0;
+    uint32_t phyMissedRefusals = 0;
+    uint32_t failuresBySrc[SEND_STATS_NUM_PHASES + 1][16] = {{0}};
+    uint32_t nextWrite = 0;
+    uint64_t busyMs = 0;
+    for (uint32_t upload = 0; upload < run.uploads; upload++) {
+        sim_upload_t stream = {.firstWrite = nextWrite, .numWrites = run.writes};
+        send_stream_t sendStream = {
+            .next = SimUploadNext,
+            .ctx = &stream,
+            .session = (run.session > 0) ? SimSession : NULL,
+        };
+
+        uint64_t start = now;
+        phyCheck.liveConn = SEND_CONN_HANDLE_ANY;
+        uint32_t rc = SendLink_transfer(&sendStream);
+        phyCheck.liveConn = SEND_CONN_HANDLE_ANY;
+        busyMs += now - start;
+        if (connOpen) {
+            connectionsLeftOpen++;
+            connOpen = false;
+        }
+
+        if (rc == 0) {
+            succeeded++;
+            uint8_t expected[SIM_MAX_WRITES * SEND_MAX_WRITE_LEN];
+            for (uint32_t i = 0; i < run.writes; i++) {
+                SimPayload(nextWrite + i, &expected[i * SEND_MAX_WRITE_LEN]);
+            }
+            if (receivedLen != run.writes * SEND_MAX_WRITE_LEN || memcmp(received, expected, receivedLen) != 0) {
+                mismatches++;
+            }
+
+            // One request for the PHY the policy picked, none on 1M
+            const phy_policy_t *policy = SendLink_getPhyPolicy();
+            if ((phyCheck.wanted == PHY_MODE_1M) ? phyCheck.requests != 0
+                                                 : (phyCheck.requests != 1 || phyCheck.asked != phyCheck.wanted)) {
+                phyWrongRequests++;
+            }
+            if (policy->rssi != phyCheck.rssi) {
+                phyWrongRssi++;
+            }
+            if (phyCheck.refused != PHY_MODE_COUNT && !(policy->unsupported & (1 << phyCheck.refused))) {
+                phyMissedRefusals++;
+            }
+            nextWrite += run.writes;
+        }
+        else {
+            failuresBySrc[(rc >> 28) & 0x7][(rc >> 24) & 0xF]++;
+            // The writes were all acknowledged before the disconnect, going again would deliver them twice
+            if (((rc >> 28) & 0x7) == ASYNC_PHASE_DISCONNECT) {
+                disconnectFailed++;
+            }
+        }
+        receivedLen = 0;
+
+        // Whatever is still due to arrive turns up between uploads, and is stale by the next one
+        vTaskDelay(pdMS_TO_TICKS(run.periodMs));
+    }
+
+    async_op_counters_t counters;
+    SendLink_getCounters(&counters);
+
+    printf("Uploads:       %u, %u went through (%.1f%%), %u writes each", run.uploads, succeeded,
+           100.0 * succeeded / run.uploads, run.writes);
+    if (run.session > 0) {
+        printf(", %u session exchanges (%u sessions finished)", run.session, sessionsCompleted);
+    }
+    printf("\nRadio busy:    %.1f s over %.1f h, %.0f ms per upload\n", busyMs / 1000.0, now / 3600000.0,
+           (double) busyMs / run.uploads);
+
+    printf("\n%-13s %8s %6s %7s %7s %7s %7s %7s %7s\n", "Phase (ms)", "count", "fail", "min", "p50", "p90", "p99",
+           "max", "mean");
+    for (int phase = 1; phase <= SEND_STATS_NUM_PHASES; phase++) {
+        uint32_t count = numPhaseSamples[phase];
+        if (count == 0 && phaseFailures[phase] == 0) {
+            continue;
+        }
+        printf("%-13s %8u %6u", phaseNames[phase], count, phaseFailures[phase]);
+        if (count > 0) {
+            uint32_t *sorted = phaseSamples[phase];
+            qsort(sorted, count, sizeof(uint32_t), compareU32);
+            uint64_t sum = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                sum += sorted[i];
+            }
+            printf(" %7u %7u %7u %7u %7u %7.0f", sorted[0], percentile(sorted, count, 50), percentile(sorted, count, 90),
+                   percentile(sorted, count, 99), sorted[count - 1], (double) sum / count);
+        }
+        printf("\n");
+    }
+
+    printf("\nFailed uploads by phase and cause:\n");
+    for (int phase = 0; phase <= SEND_STATS_NUM_PHASES; phase++) {
+        for (int src = 0; src < 16; src++) {
+            if (failuresBySrc[phase][src] > 0) {
+                printf("  %-13s %-16s %u\n", phaseNames[phase],
+                       (src < (int) (sizeof(errorSrcNames) / sizeof(errorSrcNames[0]))) ? errorSrcNames[src] : "?",
+                       failuresBySrc[phase][src]);
+            }
+        }
+    }
+
+    printf("\nState machine: %u stale events, %u stale reports, %u timeouts, %u queue overflows\n",
+           counters.staleEvents, counters.staleReports, counters.timeouts, counters.queueOverflows);
+    printf("Fake stack:    %-10s %8s %8s %8s %8s %8s %8s %8s\n", "", "requests", "refused", "errors", "dropped",
+           "late", "twice", "lostlink");
+    for (int i = 0; i < SIM_NUM_REQUESTS; i++) {
+        sim_fault_counters_t *c = &faultCounters[i];
+        if (c->requests == 0) {
+            continue;
+        }
+        printf("               %-10s %8u %8u %8u %8u %8u %8u %8u\n", requestNames[i], c->requests, c->rejected,
+               c->errors, c->dropped, c->late, c->duplicated, c->linkLosses);
+    }
+    printf("               %u stray events\n", numStrays);
+
+    const phy_policy_t *policy = SendLink_getPhyPolicy();
+    printf("\nPHY:           asked for 2M %u, Coded S2 %u, Coded S8 %u times, %u refused\n", phyRequests[PHY_MODE_2M],
+           phyRequests[PHY_MODE_CODED_S2], phyRequests[PHY_MODE_CODED_S8], phyRefusals);
+    printf("               uploads on 2M %u, 1M %u, Coded S2 %u, Coded S8 %u, ending on %s\n", policy->uploads[PHY_MODE_2M],
+           policy->uploads[PHY_MODE_1M], policy->uploads[PHY_MODE_CODED_S2], policy->uploads[PHY_MODE_CODED_S8],
+           PhyPolicy_modeName(policy->mode));
+    printf("               switches:");
+    for (int reason = PHY_REASON_NONE + 1; reason < PHY_REASON_COUNT; reason++) {
+        printf(" %s %u%s", PhyPolicy_reasonName(reason), policy->switches[reason], (reason + 1 < PHY_REASON_COUNT) ? "," : "\n");
+    }
+
+    printf("\nChecks:        %u uploads reported good that didn't deliver their writes, %u failed only for the "
+           "disconnect, %u session reads with the wrong value, %u connections left open\n", mismatches, disconnectFailed,
+           sessionMismatches, connectionsLeftOpen);
+    printf("               %u uploads that asked for the wrong PHY, %u that fed the policy the wrong RSSI, "
+           "%u refusals the policy missed\n", phyWrongRequests, phyWrongRssi, phyMissedRefusals);
+    return (mismatches > 0 || disconnectFailed > 0 || sessionMismatches > 0 || connectionsLeftOpen > 0 ||
+            phyWrongRequests > 0 || phyWrongRssi > 0 || phyMissedRefusals > 0) ? 1 : 0;
+}